@@ -0,0 +1,832 @@
+// AllocatorFuzz - случайные последовательности операций над аллокаторами без D3D. Рядом ведется
+// теневая модель, инварианты проверяются после каждой операции.
+//
+//   AllocatorFuzz [-seed 1] [-ops 20000] [-suite tlsf|descriptors|ring|release]
+//       tlsf - TlsfAllocator так, как его ведет GpuHeapAllocator: выделения с выравниванием до
+//       64 КБ, освобождения, перенос PlanMove с копированием содержимого и освобождением
+//       старого места после имитированного fence, отказ размещения копии. Проверяет границы,
+//       выравнивание, непересечение, содержимое каждого выделения (и после переноса),
+//       Validate и статистику; в конце все освобождается - аллокатор пуст одним блоком.
+//       descriptors - DescriptorAllocator: постоянные диапазоны против карты занятости (выдан,
+//       ждет fence, свободен), отказ только без подходящего свободного отрезка, слияние
+//       свободных (largestFree), устаревшие handle после освобождения и повторной выдачи того
+//       же места, переходящие диапазоны кадра - не пересекаются с еще читаемыми GPU.
+//       ring - UploadRingAllocator с имитацией fence: блоки отправляются в случайном порядке,
+//       часть бросается без отправки (Retire с fence 0, как ~Allocation), GPU отстает на
+//       0-2 кадра. Теневая очередь освобождает блоки по порядку и только после их fence;
+//       новый блок не должен задеть содержимое еще не освобожденных, в том числе через
+//       переход через конец кольца. Пустая очередь - кольцо пусто и принимает любой размер.
+//       release - DeferredReleaseQueue<unique_ptr>: объекты сдаются с fence в любом порядке,
+//       часть при уничтожении сдает в очередь новый. Каждый уничтожается ровно один раз,
+//       только в Reclaim или Clear и только с пройденным fence; Reclaim возвращает их число.
+//       Печатает первые ошибки с номером операции; код возврата 1, если ошибки были.
+//       Одинаковый -seed повторяет ту же последовательность.
+#include "../TlsfAllocator.h"
+#include "../DescriptorAllocator.h"
+#include "../UploadRingAllocator.h"
+#include "../DeferredReleaseQueue.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::mt19937_64 Rng;
+
+static const uint32_t kMaxPrinted = 10;
+
+// Ошибки одного набора: первые kMaxPrinted печатаются, остальные только считаются
+struct Checker
+{
+	const char* suite;
+	uint64_t op = 0;
+	uint32_t errors = 0;
+
+	explicit Checker(const char* name) : suite(name) {}
+
+	void Fail(const char* format, ...)
+	{
+		if (errors++ >= kMaxPrinted) return;
+		printf("%-11s op %llu: ", suite, (unsigned long long)op);
+		va_list args;
+		va_start(args, format);
+		vprintf(format, args);
+		va_end(args);
+		printf("\n");
+	}
+};
+
+static uint64_t Uniform(Rng& rng, uint64_t lo, uint64_t hi)
+{
+	return std::uniform_int_distribution<uint64_t>(lo, hi)(rng);
+}
+
+static bool Chance(Rng& rng, double p)
+{
+	return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < p;
+}
+
+// Содержимое выделения однозначно задается его меткой: перезапись чужим выделением или
+// потеря данных при переносе видны при сверке
+static uint8_t Pattern(uint32_t tag, uint64_t i)
+{
+	return (uint8_t)(tag * 0x9E3779B1u + (uint32_t)i * 131u + (uint32_t)(i >> 8));
+}
+
+static void Fill(uint8_t* data, uint64_t size, uint32_t tag)
+{
+	for (uint64_t i = 0; i < size; ++i) data[i] = Pattern(tag, i);
+}
+
+static bool Matches(const uint8_t* data, uint64_t size, uint32_t tag)
+{
+	for (uint64_t i = 0; i < size; ++i)
+		if (data[i] != Pattern(tag, i)) return false;
+	return true;
+}
+
+static void PrintResult(const Checker& check, const char* details)
+{
+	printf("%-11s %llu ops: %s - %s\n", check.suite, (unsigned long long)check.op, details,
+		check.errors ? "FAILED" : "ok");
+	if (check.errors > kMaxPrinted) printf("%-11s %u more errors not shown\n", check.suite, check.errors - kMaxPrinted);
+}
+
+// ---------------------------------------------------------------------------------------------
+// TlsfAllocator
+
+namespace
+{
+	// Выделение владельца. Во время переноса живы оба места: moveTo - копия, from еще читается
+	struct TlsfOwner
+	{
+		uint32_t handle;
+		uint64_t size;
+		uint64_t alignment;
+		uint32_t tag;
+		bool movable = false;
+		uint32_t moveTo = TlsfAllocator::InvalidHandle;
+		uint64_t moveFence = 0;
+	};
+}
+
+static uint64_t RandomTlsfSize(Rng& rng)
+{
+	const uint64_t kind = Uniform(rng, 0, 99);
+	if (kind < 70) return Uniform(rng, 1, 4096);
+	if (kind < 95) return Uniform(rng, 4096, 65536);
+	return Uniform(rng, 65536, 512 * 1024);
+}
+
+static void CheckTlsf(const TlsfAllocator& tlsf, const std::vector<TlsfOwner>& owners, uint64_t capacity, Checker& check)
+{
+	if (!tlsf.Validate()) check.Fail("Validate failed");
+
+	struct Range
+	{
+		uint64_t offset, size;
+		uint32_t handle;
+	};
+	std::vector<Range> ranges;
+	uint64_t used = 0;
+	auto add = [&](uint32_t handle, uint64_t size, uint64_t alignment) {
+		const uint64_t offset = tlsf.GetOffset(handle);
+		if (tlsf.GetSize(handle) != size)
+			check.Fail("handle %u: size %llu, expected %llu", handle, (unsigned long long)tlsf.GetSize(handle), (unsigned long long)size);
+		if (offset % alignment)
+			check.Fail("handle %u: offset %llu not aligned to %llu", handle, (unsigned long long)offset, (unsigned long long)alignment);
+		if (offset > capacity || size > capacity - offset)
+			check.Fail("handle %u: [%llu, +%llu) outside capacity", handle, (unsigned long long)offset, (unsigned long long)size);
+		ranges.push_back({ offset, size, handle });
+		used += size;
+	};
+	for (const TlsfOwner& o : owners)
+	{
+		add(o.handle, o.size, o.alignment);
+		if (o.moveTo != TlsfAllocator::InvalidHandle) add(o.moveTo, o.size, o.alignment);
+	}
+
+	std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.offset < b.offset; });
+	for (size_t i = 1; i < ranges.size(); ++i)
+	{
+		if (ranges[i - 1].offset + ranges[i - 1].size <= ranges[i].offset) continue;
+		check.Fail("handles %u and %u overlap at %llu", ranges[i - 1].handle, ranges[i].handle, (unsigned long long)ranges[i].offset);
+	}
+
+	const TlsfAllocator::Stats stats = tlsf.GetStats();
+	if (stats.used != used || stats.allocations != ranges.size())
+		check.Fail("stats: %llu bytes in %u allocations, expected %llu in %zu", (unsigned long long)stats.used,
+			stats.allocations, (unsigned long long)used, ranges.size());
+}
+
+static uint32_t FuzzTlsf(uint64_t seed, uint64_t ops)
+{
+	Checker check("tlsf");
+	Rng rng(seed);
+	const uint64_t capacity = 8ull << 20;
+	TlsfAllocator tlsf(capacity);
+	std::vector<uint8_t> memory(capacity);
+	std::vector<TlsfOwner> owners;
+	uint32_t nextTag = 1;
+	uint64_t fence = 0, completed = 0;
+	uint64_t allocations = 0, failed = 0, moves = 0, cancelled = 0;
+	double peakUsed = 0.0, peakFragmentation = 0.0;
+
+	auto verify = [&](uint32_t handle, const TlsfOwner& o, const char* what) {
+		if (!Matches(&memory[tlsf.GetOffset(handle)], o.size, o.tag))
+			check.Fail("handle %u (%s): contents of tag %u damaged", handle, what, o.tag);
+	};
+	// Fence пройден: владелец переключается на копию, старое место освобождается
+	auto finishMoves = [&](uint64_t done) {
+		for (TlsfOwner& o : owners)
+		{
+			if (o.moveTo == TlsfAllocator::InvalidHandle || o.moveFence > done) continue;
+			verify(o.moveTo, o, "moved");
+			tlsf.Free(o.handle);
+			o.handle = o.moveTo;
+			o.moveTo = TlsfAllocator::InvalidHandle;
+			// Владелец снова помечает ресурс переносимым (SetRelocatable у нового ресурса)
+			tlsf.SetMovable(o.handle, o.movable);
+		}
+	};
+
+	for (check.op = 0; check.op < ops; ++check.op)
+	{
+		const uint64_t action = Uniform(rng, 0, 99);
+		if (action < 45)
+		{
+			const uint64_t size = RandomTlsfSize(rng);
+			const uint64_t alignment = 1ull << Uniform(rng, 0, 16);
+			const uint32_t handle = tlsf.Allocate(size, alignment);
+			++allocations;
+			if (handle == TlsfAllocator::InvalidHandle)
+			{
+				++failed;
+				continue;
+			}
+			TlsfOwner o = { handle, size, alignment, nextTag++ };
+			o.movable = Chance(rng, 0.7);
+			tlsf.SetMovable(handle, o.movable);
+			// Место проверяется до записи: пересечение с живым выделением испортит его метку
+			const uint64_t offset = tlsf.GetOffset(handle);
+			if (offset <= capacity && size <= capacity - offset) Fill(&memory[offset], size, o.tag);
+			owners.push_back(o);
+		}
+		else if (action < 80)
+		{
+			if (owners.empty()) continue;
+			const size_t i = (size_t)Uniform(rng, 0, owners.size() - 1);
+			// Ресурс, который копируется, владелец не освобождает до конца переноса
+			if (owners[i].moveTo != TlsfAllocator::InvalidHandle) continue;
+			verify(owners[i].handle, owners[i], "freed");
+			tlsf.Free(owners[i].handle);
+			owners[i] = owners.back();
+			owners.pop_back();
+		}
+		else if (action < 85)
+		{
+			if (owners.empty()) continue;
+			TlsfOwner& o = owners[(size_t)Uniform(rng, 0, owners.size() - 1)];
+			if (o.moveTo != TlsfAllocator::InvalidHandle) continue;
+			o.movable = !o.movable;
+			tlsf.SetMovable(o.handle, o.movable);
+		}
+		else if (action < 90)
+		{
+			// Как GpuHeapAllocator::Defragment: переносы, пока не набран бюджет и куча фрагментирована
+			const uint64_t budget = Uniform(rng, 1, 1ull << 20);
+			const double minFragmentation = Uniform(rng, 0, 4) * 0.1;
+			uint64_t moved = 0;
+			while (moved < budget && tlsf.GetStats().fragmentation >= minFragmentation)
+			{
+				uint32_t from, to;
+				if (!tlsf.PlanMove(from, to)) break;
+				auto it = std::find_if(owners.begin(), owners.end(), [&](const TlsfOwner& o) { return o.handle == from; });
+				if (it == owners.end() || it->moveTo != TlsfAllocator::InvalidHandle || !it->movable)
+				{
+					check.Fail("PlanMove chose handle %u that is not a movable idle allocation", from);
+					tlsf.Free(to);
+					break;
+				}
+				if (tlsf.GetOffset(to) >= tlsf.GetOffset(from))
+					check.Fail("PlanMove moves handle %u up: %llu -> %llu", from, (unsigned long long)tlsf.GetOffset(from),
+						(unsigned long long)tlsf.GetOffset(to));
+				if (Chance(rng, 0.02))
+				{
+					// Копию не удалось разместить: место возвращается, ресурс остается переносимым
+					tlsf.Free(to);
+					tlsf.SetMovable(from, true);
+					++cancelled;
+					break;
+				}
+				it->moveTo = to;
+				it->moveFence = fence + 1;
+				memmove(&memory[tlsf.GetOffset(to)], &memory[tlsf.GetOffset(from)], (size_t)it->size);
+				moved += it->size;
+				++moves;
+			}
+		}
+		else
+		{
+			// Конец кадра: GPU отстает на 0-2 кадра
+			++fence;
+			completed = std::max(completed, fence - std::min<uint64_t>(fence, Uniform(rng, 0, 2)));
+			finishMoves(completed);
+		}
+
+		CheckTlsf(tlsf, owners, capacity, check);
+		const TlsfAllocator::Stats stats = tlsf.GetStats();
+		peakUsed = std::max(peakUsed, (double)stats.used / capacity);
+		peakFragmentation = std::max(peakFragmentation, stats.fragmentation);
+		if (check.op % 4096 == 0)
+			for (const TlsfOwner& o : owners) verify(o.handle, o, "sweep");
+	}
+
+	finishMoves(~0ull);
+	for (const TlsfOwner& o : owners)
+	{
+		verify(o.handle, o, "final");
+		tlsf.Free(o.handle);
+	}
+	owners.clear();
+	const TlsfAllocator::Stats stats = tlsf.GetStats();
+	if (!tlsf.IsEmpty() || !tlsf.Validate() || stats.used != 0 || stats.freeBlocks != 1 || stats.largestFree != capacity)
+		check.Fail("leak: %llu bytes in %u allocations, %u free blocks after freeing everything",
+			(unsigned long long)stats.used, stats.allocations, stats.freeBlocks);
+
+	char details[256];
+	snprintf(details, sizeof(details), "%llu allocations (%llu failed), %llu moves (%llu cancelled), peak %.1f%% used, "
+		"peak fragmentation %.2f", (unsigned long long)allocations, (unsigned long long)failed, (unsigned long long)moves,
+		(unsigned long long)cancelled, peakUsed * 100.0, peakFragmentation);
+	PrintResult(check, details);
+	return check.errors;
+}
+
+// ---------------------------------------------------------------------------------------------
+// DescriptorAllocator
+
+namespace
+{
+	enum DescriptorState : uint8_t
+	{
+		DescriptorFree,
+		DescriptorLive,
+		// Освобожден, но кадры до fence еще читают
+		DescriptorPending,
+	};
+
+	struct DescriptorOwner
+	{
+		DescriptorAllocator::Handle handle;
+		uint32_t tag;
+	};
+
+	struct DescriptorRange
+	{
+		uint32_t index;
+		uint32_t count;
+		uint64_t fence;
+	};
+}
+
+static uint32_t LargestFreeRun(const std::vector<uint8_t>& state)
+{
+	uint32_t best = 0, run = 0;
+	for (uint8_t s : state)
+	{
+		run = s == DescriptorFree ? run + 1 : 0;
+		best = std::max(best, run);
+	}
+	return best;
+}
+
+static uint32_t FuzzDescriptors(uint64_t seed, uint64_t ops)
+{
+	Checker check("descriptors");
+	Rng rng(seed);
+	const uint32_t persistent = 4096, transient = 512;
+	DescriptorAllocator descriptors(persistent, transient);
+	// Карта занятости и "содержимое" постоянной части: метка владельца в каждом дескрипторе
+	std::vector<uint8_t> state(persistent, DescriptorFree);
+	std::vector<uint32_t> slots(persistent, 0);
+	std::vector<DescriptorOwner> owners;
+	std::vector<DescriptorRange> pending, frame;
+	std::vector<DescriptorAllocator::Handle> stale;
+	uint32_t nextTag = 1;
+	uint64_t fence = 1, completed = 0;
+	uint64_t allocations = 0, failed = 0, transients = 0, transientFailed = 0, reused = 0;
+
+	auto mark = [&](uint32_t index, uint32_t count, DescriptorState s) {
+		for (uint32_t i = index; i < index + count; ++i) state[i] = s;
+	};
+	auto reclaim = [&](uint64_t done) {
+		descriptors.Reclaim(done);
+		size_t kept = 0;
+		for (const DescriptorRange& p : pending)
+		{
+			if (p.fence > done) pending[kept++] = p;
+			else mark(p.index, p.count, DescriptorFree);
+		}
+		pending.resize(kept);
+		kept = 0;
+		for (const DescriptorRange& r : frame)
+			if (r.fence > done) frame[kept++] = r;
+		frame.resize(kept);
+	};
+
+	for (check.op = 0; check.op < ops; ++check.op)
+	{
+		const uint64_t action = Uniform(rng, 0, 99);
+		if (action < 35)
+		{
+			const uint32_t count = (uint32_t)(Chance(rng, 0.9) ? Uniform(rng, 1, 16) : Uniform(rng, 17, 512));
+			const DescriptorAllocator::Handle h = descriptors.Allocate(count);
+			++allocations;
+			if (h.IsEmpty())
+			{
+				++failed;
+				const uint32_t largest = LargestFreeRun(state);
+				if (largest >= count) check.Fail("Allocate(%u) failed with a free run of %u", count, largest);
+				continue;
+			}
+			if (h.count != count || h.index >= persistent || count > persistent - h.index)
+			{
+				check.Fail("Allocate(%u) returned [%u, +%u)", count, h.index, h.count);
+				continue;
+			}
+			for (uint32_t i = h.index; i < h.index + count; ++i)
+			{
+				if (state[i] == DescriptorFree) continue;
+				check.Fail("Allocate(%u) returned [%u, +%u), descriptor %u is %s", count, h.index, count, i,
+					state[i] == DescriptorLive ? "in use" : "still read by the GPU");
+				break;
+			}
+			reused += std::any_of(stale.begin(), stale.end(), [&](const DescriptorAllocator::Handle& s) { return s.index == h.index; });
+			mark(h.index, count, DescriptorLive);
+			const DescriptorOwner o = { h, nextTag++ };
+			for (uint32_t i = h.index; i < h.index + count; ++i) slots[i] = o.tag;
+			owners.push_back(o);
+		}
+		else if (action < 65)
+		{
+			if (owners.empty()) continue;
+			const size_t i = (size_t)Uniform(rng, 0, owners.size() - 1);
+			DescriptorAllocator::Handle h = owners[i].handle;
+			for (uint32_t k = h.index; k < h.index + h.count; ++k)
+			{
+				if (slots[k] == owners[i].tag) continue;
+				check.Fail("descriptor %u of tag %u overwritten by tag %u", k, owners[i].tag, slots[k]);
+				break;
+			}
+			const DescriptorAllocator::Handle old = h;
+			descriptors.Free(h, fence);
+			if (!h.IsEmpty()) check.Fail("Free did not clear the handle of [%u, +%u)", old.index, old.count);
+			mark(old.index, old.count, DescriptorPending);
+			pending.push_back({ old.index, old.count, fence });
+			if (stale.size() < 256) stale.push_back(old);
+			else stale[(size_t)Uniform(rng, 0, stale.size() - 1)] = old;
+			owners[i] = owners.back();
+			owners.pop_back();
+		}
+		else if (action < 85)
+		{
+			const uint32_t count = (uint32_t)Uniform(rng, 1, 96);
+			const uint32_t index = descriptors.AllocateTransient(count, fence);
+			++transients;
+			if (index == DescriptorAllocator::InvalidIndex)
+			{
+				++transientFailed;
+				if (frame.empty()) check.Fail("AllocateTransient(%u) failed on an empty ring", count);
+				continue;
+			}
+			if (index < persistent || index - persistent > transient - count)
+			{
+				check.Fail("AllocateTransient(%u) returned %u outside the transient ring", count, index);
+				continue;
+			}
+			for (const DescriptorRange& r : frame)
+			{
+				if (index + count <= r.index || r.index + r.count <= index) continue;
+				check.Fail("AllocateTransient(%u) returned [%u, +%u), overlaps [%u, +%u) of fence %llu (completed %llu)",
+					count, index, count, r.index, r.count, (unsigned long long)r.fence, (unsigned long long)completed);
+				break;
+			}
+			frame.push_back({ index, count, fence });
+		}
+		else
+		{
+			// Конец кадра: GPU отстает на 0-2 кадра
+			++fence;
+			completed = std::max(completed, fence - 1 - std::min<uint64_t>(fence - 1, Uniform(rng, 0, 2)));
+			reclaim(completed);
+		}
+
+		for (const DescriptorOwner& o : owners)
+		{
+			if (descriptors.Resolve(o.handle) == o.handle.index) continue;
+			check.Fail("live handle [%u, +%u) gen %u does not resolve", o.handle.index, o.handle.count, o.handle.generation);
+			break;
+		}
+		for (const DescriptorAllocator::Handle& s : stale)
+		{
+			if (!descriptors.IsValid(s) && descriptors.Resolve(s) == DescriptorAllocator::InvalidIndex) continue;
+			check.Fail("freed handle [%u, +%u) gen %u still resolves", s.index, s.count, s.generation);
+			break;
+		}
+		uint32_t used = 0, waiting = 0;
+		for (uint8_t s : state)
+		{
+			used += s == DescriptorLive;
+			waiting += s == DescriptorPending;
+		}
+		const DescriptorAllocator::Stats stats = descriptors.GetStats();
+		const uint32_t largest = LargestFreeRun(state);
+		if (stats.used != used || stats.ranges != owners.size() || stats.pending != waiting || stats.largestFree != largest)
+			check.Fail("stats: used %u, ranges %u, pending %u, largest free %u; expected %u, %zu, %u, %u", stats.used,
+				stats.ranges, stats.pending, stats.largestFree, used, owners.size(), waiting, largest);
+	}
+
+	for (DescriptorOwner& o : owners) descriptors.Free(o.handle, fence);
+	owners.clear();
+	reclaim(fence);
+	const DescriptorAllocator::Stats stats = descriptors.GetStats();
+	if (stats.used || stats.ranges || stats.pending || stats.largestFree != persistent || stats.transientUsed)
+		check.Fail("leak: used %u, ranges %u, pending %u, largest free %u, transient used %u after freeing everything",
+			stats.used, stats.ranges, stats.pending, stats.largestFree, stats.transientUsed);
+
+	char details[256];
+	snprintf(details, sizeof(details), "%llu allocations (%llu failed), %llu ranges reissued to stale handles, "
+		"%llu transient (%llu failed)", (unsigned long long)allocations, (unsigned long long)failed, (unsigned long long)reused,
+		(unsigned long long)transients, (unsigned long long)transientFailed);
+	PrintResult(check, details);
+	return check.errors;
+}
+
+// ---------------------------------------------------------------------------------------------
+// UploadRingAllocator
+
+namespace
+{
+	struct RingBlock
+	{
+		uint32_t id;
+		uint64_t offset;
+		uint64_t size;
+		uint32_t tag;
+		bool retired = false;
+		uint64_t fence = 0;
+	};
+}
+
+static uint32_t FuzzUploadRing(uint64_t seed, uint64_t ops)
+{
+	Checker check("ring");
+	Rng rng(seed);
+	const uint64_t capacity = 64 * 1024;
+	UploadRingAllocator ring(capacity);
+	std::vector<uint8_t> memory(capacity);
+	// Теневая очередь: блоки в порядке выделения, пока их не освободил бы Reclaim
+	std::deque<RingBlock> blocks;
+	uint32_t nextTag = 1;
+	uint64_t fence = 1, completed = 0;
+	uint64_t allocations = 0, failed = 0, wraps = 0, abandoned = 0, peakUsed = 0;
+	uint64_t lastOffset = 0;
+	uint32_t lastId = 0;
+	bool anyId = false;
+
+	auto reclaim = [&](uint64_t done) {
+		ring.Reclaim(done);
+		while (!blocks.empty() && blocks.front().retired && blocks.front().fence <= done)
+		{
+			const RingBlock& b = blocks.front();
+			if (!Matches(&memory[b.offset], b.size, b.tag))
+				check.Fail("block %u [%llu, +%llu) overwritten before its fence %llu passed", b.id,
+					(unsigned long long)b.offset, (unsigned long long)b.size, (unsigned long long)b.fence);
+			blocks.pop_front();
+		}
+		if (blocks.empty() && (ring.GetUsed() || ring.GetLiveBlocks()))
+			check.Fail("all blocks reclaimed, ring still holds %llu bytes in %zu blocks",
+				(unsigned long long)ring.GetUsed(), ring.GetLiveBlocks());
+	};
+
+	for (check.op = 0; check.op < ops; ++check.op)
+	{
+		const uint64_t action = Uniform(rng, 0, 99);
+		if (action < 45)
+		{
+			const uint64_t kind = Uniform(rng, 0, 99);
+			const uint64_t size = kind < 80 ? Uniform(rng, 1, 2048) : kind < 98 ? Uniform(rng, 2048, capacity / 2) : Uniform(rng, capacity / 2, capacity + 1024);
+			const uint64_t alignment = 1ull << Uniform(rng, 0, 9);
+			uint32_t id = 0;
+			const uint64_t offset = ring.Allocate(size, alignment, id);
+			++allocations;
+			if (offset == UploadRingAllocator::InvalidOffset)
+			{
+				++failed;
+				if (blocks.empty() && size <= capacity) check.Fail("Allocate(%llu) failed on an empty ring", (unsigned long long)size);
+				continue;
+			}
+			if (size > capacity) check.Fail("Allocate(%llu) succeeded, larger than the ring", (unsigned long long)size);
+			if (offset % alignment || offset > capacity || size > capacity - offset)
+			{
+				check.Fail("Allocate(%llu, %llu) returned %llu", (unsigned long long)size, (unsigned long long)alignment, (unsigned long long)offset);
+				continue;
+			}
+			if (anyId && id <= lastId) check.Fail("block id %u after %u", id, lastId);
+			for (const RingBlock& b : blocks)
+			{
+				if (offset + size <= b.offset || b.offset + b.size <= offset) continue;
+				check.Fail("block %u [%llu, +%llu) overlaps block %u [%llu, +%llu), %s", id, (unsigned long long)offset,
+					(unsigned long long)size, b.id, (unsigned long long)b.offset, (unsigned long long)b.size,
+					b.retired ? "fence not passed" : "not retired");
+				break;
+			}
+			wraps += !blocks.empty() && offset < lastOffset;
+			lastOffset = offset;
+			lastId = id;
+			anyId = true;
+			RingBlock b;
+			b.id = id;
+			b.offset = offset;
+			b.size = size;
+			b.tag = nextTag++;
+			Fill(&memory[offset], size, b.tag);
+			blocks.push_back(b);
+		}
+		else if (action < 85)
+		{
+			// Отправка в произвольном порядке: копирования пишутся разными задачами загрузки
+			std::vector<size_t> open;
+			for (size_t i = 0; i < blocks.size(); ++i)
+				if (!blocks[i].retired) open.push_back(i);
+			if (open.empty()) continue;
+			RingBlock& b = blocks[open[(size_t)Uniform(rng, 0, open.size() - 1)]];
+			b.retired = true;
+			// Allocation уничтожена без отправки - ~Allocation возвращает блок с fence 0
+			b.fence = Chance(rng, 0.1) ? 0 : fence;
+			abandoned += b.fence == 0;
+			ring.Retire(b.id, b.fence);
+		}
+		else
+		{
+			++fence;
+			completed = std::max(completed, fence - 1 - std::min<uint64_t>(fence - 1, Uniform(rng, 0, 2)));
+			reclaim(completed);
+		}
+		peakUsed = std::max(peakUsed, ring.GetUsed());
+		if (ring.GetUsed() > capacity) check.Fail("used %llu over capacity", (unsigned long long)ring.GetUsed());
+	}
+
+	for (RingBlock& b : blocks)
+	{
+		if (b.retired) continue;
+		b.retired = true;
+		ring.Retire(b.id, 0);
+	}
+	reclaim(fence);
+	if (!blocks.empty()) check.Fail("%zu blocks left after the last fence", blocks.size());
+
+	char details[256];
+	snprintf(details, sizeof(details), "%llu allocations (%llu failed), %llu wraps, %llu abandoned, peak %.1f%% used",
+		(unsigned long long)allocations, (unsigned long long)failed, (unsigned long long)wraps, (unsigned long long)abandoned,
+		100.0 * peakUsed / capacity);
+	PrintResult(check, details);
+	return check.errors;
+}
+
+// ---------------------------------------------------------------------------------------------
+// DeferredReleaseQueue
+
+namespace
+{
+	class TrackedObject;
+	typedef DeferredReleaseQueue<std::unique_ptr<TrackedObject>> TrackedQueue;
+
+	// Теневое состояние объектов очереди по номеру
+	struct ReleaseLog
+	{
+		enum State : uint8_t
+		{
+			Queued,
+			Destroyed,
+		};
+
+		Checker* check = nullptr;
+		TrackedQueue* queue = nullptr;
+		std::vector<State> state;
+		std::vector<uint64_t> fence;
+		uint64_t completed = 0;
+		uint64_t current = 0;
+		// Идет Reclaim или Clear - только там объекты и могут уничтожаться
+		bool releasing = false;
+		bool clearing = false;
+		uint64_t destroyedNow = 0;
+		uint64_t spawned = 0;
+
+		uint32_t Add(uint64_t objectFence)
+		{
+			state.push_back(Queued);
+			fence.push_back(objectFence);
+			return (uint32_t)state.size() - 1;
+		}
+		void Retire(bool spawns, uint64_t objectFence);
+		void OnDestroyed(uint32_t id);
+	};
+
+	// Как ресурс, освобождение которого тянет за собой еще один (кучу, буфер загрузки)
+	class TrackedObject
+	{
+	public:
+		TrackedObject(ReleaseLog& log, uint32_t id, bool spawns) : m_log(log), m_id(id), m_spawns(spawns) {}
+		~TrackedObject()
+		{
+			m_log.OnDestroyed(m_id);
+			if (m_spawns && !m_log.clearing)
+			{
+				++m_log.spawned;
+				m_log.Retire(false, m_log.current);
+			}
+		}
+
+	private:
+		ReleaseLog& m_log;
+		uint32_t m_id;
+		bool m_spawns;
+	};
+
+	void ReleaseLog::Retire(bool spawns, uint64_t objectFence)
+	{
+		const uint32_t id = Add(objectFence);
+		queue->Retire(std::unique_ptr<TrackedObject>(new TrackedObject(*this, id, spawns)), objectFence);
+	}
+
+	void ReleaseLog::OnDestroyed(uint32_t id)
+	{
+		if (state[id] == Destroyed) check->Fail("object %u destroyed twice", id);
+		else if (!releasing) check->Fail("object %u destroyed outside Reclaim and Clear", id);
+		else if (!clearing && fence[id] > completed)
+			check->Fail("object %u destroyed at completed fence %llu, its fence is %llu", id,
+				(unsigned long long)completed, (unsigned long long)fence[id]);
+		state[id] = Destroyed;
+		++destroyedNow;
+	}
+}
+
+static uint32_t FuzzReleaseQueue(uint64_t seed, uint64_t ops)
+{
+	Checker check("release");
+	Rng rng(seed);
+	TrackedQueue queue;
+	ReleaseLog log;
+	log.check = &check;
+	log.queue = &queue;
+	log.current = 1;
+	uint64_t retired = 0, reclaims = 0, released = 0;
+
+	auto queued = [&]() {
+		size_t n = 0;
+		for (ReleaseLog::State s : log.state) n += s == ReleaseLog::Queued;
+		return n;
+	};
+
+	for (check.op = 0; check.op < ops; ++check.op)
+	{
+		if (Uniform(rng, 0, 99) < 70)
+		{
+			// Последняя работа - в этом кадре или в одном из еще не пройденных; иногда уже пройдена
+			const uint64_t back = Uniform(rng, 0, 3);
+			log.Retire(Chance(rng, 0.1), log.current - std::min(log.current, back));
+			++retired;
+		}
+		else
+		{
+			++log.current;
+			log.completed = std::max(log.completed, log.current - 1 - std::min<uint64_t>(log.current - 1, Uniform(rng, 0, 2)));
+			size_t expected = 0;
+			for (size_t id = 0; id < log.state.size(); ++id)
+				expected += log.state[id] == ReleaseLog::Queued && log.fence[id] <= log.completed;
+			log.releasing = true;
+			log.destroyedNow = 0;
+			const size_t count = queue.Reclaim(log.completed);
+			log.releasing = false;
+			if (count != expected || log.destroyedNow != expected)
+				check.Fail("Reclaim(%llu) returned %zu and destroyed %llu, expected %zu", (unsigned long long)log.completed,
+					count, (unsigned long long)log.destroyedNow, expected);
+			for (size_t id = 0; id < log.state.size(); ++id)
+			{
+				if (log.state[id] != ReleaseLog::Queued || log.fence[id] > log.completed) continue;
+				check.Fail("object %zu with fence %llu survived Reclaim(%llu)", id, (unsigned long long)log.fence[id],
+					(unsigned long long)log.completed);
+				break;
+			}
+			++reclaims;
+			released += count;
+		}
+		if (queue.GetSize() != queued())
+			check.Fail("queue holds %zu objects, expected %zu", queue.GetSize(), queued());
+	}
+
+	log.releasing = true;
+	log.clearing = true;
+	queue.Clear();
+	log.releasing = false;
+	if (!queue.IsEmpty() || queued()) check.Fail("Clear left %zu objects, %zu never destroyed", queue.GetSize(), queued());
+
+	char details[256];
+	snprintf(details, sizeof(details), "%llu retired (%llu from destructors), %llu released by %llu reclaims",
+		(unsigned long long)retired, (unsigned long long)log.spawned, (unsigned long long)released, (unsigned long long)reclaims);
+	PrintResult(check, details);
+	return check.errors;
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t seed = 1, ops = 20000;
+	std::string suite;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-seed") && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+		else if (!strcmp(argv[i], "-ops") && i + 1 < argc) ops = strtoull(argv[++i], nullptr, 10);
+		else if (!strcmp(argv[i], "-suite") && i + 1 < argc) suite = argv[++i];
+		else
+		{
+			printf("usage: AllocatorFuzz [-seed 1] [-ops 20000] [-suite tlsf|descriptors|ring|release]\n");
+			return 1;
+		}
+	}
+
+	uint32_t errors = 0;
+	bool ran = false;
+	if (suite.empty() || suite == "tlsf")
+	{
+		errors += FuzzTlsf(seed, ops);
+		ran = true;
+	}
+	if (suite.empty() || suite == "descriptors")
+	{
+		errors += FuzzDescriptors(seed, ops);
+		ran = true;
+	}
+	if (suite.empty() || suite == "ring")
+	{
+		errors += FuzzUploadRing(seed, ops);
+		ran = true;
+	}
+	if (suite.empty() || suite == "release")
+	{
+		errors += FuzzReleaseQueue(seed, ops);
+		ran = true;
+	}
+	if (!ran)
+	{
+		printf("unknown suite %s\n", suite.c_str());
+		return 1;
+	}
+	printf("seed %llu: %s\n", (unsigned long long)seed, errors ? "FAILED" : "all checks passed");
+	return errors ? 1 : 0;
+}
\ No newline at end of file
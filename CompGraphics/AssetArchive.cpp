@@ -0,0 +1,321 @@
+#include "AssetArchive.h"
+#include "VirtualFileSystem.h"
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+
+static const char kArchiveMagic[4] = { 'C', 'G', 'P', 'K' };
+static const char kSourcePrefix[] = "#source:";
+
+static uint64_t AlignUp(uint64_t v, uint64_t a) { return (v + a - 1) / a * a; }
+
+static void CopyName(char* dst, size_t capacity, const std::string& src)
+{
+	size_t n = std::min(src.size(), capacity - 1);
+	memcpy(dst, src.data(), n);
+	dst[n] = '\0';
+}
+
+std::string AssetArchive::NormalizeName(const std::string& path)
+{
+	return VirtualFileSystem::Normalize(path);
+}
+
+std::string AssetArchive::AssetOf(const std::string& entryName)
+{
+	return entryName.substr(0, entryName.find('#'));
+}
+
+std::string AssetArchive::SourceOf(const std::string& entryName)
+{
+	size_t pos = entryName.find(kSourcePrefix);
+	return pos == std::string::npos ? AssetOf(entryName) : entryName.substr(pos + sizeof(kSourcePrefix) - 1);
+}
+
+bool AssetArchive::StampFile(const std::string& diskPath, AssetSourceStamp& stamp)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(diskPath.c_str(), GetFileExInfoStandard, &data)) return false;
+	stamp.size = (uint64_t)data.nFileSizeHigh << 32 | data.nFileSizeLow;
+	stamp.time = (uint64_t)data.ftLastWriteTime.dwHighDateTime << 32 | data.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+static AssetSourceStamp StampOrUnknown(const std::string& diskPath)
+{
+	AssetSourceStamp stamp;
+	AssetArchive::StampFile(diskPath, stamp);
+	return stamp;
+}
+
+bool AssetArchive::Open(const std::string& path)
+{
+	Close();
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(m_file, &fileSize) || (uint64_t)fileSize.QuadPart < sizeof(ArchiveHeader)) { Close(); return false; }
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping) { Close(); return false; }
+	m_base = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_base) { Close(); return false; }
+	m_size = (size_t)fileSize.QuadPart;
+
+	m_header = reinterpret_cast<const ArchiveHeader*>(m_base);
+	bool valid = memcmp(m_header->magic, kArchiveMagic, 4) == 0 && m_header->version == Version &&
+		m_header->indexOffset <= m_size && m_header->indexSize <= m_size - m_header->indexOffset &&
+		(uint64_t)m_header->entryCount * sizeof(ArchiveEntry) <= m_header->indexSize;
+	if (valid)
+	{
+		m_entries = reinterpret_cast<const ArchiveEntry*>(m_base + m_header->indexOffset);
+		m_names = reinterpret_cast<const char*>(m_entries + m_header->entryCount);
+		uint64_t namesSize = m_header->indexSize - (uint64_t)m_header->entryCount * sizeof(ArchiveEntry);
+		for (uint32_t i = 0; i < m_header->entryCount && valid; ++i)
+		{
+			const ArchiveEntry& e = m_entries[i];
+			valid = e.offset <= m_size && e.size <= m_size - e.offset &&
+				(uint64_t)e.nameOffset + e.nameLength <= namesSize;
+		}
+	}
+	if (!valid)
+	{
+		OutputDebugStringA(("[AssetArchive] Invalid archive: " + path + "\n").c_str());
+		Close();
+		return false;
+	}
+	m_path = path;
+	return true;
+}
+
+void AssetArchive::Close()
+{
+	if (m_base) UnmapViewOfFile(m_base);
+	if (m_mapping) CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = nullptr;
+	m_base = nullptr;
+	m_size = 0;
+	m_header = nullptr;
+	m_entries = nullptr;
+	m_names = nullptr;
+	m_path.clear();
+}
+
+std::string AssetArchive::GetEntryName(uint32_t index) const
+{
+	if (!m_header || index >= m_header->entryCount) return std::string();
+	return std::string(m_names + m_entries[index].nameOffset, m_entries[index].nameLength);
+}
+
+AssetBlobType AssetArchive::GetEntryType(uint32_t index) const
+{
+	return m_header && index < m_header->entryCount ? m_entries[index].type : AssetBlobType::Raw;
+}
+
+AssetSourceStamp AssetArchive::GetEntrySource(uint32_t index) const
+{
+	AssetSourceStamp stamp;
+	if (!m_header || index >= m_header->entryCount) return stamp;
+	stamp.size = m_entries[index].sourceSize;
+	stamp.time = m_entries[index].sourceTime;
+	return stamp;
+}
+
+bool AssetArchive::Find(const std::string& name, const uint8_t*& data, size_t& size, AssetBlobType* type) const
+{
+	if (!m_header) return false;
+	const std::string key = NormalizeName(name);
+	const ArchiveEntry* begin = m_entries;
+	const ArchiveEntry* end = m_entries + m_header->entryCount;
+	auto compare = [this](const ArchiveEntry& e, const std::string& k) {
+		return k.compare(0, std::string::npos, m_names + e.nameOffset, e.nameLength) > 0;
+		};
+	const ArchiveEntry* it = std::lower_bound(begin, end, key, compare);
+	if (it == end || key.compare(0, std::string::npos, m_names + it->nameOffset, it->nameLength) != 0)
+		return false;
+	data = m_base + it->offset;
+	size = (size_t)it->size;
+	if (type) *type = it->type;
+	return true;
+}
+
+bool AssetArchive::ReadMesh(const std::string& objPath, ObjMesh& out) const
+{
+	const uint8_t* v = nullptr; const uint8_t* i = nullptr; const uint8_t* s = nullptr; const uint8_t* m = nullptr;
+	size_t vSize = 0, iSize = 0, sSize = 0, mSize = 0;
+	if (!Find(objPath + "#vertices", v, vSize) || !Find(objPath + "#indices", i, iSize) ||
+		!Find(objPath + "#subsets", s, sSize) || !Find(objPath + "#materials", m, mSize))
+		return false;
+
+	// Меш из архива индексируют без проверок (экземпляры, ячейки, BVH): испорченный или
+	// устаревший блоб отклоняется целиком, меш грузится из OBJ
+	const ObjMesh::Vertex* vertices = reinterpret_cast<const ObjMesh::Vertex*>(v);
+	const UINT* indices = reinterpret_cast<const UINT*>(i);
+	const MeshSubset* subsets = reinterpret_cast<const MeshSubset*>(s);
+	const size_t vCount = vSize / sizeof(ObjMesh::Vertex), iCount = iSize / sizeof(UINT), sCount = sSize / sizeof(MeshSubset);
+	bool valid = vSize % sizeof(ObjMesh::Vertex) == 0 && iSize % sizeof(UINT) == 0 &&
+		sSize % sizeof(MeshSubset) == 0 && mSize % sizeof(CookedMaterial) == 0;
+	// Копии сабсетов в архив не пишутся
+	for (size_t k = 0; valid && k < sCount; ++k)
+		valid = subsets[k].instanceCount == 0 && (uint64_t)subsets[k].indexStart + subsets[k].indexCount <= iCount;
+	for (size_t k = 0; valid && k < iCount; ++k) valid = indices[k] < vCount;
+	if (!valid)
+	{
+		OutputDebugStringA(("[AssetArchive] Corrupt mesh, loading OBJ instead: " + objPath + "\n").c_str());
+		return false;
+	}
+
+	out.vertices.assign(vertices, vertices + vCount);
+	out.indices.assign(indices, indices + iCount);
+	out.subsets.assign(subsets, subsets + sCount);
+	out.instances.clear();
+
+	const CookedMaterial* cooked = reinterpret_cast<const CookedMaterial*>(m);
+	out.materials.resize(mSize / sizeof(CookedMaterial));
+	for (size_t k = 0; k < out.materials.size(); ++k)
+	{
+		Material& mat = out.materials[k];
+		mat.name.assign(cooked[k].name, strnlen(cooked[k].name, sizeof(cooked[k].name)));
+		mat.diffuse = XMFLOAT4(cooked[k].diffuse);
+		mat.specular = XMFLOAT4(cooked[k].specular);
+		mat.shininess = cooked[k].shininess;
+		mat.diffuseTexture.assign(cooked[k].diffuseTexture, strnlen(cooked[k].diffuseTexture, sizeof(cooked[k].diffuseTexture)));
+	}
+	return true;
+}
+
+bool AssetArchive::ReadTexture(const std::string& path, TextureLoader::TextureData& out) const
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	AssetBlobType type;
+	if (!Find(path, data, size, &type) || type != AssetBlobType::Texture || size < sizeof(CookedTextureHeader))
+		return false;
+	const CookedTextureHeader* h = reinterpret_cast<const CookedTextureHeader*>(data);
+	if ((uint64_t)h->rowPitch * h->height > size - sizeof(CookedTextureHeader)) return false;
+
+	out.width = h->width;
+	out.height = h->height;
+	out.format = (DXGI_FORMAT)h->format;
+	out.rowPitch = h->rowPitch;
+	const uint8_t* pixels = data + sizeof(CookedTextureHeader);
+	out.pixels.assign(pixels, pixels + (size_t)h->rowPitch * h->height);
+	return true;
+}
+
+void AssetArchiveWriter::AddBlob(const std::string& name, AssetBlobType type, const void* data, size_t size,
+	const AssetSourceStamp& source)
+{
+	std::string key = AssetArchive::NormalizeName(name);
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (Blob& b : m_blobs)
+	{
+		if (b.name != key) continue;
+		b.type = type;
+		b.data.assign(bytes, bytes + size);
+		b.source = source;
+		return;
+	}
+	m_blobs.push_back({ key, type, std::vector<uint8_t>(bytes, bytes + size), source });
+}
+
+bool AssetArchiveWriter::HasBlob(const std::string& name) const
+{
+	std::string key = AssetArchive::NormalizeName(name);
+	for (const Blob& b : m_blobs)
+		if (b.name == key) return true;
+	return false;
+}
+
+void AssetArchiveWriter::AddMesh(const std::string& objPath, const ObjMesh& mesh)
+{
+	const AssetSourceStamp source = StampOrUnknown(objPath);
+	AddBlob(objPath + "#vertices", AssetBlobType::Vertices, mesh.vertices.data(), mesh.vertices.size() * sizeof(ObjMesh::Vertex), source);
+	AddBlob(objPath + "#indices", AssetBlobType::Indices, mesh.indices.data(), mesh.indices.size() * sizeof(UINT), source);
+	AddBlob(objPath + "#subsets", AssetBlobType::Subsets, mesh.subsets.data(), mesh.subsets.size() * sizeof(MeshSubset), source);
+	for (const std::string& library : mesh.materialLibraries)
+		AddBlob(objPath + kSourcePrefix + library, AssetBlobType::Source, nullptr, 0, StampOrUnknown(library));
+
+	std::vector<CookedMaterial> cooked(mesh.materials.size());
+	for (size_t k = 0; k < mesh.materials.size(); ++k)
+	{
+		const Material& mat = mesh.materials[k];
+		CookedMaterial& c = cooked[k];
+		memset(&c, 0, sizeof(c));
+		memcpy(c.diffuse, &mat.diffuse, sizeof(c.diffuse));
+		memcpy(c.specular, &mat.specular, sizeof(c.specular));
+		c.shininess = mat.shininess;
+		CopyName(c.name, sizeof(c.name), mat.name);
+		CopyName(c.diffuseTexture, sizeof(c.diffuseTexture), mat.diffuseTexture);
+	}
+	AddBlob(objPath + "#materials", AssetBlobType::Materials, cooked.data(), cooked.size() * sizeof(CookedMaterial), source);
+}
+
+void AssetArchiveWriter::AddTexture(const std::string& path, const TextureLoader::TextureData& texture)
+{
+	CookedTextureHeader h = { texture.width, texture.height, (uint32_t)texture.format, texture.rowPitch };
+	std::vector<uint8_t> blob(sizeof(h) + texture.pixels.size());
+	memcpy(blob.data(), &h, sizeof(h));
+	if (!texture.pixels.empty()) memcpy(blob.data() + sizeof(h), texture.pixels.data(), texture.pixels.size());
+	AddBlob(path, AssetBlobType::Texture, blob.data(), blob.size(), StampOrUnknown(path));
+}
+
+uint64_t AssetArchiveWriter::GetPayloadSize() const
+{
+	uint64_t total = 0;
+	for (const Blob& b : m_blobs) total += b.data.size();
+	return total;
+}
+
+bool AssetArchiveWriter::Write(const std::string& path, uint32_t pageSize) const
+{
+	std::vector<const Blob*> sorted;
+	for (const Blob& b : m_blobs) sorted.push_back(&b);
+	std::sort(sorted.begin(), sorted.end(), [](const Blob* a, const Blob* b) { return a->name < b->name; });
+
+	// Блобы начинаются с границы страницы: при отображении файла чтение одного ресурса
+	// не подтягивает в память страницы соседних
+	std::vector<ArchiveEntry> entries(sorted.size());
+	std::string names;
+	uint64_t offset = pageSize;
+	for (size_t k = 0; k < sorted.size(); ++k)
+	{
+		ArchiveEntry& e = entries[k];
+		e.offset = offset;
+		e.size = sorted[k]->data.size();
+		e.nameOffset = (uint32_t)names.size();
+		e.nameLength = (uint32_t)sorted[k]->name.size();
+		e.type = sorted[k]->type;
+		e.reserved = 0;
+		e.sourceSize = sorted[k]->source.size;
+		e.sourceTime = sorted[k]->source.time;
+		names += sorted[k]->name;
+		offset = AlignUp(offset + e.size, pageSize);
+	}
+
+	ArchiveHeader header = {};
+	memcpy(header.magic, kArchiveMagic, 4);
+	header.version = AssetArchive::Version;
+	header.pageSize = pageSize;
+	header.entryCount = (uint32_t)entries.size();
+	header.indexOffset = offset;
+	header.indexSize = entries.size() * sizeof(ArchiveEntry) + names.size();
+
+	std::ofstream f(path, std::ios::binary | std::ios::trunc);
+	if (!f.is_open()) return false;
+	std::vector<char> zeros(pageSize, 0);
+	f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	f.write(zeros.data(), pageSize - sizeof(header));
+	for (size_t k = 0; k < sorted.size(); ++k)
+	{
+		const std::vector<uint8_t>& data = sorted[k]->data;
+		if (!data.empty()) f.write(reinterpret_cast<const char*>(data.data()), data.size());
+		uint64_t padded = AlignUp(entries[k].offset + data.size(), pageSize) - (entries[k].offset + data.size());
+		f.write(zeros.data(), (std::streamsize)padded);
+	}
+	if (!entries.empty()) f.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+	f.write(names.data(), names.size());
+	return (bool)f;
+}
\ No newline at end of file
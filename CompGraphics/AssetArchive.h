@@ -0,0 +1,146 @@
+#pragma once
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "OBJLoader.h"
+#include "TextureLoader.h"
+
+// Формат архива (.pak), который пишет AssetCooker:
+//   [ArchiveHeader][блоб, выровненный по странице]...[индекс: ArchiveEntry x N][таблица имен]
+// Записи индекса отсортированы по имени - поиск двоичный, без обращений к ФС.
+// Имена нормализованы так же, как пути VirtualFileSystem.
+// У каждой записи - размер и время изменения исходного файла на момент сборки: если файл в
+// смонтированном каталоге с тех пор изменился, VirtualFileSystem не дает архиву его перекрыть.
+enum class AssetBlobType : uint32_t
+{
+	Raw = 0,
+	Vertices = 1,
+	Indices = 2,
+	Subsets = 3,
+	Materials = 4,
+	Texture = 5,
+	// Пустая запись "<obj>#source:<путь>" - отметка еще одного исходного файла меша (MTL)
+	Source = 6,
+};
+
+// Размер и время последней записи (FILETIME) исходного файла; time 0 - неизвестно, не проверяется
+struct AssetSourceStamp
+{
+	uint64_t size = 0;
+	uint64_t time = 0;
+
+	bool operator==(const AssetSourceStamp& o) const { return size == o.size && time == o.time; }
+	bool operator!=(const AssetSourceStamp& o) const { return !(*this == o); }
+};
+
+#pragma pack(push, 1)
+struct ArchiveHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t pageSize;
+	uint32_t entryCount;
+	uint64_t indexOffset;
+	uint64_t indexSize;
+};
+
+struct ArchiveEntry
+{
+	uint64_t offset;
+	uint64_t size;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	AssetBlobType type;
+	uint32_t reserved;
+	uint64_t sourceSize;
+	uint64_t sourceTime;
+};
+
+struct CookedMaterial
+{
+	float diffuse[4];
+	float specular[4];
+	float shininess;
+	char name[64];
+	char diffuseTexture[260];
+};
+
+struct CookedTextureHeader
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+	uint32_t rowPitch;
+};
+#pragma pack(pop)
+
+// Архив, открытый одним отображением в память. Данные блобов читаются прямо из отображения.
+class AssetArchive
+{
+public:
+	// 2 - сферы в MeshSubset, 3 - копии сабсетов (instanceStart, instanceCount),
+	// 4 - отметки исходных файлов
+	static const uint32_t Version = 4;
+
+	AssetArchive() = default;
+	AssetArchive(const AssetArchive&) = delete;
+	AssetArchive& operator=(const AssetArchive&) = delete;
+	~AssetArchive() { Close(); }
+
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const { return m_base != nullptr; }
+	const std::string& GetPath() const { return m_path; }
+
+	bool Find(const std::string& name, const uint8_t*& data, size_t& size, AssetBlobType* type = nullptr) const;
+	uint32_t GetEntryCount() const { return m_header ? m_header->entryCount : 0; }
+	std::string GetEntryName(uint32_t index) const;
+	AssetBlobType GetEntryType(uint32_t index) const;
+	AssetSourceStamp GetEntrySource(uint32_t index) const;
+
+	// Меш хранится блобами "<obj>#vertices", "#indices", "#subsets", "#materials"
+	bool ReadMesh(const std::string& objPath, ObjMesh& out) const;
+	bool ReadTexture(const std::string& path, TextureLoader::TextureData& out) const;
+
+	static std::string NormalizeName(const std::string& path);
+	// Ассет записи ("<obj>" для "<obj>#vertices") и файл, из которого она собрана
+	static std::string AssetOf(const std::string& entryName);
+	static std::string SourceOf(const std::string& entryName);
+	static bool StampFile(const std::string& diskPath, AssetSourceStamp& stamp);
+
+private:
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = nullptr;
+	const uint8_t* m_base = nullptr;
+	size_t m_size = 0;
+	const ArchiveHeader* m_header = nullptr;
+	const ArchiveEntry* m_entries = nullptr;
+	const char* m_names = nullptr;
+	std::string m_path;
+};
+
+class AssetArchiveWriter
+{
+public:
+	void AddBlob(const std::string& name, AssetBlobType type, const void* data, size_t size,
+		const AssetSourceStamp& source = AssetSourceStamp());
+	// Меш и текстура отмечаются своими файлами на диске (и MTL меша) - пути те же, что у VFS
+	void AddMesh(const std::string& objPath, const ObjMesh& mesh);
+	void AddTexture(const std::string& path, const TextureLoader::TextureData& texture);
+	bool HasBlob(const std::string& name) const;
+
+	bool Write(const std::string& path, uint32_t pageSize = 4096) const;
+	uint64_t GetPayloadSize() const;
+
+private:
+	struct Blob
+	{
+		std::string name;
+		AssetBlobType type;
+		std::vector<uint8_t> data;
+		AssetSourceStamp source;
+	};
+	std::vector<Blob> m_blobs;
+};
\ No newline at end of file
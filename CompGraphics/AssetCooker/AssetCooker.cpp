@@ -0,0 +1,168 @@
+// AssetCooker - офлайн-сборка архива для RenderingSystem::MountArchive.
+//
+//   AssetCooker -o sponza.pak [-t texture]... mesh.obj...
+//       Разбирает OBJ/MTL через ObjLoader, декодирует текстуры материалов и перечисленные
+//       через -t через TextureLoader и пишет все одним архивом с выровненными блобами.
+//   AssetCooker -bench sponza.pak [-t texture]... mesh.obj...
+//       Сравнивает загрузку тех же данных из отдельных файлов и из архива.
+//       Первый проход холодный только при пустом файловом кэше ОС (после перезагрузки
+//       или очистки standby list), остальные - теплые. Для холодного сравнения запускать
+//       с -mode archive|loose|async|pool по одному варианту на очищенный кэш.
+//       async/pool - отдельные файлы, но все чтения текстур ставятся сразу через
+//       AsyncFileReader (IOCP или пул потоков), декодирование идет по мере прихода.
+#include "../AssetArchive.h"
+#include "../OBJLoader.h"
+#include "../TextureLoader.h"
+#include "../AsyncFileReader.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void CollectTextures(const ObjMesh& mesh, std::vector<std::string>& textures)
+{
+	for (const Material& m : mesh.materials)
+	{
+		if (m.diffuseTexture.empty()) continue;
+		bool seen = false;
+		for (const std::string& t : textures) seen = seen || AssetArchive::NormalizeName(t) == m.diffuseTexture;
+		if (!seen) textures.push_back(m.diffuseTexture);
+	}
+}
+
+static bool LoadTextureFile(const std::string& path, TextureLoader::TextureData& td)
+{
+	std::wstring wpath(path.begin(), path.end());
+	return TextureLoader::LoadFromFile(wpath, td);
+}
+
+static int Cook(const std::string& output, const std::vector<std::string>& meshes, std::vector<std::string> textures)
+{
+	AssetArchiveWriter writer;
+	for (const std::string& objPath : meshes)
+	{
+		ObjMesh mesh;
+		if (!ObjLoader::Load(objPath, mesh))
+		{
+			fprintf(stderr, "Failed to load %s\n", objPath.c_str());
+			return 1;
+		}
+		writer.AddMesh(objPath, mesh);
+		CollectTextures(mesh, textures);
+		printf("mesh    %s: %zu vertices, %zu indices, %zu materials\n", objPath.c_str(),
+			mesh.vertices.size(), mesh.indices.size(), mesh.materials.size());
+	}
+
+	int missing = 0;
+	for (const std::string& path : textures)
+	{
+		TextureLoader::TextureData td;
+		if (!LoadTextureFile(path, td))
+		{
+			// Такая текстура и на старом пути подменялась заглушкой - не ошибка сборки
+			printf("missing %s\n", path.c_str());
+			++missing;
+			continue;
+		}
+		writer.AddTexture(path, td);
+		printf("texture %s: %ux%u\n", path.c_str(), td.width, td.height);
+	}
+
+	if (!writer.Write(output))
+	{
+		fprintf(stderr, "Failed to write %s\n", output.c_str());
+		return 1;
+	}
+	printf("%s: %zu textures (%d missing), %.1f MB payload\n", output.c_str(),
+		textures.size() - missing, missing, writer.GetPayloadSize() / (1024.0 * 1024.0));
+	return 0;
+}
+
+static int Bench(const std::string& archivePath, const std::string& mode, const std::vector<std::string>& meshes, std::vector<std::string> textures)
+{
+	for (const std::string& objPath : meshes)
+	{
+		ObjMesh mesh;
+		if (ObjLoader::Load(objPath, mesh)) CollectTextures(mesh, textures);
+	}
+
+	auto loose = [&]() {
+		for (const std::string& objPath : meshes)
+		{
+			ObjMesh mesh;
+			ObjLoader::Load(objPath, mesh);
+		}
+		for (const std::string& path : textures)
+		{
+			TextureLoader::TextureData td;
+			LoadTextureFile(path, td);
+		}
+		};
+	auto looseAsync = [&](AsyncFileReader::Backend backend) {
+		AsyncFileReader reader(backend);
+		for (const std::string& path : textures) reader.Submit(path);
+		for (const std::string& objPath : meshes)
+		{
+			ObjMesh mesh;
+			ObjLoader::Load(objPath, mesh);
+		}
+		AsyncFileReader::Result r;
+		while (reader.WaitNext(r))
+		{
+			TextureLoader::TextureData td;
+			if (r.ok) TextureLoader::LoadFromMemory(r.bytes.data(), r.bytes.size(), td);
+		}
+		};
+	auto packed = [&]() {
+		AssetArchive archive;
+		if (!archive.Open(archivePath)) return;
+		for (const std::string& objPath : meshes)
+		{
+			ObjMesh mesh;
+			archive.ReadMesh(objPath, mesh);
+		}
+		for (const std::string& path : textures)
+		{
+			TextureLoader::TextureData td;
+			archive.ReadTexture(path, td);
+		}
+		};
+
+	const int warmRuns = 5;
+	auto measure = [&](const char* name, auto&& fn) {
+		auto t0 = std::chrono::high_resolution_clock::now();
+		fn();
+		double cold = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+		t0 = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < warmRuns; ++i) fn();
+		double warm = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count() / warmRuns;
+		printf("%-12s first: %9.1f ms   warm: %9.1f ms\n", name, cold, warm);
+		};
+	if (mode.empty() || mode == "archive") measure("archive", packed);
+	if (mode.empty() || mode == "loose") measure("loose files", loose);
+	if (mode.empty() || mode == "async") measure("loose async", [&]() { looseAsync(AsyncFileReader::Backend::Overlapped); });
+	if (mode.empty() || mode == "pool") measure("loose pool", [&]() { looseAsync(AsyncFileReader::Backend::ThreadPool); });
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	std::string output, bench, mode;
+	std::vector<std::string> meshes, textures;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-o") && i + 1 < argc) output = argv[++i];
+		else if (!strcmp(argv[i], "-bench") && i + 1 < argc) bench = argv[++i];
+		else if (!strcmp(argv[i], "-mode") && i + 1 < argc) mode = argv[++i];
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc) textures.push_back(argv[++i]);
+		else meshes.push_back(argv[i]);
+	}
+	if ((output.empty() && bench.empty()) || meshes.empty())
+	{
+		printf("usage: AssetCooker -o <archive> [-t texture]... <mesh.obj>...\n"
+			"       AssetCooker -bench <archive> [-mode archive|loose|async|pool] [-t texture]... <mesh.obj>...\n");
+		return 1;
+	}
+	return bench.empty() ? Cook(output, meshes, textures) : Bench(bench, mode, meshes, textures);
+}
\ No newline at end of file
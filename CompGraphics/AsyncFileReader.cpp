@@ -0,0 +1,211 @@
+#include "AsyncFileReader.h"
+#include <algorithm>
+#include <fstream>
+
+// Крупные файлы читаются несколькими запросами, чтобы один ReadFile не превышал DWORD
+static const uint64_t kMaxReadChunk = 64ull << 20;
+
+AsyncFileReader::AsyncFileReader(Backend backend, unsigned maxInFlight)
+	: m_backend(backend), m_maxInFlight(std::max(maxInFlight, 1u))
+{
+	if (m_backend == Backend::Overlapped)
+	{
+		m_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+		if (!m_port)
+		{
+			OutputDebugStringA("[AsyncFileReader] IOCP unavailable, falling back to thread pool\n");
+			m_backend = Backend::ThreadPool;
+		}
+	}
+	if (m_backend == Backend::ThreadPool)
+	{
+		unsigned count = std::min(std::max(std::thread::hardware_concurrency(), 2u), 8u);
+		for (unsigned i = 0; i < count; ++i)
+			m_workers.emplace_back([this]() { WorkerLoop(); });
+	}
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	if (m_port)
+	{
+		// Отменяем незавершенные чтения и дожидаемся их пакетов, иначе ОС писала бы в освобожденные буферы
+		for (Request* req : m_inFlight) CancelIoEx(req->file, &req->ov);
+		while (!m_inFlight.empty())
+		{
+			DWORD bytes = 0;
+			ULONG_PTR key = 0;
+			OVERLAPPED* ov = nullptr;
+			GetQueuedCompletionStatus(m_port, &bytes, &key, &ov, INFINITE);
+			if (!ov) continue;
+			std::unique_ptr<Request> req(reinterpret_cast<Request*>(key));
+			m_inFlight.erase(std::find(m_inFlight.begin(), m_inFlight.end(), req.get()));
+			CloseHandle(req->file);
+		}
+		CloseHandle(m_port);
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& t : m_workers) t.join();
+}
+
+size_t AsyncFileReader::Submit(const std::string& diskPath)
+{
+	std::unique_ptr<Request> req(new Request());
+	req->index = m_nextIndex++;
+	req->path = diskPath;
+	++m_outstanding;
+	const size_t index = req->index;
+
+	if (m_backend == Backend::ThreadPool)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(std::move(req));
+		}
+		m_wake.notify_one();
+		return index;
+	}
+
+	m_queued.push_back(std::move(req));
+	StartQueued();
+	return index;
+}
+
+void AsyncFileReader::StartQueued()
+{
+	while (!m_queued.empty() && m_inFlight.size() < m_maxInFlight)
+	{
+		std::unique_ptr<Request> req = std::move(m_queued.front());
+		m_queued.pop_front();
+		if (!Open(*req))
+		{
+			Complete(std::move(req), false);
+			continue;
+		}
+		if (req->bytes.empty())
+		{
+			Complete(std::move(req), true);
+			continue;
+		}
+		m_inFlight.push_back(req.get());
+		Request* raw = req.release();
+		if (!IssueRead(*raw))
+		{
+			m_inFlight.pop_back();
+			Complete(std::unique_ptr<Request>(raw), false);
+		}
+	}
+}
+
+bool AsyncFileReader::Open(Request& req)
+{
+	req.file = CreateFileA(req.path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (req.file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(req.file, &size)) return false;
+	if (!CreateIoCompletionPort(req.file, m_port, reinterpret_cast<ULONG_PTR>(&req), 0)) return false;
+	req.bytes.resize((size_t)size.QuadPart);
+	return true;
+}
+
+bool AsyncFileReader::IssueRead(Request& req)
+{
+	const uint64_t remaining = req.bytes.size() - req.done;
+	const DWORD chunk = (DWORD)std::min(remaining, kMaxReadChunk);
+	req.ov = OVERLAPPED{};
+	req.ov.Offset = (DWORD)(req.done & 0xFFFFFFFFull);
+	req.ov.OffsetHigh = (DWORD)(req.done >> 32);
+	// Успешное синхронное завершение тоже приходит пакетом в порт
+	if (ReadFile(req.file, req.bytes.data() + req.done, chunk, nullptr, &req.ov)) return true;
+	return GetLastError() == ERROR_IO_PENDING;
+}
+
+void AsyncFileReader::Complete(std::unique_ptr<Request> req, bool ok)
+{
+	if (req->file != INVALID_HANDLE_VALUE) CloseHandle(req->file);
+	Result r;
+	r.index = req->index;
+	r.ok = ok;
+	if (ok) r.bytes = std::move(req->bytes);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_results.push_back(std::move(r));
+	}
+	m_ready.notify_one();
+}
+
+bool AsyncFileReader::WaitNext(Result& out)
+{
+	if (m_outstanding == 0) return false;
+
+	if (m_backend == Backend::ThreadPool)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_ready.wait(lock, [this]() { return !m_results.empty(); });
+		out = std::move(m_results.front());
+		m_results.pop_front();
+		--m_outstanding;
+		return true;
+	}
+
+	for (;;)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_results.empty())
+			{
+				out = std::move(m_results.front());
+				m_results.pop_front();
+				--m_outstanding;
+				return true;
+			}
+		}
+
+		DWORD bytes = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED* ov = nullptr;
+		BOOL ok = GetQueuedCompletionStatus(m_port, &bytes, &key, &ov, INFINITE);
+		if (!ov) continue;
+		Request* req = reinterpret_cast<Request*>(key);
+		req->done += bytes;
+		bool finished = !ok || bytes == 0 || req->done >= req->bytes.size();
+		if (!finished && IssueRead(*req)) continue;
+
+		m_inFlight.erase(std::find(m_inFlight.begin(), m_inFlight.end(), req));
+		Complete(std::unique_ptr<Request>(req), req->done == req->bytes.size());
+		StartQueued();
+	}
+}
+
+bool AsyncFileReader::ReadWhole(const std::string& path, std::vector<uint8_t>& bytes)
+{
+	std::ifstream f(path, std::ios::binary | std::ios::ate);
+	if (!f.is_open()) return false;
+	std::streamsize size = f.tellg();
+	if (size < 0) return false;
+	bytes.resize((size_t)size);
+	f.seekg(0);
+	return size == 0 || (bool)f.read(reinterpret_cast<char*>(bytes.data()), size);
+}
+
+void AsyncFileReader::WorkerLoop()
+{
+	for (;;)
+	{
+		std::unique_ptr<Request> req;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+			if (m_stop) return;
+			req = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		bool ok = ReadWhole(req->path, req->bytes);
+		Complete(std::move(req), ok);
+	}
+}
\ No newline at end of file
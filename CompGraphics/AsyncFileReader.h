@@ -0,0 +1,83 @@
+#pragma once
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Асинхронное чтение файлов целиком: все запросы сцены ставятся сразу, готовые буферы
+// забираются через WaitNext в порядке завершения, а не в порядке Submit.
+// Overlapped: ReadFile с OVERLAPPED и порт завершения (IOCP), очередь ввода-вывода у ОС
+// всегда полная. ThreadPool: блокирующее чтение в нескольких потоках - запасной вариант,
+// если порт не создался. Объект используется одним потоком (Submit/WaitNext).
+class AsyncFileReader
+{
+public:
+	enum class Backend
+	{
+		Overlapped,
+		ThreadPool,
+	};
+
+	struct Result
+	{
+		size_t index = 0;
+		bool ok = false;
+		std::vector<uint8_t> bytes;
+	};
+
+	explicit AsyncFileReader(Backend backend = Backend::Overlapped, unsigned maxInFlight = 32);
+	~AsyncFileReader();
+	AsyncFileReader(const AsyncFileReader&) = delete;
+	AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+	// Возвращает индекс запроса, который придет в Result::index
+	size_t Submit(const std::string& diskPath);
+	// Блокирует до завершения любого чтения; false, если незабранных запросов не осталось
+	bool WaitNext(Result& out);
+
+	Backend GetBackend() const { return m_backend; }
+	size_t GetOutstanding() const { return m_outstanding; }
+
+private:
+	struct Request
+	{
+		OVERLAPPED ov{};
+		HANDLE file = INVALID_HANDLE_VALUE;
+		size_t index = 0;
+		std::string path;
+		std::vector<uint8_t> bytes;
+		uint64_t done = 0;
+	};
+
+	void StartQueued();
+	bool Open(Request& req);
+	bool IssueRead(Request& req);
+	void Complete(std::unique_ptr<Request> req, bool ok);
+	void WorkerLoop();
+	static bool ReadWhole(const std::string& path, std::vector<uint8_t>& bytes);
+
+	Backend m_backend;
+	unsigned m_maxInFlight;
+	size_t m_nextIndex = 0;
+	size_t m_outstanding = 0;
+
+	// Overlapped
+	HANDLE m_port = nullptr;
+	std::deque<std::unique_ptr<Request>> m_queued;
+	std::vector<Request*> m_inFlight;
+
+	// ThreadPool; готовые результаты обоих бэкендов тоже здесь
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_ready;
+	std::deque<std::unique_ptr<Request>> m_jobs;
+	std::deque<Result> m_results;
+	bool m_stop = false;
+};
\ No newline at end of file
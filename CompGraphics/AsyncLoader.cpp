@@ -0,0 +1,179 @@
+#include "AsyncLoader.h"
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <algorithm>
+#include <cstdio>
+
+static const std::string kNoName;
+
+static double MsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const std::string& AsyncLoadHandle::GetName() const
+{
+	return m_status ? m_status->name : kNoName;
+}
+
+void AsyncLoadHandle::WaitForCpu() const
+{
+	if (m_status) m_status->cpuDoneFuture.wait();
+}
+
+AsyncLoader::AsyncLoader(unsigned workerCount)
+	: m_ready(256)
+{
+	if (workerCount == 0)
+		workerCount = std::min(std::max(std::thread::hardware_concurrency() / 2, 1u), 4u);
+	for (unsigned i = 0; i < workerCount; ++i)
+		m_workers.emplace_back([this]() { WorkerLoop(); });
+}
+
+AsyncLoader::~AsyncLoader()
+{
+	Shutdown();
+}
+
+void AsyncLoader::Finish(Job& job, AsyncLoadState state)
+{
+	job.status->state = state;
+	--m_pending;
+	if (state == AsyncLoadState::Failed)
+	{
+		char msg[512];
+		sprintf_s(msg, "[AsyncLoad] %s failed\n", job.status->name.c_str());
+		OutputDebugStringA(msg);
+	}
+}
+
+AsyncLoadHandle AsyncLoader::Submit(const std::string& name, AsyncLoadJob job)
+{
+	auto status = std::make_shared<AsyncLoadStatus>();
+	status->name = name;
+	status->cpuDoneFuture = status->cpuDone.get_future().share();
+	status->submitted = std::chrono::steady_clock::now();
+
+	std::unique_ptr<Job> j(new Job());
+	j->status = status;
+	j->work = std::move(job);
+	++m_pending;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_stop || m_workers.empty())
+		{
+			Finish(*j, AsyncLoadState::Failed);
+			status->cpuDone.set_value();
+			return AsyncLoadHandle(status);
+		}
+		m_queue.push_back(j.release());
+	}
+	m_wake.notify_one();
+	return AsyncLoadHandle(status);
+}
+
+void AsyncLoader::WorkerLoop()
+{
+	for (;;)
+	{
+		Job* job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+			if (m_stop) return;
+			job = m_queue.front();
+			m_queue.pop_front();
+		}
+
+		job->status->state = AsyncLoadState::Loading;
+		try { job->upload = job->work(); }
+		catch (...) { job->upload.reset(); }
+		job->work = nullptr;
+		job->status->cpuMs = MsSince(job->status->submitted);
+
+		std::shared_ptr<AsyncLoadStatus> status = job->status;
+		if (job->upload)
+		{
+			// Статус выставляется до публикации: после TryPush задачей владеет поток отрисовки.
+			// Полную очередь освобождает Pump; после Shutdown его может уже не быть - задача отменяется
+			status->state = AsyncLoadState::ReadyForUpload;
+			bool published = false;
+			while (!(published = m_ready.TryPush(job)) && !m_stop) std::this_thread::yield();
+			if (!published)
+			{
+				Finish(*job, AsyncLoadState::Failed);
+				delete job;
+			}
+		}
+		else
+		{
+			Finish(*job, AsyncLoadState::Failed);
+			delete job;
+		}
+		status->cpuDone.set_value();
+	}
+}
+
+void AsyncLoader::Pump(uint64_t completedFence, uint64_t submitFence, uint32_t maxUploads)
+{
+	// Копирование, записанное в кадре с fence <= completedFence, уже выполнено на GPU
+	for (size_t i = 0; i < m_inFlight.size();)
+	{
+		Job& job = *m_inFlight[i];
+		if (job.fence > completedFence) { ++i; continue; }
+		job.upload->MakeVisible();
+		job.status->residentMs = MsSince(job.status->submitted);
+		Finish(job, AsyncLoadState::Resident);
+
+		char msg[512];
+		sprintf_s(msg, "[AsyncLoad] %s resident: background %.1f ms, visible after %.1f ms\n",
+			job.status->name.c_str(), job.status->cpuMs, job.status->residentMs);
+		OutputDebugStringA(msg);
+		m_inFlight.erase(m_inFlight.begin() + i);
+	}
+
+	Job* ready = nullptr;
+	for (uint32_t n = 0; n < maxUploads && m_ready.TryPop(ready); ++n)
+	{
+		std::unique_ptr<Job> job(ready);
+		bool recorded = false;
+		try { recorded = job->upload->Record(); }
+		catch (...) {}
+		if (!recorded)
+		{
+			Finish(*job, AsyncLoadState::Failed);
+			continue;
+		}
+		job->fence = submitFence;
+		job->status->state = AsyncLoadState::Uploading;
+		m_inFlight.push_back(std::move(job));
+	}
+}
+
+void AsyncLoader::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& t : m_workers) t.join();
+	m_workers.clear();
+
+	for (Job* job : m_queue)
+	{
+		Finish(*job, AsyncLoadState::Failed);
+		job->status->cpuDone.set_value();
+		delete job;
+	}
+	m_queue.clear();
+
+	Job* ready = nullptr;
+	while (m_ready.TryPop(ready))
+	{
+		Finish(*ready, AsyncLoadState::Failed);
+		delete ready;
+	}
+	for (auto& job : m_inFlight) Finish(*job, AsyncLoadState::Failed);
+	m_inFlight.clear();
+}
\ No newline at end of file
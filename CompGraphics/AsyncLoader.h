@@ -0,0 +1,129 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LockFreeQueue.h"
+
+// Жизненный цикл фоновой загрузки:
+//   Queued -> Loading (поток пула) -> ReadyForUpload -> Uploading (команды копирования записаны
+//   в кадр) -> Resident (fence этого кадра пройден, ресурс виден отрисовке) | Failed
+enum class AsyncLoadState : int
+{
+	Queued,
+	Loading,
+	ReadyForUpload,
+	Uploading,
+	Resident,
+	Failed,
+};
+
+// GPU-часть загрузки, которую поток пула отдает потоку отрисовки.
+// Record вызывается на открытом списке команд кадра, MakeVisible - когда fence этого кадра пройден.
+class PendingUpload
+{
+public:
+	virtual ~PendingUpload() = default;
+	virtual bool Record() = 0;
+	virtual void MakeVisible() = 0;
+};
+
+// CPU-часть загрузки: выполняется в пуле, nullptr - ошибка
+using AsyncLoadJob = std::function<std::unique_ptr<PendingUpload>()>;
+
+struct AsyncLoadStatus
+{
+	std::string name;
+	std::atomic<AsyncLoadState> state{ AsyncLoadState::Queued };
+	std::promise<void> cpuDone;
+	std::shared_future<void> cpuDoneFuture;
+	std::chrono::steady_clock::time_point submitted;
+	double cpuMs = 0.0;
+	double residentMs = 0.0;
+};
+
+// Возвращается сразу из Submit; копируется свободно, опрашивается с любого потока
+class AsyncLoadHandle
+{
+public:
+	AsyncLoadHandle() = default;
+
+	bool IsValid() const { return m_status != nullptr; }
+	AsyncLoadState GetState() const { return m_status ? m_status->state.load() : AsyncLoadState::Failed; }
+	bool IsResident() const { return GetState() == AsyncLoadState::Resident; }
+	bool IsFailed() const { return GetState() == AsyncLoadState::Failed; }
+	bool IsFinished() const { return IsResident() || IsFailed(); }
+	const std::string& GetName() const;
+	// Время от Submit до конца CPU-части и до появления в кадре (0, пока не наступило)
+	double GetCpuMs() const { return m_status ? m_status->cpuMs : 0.0; }
+	double GetResidentMs() const { return m_status ? m_status->residentMs : 0.0; }
+
+	// Ждет только CPU-часть: GPU-часть продвигает Pump на потоке отрисовки
+	void WaitForCpu() const;
+
+private:
+	friend class AsyncLoader;
+	explicit AsyncLoadHandle(std::shared_ptr<AsyncLoadStatus> status) : m_status(std::move(status)) {}
+
+	std::shared_ptr<AsyncLoadStatus> m_status;
+};
+
+// Пул потоков для разбора и декодирования ассетов. Готовые результаты уходят потоку отрисовки
+// через lock-free очередь; Pump раз в кадр записывает копирование и по значению fence
+// переводит загрузку в Resident. Сам загрузчик не зависит от D3D12: fence - просто числа,
+// поэтому передачу между потоками можно гонять без окна и устройства.
+class AsyncLoader
+{
+public:
+	// 0 - половина аппаратных потоков, от 1 до 4
+	explicit AsyncLoader(unsigned workerCount = 0);
+	~AsyncLoader();
+	AsyncLoader(const AsyncLoader&) = delete;
+	AsyncLoader& operator=(const AsyncLoader&) = delete;
+
+	AsyncLoadHandle Submit(const std::string& name, AsyncLoadJob job);
+
+	// Только поток отрисовки. completedFence - пройденное GPU значение, submitFence - значение,
+	// которое будет выставлено после команд текущего кадра.
+	void Pump(uint64_t completedFence, uint64_t submitFence, uint32_t maxUploads = UINT32_MAX);
+
+	// Останавливает пул; загрузки, которые еще не начались или ждут места в очереди готовых,
+	// завершаются как Failed
+	void Shutdown();
+
+	bool HasPendingWork() const { return m_pending != 0; }
+	size_t GetInFlightCount() const { return m_inFlight.size(); }
+	unsigned GetWorkerCount() const { return (unsigned)m_workers.size(); }
+
+private:
+	struct Job
+	{
+		std::shared_ptr<AsyncLoadStatus> status;
+		AsyncLoadJob work;
+		std::unique_ptr<PendingUpload> upload;
+		uint64_t fence = 0;
+	};
+
+	void WorkerLoop();
+	void Finish(Job& job, AsyncLoadState state);
+
+	std::vector<std::thread> m_workers;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<Job*> m_queue;
+	// Пишется под m_mutex; без него читает только поток, ждущий места в m_ready
+	std::atomic<bool> m_stop{ false };
+	// Загрузки, еще не ставшие Resident или Failed
+	std::atomic<uint32_t> m_pending{ 0 };
+
+	LockFreeQueue<Job*> m_ready;
+	std::vector<std::unique_ptr<Job>> m_inFlight;
+};
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Объекты, которые еще могут читать кадры на GPU: каждый живет до прохождения fence своей
+// последней работы. Без D3D - только значения fence, поэтому проверяется на CPU с имитацией
+// fence. T - владеющий тип (ComPtr, unique_ptr); объект уничтожается в Reclaim или Clear.
+// Не потокобезопасен - только поток отрисовки.
+template<class T>
+class DeferredReleaseQueue
+{
+public:
+	// Последняя работа с объектом записана в список команд, после которого GPU выставит fence
+	void Retire(T item, uint64_t fence)
+	{
+		m_items.push_back({ fence, std::move(item) });
+	}
+
+	// Уничтожает объекты с пройденным fence, возвращает их число. Порядок fence не важен
+	size_t Reclaim(uint64_t completedFence)
+	{
+		std::vector<T> released;
+		size_t kept = 0;
+		for (size_t i = 0; i < m_items.size(); ++i)
+		{
+			if (m_items[i].fence > completedFence) m_items[kept++] = std::move(m_items[i]);
+			else released.push_back(std::move(m_items[i].item));
+		}
+		m_items.resize(kept);
+		// Деструкторы - после сжатия очереди: они могут вернуть в нее новый объект
+		return released.size();
+	}
+
+	// Только когда GPU простаивает
+	void Clear()
+	{
+		std::vector<Entry> items;
+		items.swap(m_items);
+	}
+
+	size_t GetSize() const { return m_items.size(); }
+	bool IsEmpty() const { return m_items.empty(); }
+
+private:
+	struct Entry
+	{
+		uint64_t fence;
+		T item;
+	};
+
+	std::vector<Entry> m_items;
+};
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "DescriptorAllocator.h"
+
+DescriptorAllocator::DescriptorAllocator(uint32_t persistentCount, uint32_t transientCount)
+	: m_persistentCount(persistentCount), m_transientCount(transientCount),
+	m_rangeCount(persistentCount, 0), m_generation(persistentCount, 1), m_transient(transientCount)
+{
+	if (persistentCount) InsertFree(0, persistentCount);
+}
+
+void DescriptorAllocator::InsertFree(uint32_t index, uint32_t count)
+{
+	auto next = m_freeByIndex.lower_bound(index);
+	if (next != m_freeByIndex.end() && index + count == next->first)
+	{
+		count += next->second;
+		EraseFree(next);
+	}
+	auto prev = m_freeByIndex.lower_bound(index);
+	if (prev != m_freeByIndex.begin())
+	{
+		--prev;
+		if (prev->first + prev->second == index)
+		{
+			index = prev->first;
+			count += prev->second;
+			EraseFree(prev);
+		}
+	}
+	m_freeByIndex.emplace(index, count);
+	m_freeBySize.emplace(count, index);
+}
+
+void DescriptorAllocator::EraseFree(std::map<uint32_t, uint32_t>::iterator it)
+{
+	auto range = m_freeBySize.equal_range(it->second);
+	for (auto s = range.first; s != range.second; ++s)
+	{
+		if (s->second != it->first) continue;
+		m_freeBySize.erase(s);
+		break;
+	}
+	m_freeByIndex.erase(it);
+}
+
+DescriptorAllocator::Handle DescriptorAllocator::Allocate(uint32_t count)
+{
+	Handle handle;
+	if (count == 0) return handle;
+	auto best = m_freeBySize.lower_bound(count);
+	if (best == m_freeBySize.end()) return handle;
+
+	const uint32_t index = best->second;
+	const uint32_t free = best->first;
+	EraseFree(m_freeByIndex.find(index));
+	if (free > count) InsertFree(index + count, free - count);
+
+	m_rangeCount[index] = count;
+	m_used += count;
+	++m_ranges;
+	handle.index = index;
+	handle.count = count;
+	handle.generation = m_generation[index];
+	return handle;
+}
+
+void DescriptorAllocator::Free(Handle& handle, uint64_t fence)
+{
+	if (!IsValid(handle)) return;
+	// Новое поколение сразу: handle на этот диапазон больше не разрешается, хотя дескрипторы
+	// еще читают кадры на GPU
+	++m_generation[handle.index];
+	m_rangeCount[handle.index] = 0;
+	m_used -= handle.count;
+	--m_ranges;
+	m_pending.push_back({ fence, handle.index, handle.count });
+	handle = Handle();
+}
+
+bool DescriptorAllocator::IsValid(const Handle& handle) const
+{
+	return handle.count != 0 && handle.index < m_persistentCount &&
+		m_rangeCount[handle.index] == handle.count && m_generation[handle.index] == handle.generation;
+}
+
+uint32_t DescriptorAllocator::Resolve(const Handle& handle) const
+{
+	return IsValid(handle) ? handle.index : InvalidIndex;
+}
+
+uint32_t DescriptorAllocator::AllocateTransient(uint32_t count, uint64_t fence)
+{
+	if (count == 0) return InvalidIndex;
+	uint32_t id = 0;
+	const uint64_t offset = m_transient.Allocate(count, 1, id);
+	if (offset == UploadRingAllocator::InvalidOffset) return InvalidIndex;
+	m_transient.Retire(id, fence);
+	return m_persistentCount + (uint32_t)offset;
+}
+
+void DescriptorAllocator::Reclaim(uint64_t completedFence)
+{
+	m_transient.Reclaim(completedFence);
+	size_t kept = 0;
+	for (size_t i = 0; i < m_pending.size(); ++i)
+	{
+		if (m_pending[i].fence > completedFence) m_pending[kept++] = m_pending[i];
+		else InsertFree(m_pending[i].index, m_pending[i].count);
+	}
+	m_pending.resize(kept);
+}
+
+DescriptorAllocator::Stats DescriptorAllocator::GetStats() const
+{
+	Stats stats;
+	stats.capacity = m_persistentCount;
+	stats.used = m_used;
+	stats.ranges = m_ranges;
+	stats.largestFree = m_freeBySize.empty() ? 0 : m_freeBySize.rbegin()->first;
+	for (const PendingFree& p : m_pending) stats.pending += p.count;
+	stats.transientCapacity = m_transientCount;
+	stats.transientUsed = (uint32_t)m_transient.GetUsed();
+	return stats;
+}
\ No newline at end of file
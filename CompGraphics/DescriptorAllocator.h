@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "UploadRingAllocator.h"
+
+// Индексы дескрипторов одной кучи: постоянные диапазоны (таблицы материалов) со слиянием
+// свободных и переходящие диапазоны кадра в кольце в конце кучи. Освобожденный диапазон
+// выдается снова только после fence, а handle со старым поколением перестает разрешаться.
+// Без D3D и без блокировок - только поток отрисовки.
+class DescriptorAllocator
+{
+public:
+	static const uint32_t InvalidIndex = ~0u;
+
+	struct Handle
+	{
+		uint32_t index = 0;
+		uint32_t count = 0;
+		uint32_t generation = 0;
+		bool IsEmpty() const { return count == 0; }
+		bool operator==(const Handle& other) const
+		{
+			return index == other.index && count == other.count && generation == other.generation;
+		}
+	};
+
+	struct Stats
+	{
+		uint32_t capacity = 0;
+		uint32_t used = 0;
+		uint32_t ranges = 0;
+		uint32_t largestFree = 0;
+		// Освобождены, но ждут fence
+		uint32_t pending = 0;
+		uint32_t transientCapacity = 0;
+		uint32_t transientUsed = 0;
+	};
+
+	DescriptorAllocator(uint32_t persistentCount, uint32_t transientCount);
+
+	// Пустой handle - нет непрерывного свободного диапазона такой длины
+	Handle Allocate(uint32_t count);
+	// Диапазон читают кадры до fence включительно; handle обнуляется
+	void Free(Handle& handle, uint64_t fence);
+	bool IsValid(const Handle& handle) const;
+	// InvalidIndex - handle пустой или диапазон уже освобожден
+	uint32_t Resolve(const Handle& handle) const;
+
+	// Диапазон на один кадр: возвращается сам после fence. InvalidIndex - кольцо занято
+	uint32_t AllocateTransient(uint32_t count, uint64_t fence);
+	void Reclaim(uint64_t completedFence);
+
+	uint32_t GetCapacity() const { return m_persistentCount + m_transientCount; }
+	Stats GetStats() const;
+
+private:
+	void InsertFree(uint32_t index, uint32_t count);
+	void EraseFree(std::map<uint32_t, uint32_t>::iterator it);
+
+	struct PendingFree
+	{
+		uint64_t fence;
+		uint32_t index;
+		uint32_t count;
+	};
+
+	uint32_t m_persistentCount;
+	uint32_t m_transientCount;
+	// Свободные диапазоны: по началу - для слияния соседей, по длине - для выбора наименьшего подходящего
+	std::map<uint32_t, uint32_t> m_freeByIndex;
+	std::multimap<uint32_t, uint32_t> m_freeBySize;
+	// По первому индексу диапазона: длина выданного диапазона (0 - не выдан) и поколение
+	std::vector<uint32_t> m_rangeCount;
+	std::vector<uint32_t> m_generation;
+	std::vector<PendingFree> m_pending;
+	UploadRingAllocator m_transient;
+	uint32_t m_used = 0;
+	uint32_t m_ranges = 0;
+};
\ No newline at end of file
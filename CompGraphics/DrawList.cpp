@@ -0,0 +1,163 @@
+#include "DrawList.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+static uint64_t Field(uint32_t value, uint32_t bits)
+{
+	return (uint64_t)value & ((1ull << bits) - 1);
+}
+
+uint64_t DrawList::MakeKey(uint32_t pass, uint32_t pipeline, uint32_t mesh, uint32_t table, uint32_t material, uint32_t depth)
+{
+	uint64_t key = Field(pass, PassBits);
+	key = (key << PipelineBits) | Field(pipeline, PipelineBits);
+	key = (key << MeshBits) | Field(mesh, MeshBits);
+	key = (key << TableBits) | Field(table, TableBits);
+	key = (key << MaterialBits) | Field(material, MaterialBits);
+	key = (key << DepthBits) | Field(depth, DepthBits);
+	return key;
+}
+
+uint32_t DrawList::DepthBucket(float distance, float maxDistance)
+{
+	const uint32_t maxBucket = (1u << DepthBits) - 1;
+	if (!(distance > 0.f) || maxDistance <= 0.f) return 0;
+	if (distance >= maxDistance) return maxBucket;
+	return (uint32_t)(distance / maxDistance * maxBucket);
+}
+
+void DrawList::Clear()
+{
+	m_keys.clear();
+	m_pipelines.clear();
+	m_meshes.clear();
+	m_tables.clear();
+	m_materials.clear();
+	m_indexStarts.clear();
+	m_indexCounts.clear();
+	m_instances.clear();
+	m_order.clear();
+}
+
+void DrawList::Add(uint64_t key, uint32_t pipeline, uint32_t mesh, uint32_t table, uint64_t material,
+	uint32_t indexStart, uint32_t indexCount, uint32_t instance)
+{
+	m_order.push_back((uint32_t)m_keys.size());
+	m_keys.push_back(key);
+	m_pipelines.push_back(pipeline);
+	m_meshes.push_back(mesh);
+	m_tables.push_back(table);
+	m_materials.push_back(material);
+	m_indexStarts.push_back(indexStart);
+	m_indexCounts.push_back(indexCount);
+	m_instances.push_back(instance);
+}
+
+void DrawList::Sort()
+{
+	const size_t count = m_keys.size();
+	if (count < 2) return;
+	for (int i = 0; i < 2; ++i)
+	{
+		m_sortKeys[i].resize(count);
+		m_sortOrder[i].resize(count);
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_sortKeys[0][i] = m_keys[m_order[i]];
+		m_sortOrder[0][i] = m_order[i];
+	}
+
+	// Гистограммы всех восьми байтов за один проход
+	uint32_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t key = m_sortKeys[0][i];
+		for (int b = 0; b < 8; ++b, key >>= 8) ++histograms[b][key & 0xff];
+	}
+
+	int src = 0;
+	for (int b = 0; b < 8; ++b)
+	{
+		uint32_t* histogram = histograms[b];
+		const uint32_t shift = b * 8;
+		if (histogram[(m_sortKeys[src][0] >> shift) & 0xff] == count) continue;
+
+		uint32_t offsets[256];
+		uint32_t sum = 0;
+		for (int v = 0; v < 256; ++v)
+		{
+			offsets[v] = sum;
+			sum += histogram[v];
+		}
+		const uint64_t* keysIn = m_sortKeys[src].data();
+		const uint32_t* orderIn = m_sortOrder[src].data();
+		uint64_t* keysOut = m_sortKeys[src ^ 1].data();
+		uint32_t* orderOut = m_sortOrder[src ^ 1].data();
+		for (size_t i = 0; i < count; ++i)
+		{
+			const uint32_t slot = offsets[(keysIn[i] >> shift) & 0xff]++;
+			keysOut[slot] = keysIn[i];
+			orderOut[slot] = orderIn[i];
+		}
+		src ^= 1;
+	}
+	m_order.assign(m_sortOrder[src].begin(), m_sortOrder[src].end());
+}
+
+DrawList::StateChanges DrawList::CountStateChanges(bool sorted) const
+{
+	StateChanges changes;
+	const size_t count = m_keys.size();
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint32_t item = sorted ? m_order[i] : (uint32_t)i;
+		const uint32_t prev = i == 0 ? 0 : (sorted ? m_order[i - 1] : (uint32_t)(i - 1));
+		const bool first = i == 0;
+		if (first || m_pipelines[item] != m_pipelines[prev]) ++changes.pipelines;
+		if (first || m_meshes[item] != m_meshes[prev]) ++changes.meshes;
+		if (first || m_tables[item] != m_tables[prev]) ++changes.tables;
+		if (first || m_materials[item] != m_materials[prev]) ++changes.materials;
+		++changes.draws;
+	}
+	return changes;
+}
+
+std::vector<DrawList::SortTiming> DrawList::BenchmarkSort(const std::vector<size_t>& sizes, int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	std::vector<SortTiming> timings;
+	std::mt19937 rng(12345);
+	for (size_t size : sizes)
+	{
+		// Как у сцены: немного вариантов PSO и мешей, сотни таблиц и материалов, любая глубина
+		DrawList list;
+		for (size_t i = 0; i < size; ++i)
+		{
+			const uint32_t pipeline = rng() % 8, mesh = rng() % 4, table = rng() % 512, material = rng() % 1024;
+			list.Add(MakeKey(0, pipeline, mesh, table, material, rng() & 0xffff), pipeline, mesh, table, material, 0, 3, 0);
+		}
+		std::vector<uint32_t> unsorted(list.m_order);
+		std::vector<std::pair<uint64_t, uint32_t>> pairs(size);
+
+		SortTiming timing;
+		timing.items = size;
+		for (int it = 0; it < iterations; ++it)
+		{
+			list.m_order = unsorted;
+			Clock::time_point start = Clock::now();
+			list.Sort();
+			timing.radixMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			for (size_t i = 0; i < size; ++i) pairs[i] = std::make_pair(list.m_keys[i], (uint32_t)i);
+			start = Clock::now();
+			std::sort(pairs.begin(), pairs.end());
+			timing.stdSortMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+		timing.radixMilliseconds /= iterations;
+		timing.stdSortMilliseconds /= iterations;
+		timings.push_back(timing);
+	}
+	return timings;
+}
\ No newline at end of file
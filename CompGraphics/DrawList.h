@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Отрисовки кадра: поля элементов лежат отдельными массивами (SoA), порядок задает
+// 64-битный ключ. Старшие поля ключа - самое дорогое переключение, поэтому после сортировки
+// одинаковое состояние идет подряд, а внутри него - от ближних к дальним.
+// Без D3D: сортировка и подсчет переключений проверяются на CPU. Только поток отрисовки.
+class DrawList
+{
+public:
+	// Поля ключа от старших битов к младшим
+	static const uint32_t PassBits = 4;
+	static const uint32_t PipelineBits = 8;
+	static const uint32_t MeshBits = 4;
+	static const uint32_t TableBits = 16;
+	static const uint32_t MaterialBits = 16;
+	static const uint32_t DepthBits = 16;
+
+	// Поле шире своих битов обрезается
+	static uint64_t MakeKey(uint32_t pass, uint32_t pipeline, uint32_t mesh, uint32_t table, uint32_t material, uint32_t depth);
+	// Расстояние [0, maxDistance] в DepthBits бит, дальше - последнее значение
+	static uint32_t DepthBucket(float distance, float maxDistance);
+
+	// Сколько раз меняется каждое состояние, если пропускать повторы
+	struct StateChanges
+	{
+		uint32_t pipelines = 0;
+		uint32_t meshes = 0;
+		uint32_t tables = 0;
+		uint32_t materials = 0;
+		uint32_t draws = 0;
+		uint32_t Total() const { return pipelines + meshes + tables + materials; }
+	};
+
+	struct SortTiming
+	{
+		size_t items = 0;
+		double radixMilliseconds = 0.0;
+		double stdSortMilliseconds = 0.0;
+	};
+
+	void Clear();
+	// material - адрес констант материала или другой идентификатор, который сравнивается целиком;
+	// instance - номер экземпляра меша (матрицы) в буфере экземпляров
+	void Add(uint64_t key, uint32_t pipeline, uint32_t mesh, uint32_t table, uint64_t material,
+		uint32_t indexStart, uint32_t indexCount, uint32_t instance);
+	// LSD radix sort по байтам ключа; байт, одинаковый у всех элементов, пропускается.
+	// Равные ключи сохраняют текущий порядок
+	void Sort();
+
+	size_t GetSize() const { return m_keys.size(); }
+	// Номер элемента на i-м месте; до Sort - порядок добавления
+	uint32_t GetOrder(size_t i) const { return m_order[i]; }
+
+	uint64_t GetKey(uint32_t item) const { return m_keys[item]; }
+	uint32_t GetPipeline(uint32_t item) const { return m_pipelines[item]; }
+	uint32_t GetMesh(uint32_t item) const { return m_meshes[item]; }
+	uint32_t GetTable(uint32_t item) const { return m_tables[item]; }
+	uint64_t GetMaterial(uint32_t item) const { return m_materials[item]; }
+	uint32_t GetIndexStart(uint32_t item) const { return m_indexStarts[item]; }
+	uint32_t GetIndexCount(uint32_t item) const { return m_indexCounts[item]; }
+	uint32_t GetInstance(uint32_t item) const { return m_instances[item]; }
+
+	// sorted = false - в порядке добавления, true - в текущем порядке
+	StateChanges CountStateChanges(bool sorted) const;
+
+	// Время Sort и std::sort тех же ключей на случайных списках заданных размеров
+	static std::vector<SortTiming> BenchmarkSort(const std::vector<size_t>& sizes, int iterations);
+
+private:
+	std::vector<uint64_t> m_keys;
+	std::vector<uint32_t> m_pipelines;
+	std::vector<uint32_t> m_meshes;
+	std::vector<uint32_t> m_tables;
+	std::vector<uint64_t> m_materials;
+	std::vector<uint32_t> m_indexStarts;
+	std::vector<uint32_t> m_indexCounts;
+	std::vector<uint32_t> m_instances;
+	std::vector<uint32_t> m_order;
+	// Буферы сортировки живут между кадрами, чтобы не выделять память
+	std::vector<uint64_t> m_sortKeys[2];
+	std::vector<uint32_t> m_sortOrder[2];
+};
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "DrawPackets.h"
+#include "JobSystem.h"
+#include "OcclusionBuffer.h"
+#include "PotentiallyVisibleSet.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+
+bool DrawPacketBuilder::Apply(const CommandPacket& packet, State& bound)
+{
+	switch (packet.type)
+	{
+	case CommandPacket::SetPipeline:
+		if (bound.pipeline == packet.value) return false;
+		bound.pipeline = packet.value;
+		return true;
+	case CommandPacket::SetMesh:
+		if (bound.mesh == packet.value) return false;
+		bound.mesh = packet.value;
+		return true;
+	case CommandPacket::SetTable:
+		if (bound.table == packet.value) return false;
+		bound.table = packet.value;
+		return true;
+	case CommandPacket::SetMaterial:
+		if (bound.material == packet.material) return false;
+		bound.material = packet.material;
+		return true;
+	default:
+		return true;
+	}
+}
+
+void DrawPacketBuilder::BuildChunk(const RetainedDrawList& list, const float planes[6][4], const OcclusionBuffer* occlusion,
+	const PotentiallyVisibleSet* pvs, size_t begin, size_t end, Chunk& chunk)
+{
+	chunk.visible.clear();
+	chunk.packets.clear();
+	chunk.instances.clear();
+	list.CullRange(planes, begin, end, chunk.visible);
+	chunk.pvsCulled = 0;
+	chunk.occluded = 0;
+	if (pvs)
+	{
+		const size_t inFrustum = chunk.visible.size();
+		chunk.visible.erase(std::remove_if(chunk.visible.begin(), chunk.visible.end(),
+			[&](uint32_t item) { return !pvs->IsVisible(list.GetCluster(item)); }), chunk.visible.end());
+		chunk.pvsCulled = (uint32_t)(inFrustum - chunk.visible.size());
+	}
+	if (occlusion)
+	{
+		const size_t tested = chunk.visible.size();
+		chunk.visible.erase(std::remove_if(chunk.visible.begin(), chunk.visible.end(),
+			[&](uint32_t item) { return occlusion->IsOccluded(list.GetSphere(item)); }), chunk.visible.end());
+		chunk.occluded = (uint32_t)(tested - chunk.visible.size());
+	}
+
+	const DrawList& draws = list.GetList();
+	State bound;
+	chunk.draws = 0;
+	for (uint32_t item : chunk.visible)
+	{
+		const size_t before = chunk.packets.size();
+		CommandPacket packet;
+		packet.type = CommandPacket::SetPipeline;
+		packet.value = draws.GetPipeline(item);
+		if (Apply(packet, bound)) chunk.packets.push_back(packet);
+		packet.type = CommandPacket::SetMesh;
+		packet.value = draws.GetMesh(item);
+		if (Apply(packet, bound)) chunk.packets.push_back(packet);
+		packet.type = CommandPacket::SetTable;
+		packet.value = draws.GetTable(item);
+		if (Apply(packet, bound)) chunk.packets.push_back(packet);
+		packet = CommandPacket();
+		packet.type = CommandPacket::SetMaterial;
+		packet.material = draws.GetMaterial(item);
+		if (Apply(packet, bound)) chunk.packets.push_back(packet);
+
+		const uint32_t indexCount = draws.GetIndexCount(item), indexStart = draws.GetIndexStart(item);
+		const uint32_t instance = (uint32_t)chunk.instances.size();
+		chunk.instances.push_back(draws.GetInstance(item));
+		// Состояние не менялось, и предыдущая отрисовка того же сабсета - еще один ее экземпляр
+		if (chunk.packets.size() == before && !chunk.packets.empty())
+		{
+			CommandPacket& last = chunk.packets.back();
+			if (last.value == indexCount && last.start == indexStart)
+			{
+				++last.instanceCount;
+				continue;
+			}
+		}
+		packet = CommandPacket();
+		packet.value = indexCount;
+		packet.start = indexStart;
+		packet.instanceStart = instance;
+		packet.instanceCount = 1;
+		chunk.packets.push_back(packet);
+		++chunk.draws;
+	}
+	// У первой отрисовки куска выставлены все четыре состояния
+	chunk.leading = chunk.visible.empty() ? 0 : 4;
+	chunk.last = bound;
+}
+
+void DrawPacketBuilder::Build(const RetainedDrawList& list, const float planes[6][4], JobSystem* jobs, size_t chunkSize,
+	const OcclusionBuffer* occlusion, const PotentiallyVisibleSet* pvs)
+{
+	const size_t size = list.GetList().GetSize();
+	if (chunkSize == 0) chunkSize = size ? size : 1;
+	const size_t chunkCount = (size + chunkSize - 1) / chunkSize;
+	if (m_chunks.size() < chunkCount) m_chunks.resize(chunkCount);
+
+	auto build = [&](size_t c) {
+		const size_t begin = c * chunkSize;
+		const size_t end = begin + chunkSize < size ? begin + chunkSize : size;
+		BuildChunk(list, planes, occlusion, pvs, begin, end, m_chunks[c]);
+		};
+	if (jobs) jobs->ParallelFor(chunkCount, build);
+	else for (size_t c = 0; c < chunkCount; ++c) build(c);
+
+	m_packets.clear();
+	m_instances.clear();
+	m_draws = 0;
+	m_pvsCulled = 0;
+	m_occluded = 0;
+	State bound;
+	for (size_t c = 0; c < chunkCount; ++c)
+	{
+		const Chunk& chunk = m_chunks[c];
+		m_pvsCulled += chunk.pvsCulled;
+		m_occluded += chunk.occluded;
+		if (chunk.draws == 0) continue;
+		const uint32_t base = (uint32_t)m_instances.size();
+		m_instances.insert(m_instances.end(), chunk.instances.begin(), chunk.instances.end());
+
+		const size_t emitted = m_packets.size();
+		for (size_t i = 0; i < chunk.leading; ++i)
+			if (Apply(chunk.packets[i], bound)) m_packets.push_back(chunk.packets[i]);
+		size_t i = chunk.leading;
+		m_draws += chunk.draws;
+		// Состояние не сменилось: первая отрисовка куска может продолжать последнюю отрисовку
+		// предыдущего, ее экземпляры лежат сразу за экземплярами той
+		if (m_packets.size() == emitted && emitted > 0)
+		{
+			CommandPacket& last = m_packets.back();
+			const CommandPacket& first = chunk.packets[i];
+			if (last.value == first.value && last.start == first.start)
+			{
+				last.instanceCount += first.instanceCount;
+				++i;
+				--m_draws;
+			}
+		}
+		for (; i < chunk.packets.size(); ++i)
+		{
+			m_packets.push_back(chunk.packets[i]);
+			if (m_packets.back().type == CommandPacket::Draw) m_packets.back().instanceStart += base;
+		}
+		bound = chunk.last;
+	}
+}
+
+std::vector<DrawPacketBuilder::BuildTiming> DrawPacketBuilder::BenchmarkBuild(size_t draws,
+	const std::vector<unsigned>& threadCounts, size_t chunkSize, int iterations, uint32_t instancesPerDraw)
+{
+	if (instancesPerDraw == 0) instancesPerDraw = 1;
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<float> position(-1000.f, 1000.f);
+	RetainedDrawList list(1);
+	list.ClearSlot(0);
+	RetainedDrawList::Draw draw;
+	for (size_t i = 0; i < draws; ++i)
+	{
+		// Экземпляры сабсета добавляются подряд с одним ключом, как в AddMeshDraws
+		if (i % instancesPerDraw == 0)
+		{
+			draw.pipeline = rng() % 8;
+			draw.table = rng() % 64;
+			draw.material = (rng() % 256 + 1) * 256;
+			draw.indexStart = (uint32_t)(i / instancesPerDraw) * 36;
+			draw.indexCount = 36;
+			draw.key = DrawList::MakeKey(0, draw.pipeline, 0, draw.table, (uint32_t)(draw.material / 256), 0);
+		}
+		draw.instance = (uint32_t)i;
+		draw.sphere[0] = position(rng);
+		draw.sphere[1] = position(rng);
+		draw.sphere[2] = position(rng);
+		draw.sphere[3] = 10.f;
+		list.Add(0, draw);
+	}
+	list.Update();
+	// x >= 0, остальные плоскости далеко
+	const float planes[6][4] = {
+		{ 1.f, 0.f, 0.f, 0.f }, { -1.f, 0.f, 0.f, 1e6f }, { 0.f, 1.f, 0.f, 1e6f },
+		{ 0.f, -1.f, 0.f, 1e6f }, { 0.f, 0.f, 1.f, 1e6f }, { 0.f, 0.f, -1.f, 1e6f } };
+
+	DrawPacketBuilder reference;
+	reference.Build(list, planes, nullptr, chunkSize);
+
+	std::vector<BuildTiming> timings;
+	for (unsigned threads : threadCounts)
+	{
+		std::unique_ptr<JobSystem> jobs;
+		if (threads > 1) jobs = std::make_unique<JobSystem>(threads - 1);
+		DrawPacketBuilder builder;
+		builder.Build(list, planes, jobs.get(), chunkSize);
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i) builder.Build(list, planes, jobs.get(), chunkSize);
+		const auto end = std::chrono::steady_clock::now();
+
+		BuildTiming timing;
+		timing.threads = jobs ? jobs->GetThreadCount() : 1;
+		timing.draws = draws;
+		timing.milliseconds = std::chrono::duration<double, std::milli>(end - start).count() / (iterations > 0 ? iterations : 1);
+		timing.batches = builder.GetDrawCount();
+		timing.instances = builder.GetInstanceCount();
+		timing.identical = builder.GetPackets() == reference.GetPackets() && builder.GetInstances() == reference.GetInstances();
+		timings.push_back(timing);
+	}
+	return timings;
+}
\ No newline at end of file
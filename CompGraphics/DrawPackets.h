@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "RetainedDrawList.h"
+
+class JobSystem;
+class OcclusionBuffer;
+class PotentiallyVisibleSet;
+
+// Команда отрисовки без привязки к API: смена состояния или отрисовка. Поток пакетов
+// переигрывается в список команд D3D12, а на CPU сравнивается поэлементно
+struct CommandPacket
+{
+	enum Type : uint32_t { SetPipeline, SetMesh, SetTable, SetMaterial, Draw };
+
+	Type type = Draw;
+	// SetPipeline, SetMesh, SetTable - новое значение; Draw - число индексов
+	uint32_t value = 0;
+	// Draw - первый индекс
+	uint32_t start = 0;
+	// Draw - экземпляры [instanceStart, instanceStart + instanceCount) в GetInstances()
+	uint32_t instanceStart = 0;
+	uint32_t instanceCount = 0;
+	// SetMaterial - адрес констант материала
+	uint64_t material = 0;
+
+	bool operator==(const CommandPacket& other) const
+	{
+		return type == other.type && value == other.value && start == other.start &&
+			instanceStart == other.instanceStart && instanceCount == other.instanceCount && material == other.material;
+	}
+};
+
+// Пакеты видимых отрисовок RetainedDrawList. Отсортированный порядок режется на куски, кусок
+// отсекается и переводится в свой поток пакетов на потоке JobSystem, потоки сливаются в порядке
+// кусков. Кусок начинается с неизвестного состояния, поэтому при слиянии его смены состояния
+// до первой отрисовки, уже выставленные предыдущими кусками, отбрасываются: результат тот же,
+// что у однопоточной сборки, при любом числе потоков и размере куска.
+// Подряд идущие видимые записи с тем же состоянием и диапазоном индексов (экземпляры одного
+// сабсета) становятся одной отрисовкой с instanceCount > 1; номера их экземпляров сжимаются
+// в GetInstances() подряд. Отрисовка, разрезанная границей кусков, склеивается при слиянии.
+// Записи, прошедшие пирамиду, отбрасываются набором PVS ячейки камеры, затем буфером перекрытия.
+class DrawPacketBuilder
+{
+public:
+	struct BuildTiming
+	{
+		unsigned threads = 0;
+		size_t draws = 0;
+		// Отрисовок и видимых экземпляров после сборки
+		uint32_t batches = 0;
+		uint32_t instances = 0;
+		double milliseconds = 0.0;
+		// Пакеты совпали с однопоточной сборкой
+		bool identical = false;
+	};
+
+	// jobs == nullptr - все куски на вызывающем потоке; occlusion - уже отрисованный для этого
+	// кадра буфер, pvs - набор с выбранной ячейкой камеры, или nullptr
+	void Build(const RetainedDrawList& list, const float planes[6][4], JobSystem* jobs, size_t chunkSize,
+		const OcclusionBuffer* occlusion = nullptr, const PotentiallyVisibleSet* pvs = nullptr);
+
+	const std::vector<CommandPacket>& GetPackets() const { return m_packets; }
+	// Номера видимых экземпляров подряд по отрисовкам
+	const std::vector<uint32_t>& GetInstances() const { return m_instances; }
+	// Отрисовки (пакеты Draw) последней сборки
+	uint32_t GetDrawCount() const { return m_draws; }
+	// Видимые записи последней сборки
+	uint32_t GetInstanceCount() const { return (uint32_t)m_instances.size(); }
+	// Записи внутри пирамиды, отброшенные набором PVS и буфером перекрытия
+	uint32_t GetPvsCulledCount() const { return m_pvsCulled; }
+	uint32_t GetOccludedCount() const { return m_occluded; }
+
+	// Случайный список из draws записей, по instancesPerDraw экземпляров одного сабсета,
+	// половина отсекается; сборка на каждом числе потоков
+	static std::vector<BuildTiming> BenchmarkBuild(size_t draws, const std::vector<unsigned>& threadCounts,
+		size_t chunkSize, int iterations, uint32_t instancesPerDraw = 1);
+
+private:
+	struct State
+	{
+		uint32_t pipeline = UINT32_MAX;
+		uint32_t mesh = UINT32_MAX;
+		uint32_t table = UINT32_MAX;
+		uint64_t material = UINT64_MAX;
+	};
+
+	struct Chunk
+	{
+		std::vector<uint32_t> visible;
+		std::vector<CommandPacket> packets;
+		std::vector<uint32_t> instances;
+		// Смены состояния до первой отрисовки
+		size_t leading = 0;
+		State last;
+		uint32_t draws = 0;
+		uint32_t pvsCulled = 0;
+		uint32_t occluded = 0;
+	};
+
+	static void BuildChunk(const RetainedDrawList& list, const float planes[6][4], const OcclusionBuffer* occlusion,
+		const PotentiallyVisibleSet* pvs, size_t begin, size_t end, Chunk& chunk);
+	// true - пакет меняет состояние bound (и bound обновлен), false - повтор
+	static bool Apply(const CommandPacket& packet, State& bound);
+
+	// Память кусков живет между кадрами
+	std::vector<Chunk> m_chunks;
+	std::vector<CommandPacket> m_packets;
+	std::vector<uint32_t> m_instances;
+	uint32_t m_draws = 0;
+	uint32_t m_pvsCulled = 0;
+	uint32_t m_occluded = 0;
+};
\ No newline at end of file
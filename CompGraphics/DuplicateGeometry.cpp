@@ -0,0 +1,343 @@
+#include "DuplicateGeometry.h"
+#include "SceneConstants.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+// Связный кусок сабсета: вершины в порядке первого появления, треугольники в их номерах
+struct DuplicateComponent
+{
+	int subset = 0;
+	std::vector<uint32_t> vertices;
+	std::vector<uint32_t> indices;
+	XMFLOAT3 centroid = { 0.f, 0.f, 0.f };
+	uint64_t hash = 0;
+};
+
+// Образец и его копии; матрицы - из пространства образца в пространство копии
+struct DuplicateGroup
+{
+	uint32_t prototype = 0;
+	std::vector<uint32_t> copies;
+	std::vector<XMFLOAT4X4> transforms;
+};
+
+static void HashValue(uint64_t& hash, uint64_t value)
+{
+	for (int i = 0; i < 8; ++i, value >>= 8)
+	{
+		hash ^= value & 0xff;
+		hash *= 1099511628211ull;
+	}
+}
+
+static uint32_t FindRoot(std::vector<uint32_t>& parent, uint32_t v)
+{
+	while (parent[v] != v) v = parent[v] = parent[parent[v]];
+	return v;
+}
+
+// Куски одного сабсета. Вершины с одинаковой позицией (шов нормалей или UV) склеиваются,
+// иначе деталь распалась бы по швам
+static void SplitComponents(const ObjMesh& mesh, int subset, std::vector<DuplicateComponent>& out)
+{
+	const MeshSubset& sub = mesh.subsets[subset];
+	const uint32_t end = sub.indexStart + sub.indexCount / 3 * 3;
+	std::unordered_map<uint32_t, uint32_t> local;
+	std::vector<uint32_t> vertices;
+	for (uint32_t i = sub.indexStart; i < end; ++i)
+		if (local.emplace(mesh.indices[i], (uint32_t)vertices.size()).second) vertices.push_back(mesh.indices[i]);
+
+	std::vector<uint32_t> parent(vertices.size());
+	std::iota(parent.begin(), parent.end(), 0u);
+	auto unite = [&](uint32_t a, uint32_t b) { parent[FindRoot(parent, a)] = FindRoot(parent, b); };
+	std::unordered_map<uint64_t, uint32_t> byPosition;
+	for (uint32_t v = 0; v < (uint32_t)vertices.size(); ++v)
+	{
+		uint32_t bits[3];
+		memcpy(bits, &mesh.vertices[vertices[v]].Position, sizeof(bits));
+		uint64_t key = 14695981039346656037ull;
+		for (uint32_t b : bits) HashValue(key, b);
+		auto it = byPosition.emplace(key, v);
+		if (!it.second) unite(v, it.first->second);
+	}
+	for (uint32_t i = sub.indexStart; i < end; i += 3)
+	{
+		unite(local[mesh.indices[i]], local[mesh.indices[i + 1]]);
+		unite(local[mesh.indices[i]], local[mesh.indices[i + 2]]);
+	}
+
+	// Куски в порядке первого треугольника; вершина принадлежит ровно одному куску
+	std::unordered_map<uint32_t, uint32_t> rootComponent;
+	std::vector<uint32_t> componentLocal(vertices.size(), UINT32_MAX);
+	for (uint32_t i = sub.indexStart; i < end; i += 3)
+	{
+		const uint32_t root = FindRoot(parent, local[mesh.indices[i]]);
+		auto it = rootComponent.emplace(root, (uint32_t)out.size());
+		if (it.second)
+		{
+			out.push_back(DuplicateComponent());
+			out.back().subset = subset;
+		}
+		DuplicateComponent& c = out[it.first->second];
+		for (uint32_t k = 0; k < 3; ++k)
+		{
+			const uint32_t v = local[mesh.indices[i + k]];
+			if (componentLocal[v] == UINT32_MAX)
+			{
+				componentLocal[v] = (uint32_t)c.vertices.size();
+				c.vertices.push_back(vertices[v]);
+			}
+			c.indices.push_back(componentLocal[v]);
+		}
+	}
+}
+
+// Центр масс и хеш признаков, которые не меняются при повороте и сдвиге
+static void Describe(const ObjMesh& mesh, DuplicateComponent& c, float tolerance)
+{
+	XMVECTOR sum = XMVectorZero();
+	for (uint32_t v : c.vertices) sum = XMVectorAdd(sum, XMLoadFloat3(&mesh.vertices[v].Position));
+	const XMVECTOR centroid = XMVectorScale(sum, 1.0f / c.vertices.size());
+	XMStoreFloat3(&c.centroid, centroid);
+	float gyration = 0.f;
+	for (uint32_t v : c.vertices)
+		gyration += XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&mesh.vertices[v].Position), centroid)));
+	gyration = sqrtf(gyration / c.vertices.size());
+
+	uint64_t hash = 14695981039346656037ull;
+	HashValue(hash, (uint64_t)(int64_t)mesh.subsets[c.subset].materialIdx);
+	HashValue(hash, c.vertices.size());
+	HashValue(hash, c.indices.size());
+	for (uint32_t i : c.indices) HashValue(hash, i);
+	// Ячейка много больше ошибки округления копий: на границу ячейки они почти не попадают
+	HashValue(hash, (uint64_t)(gyration / (tolerance * 64.f)));
+	c.hash = hash;
+}
+
+// Собственный вектор наибольшего собственного числа симметричной матрицы (метод Якоби)
+static void LargestEigenvector(double a[4][4], double out[4])
+{
+	double v[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+	for (int sweep = 0; sweep < 50; ++sweep)
+	{
+		double off = 0.0, diagonal = 0.0;
+		for (int p = 0; p < 4; ++p)
+		{
+			diagonal += a[p][p] * a[p][p];
+			for (int q = p + 1; q < 4; ++q) off += a[p][q] * a[p][q];
+		}
+		if (off <= 1e-24 * diagonal) break;
+		for (int p = 0; p < 4; ++p)
+			for (int q = p + 1; q < 4; ++q)
+			{
+				if (a[p][q] == 0.0) continue;
+				const double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+				const double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+				const double c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+				for (int k = 0; k < 4; ++k)
+				{
+					const double kp = a[k][p], kq = a[k][q];
+					a[k][p] = c * kp - s * kq;
+					a[k][q] = s * kp + c * kq;
+				}
+				for (int k = 0; k < 4; ++k)
+				{
+					const double pk = a[p][k], qk = a[q][k];
+					a[p][k] = c * pk - s * qk;
+					a[q][k] = s * pk + c * qk;
+				}
+				for (int k = 0; k < 4; ++k)
+				{
+					const double kp = v[k][p], kq = v[k][q];
+					v[k][p] = c * kp - s * kq;
+					v[k][q] = s * kp + c * kq;
+				}
+			}
+	}
+	int best = 0;
+	for (int i = 1; i < 4; ++i)
+		if (a[i][i] > a[best][best]) best = i;
+	for (int i = 0; i < 4; ++i) out[i] = v[i][best];
+}
+
+// Матрица из пространства a в пространство b, если b - жесткая копия a с тем же порядком
+// вершин. Поворот - кватернион Хорна по парам вершин относительно центров масс
+static bool MatchRigid(const ObjMesh& mesh, const DuplicateComponent& a, const DuplicateComponent& b,
+	const DuplicateGeometryOptions& options, XMFLOAT4X4& transform)
+{
+	if (mesh.subsets[a.subset].materialIdx != mesh.subsets[b.subset].materialIdx) return false;
+	if (a.vertices.size() != b.vertices.size() || a.indices != b.indices) return false;
+	const size_t count = a.vertices.size();
+	// UV не поворачиваются
+	for (size_t i = 0; i < count; ++i)
+	{
+		const XMFLOAT2& ta = mesh.vertices[a.vertices[i]].TexCoord;
+		const XMFLOAT2& tb = mesh.vertices[b.vertices[i]].TexCoord;
+		if (fabsf(ta.x - tb.x) > options.texCoordTolerance || fabsf(ta.y - tb.y) > options.texCoordTolerance) return false;
+	}
+
+	double s[3][3] = {};
+	for (size_t i = 0; i < count; ++i)
+	{
+		const XMFLOAT3& pa = mesh.vertices[a.vertices[i]].Position;
+		const XMFLOAT3& pb = mesh.vertices[b.vertices[i]].Position;
+		const double p[3] = { pa.x - a.centroid.x, pa.y - a.centroid.y, pa.z - a.centroid.z };
+		const double q[3] = { pb.x - b.centroid.x, pb.y - b.centroid.y, pb.z - b.centroid.z };
+		for (int r = 0; r < 3; ++r)
+			for (int k = 0; k < 3; ++k) s[r][k] += p[r] * q[k];
+	}
+	double n[4][4] = {
+		{ s[0][0] + s[1][1] + s[2][2], s[1][2] - s[2][1], s[2][0] - s[0][2], s[0][1] - s[1][0] },
+		{ s[1][2] - s[2][1], s[0][0] - s[1][1] - s[2][2], s[0][1] + s[1][0], s[2][0] + s[0][2] },
+		{ s[2][0] - s[0][2], s[0][1] + s[1][0], -s[0][0] + s[1][1] - s[2][2], s[1][2] + s[2][1] },
+		{ s[0][1] - s[1][0], s[2][0] + s[0][2], s[1][2] + s[2][1], -s[0][0] - s[1][1] + s[2][2] } };
+	double quat[4];
+	LargestEigenvector(n, quat);
+
+	XMMATRIX m = XMMatrixRotationQuaternion(XMVector4Normalize(
+		XMVectorSet((float)quat[1], (float)quat[2], (float)quat[3], (float)quat[0])));
+	const XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&b.centroid), XMVector3TransformNormal(XMLoadFloat3(&a.centroid), m));
+	m.r[3] = XMVectorSetW(offset, 1.0f);
+
+	const float positionTolerance = options.positionTolerance * options.positionTolerance;
+	const float normalTolerance = options.normalTolerance * options.normalTolerance;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const ObjMesh::Vertex& va = mesh.vertices[a.vertices[i]];
+		const ObjMesh::Vertex& vb = mesh.vertices[b.vertices[i]];
+		const XMVECTOR p = XMVector3Transform(XMLoadFloat3(&va.Position), m);
+		if (XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(p, XMLoadFloat3(&vb.Position)))) > positionTolerance) return false;
+		const XMVECTOR normal = XMVector3TransformNormal(XMLoadFloat3(&va.Normal), m);
+		if (XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(normal, XMLoadFloat3(&vb.Normal)))) > normalTolerance) return false;
+	}
+	XMStoreFloat4x4(&transform, m);
+	return true;
+}
+
+DuplicateGeometryReport InstanceDuplicateGeometry(ObjMesh& mesh, const DuplicateGeometryOptions& options)
+{
+	const auto start = std::chrono::steady_clock::now();
+	DuplicateGeometryReport report;
+	report.verticesBefore = report.verticesAfter = mesh.vertices.size();
+	report.indicesBefore = report.indicesAfter = mesh.indices.size();
+	report.bytesBefore = report.bytesAfter = mesh.vertices.size() * sizeof(ObjMesh::Vertex) +
+		mesh.indices.size() * sizeof(uint32_t) + mesh.instances.size() * sizeof(InstanceData);
+	// Уже разобранный меш второй раз не трогаем
+	if (!mesh.instances.empty()) return report;
+
+	std::vector<DuplicateComponent> components;
+	for (int s = 0; s < (int)mesh.subsets.size(); ++s) SplitComponents(mesh, s, components);
+	report.components = (uint32_t)components.size();
+	for (DuplicateComponent& c : components) Describe(mesh, c, options.positionTolerance);
+
+	// Кусок сравнивается с образцом каждой группы своей корзины
+	std::vector<DuplicateGroup> groups;
+	std::vector<int> componentGroup(components.size(), -1);
+	std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+	for (uint32_t i = 0; i < (uint32_t)components.size(); ++i)
+	{
+		if (components[i].vertices.size() < options.minVertices) continue;
+		std::vector<uint32_t>& bucket = buckets[components[i].hash];
+		XMFLOAT4X4 transform;
+		for (uint32_t g : bucket)
+		{
+			if (!MatchRigid(mesh, components[groups[g].prototype], components[i], options, transform)) continue;
+			groups[g].copies.push_back(i);
+			groups[g].transforms.push_back(transform);
+			componentGroup[i] = (int)g;
+			break;
+		}
+		if (componentGroup[i] >= 0) continue;
+		componentGroup[i] = (int)groups.size();
+		bucket.push_back((uint32_t)groups.size());
+		groups.push_back(DuplicateGroup());
+		groups.back().prototype = i;
+	}
+
+	// Группа окупается, если сэкономленные вершины и индексы дороже матриц экземпляров
+	std::vector<bool> accepted(groups.size(), false);
+	for (size_t g = 0; g < groups.size(); ++g)
+	{
+		const DuplicateComponent& prototype = components[groups[g].prototype];
+		const size_t copies = groups[g].copies.size();
+		const size_t geometry = prototype.vertices.size() * sizeof(ObjMesh::Vertex) + prototype.indices.size() * sizeof(uint32_t);
+		accepted[g] = copies + 1 >= options.minCopies && copies > 0 && copies * geometry > (copies + 1) * sizeof(InstanceData);
+		if (!accepted[g]) continue;
+		++report.prototypes;
+		report.copies += (uint32_t)copies;
+	}
+	if (report.prototypes == 0)
+	{
+		report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return report;
+	}
+
+	std::vector<ObjMesh::Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MeshSubset> subsets;
+	std::vector<XMFLOAT4X4> instances;
+	std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+	auto emit = [&](const DuplicateComponent& c) {
+		for (uint32_t i : c.indices)
+		{
+			const uint32_t v = c.vertices[i];
+			if (remap[v] == UINT32_MAX)
+			{
+				remap[v] = (uint32_t)vertices.size();
+				vertices.push_back(mesh.vertices[v]);
+			}
+			indices.push_back(remap[v]);
+		}
+		};
+
+	// Неповторяющаяся часть сабсетов в прежнем порядке; куски идут по сабсетам подряд
+	size_t next = 0;
+	for (int s = 0; s < (int)mesh.subsets.size(); ++s)
+	{
+		MeshSubset sub;
+		sub.materialIdx = mesh.subsets[s].materialIdx;
+		sub.indexStart = (uint32_t)indices.size();
+		for (; next < components.size() && components[next].subset == s; ++next)
+		{
+			const int g = componentGroup[next];
+			if (g < 0 || !accepted[g]) emit(components[next]);
+		}
+		sub.indexCount = (uint32_t)indices.size() - sub.indexStart;
+		if (sub.indexCount) subsets.push_back(sub);
+	}
+	// Образцы: вершины остаются на месте образца, его матрица единичная
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	for (size_t g = 0; g < groups.size(); ++g)
+	{
+		if (!accepted[g]) continue;
+		const DuplicateComponent& prototype = components[groups[g].prototype];
+		MeshSubset sub;
+		sub.materialIdx = mesh.subsets[prototype.subset].materialIdx;
+		sub.indexStart = (uint32_t)indices.size();
+		emit(prototype);
+		sub.indexCount = (uint32_t)indices.size() - sub.indexStart;
+		sub.instanceStart = (uint32_t)instances.size();
+		sub.instanceCount = (uint32_t)groups[g].copies.size() + 1;
+		instances.push_back(identity);
+		instances.insert(instances.end(), groups[g].transforms.begin(), groups[g].transforms.end());
+		subsets.push_back(sub);
+	}
+
+	mesh.vertices.swap(vertices);
+	mesh.indices.swap(indices);
+	mesh.subsets.swap(subsets);
+	mesh.instances.swap(instances);
+	ObjLoader::ComputeSubsetBounds(mesh);
+
+	report.verticesAfter = mesh.vertices.size();
+	report.indicesAfter = mesh.indices.size();
+	report.bytesAfter = mesh.vertices.size() * sizeof(ObjMesh::Vertex) + mesh.indices.size() * sizeof(uint32_t) +
+		mesh.instances.size() * sizeof(InstanceData);
+	report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return report;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "OBJLoader.h"
+
+// Повторяющаяся геометрия, запеченная в мировые координаты (колонны, арки, вазы Sponza).
+// Сабсет режется на связные куски (вершины с одинаковой позицией склеиваются), кусок
+// приводится к центру масс и хешируется по топологии и радиусу инерции - признакам,
+// которые не меняются при повороте и сдвиге. Куски с одним хешем сравниваются вершина
+// в вершину: поворот находится методом Хорна, копия принимается, если все позиции,
+// нормали и UV совпали с допуском. Копии заменяются одним общим сабсетом с матрицами
+// в ObjMesh::instances. Без D3D, работает на потоке загрузки.
+struct DuplicateGeometryOptions
+{
+	// Допуск позиций в единицах модели, нормалей - по длине разности, UV - по координате
+	float positionTolerance = 0.01f;
+	float normalTolerance = 0.01f;
+	float texCoordTolerance = 1e-4f;
+	// Мелкие куски дешевле оставить как есть: экземпляр стоит матриц и отдельной отрисовки
+	uint32_t minVertices = 24;
+	uint32_t minCopies = 2;
+};
+
+struct DuplicateGeometryReport
+{
+	uint32_t components = 0;
+	// Общие сабсеты и замененные ими куски (без самого образца)
+	uint32_t prototypes = 0;
+	uint32_t copies = 0;
+	size_t verticesBefore = 0;
+	size_t verticesAfter = 0;
+	size_t indicesBefore = 0;
+	size_t indicesAfter = 0;
+	// Вершины, индексы и, после, матрицы экземпляров InstanceData
+	size_t bytesBefore = 0;
+	size_t bytesAfter = 0;
+	double milliseconds = 0.0;
+};
+
+// Переписывает вершины, индексы и сабсеты mesh: сначала неповторяющаяся часть каждого
+// сабсета, затем по сабсету на образец с instanceCount копий (первая - сам образец,
+// единичная матрица). Сферы сабсетов пересчитываются
+DuplicateGeometryReport InstanceDuplicateGeometry(ObjMesh& mesh, const DuplicateGeometryOptions& options = DuplicateGeometryOptions());
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "FileWatcher.h"
+#include "VirtualFileSystem.h"
+#include <cstdio>
+
+static const DWORD kWatchFilter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE;
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+	for (auto& dir : m_directories)
+	{
+		// Буфер должен жить, пока отмененный запрос не завершится
+		DWORD bytes = 0;
+		CancelIoEx(dir->handle, &dir->ov);
+		GetOverlappedResult(dir->handle, &dir->ov, &bytes, TRUE);
+		CloseHandle(dir->handle);
+		CloseHandle(dir->event);
+	}
+}
+
+bool FileWatcher::Watch(const std::string& directory, const std::string& mountPoint)
+{
+	std::unique_ptr<Directory> dir(new Directory());
+	dir->handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	if (dir->handle == INVALID_HANDLE_VALUE) return false;
+	dir->event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	dir->mountPoint = VirtualFileSystem::Normalize(mountPoint);
+	dir->buffer.resize(64 * 1024);
+
+	// Поток ждет фиксированный набор событий, поэтому новый каталог добавляется при остановленном потоке
+	Stop();
+	if (!Issue(*dir))
+	{
+		CloseHandle(dir->handle);
+		CloseHandle(dir->event);
+		Start();
+		return false;
+	}
+	m_directories.push_back(std::move(dir));
+	Start();
+
+	char msg[512];
+	sprintf_s(msg, "[FileWatcher] Watching %s at '%s'\n", directory.c_str(), mountPoint.c_str());
+	OutputDebugStringA(msg);
+	return true;
+}
+
+bool FileWatcher::Issue(Directory& dir)
+{
+	ResetEvent(dir.event);
+	dir.ov = OVERLAPPED{};
+	dir.ov.hEvent = dir.event;
+	return ReadDirectoryChangesW(dir.handle, dir.buffer.data(), (DWORD)dir.buffer.size(), TRUE,
+		kWatchFilter, nullptr, &dir.ov, nullptr) != FALSE;
+}
+
+void FileWatcher::Start()
+{
+	if (m_directories.empty()) return;
+	m_stopEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	m_thread = std::thread([this]() { ThreadLoop(); });
+}
+
+void FileWatcher::Stop()
+{
+	if (!m_thread.joinable()) return;
+	SetEvent(m_stopEvent);
+	m_thread.join();
+	CloseHandle(m_stopEvent);
+	m_stopEvent = nullptr;
+}
+
+void FileWatcher::ThreadLoop()
+{
+	std::vector<HANDLE> events;
+	for (auto& dir : m_directories) events.push_back(dir->event);
+	events.push_back(m_stopEvent);
+
+	for (;;)
+	{
+		DWORD wait = WaitForMultipleObjects((DWORD)events.size(), events.data(), FALSE, INFINITE);
+		if (wait < WAIT_OBJECT_0 || wait >= WAIT_OBJECT_0 + events.size() - 1) return;
+		Directory& dir = *m_directories[wait - WAIT_OBJECT_0];
+		DWORD bytes = 0;
+		if (GetOverlappedResult(dir.handle, &dir.ov, &bytes, FALSE)) Parse(dir, bytes);
+		Issue(dir);
+	}
+}
+
+void FileWatcher::Parse(Directory& dir, DWORD bytes)
+{
+	// 0 байт - переполнение буфера, часть событий потеряна; следующий вызов продолжит слежение
+	if (bytes == 0) return;
+	const auto now = std::chrono::steady_clock::now();
+	const uint8_t* p = dir.buffer.data();
+	for (;;)
+	{
+		const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+		if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+		{
+			const int wideLength = (int)(info->FileNameLength / sizeof(WCHAR));
+			int length = WideCharToMultiByte(CP_ACP, 0, info->FileName, wideLength, nullptr, 0, nullptr, nullptr);
+			std::string name(length, '\0');
+			WideCharToMultiByte(CP_ACP, 0, info->FileName, wideLength, &name[0], length, nullptr, nullptr);
+
+			// CP_ACP - так же, как имена из FindFirstFileA при монтировании
+			std::string path = VirtualFileSystem::Join(dir.mountPoint, name);
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto it = m_pending.find(path);
+			if (it == m_pending.end()) m_pending.emplace(path, Pending{ now, now });
+			else it->second.last = now;
+		}
+		if (info->NextEntryOffset == 0) break;
+		p += info->NextEntryOffset;
+	}
+}
+
+void FileWatcher::Poll(std::vector<Change>& changes, double quietMs)
+{
+	const auto now = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto it = m_pending.begin(); it != m_pending.end();)
+	{
+		if (std::chrono::duration<double, std::milli>(now - it->second.last).count() < quietMs)
+		{
+			++it;
+			continue;
+		}
+		changes.push_back({ it->first, it->second.first });
+		it = m_pending.erase(it);
+	}
+}
\ No newline at end of file
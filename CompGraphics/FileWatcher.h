@@ -0,0 +1,60 @@
+#pragma once
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Слежение за каталогами через ReadDirectoryChangesW (рекурсивно, overlapped) в отдельном потоке.
+// Пути изменений переводятся в виртуальные (mountPoint + относительный путь, как в VirtualFileSystem).
+// Редактор обычно пишет файл несколькими операциями, поэтому Poll отдает файл только после
+// паузы в событиях по нему.
+class FileWatcher
+{
+public:
+	struct Change
+	{
+		std::string path;
+		// Первое событие по файлу - от него считается задержка перезагрузки
+		std::chrono::steady_clock::time_point firstSeen;
+	};
+
+	FileWatcher() = default;
+	~FileWatcher();
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	bool Watch(const std::string& directory, const std::string& mountPoint = "");
+	void Poll(std::vector<Change>& changes, double quietMs = 100.0);
+
+private:
+	struct Directory
+	{
+		HANDLE handle = INVALID_HANDLE_VALUE;
+		HANDLE event = nullptr;
+		OVERLAPPED ov{};
+		std::string mountPoint;
+		std::vector<uint8_t> buffer;
+	};
+	struct Pending
+	{
+		std::chrono::steady_clock::time_point first;
+		std::chrono::steady_clock::time_point last;
+	};
+
+	void Start();
+	void Stop();
+	void ThreadLoop();
+	bool Issue(Directory& dir);
+	void Parse(Directory& dir, DWORD bytes);
+
+	std::vector<std::unique_ptr<Directory>> m_directories;
+	std::thread m_thread;
+	HANDLE m_stopEvent = nullptr;
+	std::mutex m_mutex;
+	std::map<std::string, Pending> m_pending;
+};
\ No newline at end of file
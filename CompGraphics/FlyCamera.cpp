@@ -0,0 +1,72 @@
+#include "FlyCamera.h"
+#include <cmath>
+
+using namespace DirectX;
+
+static const float MaxPitch = XM_PIDIV2 - 0.1f;
+
+static float ClampPitch(float pitch)
+{
+	return pitch < -MaxPitch ? -MaxPitch : (pitch > MaxPitch ? MaxPitch : pitch);
+}
+
+void FlyCamera::Update(float deltaTime, const InputDevice& input)
+{
+	const float moveSpeed = m_speed * deltaTime;
+	XMFLOAT3 moveDelta = { 0, 0, 0 };
+	if (input.IsKeyDown('W')) moveDelta.z += moveSpeed;
+	if (input.IsKeyDown('S')) moveDelta.z -= moveSpeed;
+	if (input.IsKeyDown('A')) moveDelta.x -= moveSpeed;
+	if (input.IsKeyDown('D')) moveDelta.x += moveSpeed;
+	if (input.IsKeyDown('Q')) moveDelta.y -= moveSpeed;
+	if (input.IsKeyDown('E')) moveDelta.y += moveSpeed;
+	if (input.MouseDX() != 0 || input.MouseDY() != 0)
+	{
+		const float mouseSensitivity = 0.005f;
+		m_yaw += input.MouseDX() * mouseSensitivity;
+		m_pitch = ClampPitch(m_pitch + input.MouseDY() * mouseSensitivity);
+	}
+	const float rotateSpeed = 1.0f * deltaTime;
+	if (input.IsKeyDown(KEY_LEFT)) m_yaw += rotateSpeed;
+	if (input.IsKeyDown(KEY_RIGHT)) m_yaw -= rotateSpeed;
+	if (input.IsKeyDown(KEY_UP)) m_pitch = ClampPitch(m_pitch + rotateSpeed);
+	if (input.IsKeyDown(KEY_DOWN)) m_pitch = ClampPitch(m_pitch - rotateSpeed);
+
+	const XMMATRIX rotation = XMMatrixRotationRollPitchYaw(m_pitch, m_yaw, 0);
+	const XMVECTOR eye = XMLoadFloat3(&m_eye) + XMVector3TransformNormal(XMLoadFloat3(&moveDelta), rotation);
+	XMStoreFloat3(&m_eye, eye);
+	XMStoreFloat3(&m_target, eye + XMVector3TransformNormal(XMVectorSet(0, 0, 1, 0), rotation));
+}
+
+void FlyCamera::SetEye(const XMFLOAT3& eye)
+{
+	const XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&eye), XMLoadFloat3(&m_eye));
+	XMStoreFloat3(&m_target, XMVectorAdd(XMLoadFloat3(&m_target), offset));
+	m_eye = eye;
+}
+
+XMMATRIX FlyCamera::GetView() const
+{
+	return XMMatrixLookAtLH(XMLoadFloat3(&m_eye), XMLoadFloat3(&m_target), XMLoadFloat3(&m_up));
+}
+
+XMMATRIX FlyCamera::GetProj(float aspect) const
+{
+	return XMMatrixPerspectiveFovLH(XMConvertToRadians(FovY), aspect, NearPlane, FarPlane);
+}
+
+float FlyCamera::GetVerticalAngle() const
+{
+	XMFLOAT3 dir;
+	XMStoreFloat3(&dir, XMVector3Normalize(XMLoadFloat3(&m_target) - XMLoadFloat3(&m_eye)));
+	const float horizLength = sqrtf(dir.x * dir.x + dir.z * dir.z);
+	return atan2f(dir.y, horizLength);
+}
+
+// Плоскости из столбцов view * proj: x, y в [-w, w], z в [0, w]
+void FlyCamera::ExtractFrustum(FXMMATRIX viewProj, float planes[6][4])
+{
+	const XMMATRIX m = XMMatrixTranspose(viewProj);
+	const XMVECTOR p[6] = { m.r[3] + m.r[0], m.r[3] - m.r[0], m.r[3] + m.r[1], m.r[3] - m.r[1], m.r[2], m.r[3] - m.r[2] };
+	for (int i = 0; i < 6; ++i) XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(planes[i]), XMPlaneNormalize(p[i]));
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include <DirectXMath.h>
+#include "InputDevice.h"
+
+// Свободная камера: WASD и QE двигают вдоль осей взгляда, мышь и стрелки поворачивают.
+// Без D3D: ей управляют и окно, и безголовый прогон по записанному вводу
+class FlyCamera
+{
+public:
+	void Update(float deltaTime, const InputDevice& input);
+
+	const DirectX::XMFLOAT3& GetEye() const { return m_eye; }
+	// Переносит камеру, направление взгляда не меняется (после проверки столкновений)
+	void SetEye(const DirectX::XMFLOAT3& eye);
+	DirectX::XMMATRIX GetView() const;
+	DirectX::XMMATRIX GetProj(float aspect) const;
+	// Угол взгляда над горизонтом
+	float GetVerticalAngle() const;
+
+	// Плоскости (a, b, c, d) пирамиды viewProj, нормализованные, нормали внутрь
+	static void ExtractFrustum(DirectX::FXMMATRIX viewProj, float planes[6][4]);
+
+	static constexpr float FovY = 60.f;
+	static constexpr float NearPlane = 0.1f;
+	static constexpr float FarPlane = 5000.f;
+
+private:
+	DirectX::XMFLOAT3 m_eye = { -80.f, 20.f, -20.f };
+	DirectX::XMFLOAT3 m_target = { 0.f, 10.f, 0.f };
+	DirectX::XMFLOAT3 m_up = { 0.f, 1.f, 0.f };
+	float m_speed = 500.0f;
+	float m_yaw = 0.0f;
+	float m_pitch = 0.0f;
+};
\ No newline at end of file
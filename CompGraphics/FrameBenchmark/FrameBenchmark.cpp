@@ -0,0 +1,328 @@
+// FrameBenchmark - CPU-стоимость кадра RenderingSystem без GPU и окна.
+//
+//   FrameBenchmark flight.txt [-scene sponza.obj] [-stump broken_stump.obj] [-threads N] [-repeat N]
+//                   [-stumps N] [-dedup] [-occlusion] [-pvs sponza.pvs] [-collision]
+//       Проигрывает записанный полет камеры (приложение с ключом -record flight.txt) над
+//       Sponza и пнем. Кадр - тот же отложенный путь, что RenderingSystem::DrawScene: камера,
+//       блоки констант, удерживаемый список отрисовок, отсечение и пакеты на JobSystem, дождь.
+//       Команды принимает NullCommandList. Печатает мс CPU на кадр, отрисовки и байты
+//       констант на кадр и хеш потока команд для сравнения сборок.
+//       -threads - потоков сборки пакетов вместе с основным (1 - без пула), -repeat - сколько
+//       раз пройти запись, -stumps - сколько пней (сетка от STUMP_POSITION с шагом 200); все
+//       пни - экземпляры одного меша, видимые рисуются одной отрисовкой на сабсет.
+//       -dedup - повторяющиеся куски сцены заменяются экземплярами, как при загрузке в
+//       RenderingSystem; печатается, сколько памяти вершин и индексов это сэкономило.
+//       -occlusion - сабсеты сцены режутся по ячейкам, каждый кадр крупные треугольники
+//       растеризуются в OcclusionBuffer, и прошедшие пирамиду отрисовки проверяются по нему;
+//       печатается время растеризации и доля отброшенных за полет.
+//       -pvs - набор PvsBaker для этой сцены (включает -dedup и ячейки, как при загрузке);
+//       каждый кадр выбирается ячейка камеры, и отрисовки сцены проверяются по ее набору
+//       до буфера перекрытия; печатается доля отброшенных набором.
+//       -collision - камера сталкивается со сценой, как в RenderingSystem::UpdateCamera (C в
+//       записи переключает столкновения и здесь): печатается время построения TriangleBvh и
+//       шага камеры. Путь камеры при этом другой, хеш потока не сравним с прогоном без ключа.
+//
+// Материалы - как после загрузки RenderingSystem, но текстуры не декодируются: у каждой
+// диффузной текстуры своя таблица (без упаковки TexturePacker таблиц не меньше), у пня полный
+// набор карт - тесселяция со смещением 15 и карта нормалей.
+#include "../OBJLoader.h"
+#include "../SceneConstants.h"
+#include "../SceneDraws.h"
+#include "../SceneFrame.h"
+#include "../DuplicateGeometry.h"
+#include "../FlyCamera.h"
+#include "../RainSimulation.h"
+#include "../InputRecording.h"
+#include "../GeometryPermutation.h"
+#include "../RetainedDrawList.h"
+#include "../DrawPackets.h"
+#include "../OcclusionBuffer.h"
+#include "../PotentiallyVisibleSet.h"
+#include "../TriangleBvh.h"
+#include "../JobSystem.h"
+#include "../NullCommandList.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+// Как у окна приложения
+static const float kAspect = 1280.f / 720.f;
+// Адреса блоков материалов: только различаются между материалами, GPU их не читает
+static const uint64_t kSceneMaterials = 0x100000;
+static const uint64_t kStumpMaterials = 0x200000;
+
+static std::vector<DrawMaterial> SceneMaterials(const ObjMesh& mesh)
+{
+	std::vector<DrawMaterial> materials(std::max<size_t>(mesh.materials.size(), 1));
+	std::map<std::string, uint32_t> tables;
+	for (size_t i = 0; i < materials.size(); ++i)
+	{
+		const std::string texture = i < mesh.materials.size() ? mesh.materials[i].diffuseTexture : std::string();
+		GeometryMaterialFeatures features;
+		features.diffuseMap = !texture.empty();
+		materials[i].pipeline = GeometryPermutationKey(features);
+		// Таблица 0 - текстуры по умолчанию
+		materials[i].table = texture.empty() ? 0 : tables.emplace(texture, (uint32_t)tables.size() + 1).first->second;
+		materials[i].constants = kSceneMaterials + i * sizeof(MaterialConstants);
+	}
+	return materials;
+}
+
+static std::vector<DrawMaterial> StumpMaterials(uint32_t table)
+{
+	GeometryMaterialFeatures features;
+	features.diffuseMap = true;
+	features.normalMap = true;
+	features.displacementScale = 15.0f;
+	DrawMaterial material;
+	material.pipeline = GeometryPermutationKey(features);
+	material.table = table;
+	material.constants = kStumpMaterials;
+	material.displacementScale = features.displacementScale;
+	return { material };
+}
+
+static double Percentile(std::vector<double> values, double p)
+{
+	if (values.empty()) return 0.0;
+	const size_t i = std::min(values.size() - 1, (size_t)(p * (values.size() - 1) + 0.5));
+	std::nth_element(values.begin(), values.begin() + i, values.end());
+	return values[i];
+}
+
+int main(int argc, char** argv)
+{
+	std::string recordingPath, scenePath = "sponza.obj", stumpPath = "broken_stump.obj", pvsPath;
+	int threads = 0, repeat = 1, stumpCount = 1;
+	bool dedup = false, occlusion = false, collision = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-scene") && i + 1 < argc) scenePath = argv[++i];
+		else if (!strcmp(argv[i], "-stump") && i + 1 < argc) stumpPath = argv[++i];
+		else if (!strcmp(argv[i], "-threads") && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-repeat") && i + 1 < argc) repeat = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-stumps") && i + 1 < argc) stumpCount = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-dedup")) dedup = true;
+		else if (!strcmp(argv[i], "-occlusion")) occlusion = true;
+		else if (!strcmp(argv[i], "-pvs") && i + 1 < argc) pvsPath = argv[++i];
+		else if (!strcmp(argv[i], "-collision")) collision = true;
+		else recordingPath = argv[i];
+	}
+	if (recordingPath.empty())
+	{
+		printf("usage: FrameBenchmark <recording> [-scene sponza.obj] [-stump broken_stump.obj] [-threads N] [-repeat N] [-stumps N] [-dedup] [-occlusion] [-pvs sponza.pvs] [-collision]\n");
+		return 1;
+	}
+
+	InputRecording recording;
+	if (!recording.Load(recordingPath) || recording.GetFrameCount() == 0)
+	{
+		fprintf(stderr, "Failed to load recording %s\n", recordingPath.c_str());
+		return 1;
+	}
+	ObjMesh scene, stump;
+	if (!ObjLoader::Load(scenePath, scene))
+	{
+		fprintf(stderr, "Failed to load %s\n", scenePath.c_str());
+		return 1;
+	}
+	if (!pvsPath.empty()) dedup = true;
+	if (dedup)
+	{
+		const DuplicateGeometryReport report = InstanceDuplicateGeometry(scene);
+		printf("%s: %u components, %u prototypes replace %u copies, %.1f ms\n", scenePath.c_str(),
+			report.components, report.prototypes, report.copies, report.milliseconds);
+		printf("vertices  %zu -> %zu, indices %zu -> %zu\n", report.verticesBefore, report.verticesAfter,
+			report.indicesBefore, report.indicesAfter);
+		printf("memory    %.2f -> %.2f MB (%.1f%% saved, instance matrices included)\n", report.bytesBefore / 1048576.0,
+			report.bytesAfter / 1048576.0, report.bytesBefore ? 100.0 * (1.0 - (double)report.bytesAfter / report.bytesBefore) : 0.0);
+	}
+	// Как RenderingSystem::LoadSceneMesh: сначала экземпляры, потом ячейки
+	std::vector<XMFLOAT3> occluders;
+	if (occlusion || !pvsPath.empty()) SplitSubsetsByCell(scene, OCCLUSION_CELL_SIZE);
+	if (occlusion) occluders = SelectOccluders(scene, OCCLUSION_OCCLUDERS);
+	PotentiallyVisibleSet pvs;
+	if (!pvsPath.empty())
+	{
+		std::vector<uint8_t> bytes;
+		FILE* file = fopen(pvsPath.c_str(), "rb");
+		if (file)
+		{
+			uint8_t buffer[65536];
+			size_t read;
+			while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + read);
+			fclose(file);
+		}
+		if (!pvs.Load(bytes.data(), bytes.size()) || pvs.GetFingerprint() != PotentiallyVisibleSet::Fingerprint(scene) ||
+			pvs.GetClusterCount() != CountClusters(scene))
+		{
+			fprintf(stderr, "%s is missing or was baked for another scene\n", pvsPath.c_str());
+			return 1;
+		}
+		printf("pvs       %s: %u clusters, %u cells, %zu bytes\n", pvsPath.c_str(), pvs.GetClusterCount(), pvs.GetCellCount(), bytes.size());
+	}
+	const bool hasStump = ObjLoader::Load(stumpPath, stump);
+	if (!hasStump) printf("stump %s not found, drawing the scene only\n", stumpPath.c_str());
+
+	// Блоки мешей и экземпляры - как RenderingSystem::RebuildInstances, пни дополнительно
+	// через AddStumpInstance
+	ObjectConstants objects[DRAW_MESH_COUNT] = {};
+	objects[DRAW_MESH_SCENE].TexScrollX = 0.05f;
+	std::vector<InstanceData> instances;
+	std::vector<uint32_t> meshInstances[DRAW_MESH_COUNT] = { { 0 }, {} };
+	AppendMeshInstances(XMMatrixIdentity(), scene.instances, instances);
+	const int side = (int)ceil(sqrt((double)stumpCount));
+	for (int i = 0; i < stumpCount; ++i)
+	{
+		const XMFLOAT3 position(STUMP_POSITION.x + (i % side) * 200.0f, STUMP_POSITION.y, STUMP_POSITION.z + (i / side) * 200.0f);
+		meshInstances[DRAW_MESH_STUMP].push_back((uint32_t)instances.size());
+		AppendMeshInstances(StumpWorld(position), stump.instances, instances);
+	}
+
+	const std::vector<DrawMaterial> sceneMaterials = SceneMaterials(scene);
+	std::vector<DrawMaterial> stumpMaterials;
+	if (hasStump)
+	{
+		uint32_t tables = 0;
+		for (const DrawMaterial& m : sceneMaterials) tables = std::max(tables, m.table);
+		stumpMaterials = StumpMaterials(tables + 1);
+	}
+
+	std::unique_ptr<JobSystem> jobs;
+	if (threads <= 0) jobs.reset(new JobSystem());
+	else if (threads > 1) jobs.reset(new JobSystem(threads - 1));
+	const unsigned threadCount = jobs ? jobs->GetThreadCount() : 1;
+
+	TriangleBvh bvh;
+	if (collision)
+	{
+		const TriangleBvh::BuildReport report = bvh.Build(scene, jobs.get());
+		printf("bvh       %u triangles, %u nodes, depth %u, %.2f MB, built in %.1f ms on %u thread(s)\n", report.triangles,
+			report.nodes, report.maxDepth, report.bytes / 1048576.0, report.milliseconds, report.threads);
+	}
+
+	FlyCamera camera;
+	CameraCollision cameraCollision;
+	cameraCollision.enabled = collision;
+	const FrameSettings settings;
+	InputDevice input;
+	RainSimulation rain;
+	RetainedDrawList draws(DRAW_MESH_COUNT);
+	DrawPacketBuilder packets;
+	OcclusionBuffer occlusionBuffer;
+	NullCommandList commands;
+	std::vector<PointLight> rainLights(RainSimulation::MaxLights);
+	bool objectsDirty = true;
+	float totalTime = 0.f;
+
+	typedef std::chrono::high_resolution_clock Clock;
+	const size_t frameCount = recording.GetFrameCount() * repeat;
+	std::vector<double> frameMs, rasterMs, culledPercent, collisionMs;
+	frameMs.reserve(frameCount);
+	uint64_t inFrustum = 0, occluded = 0, pvsCulled = 0;
+	for (size_t f = 0; f < frameCount; ++f)
+	{
+		const InputRecording::Frame& frame = recording.GetFrame(f % recording.GetFrameCount());
+		const Clock::time_point start = Clock::now();
+
+		input.SetSnapshot(frame.input);
+		const Clock::time_point stepStart = Clock::now();
+		UpdateSceneCamera(camera, cameraCollision, bvh, frame.deltaTime, input);
+		if (collision) collisionMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - stepStart).count());
+		totalTime += frame.deltaTime;
+
+		// Блоки объектов пишутся, только когда меняются
+		if (objectsDirty)
+		{
+			commands.WriteConstants(sizeof(objects) + instances.size() * sizeof(InstanceData));
+			objectsDirty = false;
+		}
+
+		const LightBufferData light = MakeLightConstants(camera.GetEye());
+		commands.WriteConstants(sizeof(light));
+
+		// Геометрический проход
+		FrameView view;
+		const FrameConstants constants = MakeFrameConstants(camera, kAspect, totalTime, settings, view);
+		commands.WriteConstants(sizeof(constants));
+		UpdateDirtyDraws(draws, [&](uint32_t mesh) {
+			if (mesh == DRAW_MESH_SCENE)
+				AddMeshDraws(draws, DRAW_PASS_GEOMETRY, mesh, scene.subsets, sceneMaterials, meshInstances[mesh], instances, true);
+			else
+				AddMeshDraws(draws, DRAW_PASS_GEOMETRY, mesh, stump.subsets, stumpMaterials, meshInstances[mesh], instances);
+		});
+		const DrawCulling culling = BuildVisibleDraws(draws, view, occlusion ? &occlusionBuffer : nullptr, occluders,
+			pvs.IsEmpty() ? nullptr : &pvs, jobs.get(), packets);
+		if (culling.occlusion) rasterMs.push_back(occlusionBuffer.GetRenderMilliseconds());
+		if (occlusion || !pvs.IsEmpty())
+		{
+			const uint32_t culled = packets.GetOccludedCount() + packets.GetPvsCulledCount();
+			const uint32_t tested = packets.GetInstanceCount() + culled;
+			inFrustum += tested;
+			occluded += packets.GetOccludedCount();
+			pvsCulled += packets.GetPvsCulledCount();
+			culledPercent.push_back(tested ? 100.0 * culled / tested : 0.0);
+		}
+		// Номера видимых экземпляров - в кольцо кадра, как в SubmitDrawList
+		commands.WriteConstants(packets.GetInstances().size() * sizeof(uint32_t));
+		commands.Replay(packets.GetPackets());
+
+		// Проход освещения: источники дождя целиком в буфер загрузки, полноэкранный треугольник
+		rain.Update(frame.deltaTime);
+		rain.Write(rainLights.data());
+		commands.WriteConstants(rainLights.size() * sizeof(PointLight));
+		commands.Draw(3);
+
+		frameMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+
+	// Первый кадр строит список отрисовок - в среднем не учитывается
+	const NullCommandList::Stats& stats = commands.GetStats();
+	const double frames = (double)frameCount;
+	double total = 0.0;
+	for (size_t f = 1; f < frameMs.size(); ++f) total += frameMs[f];
+	const std::vector<double> steady(frameMs.begin() + (frameMs.size() > 1 ? 1 : 0), frameMs.end());
+	printf("%s: %zu frames (%zu recorded x %d), %u thread(s), %u draws in list\n", recordingPath.c_str(),
+		frameCount, recording.GetFrameCount(), repeat, threadCount, draws.GetStats().draws);
+	printf("cpu       %.4f ms/frame (median %.4f, p99 %.4f, max %.4f), first frame %.4f ms\n",
+		steady.empty() ? 0.0 : total / steady.size(), Percentile(steady, 0.5), Percentile(steady, 0.99),
+		steady.empty() ? 0.0 : *std::max_element(steady.begin(), steady.end()), frameMs[0]);
+	printf("draws     %.1f/frame, %.1f instances/frame, %.0f indices/frame, %.1f packets/frame\n",
+		stats.draws / frames, stats.instances / frames, stats.indices / frames, stats.packets / frames);
+	printf("state     PSO %.1f, mesh %.1f, table %.1f, material %.1f changes/frame\n",
+		stats.pipelineChanges / frames, stats.meshChanges / frames, stats.tableChanges / frames, stats.materialChanges / frames);
+	printf("constants %.0f bytes/frame\n", stats.constantBytes / frames);
+	if (occlusion)
+	{
+		double raster = 0.0;
+		for (double ms : rasterMs) raster += ms;
+		printf("occlusion %zu occluder triangles, raster %.4f ms/frame (p99 %.4f), %ux%u\n", occluders.size() / 3,
+			raster / frames, Percentile(rasterMs, 0.99), OcclusionBuffer::Width, OcclusionBuffer::Height);
+	}
+	if (occlusion || !pvs.IsEmpty())
+	{
+		printf("culled    %.1f%% of frustum-visible draws (%.1f of %.1f/frame), median frame %.1f%%, max %.1f%%\n",
+			inFrustum ? 100.0 * (occluded + pvsCulled) / inFrustum : 0.0, (occluded + pvsCulled) / frames, inFrustum / frames,
+			Percentile(culledPercent, 0.5), *std::max_element(culledPercent.begin(), culledPercent.end()));
+		printf("          %.1f%% by PVS, %.1f%% by occlusion buffer\n", inFrustum ? 100.0 * pvsCulled / inFrustum : 0.0,
+			inFrustum ? 100.0 * occluded / inFrustum : 0.0);
+	}
+	if (collision)
+	{
+		double sweep = 0.0;
+		for (double ms : collisionMs) sweep += ms;
+		printf("collision %.4f ms/frame (p99 %.4f), camera radius %.1f\n", sweep / frames, Percentile(collisionMs, 0.99),
+			CAMERA_COLLISION_RADIUS);
+	}
+	printf("stream    %016llx\n", (unsigned long long)stats.streamHash);
+	return 0;
+}
\ No newline at end of file
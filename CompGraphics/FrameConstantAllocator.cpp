@@ -0,0 +1,104 @@
+#include "FrameConstantAllocator.h"
+#include "d3dx12.h"
+
+static UINT64 AlignConstants(UINT64 size)
+{
+	const UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+FrameConstantAllocator::~FrameConstantAllocator()
+{
+	for (Slot& slot : m_slots)
+	{
+		for (Page& page : slot.pages) DestroyPage(page);
+	}
+}
+
+bool FrameConstantAllocator::Init(ID3D12Device* device, uint32_t frameCount, UINT64 capacity)
+{
+	m_device = device;
+	m_slots.resize(frameCount);
+	for (Slot& slot : m_slots)
+	{
+		slot.pages.emplace_back();
+		if (!CreatePage(AlignConstants(capacity), slot.pages.back())) return false;
+	}
+	m_current = &m_slots[0];
+	return true;
+}
+
+bool FrameConstantAllocator::CreatePage(UINT64 capacity, Page& out)
+{
+	CD3DX12_HEAP_PROPERTIES upHeap(D3D12_HEAP_TYPE_UPLOAD);
+	CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(capacity);
+	if (FAILED(m_device->CreateCommittedResource(&upHeap, D3D12_HEAP_FLAG_NONE, &desc,
+		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&out.buffer))))
+		return false;
+	out.buffer->SetName(L"FrameConstants");
+	CD3DX12_RANGE noRead(0, 0);
+	if (FAILED(out.buffer->Map(0, &noRead, reinterpret_cast<void**>(&out.cpu))))
+	{
+		out.buffer.Reset();
+		return false;
+	}
+	out.gpu = out.buffer->GetGPUVirtualAddress();
+	out.capacity = capacity;
+	return true;
+}
+
+void FrameConstantAllocator::DestroyPage(Page& page)
+{
+	if (page.buffer && page.cpu) page.buffer->Unmap(0, nullptr);
+	page = Page();
+}
+
+void FrameConstantAllocator::BeginFrame(uint32_t frameIndex)
+{
+	m_current = &m_slots[frameIndex];
+	Slot& slot = *m_current;
+	// Прошлый кадр слота не уместился: страницы заменяются одной под весь его объем
+	if (slot.pages.size() > 1)
+	{
+		UINT64 total = 0;
+		for (Page& page : slot.pages)
+		{
+			total += page.capacity;
+			DestroyPage(page);
+		}
+		slot.pages.resize(1);
+		if (!CreatePage(total, slot.pages[0])) slot.pages.clear();
+	}
+	slot.offset = 0;
+	slot.used = 0;
+
+	m_stats = Stats();
+	m_stats.capacity = slot.pages.empty() ? 0 : slot.pages[0].capacity;
+	m_stats.pages = (uint32_t)slot.pages.size();
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS FrameConstantAllocator::Push(const void* data, UINT64 size)
+{
+	Slot& slot = *m_current;
+	const UINT64 aligned = AlignConstants(size);
+	if (slot.pages.empty() || slot.offset + aligned > slot.pages.back().capacity)
+	{
+		// Новая страница не меньше уже занятого объема: за кадр их немного
+		Page page;
+		if (!CreatePage(slot.used + aligned, page)) return 0;
+		slot.pages.push_back(std::move(page));
+		slot.offset = 0;
+		m_stats.capacity += slot.pages.back().capacity;
+		++m_stats.pages;
+	}
+	Page& page = slot.pages.back();
+	memcpy(page.cpu + slot.offset, data, (size_t)size);
+	const D3D12_GPU_VIRTUAL_ADDRESS address = page.gpu + slot.offset;
+	slot.offset += aligned;
+	slot.used += aligned;
+
+	++m_stats.allocations;
+	m_stats.bytesWritten += size;
+	m_stats.bytesAllocated += aligned;
+	return address;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using Microsoft::WRL::ComPtr;
+
+// Константы, которые живут один кадр (блоки объектов, блок кадра): линейное выделение из
+// отображенного UPLOAD-буфера слота кадра. Слот сбрасывается в BeginFrame, когда fence
+// кадра, писавшего в него, уже пройден. Если буфера не хватило, кадр дописывает в новую
+// страницу, а в следующий раз слот получает один буфер под весь объем - размер догоняет
+// реальное число отрисовок. Только поток отрисовки.
+class FrameConstantAllocator
+{
+public:
+	struct Stats
+	{
+		uint32_t allocations = 0;
+		// Скопировано данных и занято вместе с выравниванием до 256 байт
+		UINT64 bytesWritten = 0;
+		UINT64 bytesAllocated = 0;
+		UINT64 capacity = 0;
+		uint32_t pages = 0;
+	};
+
+	FrameConstantAllocator() = default;
+	FrameConstantAllocator(const FrameConstantAllocator&) = delete;
+	FrameConstantAllocator& operator=(const FrameConstantAllocator&) = delete;
+	~FrameConstantAllocator();
+
+	bool Init(ID3D12Device* device, uint32_t frameCount, UINT64 capacity);
+	// GPU закончил с прошлым кадром этого слота
+	void BeginFrame(uint32_t frameIndex);
+
+	// 0 - не удалось создать страницу
+	D3D12_GPU_VIRTUAL_ADDRESS Push(const void* data, UINT64 size);
+	template<class T>
+	D3D12_GPU_VIRTUAL_ADDRESS Push(const T& data) { return Push(&data, sizeof(T)); }
+
+	// Текущего кадра
+	const Stats& GetStats() const { return m_stats; }
+
+private:
+	struct Page
+	{
+		ComPtr<ID3D12Resource> buffer;
+		uint8_t* cpu = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS gpu = 0;
+		UINT64 capacity = 0;
+	};
+	struct Slot
+	{
+		// Последняя - текущая
+		std::vector<Page> pages;
+		UINT64 offset = 0;
+		UINT64 used = 0;
+	};
+
+	bool CreatePage(UINT64 capacity, Page& out);
+	static void DestroyPage(Page& page);
+
+	ID3D12Device* m_device = nullptr;
+	std::vector<Slot> m_slots;
+	Slot* m_current = nullptr;
+	Stats m_stats;
+};
\ No newline at end of file
@@ -1,13 +1,19 @@
 ﻿#include "Gbuffer.h"
 
-bool Gbuffer::Initialize(ID3D12Device* device, ID3D12DescriptorHeap* sharedSrvHeap, int width, int height)
+static HRESULT CreateTarget(ID3D12Device* device, GpuHeapAllocator* heaps, const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES state, const D3D12_CLEAR_VALUE& clearValue, ComPtr<ID3D12Resource>& out)
+{
+    if (heaps)
+        return heaps->CreateResource(desc, state, &clearValue, out);
+    CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
+    return device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &desc, state, &clearValue, IID_PPV_ARGS(&out));
+}
+
+bool Gbuffer::Initialize(ID3D12Device* device, int width, int height, GpuHeapAllocator* heaps)
 {
     m_width = width;
     m_height = height;
 
-    if (!sharedSrvHeap) return false;
-    m_sharedSrvHeap = sharedSrvHeap;
-
     m_rtvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
     m_srvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
@@ -23,6 +29,12 @@ bool Gbuffer::Initialize(ID3D12Device* device, ID3D12DescriptorHeap* sharedSrvHe
     if (FAILED(device->CreateDescriptorHeap(&dsvDesc, IID_PPV_ARGS(&m_dsvHeap))))
         return false;
 
+    D3D12_DESCRIPTOR_HEAP_DESC srvDesc = {};
+    srvDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    srvDesc.NumDescriptors = COUNT;
+    if (FAILED(device->CreateDescriptorHeap(&srvDesc, IID_PPV_ARGS(&m_srvHeap))))
+        return false;
+
     DXGI_FORMAT formats[COUNT] = {
         DXGI_FORMAT_R8G8B8A8_UNORM,       // Albedo
         DXGI_FORMAT_R16G16B16A16_FLOAT,   // Normal
@@ -30,7 +42,7 @@ bool Gbuffer::Initialize(ID3D12Device* device, ID3D12DescriptorHeap* sharedSrvHe
     };
 
     CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart());
-    CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_sharedSrvHeap->GetCPUDescriptorHandleForHeapStart());
+    CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_srvHeap->GetCPUDescriptorHandleForHeapStart());
 
     for (int i = 0; i < COUNT; i++)
     {
@@ -44,8 +56,6 @@ bool Gbuffer::Initialize(ID3D12Device* device, ID3D12DescriptorHeap* sharedSrvHe
         texDesc.SampleDesc = { 1, 0 };
         texDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
 
-        CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
-
         D3D12_CLEAR_VALUE clearValue = {};
         clearValue.Format = formats[i];
         clearValue.Color[0] = 0.0f;
@@ -53,14 +63,8 @@ bool Gbuffer::Initialize(ID3D12Device* device, ID3D12DescriptorHeap* sharedSrvHe
         clearValue.Color[2] = 0.0f;
         clearValue.Color[3] = 0.0f;
 
-        if (FAILED(device->CreateCommittedResource(
-            &heapProps,
-            D3D12_HEAP_FLAG_NONE,
-            &texDesc,
-            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-            &clearValue, 
-            IID_PPV_ARGS(&m_renderTargets[i])
-        ))) return false;
+        if (FAILED(CreateTarget(device, heaps, texDesc, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+            clearValue, m_renderTargets[i]))) return false;
 
         device->CreateRenderTargetView(m_renderTargets[i].Get(), nullptr, rtvHandle);
 
@@ -86,19 +90,12 @@ bool Gbuffer::Initialize(ID3D12Device* device, ID3D12DescriptorHeap* sharedSrvHe
     depthDesc.SampleDesc = { 1, 0 };
     depthDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
 
-    CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
     D3D12_CLEAR_VALUE depthClear = {};
     depthClear.Format = DXGI_FORMAT_D32_FLOAT;
     depthClear.DepthStencil.Depth = 1.0f;
 
-    if (FAILED(device->CreateCommittedResource(
-        &heapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &depthDesc,
-        D3D12_RESOURCE_STATE_DEPTH_WRITE,
-        &depthClear,
-        IID_PPV_ARGS(&m_depthStencil)
-    ))) return false;
+    if (FAILED(CreateTarget(device, heaps, depthDesc, D3D12_RESOURCE_STATE_DEPTH_WRITE,
+        depthClear, m_depthStencil))) return false;
 
     device->CreateDepthStencilView(m_depthStencil.Get(), nullptr,
         m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
@@ -106,6 +103,15 @@ bool Gbuffer::Initialize(ID3D12Device* device, ID3D12DescriptorHeap* sharedSrvHe
     return true;
 }
 
+void Gbuffer::ReleaseTargets(std::vector<ComPtr<ID3D12Resource>>& out)
+{
+    for (int i = 0; i < COUNT; i++)
+    {
+        if (m_renderTargets[i]) out.push_back(std::move(m_renderTargets[i]));
+    }
+    if (m_depthStencil) out.push_back(std::move(m_depthStencil));
+}
+
 void Gbuffer::Bind(ID3D12GraphicsCommandList* cmdList)
 {
     D3D12_CPU_DESCRIPTOR_HANDLE rtvHandles[COUNT];
@@ -1,7 +1,9 @@
 #pragma once
 #include <d3d12.h>
 #include <wrl/client.h>
+#include <vector>
 #include "d3dx12.h"
+#include "GpuHeapAllocator.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -10,14 +12,19 @@ class Gbuffer
 public:
     static constexpr int COUNT = 3;
 
-    bool Initialize(ID3D12Device* device, ID3D12DescriptorHeap* sharedSrvHeap, int width, int height);
+    // heaps - размещать цели в общих кучах; без него каждая цель - отдельный ресурс
+    bool Initialize(ID3D12Device* device, int width, int height, GpuHeapAllocator* heaps = nullptr);
 
     void Bind(ID3D12GraphicsCommandList* cmdList);
     void Clear(ID3D12GraphicsCommandList* cmdList, const float clearColor[4]);
     void TransitionToRead(ID3D12GraphicsCommandList* cmdList);
     void TransitionToWrite(ID3D12GraphicsCommandList* cmdList);
 
-    ID3D12DescriptorHeap* GetSRVHeap() const { return m_sharedSrvHeap; }
+    // COUNT SRV подряд в куче, невидимой шейдерам: их копируют в таблицу кадра
+    D3D12_CPU_DESCRIPTOR_HANDLE GetSrvStart() const { return m_srvHeap->GetCPUDescriptorHandleForHeapStart(); }
+
+    // Забирает цели у GBuffer: их еще могут читать кадры на GPU, освобождает вызывающий
+    void ReleaseTargets(std::vector<ComPtr<ID3D12Resource>>& out);
 
     int GetWidth() const { return m_width; }
     int GetHeight() const { return m_height; }
@@ -27,8 +34,7 @@ private:
     ComPtr<ID3D12Resource> m_depthStencil;
     ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
     ComPtr<ID3D12DescriptorHeap> m_dsvHeap;
-
-    ID3D12DescriptorHeap* m_sharedSrvHeap = nullptr;
+    ComPtr<ID3D12DescriptorHeap> m_srvHeap;
 
     UINT m_rtvDescriptorSize = 0;
     UINT m_srvDescriptorSize = 0;
@@ -1,30 +1,11 @@
-cbuffer GBufferCB : register(b0)
-{
-    float4x4 gWorld;
-    float4x4 gView;
-    float4x4 gProj;
-    float4x4 gWorldInvTranspose;
-    float4 gMaterialDiffuse;
-    float4 gMaterialSpecular;
-    
-    int gHasTexture;
-    float gTexTilingX;
-    float gTexTilingY;
-    float gTotalTime;
-    
-    float gTexScrollX;
-    float gTexScrollY;
-    float2 gPad1;
-    
-    float3 gEyePosW;
-    float gDisplacementScale;
-    
-    float gTessNearDist;
-    float gTessFarDist;
-    float2 gPad2;
-};
+// Варианты собираются с define из GeometryPermutation:
+//   TESSELLATION - hull/domain со смещением по карте высот, иначе VS сразу в пиксельный шейдер
+//   DIFFUSE_MAP  - цвет из текстуры, иначе gMaterialDiffuse
+//   NORMAL_MAP   - нормаль из карты нормалей, иначе интерполированная
 
-Texture2D gDiffuseMap : register(t0);
+#include "SceneConstants.hlsli"
+
+Texture2DArray gDiffuseMap : register(t0);
 Texture2D gNormalMap : register(t1);
 Texture2D gDisplacementMap : register(t2);
 SamplerState gSampler : register(s0);
@@ -34,6 +15,7 @@ struct VSInput
     float3 Position : POSITION;
     float3 Normal : NORMAL;
     float2 TexCoord : TEXCOORD;
+    uint InstanceID : SV_InstanceID;
 };
 
 struct VSOutput
@@ -43,6 +25,14 @@ struct VSOutput
     float2 TexCoord : TEXCOORD;
 };
 
+struct DSOutput
+{
+    float4 PosH : SV_POSITION;
+    float3 PosW : TEXCOORD0;
+    float3 NormalW : TEXCOORD1;
+    float2 TexCoord : TEXCOORD2;
+};
+
 struct HS_CONSTANT_DATA_OUTPUT
 {
     float Edges[3] : SV_TessFactor;
@@ -56,19 +46,25 @@ struct HS_CONTROL_POINT_OUTPUT
     float2 TexCoord : TEXCOORD;
 };
 
+float2 TransformUV(float2 uv)
+{
+    uv.x = uv.x * gTexTilingX + gTotalTime * gTexScrollX;
+    uv.y = uv.y * gTexTilingY + gTotalTime * gTexScrollY;
+    return uv;
+}
+
+#ifdef TESSELLATION
+
 //Vertex Shader 
 VSOutput VSMain(VSInput vin)
 {
     VSOutput vout;
+    InstanceData instance = LoadInstance(vin.InstanceID);
     
-    float4 posW = mul(float4(vin.Position, 1.0f), gWorld);
+    float4 posW = mul(float4(vin.Position, 1.0f), instance.World);
     vout.PosW = posW.xyz;
-    vout.NormalW = mul(vin.Normal, (float3x3) gWorldInvTranspose);
-    
-    float2 uv = vin.TexCoord;
-    uv.x = uv.x * gTexTilingX + gTotalTime * gTexScrollX;
-    uv.y = uv.y * gTexTilingY + gTotalTime * gTexScrollY;
-    vout.TexCoord = uv;
+    vout.NormalW = mul(vin.Normal, (float3x3) instance.WorldInvTranspose);
+    vout.TexCoord = TransformUV(vin.TexCoord);
     
     return vout;
 }
@@ -122,14 +118,6 @@ HS_CONTROL_POINT_OUTPUT HSMain(
     return Output;
 }
 
-struct DSOutput
-{
-    float4 PosH : SV_POSITION;
-    float3 PosW : TEXCOORD0;
-    float3 NormalW : TEXCOORD1;
-    float2 TexCoord : TEXCOORD2;
-};
-
 // Domain Shader 
 [domain("tri")]
 DSOutput DSMain(
@@ -164,6 +152,25 @@ DSOutput DSMain(
     return vout;
 }
 
+#else
+
+// Без смещения hull и domain ничего не делают: вершинный шейдер сразу отдает вход пиксельного
+DSOutput VSMain(VSInput vin)
+{
+    DSOutput vout;
+    InstanceData instance = LoadInstance(vin.InstanceID);
+
+    float4 posW = mul(float4(vin.Position, 1.0f), instance.World);
+    vout.PosW = posW.xyz;
+    vout.PosH = mul(mul(posW, gView), gProj);
+    vout.NormalW = normalize(mul(vin.Normal, (float3x3) instance.WorldInvTranspose));
+    vout.TexCoord = TransformUV(vin.TexCoord);
+
+    return vout;
+}
+
+#endif
+
 struct PSOutput
 {
     float4 Albedo : SV_Target0;
@@ -176,8 +183,13 @@ PSOutput PSMain(DSOutput pin)
 {
     PSOutput pout;
     
-    float4 albedo = gHasTexture ? gDiffuseMap.Sample(gSampler, pin.TexCoord) : gMaterialDiffuse;
+#ifdef DIFFUSE_MAP
+    float4 albedo = SampleDiffuse(gDiffuseMap, gSampler, pin.TexCoord);
+#else
+    float4 albedo = gMaterialDiffuse;
+#endif
     
+#ifdef NORMAL_MAP
     float3 dp1 = ddx(pin.PosW);
     float3 dp2 = ddy(pin.PosW);
     float2 duv1 = ddx(pin.TexCoord);
@@ -204,6 +216,9 @@ PSOutput PSMain(DSOutput pin)
         N = normalize(mul(mappedNormal, TBN));
         pout.Normal = float4(N, 1.0f);
     }
+#else
+    pout.Normal = float4(normalize(pin.NormalW), 1.0f);
+#endif
     
     pout.Albedo = albedo;
     pout.Position = float4(pin.PosW, 1.0f);
@@ -0,0 +1,43 @@
+#include "GeometryPermutation.h"
+
+uint32_t GeometryPermutationKey(const GeometryMaterialFeatures& material)
+{
+	uint32_t key = 0;
+	if (material.displacementScale > 0.0f) key |= GEOMETRY_TESSELLATED;
+	if (material.diffuseMap) key |= GEOMETRY_TEXTURED;
+	if (material.normalMap) key |= GEOMETRY_NORMAL_MAPPED;
+	return key;
+}
+
+bool GeometryStageUsed(uint32_t key, GeometryStage stage)
+{
+	if (stage == GeometryStage::Hull || stage == GeometryStage::Domain) return (key & GEOMETRY_TESSELLATED) != 0;
+	return true;
+}
+
+uint32_t GeometryStageKey(uint32_t key, GeometryStage stage)
+{
+	if (stage == GeometryStage::Pixel) return key & (GEOMETRY_TEXTURED | GEOMETRY_NORMAL_MAPPED);
+	return key & GEOMETRY_TESSELLATED;
+}
+
+uint32_t GeometryStageVariant(uint32_t key, GeometryStage stage)
+{
+	return (uint32_t)stage * GEOMETRY_PERMUTATION_COUNT + GeometryStageKey(key, stage);
+}
+
+void GeometryPermutationDefines(uint32_t key, std::vector<ShaderMacro>& defines)
+{
+	if (key & GEOMETRY_TESSELLATED) defines.push_back({ "TESSELLATION", "1" });
+	if (key & GEOMETRY_TEXTURED) defines.push_back({ "DIFFUSE_MAP", "1" });
+	if (key & GEOMETRY_NORMAL_MAPPED) defines.push_back({ "NORMAL_MAP", "1" });
+}
+
+std::string GeometryPermutationName(uint32_t key)
+{
+	std::string name;
+	if (key & GEOMETRY_TESSELLATED) name += "tess";
+	if (key & GEOMETRY_TEXTURED) name += name.empty() ? "tex" : "+tex";
+	if (key & GEOMETRY_NORMAL_MAPPED) name += name.empty() ? "nrm" : "+nrm";
+	return name.empty() ? "plain" : name;
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ShaderCache.h"
+
+// Варианты шейдеров геометрического прохода. Ключ - набор признаков материала; каждый признак
+// превращается в define, поэтому ветвления по константам в шейдере не нужны, а геометрия без
+// смещения рисуется списком треугольников без hull/domain стадий.
+enum GeometryFeature : uint32_t
+{
+	GEOMETRY_TESSELLATED = 1u << 0,
+	GEOMETRY_TEXTURED = 1u << 1,
+	GEOMETRY_NORMAL_MAPPED = 1u << 2,
+};
+static const uint32_t GEOMETRY_PERMUTATION_COUNT = 8;
+
+enum class GeometryStage : uint32_t
+{
+	Vertex,
+	Hull,
+	Domain,
+	Pixel,
+};
+
+struct GeometryMaterialFeatures
+{
+	bool diffuseMap = false;
+	bool normalMap = false;
+	float displacementScale = 0.0f;
+};
+
+uint32_t GeometryPermutationKey(const GeometryMaterialFeatures& material);
+// hull и domain нужны только тесселированным вариантам
+bool GeometryStageUsed(uint32_t key, GeometryStage stage);
+// Оставляет признаки, от которых зависит стадия: вершинные стадии не зависят от текстур,
+// пиксельная - от тесселяции. Одинаковые варианты стадий компилируются один раз.
+uint32_t GeometryStageKey(uint32_t key, GeometryStage stage);
+// Уникальный номер варианта стадии для VariantCache
+uint32_t GeometryStageVariant(uint32_t key, GeometryStage stage);
+void GeometryPermutationDefines(uint32_t key, std::vector<ShaderMacro>& defines);
+// "tess+tex+nrm", "plain" - для логов и имен задач
+std::string GeometryPermutationName(uint32_t key);
+
+// Значения, которые строятся по ключу один раз. Get можно звать из нескольких потоков:
+// первый строит, остальные ждут его результат. Исключение фабрики получают все ожидающие.
+template <class T>
+class VariantCache
+{
+public:
+	using Factory = std::function<T(uint32_t key)>;
+
+	explicit VariantCache(Factory factory) : m_factory(std::move(factory)) {}
+
+	T Get(uint32_t key)
+	{
+		std::promise<T> promise;
+		std::shared_future<T> future;
+		bool owner = false;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto it = m_entries.find(key);
+			if (it != m_entries.end())
+			{
+				++m_hits;
+				future = it->second;
+			}
+			else
+			{
+				future = promise.get_future().share();
+				m_entries.emplace(key, future);
+				owner = true;
+			}
+		}
+		if (owner)
+		{
+			try
+			{
+				promise.set_value(m_factory(key));
+			}
+			catch (...)
+			{
+				promise.set_exception(std::current_exception());
+			}
+		}
+		return future.get();
+	}
+
+	size_t Size() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_entries.size();
+	}
+	uint32_t GetHits() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_hits;
+	}
+
+private:
+	Factory m_factory;
+	mutable std::mutex m_mutex;
+	std::map<uint32_t, std::shared_future<T>> m_entries;
+	uint32_t m_hits = 0;
+};
\ No newline at end of file
@@ -0,0 +1,290 @@
+#include "GpuHeapAllocator.h"
+#include "d3dx12.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+// Ключ private data ресурса, под которым хранится BlockReleaser
+static const GUID kHeapBlockGuid = { 0x6f1c2b7e, 0x4a53, 0x4d8e, { 0x9b, 0x21, 0x3e, 0x7a, 0x55, 0xc0, 0x18, 0x42 } };
+
+static const char* kKindNames[GpuHeapAllocator::KindCount] = { "buffers", "textures", "targets" };
+static const D3D12_HEAP_FLAGS kKindFlags[GpuHeapAllocator::KindCount] = {
+	D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+	D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+	D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES
+};
+
+// D3D освобождает private data вместе с ресурсом - тогда место в куче и возвращается
+class GpuHeapAllocator::BlockReleaser : public IUnknown
+{
+public:
+	BlockReleaser(GpuHeapAllocator* owner, ID3D12Resource* resource, Kind kind, size_t heap, uint32_t handle, UINT64 bytes)
+		: m_owner(owner), m_resource(resource), m_kind(kind), m_heap(heap), m_handle(handle), m_bytes(bytes)
+	{
+	}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+	{
+		if (riid == __uuidof(IUnknown))
+		{
+			*object = static_cast<IUnknown*>(this);
+			AddRef();
+			return S_OK;
+		}
+		*object = nullptr;
+		return E_NOINTERFACE;
+	}
+	ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refs; }
+	ULONG STDMETHODCALLTYPE Release() override
+	{
+		const ULONG refs = --m_refs;
+		if (refs == 0)
+		{
+			m_owner->FreeBlock(m_resource, m_kind, m_heap, m_handle, m_bytes);
+			delete this;
+		}
+		return refs;
+	}
+
+private:
+	std::atomic<ULONG> m_refs{ 1 };
+	GpuHeapAllocator* m_owner;
+	ID3D12Resource* m_resource;
+	Kind m_kind;
+	size_t m_heap;
+	uint32_t m_handle;
+	UINT64 m_bytes;
+};
+
+void GpuHeapAllocator::Init(ID3D12Device* device, UINT64 heapSize)
+{
+	m_device = device;
+	m_heapSize = heapSize;
+}
+
+GpuHeapAllocator::Kind GpuHeapAllocator::KindOf(const D3D12_RESOURCE_DESC& desc)
+{
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER) return Buffers;
+	if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) return Targets;
+	return Textures;
+}
+
+// Маленькие текстуры можно класть с выравниванием 4 КБ вместо 64 КБ, если драйвер согласен
+D3D12_RESOURCE_ALLOCATION_INFO GpuHeapAllocator::GetAllocationInfo(D3D12_RESOURCE_DESC& desc) const
+{
+	if (KindOf(desc) == Textures && desc.SampleDesc.Count <= 1)
+	{
+		desc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+		const D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, &desc);
+		if (info.SizeInBytes != UINT64_MAX && info.Alignment == D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT) return info;
+	}
+	desc.Alignment = 0;
+	return m_device->GetResourceAllocationInfo(0, 1, &desc);
+}
+
+HRESULT GpuHeapAllocator::Place(Kind kind, size_t heap, uint32_t handle, const D3D12_RESOURCE_DESC& desc,
+	D3D12_RESOURCE_STATES state, const D3D12_CLEAR_VALUE* clearValue, ComPtr<ID3D12Resource>& out)
+{
+	Heap& h = *m_heaps[kind][heap];
+	HRESULT hr = m_device->CreatePlacedResource(h.heap.Get(), h.allocator.GetOffset(handle), &desc, state,
+		clearValue, IID_PPV_ARGS(&out));
+	if (FAILED(hr)) return hr;
+	hr = Attach(out.Get(), kind, heap, handle, h.allocator.GetSize(handle));
+	if (FAILED(hr)) out.Reset();
+	return hr;
+}
+
+HRESULT GpuHeapAllocator::Attach(ID3D12Resource* resource, Kind kind, size_t heap, uint32_t handle, UINT64 bytes)
+{
+	BlockReleaser* releaser = new BlockReleaser(this, resource, kind, heap, handle, bytes);
+	const HRESULT hr = resource->SetPrivateDataInterface(kHeapBlockGuid, releaser);
+	if (FAILED(hr))
+	{
+		// Ресурс ссылку не взял: место освобождает вызывающий
+		delete releaser;
+		return hr;
+	}
+	releaser->Release();
+	m_locations[resource] = { kind, heap, handle };
+	if (heap == Committed)
+	{
+		++m_committed[kind];
+		m_committedBytes[kind] += bytes;
+	}
+	else
+		m_heaps[kind][heap]->placements[handle] = { resource, D3D12_RESOURCE_STATE_COMMON };
+	return S_OK;
+}
+
+void GpuHeapAllocator::FreeBlock(ID3D12Resource* resource, Kind kind, size_t heap, uint32_t handle, UINT64 bytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_locations.erase(resource);
+	if (heap == Committed)
+	{
+		--m_committed[kind];
+		m_committedBytes[kind] -= bytes;
+		return;
+	}
+	Heap& h = *m_heaps[kind][heap];
+	h.placements.erase(handle);
+	h.allocator.Free(handle);
+}
+
+HRESULT GpuHeapAllocator::CreateResource(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState,
+	const D3D12_CLEAR_VALUE* clearValue, ComPtr<ID3D12Resource>& out)
+{
+	out.Reset();
+	const Kind kind = KindOf(desc);
+	D3D12_RESOURCE_DESC placedDesc = desc;
+	const D3D12_RESOURCE_ALLOCATION_INFO info = GetAllocationInfo(placedDesc);
+	if (info.SizeInBytes == UINT64_MAX) return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (info.SizeInBytes <= m_heapSize)
+	{
+		auto& heaps = m_heaps[kind];
+		size_t heap = heaps.size();
+		uint32_t handle = TlsfAllocator::InvalidHandle;
+		for (size_t i = 0; i < heaps.size() && handle == TlsfAllocator::InvalidHandle; ++i)
+		{
+			if (!heaps[i]) continue;
+			handle = heaps[i]->allocator.Allocate(info.SizeInBytes, info.Alignment);
+			heap = i;
+		}
+		if (handle == TlsfAllocator::InvalidHandle)
+		{
+			// Новая куча занимает место освобожденной Trim, если такое есть
+			heap = std::find(heaps.begin(), heaps.end(), nullptr) - heaps.begin();
+			auto created = std::make_unique<Heap>(m_heapSize);
+			const UINT64 alignment = kind == Targets ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+			CD3DX12_HEAP_DESC heapDesc(m_heapSize, D3D12_HEAP_TYPE_DEFAULT, alignment, kKindFlags[kind]);
+			if (SUCCEEDED(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&created->heap))))
+			{
+				created->heap->SetName(L"GpuHeap");
+				handle = created->allocator.Allocate(info.SizeInBytes, info.Alignment);
+				if (heap == heaps.size()) heaps.push_back(std::move(created));
+				else heaps[heap] = std::move(created);
+				char buf[128];
+				sprintf_s(buf, "[GpuHeap] New %s heap #%zu (%llu MB)\n", kKindNames[kind], heap, m_heapSize >> 20);
+				OutputDebugStringA(buf);
+			}
+		}
+		if (handle != TlsfAllocator::InvalidHandle)
+		{
+			const HRESULT hr = Place(kind, heap, handle, placedDesc, initialState, clearValue, out);
+			if (SUCCEEDED(hr)) return hr;
+			heaps[heap]->allocator.Free(handle);
+		}
+	}
+
+	// Больше кучи или кучу не удалось создать - отдельный ресурс, как раньше
+	CD3DX12_HEAP_PROPERTIES defaultHeap(D3D12_HEAP_TYPE_DEFAULT);
+	HRESULT hr = m_device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &desc, initialState,
+		clearValue, IID_PPV_ARGS(&out));
+	if (FAILED(hr)) return hr;
+	hr = Attach(out.Get(), kind, Committed, 0, info.SizeInBytes);
+	if (FAILED(hr)) out.Reset();
+	return hr;
+}
+
+void GpuHeapAllocator::SetRelocatable(ID3D12Resource* resource, D3D12_RESOURCE_STATES steadyState)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_locations.find(resource);
+	if (it == m_locations.end() || it->second.heap == Committed || it->second.kind == Targets) return;
+	Heap& h = *m_heaps[it->second.kind][it->second.heap];
+	h.placements[it->second.handle].steadyState = steadyState;
+	h.allocator.SetMovable(it->second.handle, true);
+}
+
+void GpuHeapAllocator::Defragment(ID3D12GraphicsCommandList* cmdList, UINT64 maxBytes, double minFragmentation, std::vector<Move>& moves)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	UINT64 moved = 0;
+	for (int kind = Buffers; kind < Targets; ++kind)
+	{
+		for (size_t i = 0; i < m_heaps[kind].size(); ++i)
+		{
+			Heap* h = m_heaps[kind][i].get();
+			while (h && (moved == 0 || moved < maxBytes) && h->allocator.GetStats().fragmentation >= minFragmentation)
+			{
+				uint32_t from, to;
+				if (!h->allocator.PlanMove(from, to)) break;
+				const Placement source = h->placements[from];
+				const D3D12_RESOURCE_DESC desc = source.resource->GetDesc();
+				// Буферы создаются в COMMON и неявно переходят в COPY_DEST при копировании
+				const D3D12_RESOURCE_STATES initial = kind == Buffers ? D3D12_RESOURCE_STATE_COMMON : D3D12_RESOURCE_STATE_COPY_DEST;
+				ComPtr<ID3D12Resource> copy;
+				if (FAILED(Place((Kind)kind, i, to, desc, initial, nullptr, copy)))
+				{
+					h->allocator.Free(to);
+					h->allocator.SetMovable(from, true);
+					break;
+				}
+				h->placements[to].steadyState = source.steadyState;
+
+				auto toSource = CD3DX12_RESOURCE_BARRIER::Transition(source.resource, source.steadyState, D3D12_RESOURCE_STATE_COPY_SOURCE);
+				cmdList->ResourceBarrier(1, &toSource);
+				cmdList->CopyResource(copy.Get(), source.resource);
+				CD3DX12_RESOURCE_BARRIER back[2] = {
+					CD3DX12_RESOURCE_BARRIER::Transition(source.resource, D3D12_RESOURCE_STATE_COPY_SOURCE, source.steadyState),
+					CD3DX12_RESOURCE_BARRIER::Transition(copy.Get(), D3D12_RESOURCE_STATE_COPY_DEST, source.steadyState)
+				};
+				cmdList->ResourceBarrier(2, back);
+
+				Move move;
+				move.from = source.resource;
+				move.to = std::move(copy);
+				moves.push_back(std::move(move));
+				moved += h->allocator.GetSize(to);
+			}
+		}
+	}
+}
+
+void GpuHeapAllocator::Trim()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& heaps : m_heaps)
+	{
+		for (size_t i = 1; i < heaps.size(); ++i)
+		{
+			if (heaps[i] && heaps[i]->allocator.IsEmpty()) heaps[i].reset();
+		}
+	}
+}
+
+GpuHeapAllocator::Stats GpuHeapAllocator::GetStats(Kind kind) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Stats stats;
+	stats.committed = m_committed[kind];
+	stats.committedBytes = m_committedBytes[kind];
+	for (const auto& heap : m_heaps[kind])
+	{
+		if (!heap) continue;
+		const TlsfAllocator::Stats s = heap->allocator.GetStats();
+		++stats.heaps;
+		stats.placed.capacity += s.capacity;
+		stats.placed.used += s.used;
+		stats.placed.allocations += s.allocations;
+		stats.placed.freeBlocks += s.freeBlocks;
+		stats.placed.largestFree = std::max(stats.placed.largestFree, s.largestFree);
+		stats.placed.fragmentation = std::max(stats.placed.fragmentation, s.fragmentation);
+	}
+	return stats;
+}
+
+void GpuHeapAllocator::LogStats(const char* title) const
+{
+	for (int kind = 0; kind < KindCount; ++kind)
+	{
+		const Stats stats = GetStats((Kind)kind);
+		char buf[256];
+		sprintf_s(buf, "[GpuHeap] %s: %s - %u heaps, %.1f of %.1f MB in %u allocations, fragmentation %.0f%%, %u committed (%.1f MB)\n",
+			title, kKindNames[kind], stats.heaps, stats.placed.used / 1048576.0, stats.placed.capacity / 1048576.0,
+			stats.placed.allocations, stats.placed.fragmentation * 100.0, stats.committed, stats.committedBytes / 1048576.0);
+		OutputDebugStringA(buf);
+	}
+}
\ No newline at end of file
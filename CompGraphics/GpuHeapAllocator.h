@@ -0,0 +1,107 @@
+#pragma once
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "TlsfAllocator.h"
+using Microsoft::WRL::ComPtr;
+
+// Ресурсы DEFAULT-кучи размещаются (CreatePlacedResource) в больших ID3D12Heap вместо
+// отдельного CreateCommittedResource на каждый. Кучи разделены по видам ресурсов, как требует
+// resource heap tier 1. Место возвращается, когда ресурс уничтожен; замененные ресурсы
+// уничтожаются только после fence (RetireResource), поэтому GPU его уже не читает.
+class GpuHeapAllocator
+{
+public:
+	enum Kind
+	{
+		Buffers,
+		Textures,
+		Targets,
+		KindCount
+	};
+
+	// Копирование from -> to записано; владелец переключается на to, когда оно выполнено
+	struct Move
+	{
+		ComPtr<ID3D12Resource> from;
+		ComPtr<ID3D12Resource> to;
+	};
+
+	struct Stats
+	{
+		uint32_t heaps = 0;
+		// Сумма по кучам вида; largestFree и fragmentation - по худшей куче
+		TlsfAllocator::Stats placed;
+		// Ресурсы больше кучи
+		uint32_t committed = 0;
+		uint64_t committedBytes = 0;
+	};
+
+	GpuHeapAllocator() = default;
+	GpuHeapAllocator(const GpuHeapAllocator&) = delete;
+	GpuHeapAllocator& operator=(const GpuHeapAllocator&) = delete;
+
+	void Init(ID3D12Device* device, UINT64 heapSize);
+	// Можно с любого потока
+	HRESULT CreateResource(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState,
+		const D3D12_CLEAR_VALUE* clearValue, ComPtr<ID3D12Resource>& out);
+
+	// Буфер или текстуру можно переносить при дефрагментации; между кадрами ресурс всегда
+	// в steadyState. Только для ресурсов потока отрисовки - они и освобождаются на нем
+	void SetRelocatable(ID3D12Resource* resource, D3D12_RESOURCE_STATES steadyState);
+	// Записывает копирование переносимых ресурсов на свободные места ниже в их куче, пока
+	// не наберется maxBytes (один перенос - всегда). Кучи с фрагментацией ниже порога не трогает
+	void Defragment(ID3D12GraphicsCommandList* cmdList, UINT64 maxBytes, double minFragmentation, std::vector<Move>& moves);
+	// Отдает пустые кучи, кроме первой каждого вида
+	void Trim();
+
+	Stats GetStats(Kind kind) const;
+	void LogStats(const char* title) const;
+
+private:
+	class BlockReleaser;
+	struct Placement
+	{
+		ID3D12Resource* resource = nullptr;
+		D3D12_RESOURCE_STATES steadyState = D3D12_RESOURCE_STATE_COMMON;
+	};
+	struct Heap
+	{
+		explicit Heap(UINT64 size) : allocator(size) {}
+		ComPtr<ID3D12Heap> heap;
+		TlsfAllocator allocator;
+		// По handle аллокатора
+		std::map<uint32_t, Placement> placements;
+	};
+	struct Location
+	{
+		Kind kind;
+		size_t heap;
+		uint32_t handle;
+	};
+	static const size_t Committed = ~(size_t)0;
+
+	static Kind KindOf(const D3D12_RESOURCE_DESC& desc);
+	D3D12_RESOURCE_ALLOCATION_INFO GetAllocationInfo(D3D12_RESOURCE_DESC& desc) const;
+	HRESULT Place(Kind kind, size_t heap, uint32_t handle, const D3D12_RESOURCE_DESC& desc,
+		D3D12_RESOURCE_STATES state, const D3D12_CLEAR_VALUE* clearValue, ComPtr<ID3D12Resource>& out);
+	// Под m_mutex: ресурс сам вернет место, когда будет уничтожен
+	HRESULT Attach(ID3D12Resource* resource, Kind kind, size_t heap, uint32_t handle, UINT64 bytes);
+	// Вызывается при уничтожении ресурса
+	void FreeBlock(ID3D12Resource* resource, Kind kind, size_t heap, uint32_t handle, UINT64 bytes);
+
+	ID3D12Device* m_device = nullptr;
+	UINT64 m_heapSize = 0;
+	// Освобожденные Trim кучи - nullptr, чтобы номера остальных не сдвигались
+	std::vector<std::unique_ptr<Heap>> m_heaps[KindCount];
+	std::map<ID3D12Resource*, Location> m_locations;
+	uint32_t m_committed[KindCount] = {};
+	uint64_t m_committedBytes[KindCount] = {};
+	mutable std::mutex m_mutex;
+};
\ No newline at end of file
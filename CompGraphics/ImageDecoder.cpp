@@ -0,0 +1,17 @@
+#include "ImageDecoder.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+bool StbImageDecoder::Decode(const uint8_t* data, size_t size, DecodedImage& out) const
+{
+	int w, h, channels;
+	unsigned char* pixels = stbi_load_from_memory(data, (int)size, &w, &h, &channels, 4);
+	if (!pixels) return false;
+
+	out.width = (uint32_t)w;
+	out.height = (uint32_t)h;
+	out.pixels.assign(pixels, pixels + (size_t)w * h * 4);
+
+	stbi_image_free(pixels);
+	return true;
+}
\ No newline at end of file
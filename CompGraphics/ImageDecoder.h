@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// RGBA8, строки без выравнивания (rowPitch = width * 4)
+struct DecodedImage
+{
+	std::vector<uint8_t> pixels;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+// Бэкенд декодирования изображений. Decode не должен иметь состояния,
+// чтобы один экземпляр можно было вызывать из нескольких потоков.
+class ImageDecoder
+{
+public:
+	virtual ~ImageDecoder() = default;
+	virtual const char* GetName() const = 0;
+	virtual bool CanDecode(const uint8_t* data, size_t size) const = 0;
+	virtual bool Decode(const uint8_t* data, size_t size, DecodedImage& out) const = 0;
+};
+
+// Универсальный запасной вариант: все форматы, которые понимает stb_image
+class StbImageDecoder : public ImageDecoder
+{
+public:
+	const char* GetName() const override { return "stb_image"; }
+	bool CanDecode(const uint8_t* data, size_t size) const override { return data && size > 0; }
+	bool Decode(const uint8_t* data, size_t size, DecodedImage& out) const override;
+};
\ No newline at end of file
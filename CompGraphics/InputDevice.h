@@ -1,17 +1,35 @@
 #pragma once
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
 #include <array>
+#include <cstdint>
+
+// Коды клавиш - виртуальные коды Win32 (VK_*); буквы и цифры - их символы в верхнем регистре.
+// Без Win32: состояние проигрывается из записи и в безголовом прогоне
+enum InputKey : uint32_t
+{
+	KEY_LEFT = 0x25,
+	KEY_UP = 0x26,
+	KEY_RIGHT = 0x27,
+	KEY_DOWN = 0x28,
+};
 
 class InputDevice
 {
 public:
-	void OnKeyDown(WPARAM key) { if (key < 256) m_keys[key] = true; }
-	void OnKeyUp(WPARAM key) { if (key < 256) m_keys[key] = false; }
+	// Все, что читает кадр: клавиши, кнопки, позиция и смещение мыши за прошлый кадр
+	struct Snapshot
+	{
+		std::array<bool, 256> keys{};
+		std::array<bool, 3> mouseButtons{};
+		int mouseX = 0, mouseY = 0;
+		int mouseDX = 0, mouseDY = 0;
+	};
+
+	void OnKeyDown(uintptr_t key) { if (key < 256) m_keys[key] = true; }
+	void OnKeyUp(uintptr_t key) { if (key < 256) m_keys[key] = false; }
 	void OnMouseMove(int x, int y) { m_mouseX = x; m_mouseY = y; }
 	void OnMouseDown(int btn) { if (btn < 3) m_mouseButtons[btn] = true; }
 	void OnMouseUp(int btn) { if (btn < 3) m_mouseButtons[btn] = false; }
-	bool IsKeyDown(UINT key) const { return key < 256 && m_keys[key]; }
+	bool IsKeyDown(uint32_t key) const { return key < 256 && m_keys[key]; }
 	int MouseX() const { return m_mouseX; }
 	int MouseY() const { return m_mouseY; }
 	bool IsMouseDown(int btn) const { return btn < 3 && m_mouseButtons[btn]; }
@@ -24,6 +42,28 @@ public:
 		m_prevMouseX = m_mouseX;
 		m_prevMouseY = m_mouseY;
 	}
+
+	Snapshot GetSnapshot() const
+	{
+		Snapshot s;
+		s.keys = m_keys;
+		s.mouseButtons = m_mouseButtons;
+		s.mouseX = m_mouseX;
+		s.mouseY = m_mouseY;
+		s.mouseDX = m_mouseDX;
+		s.mouseDY = m_mouseDY;
+		return s;
+	}
+	// Проигрывание записи: смещение мыши берется из снимка, а не считается в EndFrame
+	void SetSnapshot(const Snapshot& s)
+	{
+		m_keys = s.keys;
+		m_mouseButtons = s.mouseButtons;
+		m_mouseX = m_prevMouseX = s.mouseX;
+		m_mouseY = m_prevMouseY = s.mouseY;
+		m_mouseDX = s.mouseDX;
+		m_mouseDY = s.mouseDY;
+	}
 private:
 	std::array<bool, 256> m_keys{};
 	std::array<bool, 3> m_mouseButtons{};
@@ -0,0 +1,64 @@
+#include "InputRecording.h"
+#include <fstream>
+
+static const char* kHeader = "InputRecording";
+static const int kVersion = 1;
+
+void InputRecording::Add(float deltaTime, const InputDevice& input)
+{
+	Frame frame;
+	frame.deltaTime = deltaTime;
+	frame.input = input.GetSnapshot();
+	m_frames.push_back(frame);
+}
+
+bool InputRecording::Save(const std::string& path) const
+{
+	std::ofstream f(path, std::ios::trunc);
+	if (!f.is_open()) return false;
+	// Девяти значащих цифр хватает, чтобы float прочитался обратно без потерь
+	f.precision(9);
+	f << kHeader << ' ' << kVersion << '\n';
+	for (const Frame& frame : m_frames)
+	{
+		const InputDevice::Snapshot& s = frame.input;
+		int buttons = 0, keyCount = 0;
+		for (size_t b = 0; b < s.mouseButtons.size(); ++b) buttons |= s.mouseButtons[b] ? 1 << b : 0;
+		for (bool down : s.keys) keyCount += down ? 1 : 0;
+		f << frame.deltaTime << ' ' << s.mouseX << ' ' << s.mouseY << ' ' << s.mouseDX << ' ' << s.mouseDY << ' '
+			<< buttons << ' ' << keyCount;
+		for (size_t k = 0; k < s.keys.size(); ++k)
+			if (s.keys[k]) f << ' ' << k;
+		f << '\n';
+	}
+	return (bool)f;
+}
+
+bool InputRecording::Load(const std::string& path)
+{
+	std::ifstream f(path);
+	if (!f.is_open()) return false;
+	std::string header;
+	int version = 0;
+	if (!(f >> header >> version) || header != kHeader || version != kVersion) return false;
+
+	std::vector<Frame> frames;
+	Frame frame;
+	int buttons = 0, keyCount = 0;
+	InputDevice::Snapshot& s = frame.input;
+	while (f >> frame.deltaTime >> s.mouseX >> s.mouseY >> s.mouseDX >> s.mouseDY >> buttons >> keyCount)
+	{
+		s.keys.fill(false);
+		for (size_t b = 0; b < s.mouseButtons.size(); ++b) s.mouseButtons[b] = (buttons >> b & 1) != 0;
+		for (int i = 0; i < keyCount; ++i)
+		{
+			unsigned key = 0;
+			if (!(f >> key) || key >= s.keys.size()) return false;
+			s.keys[key] = true;
+		}
+		frames.push_back(frame);
+	}
+	if (!f.eof()) return false;
+	m_frames.swap(frames);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "InputDevice.h"
+
+// Ввод по кадрам для повтора полета камеры без окна: приложение пишет его с ключом -record,
+// FrameBenchmark проигрывает. Текстовый файл: заголовок "InputRecording 1", дальше строка
+// на кадр - deltaTime, mouseX, mouseY, mouseDX, mouseDY, маска кнопок мыши, число нажатых
+// клавиш и их коды
+class InputRecording
+{
+public:
+	struct Frame
+	{
+		float deltaTime = 0.f;
+		InputDevice::Snapshot input;
+	};
+
+	void Add(float deltaTime, const InputDevice& input);
+	void Clear() { m_frames.clear(); }
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	size_t GetFrameCount() const { return m_frames.size(); }
+	const Frame& GetFrame(size_t i) const { return m_frames[i]; }
+
+private:
+	std::vector<Frame> m_frames;
+};
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned workerCount)
+{
+	if (workerCount == 0)
+		workerCount = std::min(std::max(std::thread::hardware_concurrency(), 2u) - 1, 7u);
+	for (unsigned i = 0; i < workerCount; ++i)
+		m_workers.emplace_back([this]() { WorkerLoop(); });
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& t : m_workers) t.join();
+}
+
+void JobSystem::ParallelFor(size_t count, const std::function<void(size_t)>& work)
+{
+	if (count == 0) return;
+	// Один кусок или нет пула - будить потоки дороже самой работы
+	if (count == 1 || m_workers.empty())
+	{
+		for (size_t i = 0; i < count; ++i) work(i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_work = &work;
+		m_count = count;
+		m_next = 0;
+		m_active = m_workers.size();
+		m_error = nullptr;
+		++m_generation;
+	}
+	m_wake.notify_all();
+	RunChunks();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_finished.wait(lock, [this]() { return m_active == 0; });
+	m_work = nullptr;
+	if (m_error)
+	{
+		std::exception_ptr error = m_error;
+		m_error = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+void JobSystem::RunChunks()
+{
+	for (;;)
+	{
+		const size_t index = m_next.fetch_add(1);
+		if (index >= m_count) return;
+		try
+		{
+			(*m_work)(index);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_error) m_error = std::current_exception();
+		}
+	}
+}
+
+void JobSystem::WorkerLoop()
+{
+	uint64_t seen = 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		m_wake.wait(lock, [this, seen]() { return m_stop || m_generation != seen; });
+		if (m_stop) return;
+		seen = m_generation;
+		lock.unlock();
+		RunChunks();
+		lock.lock();
+		if (--m_active == 0) m_finished.notify_one();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Постоянный пул для работы внутри кадра: ParallelFor раздает номера кусков потокам пула
+// и вызывающему потоку и возвращается, когда выполнены все. Потоки живут все время работы,
+// поэтому вызов на кадр не создает потоков. Один ParallelFor одновременно, без D3D.
+class JobSystem
+{
+public:
+	// 0 - по числу ядер минус вызывающий поток, до 7
+	explicit JobSystem(unsigned workerCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// work(index) для index из [0, count) в произвольном порядке и на произвольных потоках.
+	// Исключение первого упавшего куска пробрасывается после завершения остальных
+	void ParallelFor(size_t count, const std::function<void(size_t)>& work);
+
+	// Вместе с вызывающим потоком
+	unsigned GetThreadCount() const { return (unsigned)m_workers.size() + 1; }
+
+private:
+	void WorkerLoop();
+	void RunChunks();
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_finished;
+	bool m_stop = false;
+	// Меняется на каждый ParallelFor - так потоки отличают новую работу
+	uint64_t m_generation = 0;
+	const std::function<void(size_t)>* m_work = nullptr;
+	size_t m_count = 0;
+	std::atomic<size_t> m_next{ 0 };
+	// Потоки пула, еще не закончившие текущий ParallelFor
+	size_t m_active = 0;
+	std::exception_ptr m_error;
+};
\ No newline at end of file
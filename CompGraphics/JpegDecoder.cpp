@@ -0,0 +1,854 @@
+#include "JpegDecoder.h"
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JPEG_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static const int JPEG_FAST_BITS = 9;
+static const size_t JPEG_PARALLEL_MIN_PIXELS = 1024 * 1024;
+
+// +15 на случай испорченного потока, где k уходит за 63
+static const uint8_t kDezigzag[64 + 15] =
+{
+	 0,  1,  8, 16,  9,  2,  3, 10,
+	17, 24, 32, 25, 18, 11,  4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13,  6,  7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63,
+	63, 63, 63, 63, 63, 63, 63, 63,
+	63, 63, 63, 63, 63, 63, 63
+};
+
+struct JpegHuffman
+{
+	uint8_t fast[1 << JPEG_FAST_BITS];
+	uint16_t code[256];
+	uint8_t values[256];
+	uint8_t size[257];
+	uint32_t maxcode[18];
+	int delta[17];
+
+	bool Build(const uint8_t counts[16]);
+};
+
+struct JpegComponent
+{
+	int id = 0;
+	int h = 1, v = 1;
+	int tq = 0, td = 0, ta = 0;
+	int width = 0, height = 0;
+	int stride = 0;
+	std::vector<uint8_t> plane;
+};
+
+struct JpegFrame
+{
+	int width = 0, height = 0;
+	int ncomp = 0;
+	JpegComponent comp[3];
+	int scanOrder[3] = { 0, 1, 2 };
+	int hmax = 1, vmax = 1;
+	int mcusX = 0, mcusY = 0;
+	int restartInterval = 0;
+	int adobeTransform = -1;
+	uint16_t quant[4][64] = {};
+	JpegHuffman dc[4];
+	JpegHuffman ac[4];
+	const uint8_t* scanBegin = nullptr;
+	const uint8_t* dataEnd = nullptr;
+};
+
+struct JpegBitReader
+{
+	const uint8_t* ptr;
+	const uint8_t* end;
+	uint32_t buf = 0;
+	int bits = 0;
+	bool hitMarker = false;
+
+	JpegBitReader(const uint8_t* begin, const uint8_t* e) : ptr(begin), end(e) {}
+
+	void Fill()
+	{
+		while (bits <= 24)
+		{
+			uint32_t b = 0;
+			if (!hitMarker && ptr < end)
+			{
+				b = *ptr;
+				if (b == 0xFF)
+				{
+					uint8_t next = (ptr + 1 < end) ? ptr[1] : 0xD9;
+					if (next == 0x00) ptr += 2;
+					else { hitMarker = true; b = 0; }
+				}
+				else ++ptr;
+			}
+			buf |= b << (24 - bits);
+			bits += 8;
+		}
+	}
+
+	uint32_t GetBits(int n)
+	{
+		if (bits < n) Fill();
+		uint32_t v = buf >> (32 - n);
+		buf <<= n;
+		bits -= n;
+		return v;
+	}
+};
+
+static uint16_t ReadU16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+
+bool JpegHuffman::Build(const uint8_t counts[16])
+{
+	int k = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int j = 0; j < counts[i]; ++j)
+		{
+			if (k >= 255) return false;
+			size[k++] = (uint8_t)(i + 1);
+		}
+	}
+	size[k] = 0;
+
+	uint32_t c = 0;
+	k = 0;
+	for (int j = 1; j <= 16; ++j)
+	{
+		delta[j] = k - (int)c;
+		if (size[k] == j)
+		{
+			while (size[k] == j) code[k++] = (uint16_t)c++;
+			if (c - 1 >= (1u << j)) return false;
+		}
+		maxcode[j] = c << (16 - j);
+		c <<= 1;
+	}
+	maxcode[17] = 0xffffffff;
+
+	memset(fast, 255, sizeof(fast));
+	for (int i = 0; i < k; ++i)
+	{
+		int s = size[i];
+		if (s <= JPEG_FAST_BITS)
+		{
+			int first = code[i] << (JPEG_FAST_BITS - s);
+			int count = 1 << (JPEG_FAST_BITS - s);
+			for (int j = 0; j < count; ++j) fast[first + j] = (uint8_t)i;
+		}
+	}
+	return true;
+}
+
+static int DecodeHuffman(JpegBitReader& br, const JpegHuffman& h)
+{
+	if (br.bits < 16) br.Fill();
+	int c = (int)(br.buf >> (32 - JPEG_FAST_BITS));
+	int k = h.fast[c];
+	if (k < 255)
+	{
+		int s = h.size[k];
+		br.buf <<= s;
+		br.bits -= s;
+		return h.values[k];
+	}
+	uint32_t temp = br.buf >> 16;
+	for (k = JPEG_FAST_BITS + 1; ; ++k)
+		if (temp < h.maxcode[k]) break;
+	if (k == 17) return -1;
+	c = (int)(br.buf >> (32 - k)) + h.delta[k];
+	if (c < 0 || c > 255) return -1;
+	br.buf <<= k;
+	br.bits -= k;
+	return h.values[c];
+}
+
+static int ReceiveExtend(JpegBitReader& br, int n)
+{
+	if (n == 0) return 0;
+	int v = (int)br.GetBits(n);
+	if (v < (1 << (n - 1))) v -= (1 << n) - 1;
+	return v;
+}
+
+static bool DecodeBlock(JpegBitReader& br, const JpegHuffman& dc, const JpegHuffman& ac,
+	const uint16_t* q, int& dcPred, int16_t* blk)
+{
+	memset(blk, 0, 64 * sizeof(int16_t));
+	int t = DecodeHuffman(br, dc);
+	if (t < 0 || t > 15) return false;
+	dcPred += ReceiveExtend(br, t);
+	blk[0] = (int16_t)(dcPred * q[0]);
+
+	int k = 1;
+	while (k < 64)
+	{
+		int rs = DecodeHuffman(br, ac);
+		if (rs < 0) return false;
+		int s = rs & 15;
+		int r = rs >> 4;
+		if (s == 0)
+		{
+			if (rs != 0xF0) break;
+			k += 16;
+		}
+		else
+		{
+			k += r;
+			if (k > 63) return false;
+			blk[kDezigzag[k]] = (int16_t)(ReceiveExtend(br, s) * q[k]);
+			++k;
+		}
+	}
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+// IDCT: целочисленный вариант jidctint (12 бит дробной части)
+// ---------------------------------------------------------------------------
+
+#define JPEG_F2F(x) ((int)((x) * 4096 + 0.5f))
+
+#ifndef JPEG_USE_SSE2
+static inline uint8_t Clamp8(int x)
+{
+	return (uint8_t)((unsigned)x > 255 ? (x < 0 ? 0 : 255) : x);
+}
+
+#define JPEG_IDCT_1D(s0, s1, s2, s3, s4, s5, s6, s7) \
+	int t0, t1, t2, t3, p1, p2, p3, p4, p5, x0, x1, x2, x3; \
+	p2 = s2; p3 = s6; \
+	p1 = (p2 + p3) * JPEG_F2F(0.5411961f); \
+	t2 = p1 + p3 * JPEG_F2F(-1.847759065f); \
+	t3 = p1 + p2 * JPEG_F2F(0.765366865f); \
+	p2 = s0; p3 = s4; \
+	t0 = (p2 + p3) * 4096; \
+	t1 = (p2 - p3) * 4096; \
+	x0 = t0 + t3; x3 = t0 - t3; \
+	x1 = t1 + t2; x2 = t1 - t2; \
+	t0 = s7; t1 = s5; t2 = s3; t3 = s1; \
+	p3 = t0 + t2; p4 = t1 + t3; \
+	p1 = t0 + t3; p2 = t1 + t2; \
+	p5 = (p3 + p4) * JPEG_F2F(1.175875602f); \
+	t0 = t0 * JPEG_F2F(0.298631336f); \
+	t1 = t1 * JPEG_F2F(2.053119869f); \
+	t2 = t2 * JPEG_F2F(3.072711026f); \
+	t3 = t3 * JPEG_F2F(1.501321110f); \
+	p1 = p5 + p1 * JPEG_F2F(-0.899976223f); \
+	p2 = p5 + p2 * JPEG_F2F(-2.562915447f); \
+	p3 = p3 * JPEG_F2F(-1.961570560f); \
+	p4 = p4 * JPEG_F2F(-0.390180644f); \
+	t3 += p1 + p4; t2 += p2 + p3; \
+	t1 += p2 + p4; t0 += p1 + p3;
+
+static void Idct8x8(const int16_t* in, uint8_t* out, int stride)
+{
+	int val[64];
+	for (int i = 0; i < 8; ++i)
+	{
+		const int16_t* d = in + i;
+		int* v = val + i;
+		if (d[8] == 0 && d[16] == 0 && d[24] == 0 && d[32] == 0 && d[40] == 0 && d[48] == 0 && d[56] == 0)
+		{
+			int dcterm = d[0] * 4;
+			v[0] = v[8] = v[16] = v[24] = v[32] = v[40] = v[48] = v[56] = dcterm;
+			continue;
+		}
+		JPEG_IDCT_1D(d[0], d[8], d[16], d[24], d[32], d[40], d[48], d[56])
+		x0 += 512; x1 += 512; x2 += 512; x3 += 512;
+		v[0] = (x0 + t3) >> 10; v[56] = (x0 - t3) >> 10;
+		v[8] = (x1 + t2) >> 10; v[48] = (x1 - t2) >> 10;
+		v[16] = (x2 + t1) >> 10; v[40] = (x2 - t1) >> 10;
+		v[24] = (x3 + t0) >> 10; v[32] = (x3 - t0) >> 10;
+	}
+	for (int i = 0; i < 8; ++i, out += stride)
+	{
+		const int* v = val + i * 8;
+		JPEG_IDCT_1D(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7])
+		// +0.5 на округление и +128 на сдвиг уровня
+		x0 += 65536 + (128 << 17); x1 += 65536 + (128 << 17);
+		x2 += 65536 + (128 << 17); x3 += 65536 + (128 << 17);
+		out[0] = Clamp8((x0 + t3) >> 17); out[7] = Clamp8((x0 - t3) >> 17);
+		out[1] = Clamp8((x1 + t2) >> 17); out[6] = Clamp8((x1 - t2) >> 17);
+		out[2] = Clamp8((x2 + t1) >> 17); out[5] = Clamp8((x2 - t1) >> 17);
+		out[3] = Clamp8((x3 + t0) >> 17); out[4] = Clamp8((x3 - t0) >> 17);
+	}
+}
+#undef JPEG_IDCT_1D
+#else
+// Та же схема, что и в скалярном варианте, но 8 столбцов за раз:
+// повороты через _mm_madd_epi16, транспонирование через unpack.
+static void Idct8x8(const int16_t* in, uint8_t* out, int stride)
+{
+	__m128i row0, row1, row2, row3, row4, row5, row6, row7, tmp;
+
+#define JPEG_CONST(x, y) _mm_setr_epi16((short)(x), (short)(y), (short)(x), (short)(y), (short)(x), (short)(y), (short)(x), (short)(y))
+
+#define JPEG_ROT(out0, out1, x, y, c0, c1) \
+	__m128i out0##lo = _mm_unpacklo_epi16((x), (y)); \
+	__m128i out0##hi = _mm_unpackhi_epi16((x), (y)); \
+	__m128i out0##_l = _mm_madd_epi16(out0##lo, c0); \
+	__m128i out0##_h = _mm_madd_epi16(out0##hi, c0); \
+	__m128i out1##_l = _mm_madd_epi16(out0##lo, c1); \
+	__m128i out1##_h = _mm_madd_epi16(out0##hi, c1)
+
+#define JPEG_WIDEN(out, in) \
+	__m128i out##_l = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), (in)), 4); \
+	__m128i out##_h = _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), (in)), 4)
+
+#define JPEG_WADD(out, a, b) \
+	__m128i out##_l = _mm_add_epi32(a##_l, b##_l); \
+	__m128i out##_h = _mm_add_epi32(a##_h, b##_h)
+
+#define JPEG_WSUB(out, a, b) \
+	__m128i out##_l = _mm_sub_epi32(a##_l, b##_l); \
+	__m128i out##_h = _mm_sub_epi32(a##_h, b##_h)
+
+#define JPEG_BFLY(out0, out1, a, b, bias, s) \
+	{ \
+		__m128i abiased_l = _mm_add_epi32(a##_l, bias); \
+		__m128i abiased_h = _mm_add_epi32(a##_h, bias); \
+		JPEG_WADD(sum, abiased, b); \
+		JPEG_WSUB(dif, abiased, b); \
+		out0 = _mm_packs_epi32(_mm_srai_epi32(sum_l, s), _mm_srai_epi32(sum_h, s)); \
+		out1 = _mm_packs_epi32(_mm_srai_epi32(dif_l, s), _mm_srai_epi32(dif_h, s)); \
+	}
+
+#define JPEG_PASS(bias, shift) \
+	{ \
+		JPEG_ROT(t2e, t3e, row2, row6, rot0_0, rot0_1); \
+		__m128i sum04 = _mm_add_epi16(row0, row4); \
+		__m128i dif04 = _mm_sub_epi16(row0, row4); \
+		JPEG_WIDEN(t0e, sum04); \
+		JPEG_WIDEN(t1e, dif04); \
+		JPEG_WADD(x0, t0e, t3e); \
+		JPEG_WSUB(x3, t0e, t3e); \
+		JPEG_WADD(x1, t1e, t2e); \
+		JPEG_WSUB(x2, t1e, t2e); \
+		JPEG_ROT(y0o, y2o, row7, row3, rot2_0, rot2_1); \
+		JPEG_ROT(y1o, y3o, row5, row1, rot3_0, rot3_1); \
+		__m128i sum17 = _mm_add_epi16(row1, row7); \
+		__m128i sum35 = _mm_add_epi16(row3, row5); \
+		JPEG_ROT(y4o, y5o, sum17, sum35, rot1_0, rot1_1); \
+		JPEG_WADD(x4, y0o, y4o); \
+		JPEG_WADD(x5, y1o, y5o); \
+		JPEG_WADD(x6, y2o, y5o); \
+		JPEG_WADD(x7, y3o, y4o); \
+		JPEG_BFLY(row0, row7, x0, x7, bias, shift); \
+		JPEG_BFLY(row1, row6, x1, x6, bias, shift); \
+		JPEG_BFLY(row2, row5, x2, x5, bias, shift); \
+		JPEG_BFLY(row3, row4, x3, x4, bias, shift); \
+	}
+
+#define JPEG_INTERLEAVE8(a, b) tmp = a; a = _mm_unpacklo_epi8(a, b); b = _mm_unpackhi_epi8(tmp, b)
+#define JPEG_INTERLEAVE16(a, b) tmp = a; a = _mm_unpacklo_epi16(a, b); b = _mm_unpackhi_epi16(tmp, b)
+
+	const __m128i rot0_0 = JPEG_CONST(JPEG_F2F(0.5411961f), JPEG_F2F(0.5411961f) + JPEG_F2F(-1.847759065f));
+	const __m128i rot0_1 = JPEG_CONST(JPEG_F2F(0.5411961f) + JPEG_F2F(0.765366865f), JPEG_F2F(0.5411961f));
+	const __m128i rot1_0 = JPEG_CONST(JPEG_F2F(1.175875602f) + JPEG_F2F(-0.899976223f), JPEG_F2F(1.175875602f));
+	const __m128i rot1_1 = JPEG_CONST(JPEG_F2F(1.175875602f), JPEG_F2F(1.175875602f) + JPEG_F2F(-2.562915447f));
+	const __m128i rot2_0 = JPEG_CONST(JPEG_F2F(-1.961570560f) + JPEG_F2F(0.298631336f), JPEG_F2F(-1.961570560f));
+	const __m128i rot2_1 = JPEG_CONST(JPEG_F2F(-1.961570560f), JPEG_F2F(-1.961570560f) + JPEG_F2F(3.072711026f));
+	const __m128i rot3_0 = JPEG_CONST(JPEG_F2F(-0.390180644f) + JPEG_F2F(2.053119869f), JPEG_F2F(-0.390180644f));
+	const __m128i rot3_1 = JPEG_CONST(JPEG_F2F(-0.390180644f), JPEG_F2F(-0.390180644f) + JPEG_F2F(1.501321110f));
+
+	const __m128i bias0 = _mm_set1_epi32(512);
+	const __m128i bias1 = _mm_set1_epi32(65536 + (128 << 17));
+
+	row0 = _mm_load_si128((const __m128i*)(in + 0 * 8));
+	row1 = _mm_load_si128((const __m128i*)(in + 1 * 8));
+	row2 = _mm_load_si128((const __m128i*)(in + 2 * 8));
+	row3 = _mm_load_si128((const __m128i*)(in + 3 * 8));
+	row4 = _mm_load_si128((const __m128i*)(in + 4 * 8));
+	row5 = _mm_load_si128((const __m128i*)(in + 5 * 8));
+	row6 = _mm_load_si128((const __m128i*)(in + 6 * 8));
+	row7 = _mm_load_si128((const __m128i*)(in + 7 * 8));
+
+	// столбцы
+	JPEG_PASS(bias0, 10);
+	JPEG_INTERLEAVE16(row0, row4);
+	JPEG_INTERLEAVE16(row1, row5);
+	JPEG_INTERLEAVE16(row2, row6);
+	JPEG_INTERLEAVE16(row3, row7);
+	JPEG_INTERLEAVE16(row0, row2);
+	JPEG_INTERLEAVE16(row1, row3);
+	JPEG_INTERLEAVE16(row4, row6);
+	JPEG_INTERLEAVE16(row5, row7);
+	JPEG_INTERLEAVE16(row0, row1);
+	JPEG_INTERLEAVE16(row2, row3);
+	JPEG_INTERLEAVE16(row4, row5);
+	JPEG_INTERLEAVE16(row6, row7);
+
+	// строки
+	JPEG_PASS(bias1, 17);
+	__m128i p0 = _mm_packus_epi16(row0, row1);
+	__m128i p1 = _mm_packus_epi16(row2, row3);
+	__m128i p2 = _mm_packus_epi16(row4, row5);
+	__m128i p3 = _mm_packus_epi16(row6, row7);
+	JPEG_INTERLEAVE8(p0, p2);
+	JPEG_INTERLEAVE8(p1, p3);
+	JPEG_INTERLEAVE8(p0, p1);
+	JPEG_INTERLEAVE8(p2, p3);
+	JPEG_INTERLEAVE8(p0, p2);
+	JPEG_INTERLEAVE8(p1, p3);
+
+	_mm_storel_epi64((__m128i*)out, p0); out += stride;
+	_mm_storel_epi64((__m128i*)out, _mm_shuffle_epi32(p0, 0x4e)); out += stride;
+	_mm_storel_epi64((__m128i*)out, p2); out += stride;
+	_mm_storel_epi64((__m128i*)out, _mm_shuffle_epi32(p2, 0x4e)); out += stride;
+	_mm_storel_epi64((__m128i*)out, p1); out += stride;
+	_mm_storel_epi64((__m128i*)out, _mm_shuffle_epi32(p1, 0x4e)); out += stride;
+	_mm_storel_epi64((__m128i*)out, p3); out += stride;
+	_mm_storel_epi64((__m128i*)out, _mm_shuffle_epi32(p3, 0x4e));
+
+#undef JPEG_CONST
+#undef JPEG_ROT
+#undef JPEG_WIDEN
+#undef JPEG_WADD
+#undef JPEG_WSUB
+#undef JPEG_BFLY
+#undef JPEG_PASS
+#undef JPEG_INTERLEAVE8
+#undef JPEG_INTERLEAVE16
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Цветовое преобразование
+// ---------------------------------------------------------------------------
+
+static void YCbCrToRgba(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* out, int count)
+{
+	int i = 0;
+#ifdef JPEG_USE_SSE2
+	// Все вычисления в 16-битных каналах с 4 битами дробной части
+	const __m128i signflip = _mm_set1_epi8(-0x80);
+	const __m128i crConst0 = _mm_set1_epi16((short)(1.40200f * 4096.0f + 0.5f));
+	const __m128i crConst1 = _mm_set1_epi16(-(short)(0.71414f * 4096.0f + 0.5f));
+	const __m128i cbConst0 = _mm_set1_epi16(-(short)(0.34414f * 4096.0f + 0.5f));
+	const __m128i cbConst1 = _mm_set1_epi16((short)(1.77200f * 4096.0f + 0.5f));
+	const __m128i yBias = _mm_set1_epi8((char)(unsigned char)128);
+	const __m128i alpha = _mm_set1_epi16(255);
+	for (; i + 7 < count; i += 8)
+	{
+		__m128i yBytes = _mm_loadl_epi64((const __m128i*)(y + i));
+		__m128i crBytes = _mm_loadl_epi64((const __m128i*)(cr + i));
+		__m128i cbBytes = _mm_loadl_epi64((const __m128i*)(cb + i));
+		__m128i crBiased = _mm_xor_si128(crBytes, signflip);
+		__m128i cbBiased = _mm_xor_si128(cbBytes, signflip);
+
+		__m128i yw = _mm_unpacklo_epi8(yBias, yBytes);
+		__m128i crw = _mm_unpacklo_epi8(_mm_setzero_si128(), crBiased);
+		__m128i cbw = _mm_unpacklo_epi8(_mm_setzero_si128(), cbBiased);
+
+		__m128i yws = _mm_srli_epi16(yw, 4);
+		__m128i cr0 = _mm_mulhi_epi16(crConst0, crw);
+		__m128i cb0 = _mm_mulhi_epi16(cbConst0, cbw);
+		__m128i cb1 = _mm_mulhi_epi16(cbw, cbConst1);
+		__m128i cr1 = _mm_mulhi_epi16(crw, crConst1);
+		__m128i rw = _mm_srai_epi16(_mm_add_epi16(cr0, yws), 4);
+		__m128i gw = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(yws, cb0), cr1), 4);
+		__m128i bw = _mm_srai_epi16(_mm_add_epi16(yws, cb1), 4);
+
+		__m128i rb = _mm_packus_epi16(rw, bw);
+		__m128i ga = _mm_packus_epi16(gw, alpha);
+		__m128i t0 = _mm_unpacklo_epi8(rb, ga);
+		__m128i t1 = _mm_unpackhi_epi8(rb, ga);
+		_mm_storeu_si128((__m128i*)(out + i * 4), _mm_unpacklo_epi16(t0, t1));
+		_mm_storeu_si128((__m128i*)(out + i * 4 + 16), _mm_unpackhi_epi16(t0, t1));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		int yy = (y[i] << 16) + (1 << 15);
+		int cbv = cb[i] - 128;
+		int crv = cr[i] - 128;
+		int r = (yy + crv * 91881) >> 16;
+		int g = (yy - cbv * 22554 - crv * 46802) >> 16;
+		int b = (yy + cbv * 116130) >> 16;
+		uint8_t* o = out + i * 4;
+		o[0] = (uint8_t)std::min(255, std::max(0, r));
+		o[1] = (uint8_t)std::min(255, std::max(0, g));
+		o[2] = (uint8_t)std::min(255, std::max(0, b));
+		o[3] = 255;
+	}
+}
+
+static void GrayToRgba(const uint8_t* y, uint8_t* out, int count)
+{
+	int i = 0;
+#ifdef JPEG_USE_SSE2
+	const __m128i alpha = _mm_set1_epi8((char)0xFF);
+	for (; i + 15 < count; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(y + i));
+		__m128i yyLo = _mm_unpacklo_epi8(v, v);
+		__m128i yaLo = _mm_unpacklo_epi8(v, alpha);
+		__m128i yyHi = _mm_unpackhi_epi8(v, v);
+		__m128i yaHi = _mm_unpackhi_epi8(v, alpha);
+		uint8_t* o = out + i * 4;
+		_mm_storeu_si128((__m128i*)(o + 0), _mm_unpacklo_epi16(yyLo, yaLo));
+		_mm_storeu_si128((__m128i*)(o + 16), _mm_unpackhi_epi16(yyLo, yaLo));
+		_mm_storeu_si128((__m128i*)(o + 32), _mm_unpacklo_epi16(yyHi, yaHi));
+		_mm_storeu_si128((__m128i*)(o + 48), _mm_unpackhi_epi16(yyHi, yaHi));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		uint8_t* o = out + i * 4;
+		o[0] = o[1] = o[2] = y[i];
+		o[3] = 255;
+	}
+}
+
+// "Fancy" (треугольная) интерполяция хромы, как в libjpeg
+static const uint8_t* UpsampleChromaRow(const JpegComponent& c, int y, int hs, int vs, uint8_t* out, uint16_t* colsum)
+{
+	const int cw = c.width;
+	const int cy = std::min(y / vs, c.height - 1);
+	const uint8_t* nearRow = c.plane.data() + (size_t)cy * c.stride;
+	if (hs == 1 && vs == 1) return nearRow;
+
+	const uint8_t* farRow = nearRow;
+	if (vs == 2)
+	{
+		int fy = (y & 1) ? std::min(cy + 1, c.height - 1) : std::max(cy - 1, 0);
+		farRow = c.plane.data() + (size_t)fy * c.stride;
+	}
+
+	if (hs == 1)
+	{
+		for (int i = 0; i < cw; ++i)
+			out[i] = (uint8_t)((3 * nearRow[i] + farRow[i] + 2) >> 2);
+		return out;
+	}
+
+	if (cw == 1)
+	{
+		out[0] = out[1] = (vs == 2) ? (uint8_t)((3 * nearRow[0] + farRow[0] + 2) >> 2) : nearRow[0];
+		return out;
+	}
+
+	if (vs == 1)
+	{
+		out[0] = nearRow[0];
+		out[1] = (uint8_t)((nearRow[0] * 3 + nearRow[1] + 2) >> 2);
+		for (int i = 1; i < cw - 1; ++i)
+		{
+			int v = nearRow[i] * 3;
+			out[i * 2] = (uint8_t)((v + nearRow[i - 1] + 1) >> 2);
+			out[i * 2 + 1] = (uint8_t)((v + nearRow[i + 1] + 2) >> 2);
+		}
+		out[(cw - 1) * 2] = (uint8_t)((nearRow[cw - 1] * 3 + nearRow[cw - 2] + 1) >> 2);
+		out[(cw - 1) * 2 + 1] = nearRow[cw - 1];
+		return out;
+	}
+
+	for (int i = 0; i < cw; ++i)
+		colsum[i] = (uint16_t)(3 * nearRow[i] + farRow[i]);
+	int thisSum = colsum[0];
+	int nextSum = colsum[1];
+	out[0] = (uint8_t)((thisSum * 4 + 8) >> 4);
+	out[1] = (uint8_t)((thisSum * 3 + nextSum + 7) >> 4);
+	for (int i = 1; i < cw - 1; ++i)
+	{
+		int lastSum = thisSum;
+		thisSum = nextSum;
+		nextSum = colsum[i + 1];
+		out[i * 2] = (uint8_t)((thisSum * 3 + lastSum + 8) >> 4);
+		out[i * 2 + 1] = (uint8_t)((thisSum * 3 + nextSum + 7) >> 4);
+	}
+	out[(cw - 1) * 2] = (uint8_t)((nextSum * 3 + thisSum + 8) >> 4);
+	out[(cw - 1) * 2 + 1] = (uint8_t)((nextSum * 4 + 7) >> 4);
+	return out;
+}
+
+// ---------------------------------------------------------------------------
+// Разбор заголовков и декодирование
+// ---------------------------------------------------------------------------
+
+static bool ParseHeaders(const uint8_t* data, size_t size, JpegFrame& f)
+{
+	if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+	const uint8_t* p = data + 2;
+	const uint8_t* end = data + size;
+	bool haveFrame = false;
+
+	while (p + 4 <= end)
+	{
+		if (p[0] != 0xFF) return false;
+		uint8_t marker = p[1];
+		if (marker == 0xFF) { ++p; continue; }
+		p += 2;
+		if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) continue;
+		if (marker == 0xD9) return false;
+
+		uint16_t len = ReadU16(p);
+		if (len < 2 || p + len > end) return false;
+		const uint8_t* seg = p + 2;
+		const uint8_t* segEnd = p + len;
+
+		switch (marker)
+		{
+		case 0xDB:
+			while (seg < segEnd)
+			{
+				int pq = seg[0] >> 4, tq = seg[0] & 15;
+				if (tq > 3 || pq > 1 || seg + 1 + (pq ? 128 : 64) > segEnd) return false;
+				++seg;
+				for (int i = 0; i < 64; ++i)
+					f.quant[tq][i] = pq ? ReadU16(seg + i * 2) : seg[i];
+				seg += pq ? 128 : 64;
+			}
+			break;
+		case 0xC4:
+			while (seg < segEnd)
+			{
+				if (seg + 17 > segEnd) return false;
+				int tc = seg[0] >> 4, th = seg[0] & 15;
+				if (tc > 1 || th > 3) return false;
+				const uint8_t* counts = seg + 1;
+				int total = 0;
+				for (int i = 0; i < 16; ++i) total += counts[i];
+				if (total > 255 || seg + 17 + total > segEnd) return false;
+				JpegHuffman& h = tc ? f.ac[th] : f.dc[th];
+				memcpy(h.values, seg + 17, total);
+				if (!h.Build(counts)) return false;
+				seg += 17 + total;
+			}
+			break;
+		case 0xDD:
+			if (len < 4) return false;
+			f.restartInterval = ReadU16(seg);
+			break;
+		case 0xEE:
+			if (len >= 14 && memcmp(seg, "Adobe", 5) == 0) f.adobeTransform = seg[11];
+			break;
+		case 0xC0:
+		case 0xC1:
+		{
+			if (len < 8 || seg[0] != 8) return false;
+			f.height = ReadU16(seg + 1);
+			f.width = ReadU16(seg + 3);
+			f.ncomp = seg[5];
+			if (f.width == 0 || f.height == 0) return false;
+			if (f.ncomp != 1 && f.ncomp != 3) return false;
+			if (len < 8 + 3 * f.ncomp) return false;
+			for (int i = 0; i < f.ncomp; ++i)
+			{
+				JpegComponent& c = f.comp[i];
+				c.id = seg[6 + i * 3];
+				c.h = seg[7 + i * 3] >> 4;
+				c.v = seg[7 + i * 3] & 15;
+				c.tq = seg[8 + i * 3];
+				if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4 || c.tq > 3) return false;
+			}
+			haveFrame = true;
+			break;
+		}
+		case 0xDA:
+		{
+			if (!haveFrame) return false;
+			int ns = seg[0];
+			// Несколько неинтерливных сканов в baseline встречаются редко - отдаем stb
+			if (ns != f.ncomp || len < 6 + 2 * ns) return false;
+			for (int i = 0; i < ns; ++i)
+			{
+				int cid = seg[1 + i * 2];
+				int idx = -1;
+				for (int j = 0; j < f.ncomp; ++j)
+					if (f.comp[j].id == cid) idx = j;
+				if (idx < 0) return false;
+				f.comp[idx].td = seg[2 + i * 2] >> 4;
+				f.comp[idx].ta = seg[2 + i * 2] & 15;
+				if (f.comp[idx].td > 3 || f.comp[idx].ta > 3) return false;
+				f.scanOrder[i] = idx;
+			}
+			const uint8_t* spectral = seg + 1 + ns * 2;
+			if (spectral[0] != 0 || spectral[1] != 63 || spectral[2] != 0) return false;
+			f.scanBegin = segEnd;
+			f.dataEnd = end;
+			return true;
+		}
+		default:
+			// Progressive, lossless, arithmetic
+			if ((marker >= 0xC2 && marker <= 0xC7) || (marker >= 0xC9 && marker <= 0xCF)) return false;
+			break;
+		}
+		p = segEnd;
+	}
+	return false;
+}
+
+static bool SetupComponents(JpegFrame& f)
+{
+	if (f.ncomp == 3)
+	{
+		if (f.adobeTransform == 0) return false;
+		for (int i = 1; i < 3; ++i)
+			if (f.comp[i].h != 1 || f.comp[i].v != 1) return false;
+		if (f.comp[0].h > 2 || f.comp[0].v > 2) return false;
+	}
+	else
+	{
+		// Один компонент всегда кодируется неинтерливно: MCU = один блок
+		f.comp[0].h = f.comp[0].v = 1;
+	}
+	f.hmax = f.comp[0].h;
+	f.vmax = f.comp[0].v;
+	f.mcusX = (f.width + f.hmax * 8 - 1) / (f.hmax * 8);
+	f.mcusY = (f.height + f.vmax * 8 - 1) / (f.vmax * 8);
+	for (int i = 0; i < f.ncomp; ++i)
+	{
+		JpegComponent& c = f.comp[i];
+		c.stride = f.mcusX * c.h * 8;
+		c.width = (f.width * c.h + f.hmax - 1) / f.hmax;
+		c.height = (f.height * c.v + f.vmax - 1) / f.vmax;
+		c.plane.resize((size_t)c.stride * f.mcusY * c.v * 8);
+	}
+	return true;
+}
+
+static void FindRestartSegments(const uint8_t* p, const uint8_t* end, std::vector<const uint8_t*>& starts)
+{
+	starts.push_back(p);
+	while (p + 1 < end)
+	{
+		p = (const uint8_t*)memchr(p, 0xFF, end - p - 1);
+		if (!p) break;
+		uint8_t m = p[1];
+		if (m == 0x00) { p += 2; continue; }
+		if (m == 0xFF) { ++p; continue; }
+		if (m >= 0xD0 && m <= 0xD7)
+		{
+			p += 2;
+			starts.push_back(p);
+			continue;
+		}
+		break;
+	}
+}
+
+static bool DecodeSegment(JpegFrame& f, const uint8_t* begin, int firstMcu, int mcuCount)
+{
+	JpegBitReader br(begin, f.dataEnd);
+	int dcPred[3] = { 0, 0, 0 };
+	alignas(16) int16_t blk[64];
+	for (int m = firstMcu; m < firstMcu + mcuCount; ++m)
+	{
+		const int mx = m % f.mcusX;
+		const int my = m / f.mcusX;
+		for (int s = 0; s < f.ncomp; ++s)
+		{
+			const int ci = f.scanOrder[s];
+			JpegComponent& c = f.comp[ci];
+			for (int v = 0; v < c.v; ++v)
+			{
+				for (int h = 0; h < c.h; ++h)
+				{
+					if (!DecodeBlock(br, f.dc[c.td], f.ac[c.ta], f.quant[c.tq], dcPred[ci], blk))
+						return false;
+					uint8_t* dst = c.plane.data() + (size_t)((my * c.v + v) * 8) * c.stride + (mx * c.h + h) * 8;
+					Idct8x8(blk, dst, c.stride);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+static void ParallelFor(int count, bool parallel, const std::function<void(int)>& fn)
+{
+	unsigned workers = parallel ? std::max(1u, std::thread::hardware_concurrency()) : 1u;
+	workers = std::min(workers, (unsigned)std::max(count, 1));
+	if (workers <= 1)
+	{
+		for (int i = 0; i < count; ++i) fn(i);
+		return;
+	}
+	std::atomic<int> next{ 0 };
+	auto worker = [&]() {
+		for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) fn(i);
+		};
+	std::vector<std::thread> pool;
+	for (unsigned w = 1; w < workers; ++w) pool.emplace_back(worker);
+	worker();
+	for (auto& t : pool) t.join();
+}
+
+bool SimdJpegDecoder::CanDecode(const uint8_t* data, size_t size) const
+{
+	return data && size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+bool SimdJpegDecoder::Decode(const uint8_t* data, size_t size, DecodedImage& out) const
+{
+	std::unique_ptr<JpegFrame> frame(new JpegFrame());
+	JpegFrame& f = *frame;
+	if (!ParseHeaders(data, size, f) || !SetupComponents(f)) return false;
+
+	const int totalMcus = f.mcusX * f.mcusY;
+	const bool parallel = (size_t)f.width * f.height >= JPEG_PARALLEL_MIN_PIXELS;
+
+	// Без DRI весь скан - один сегмент. С DRI каждый сегмент начинается
+	// со сброса DC-предикторов и независим от остальных.
+	std::vector<const uint8_t*> segments;
+	int mcusPerSegment = totalMcus;
+	if (f.restartInterval > 0)
+	{
+		FindRestartSegments(f.scanBegin, f.dataEnd, segments);
+		mcusPerSegment = f.restartInterval;
+	}
+	else
+	{
+		segments.push_back(f.scanBegin);
+	}
+	const int segmentCount = std::min((int)segments.size(), (totalMcus + mcusPerSegment - 1) / mcusPerSegment);
+
+	std::atomic<bool> failed{ false };
+	ParallelFor(segmentCount, parallel, [&](int i) {
+		int first = i * mcusPerSegment;
+		int count = std::min(mcusPerSegment, totalMcus - first);
+		if (!DecodeSegment(f, segments[i], first, count)) failed = true;
+		});
+	if (failed) return false;
+
+	out.width = (uint32_t)f.width;
+	out.height = (uint32_t)f.height;
+	out.pixels.resize((size_t)f.width * f.height * 4);
+
+	const int bandRows = 64;
+	const int bands = (f.height + bandRows - 1) / bandRows;
+	ParallelFor(bands, parallel, [&](int band) {
+		std::vector<uint8_t> cbRow(f.width + 16), crRow(f.width + 16);
+		std::vector<uint16_t> colsum(f.width + 16);
+		const int yEnd = std::min(f.height, (band + 1) * bandRows);
+		for (int y = band * bandRows; y < yEnd; ++y)
+		{
+			uint8_t* dst = out.pixels.data() + (size_t)y * f.width * 4;
+			const uint8_t* yRow = f.comp[0].plane.data() + (size_t)y * f.comp[0].stride;
+			if (f.ncomp == 1)
+			{
+				GrayToRgba(yRow, dst, f.width);
+				continue;
+			}
+			const uint8_t* cb = UpsampleChromaRow(f.comp[1], y, f.hmax, f.vmax, cbRow.data(), colsum.data());
+			const uint8_t* cr = UpsampleChromaRow(f.comp[2], y, f.hmax, f.vmax, crRow.data(), colsum.data());
+			YCbCrToRgba(yRow, cb, cr, dst, f.width);
+		}
+		});
+	return true;
+}
\ No newline at end of file
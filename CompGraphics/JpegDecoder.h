@@ -0,0 +1,14 @@
+#pragma once
+#include "ImageDecoder.h"
+
+// Baseline JPEG (SOF0/SOF1, Huffman, 8 бит): SSE2 IDCT и YCbCr->RGBA,
+// сегменты между RST-маркерами больших изображений декодируются параллельно.
+// Progressive/arithmetic/CMYK не поддерживаются - Decode вернет false,
+// и TextureLoader перейдет к следующему бэкенду.
+class SimdJpegDecoder : public ImageDecoder
+{
+public:
+	const char* GetName() const override { return "simd_jpeg"; }
+	bool CanDecode(const uint8_t* data, size_t size) const override;
+	bool Decode(const uint8_t* data, size_t size, DecodedImage& out) const override;
+};
\ No newline at end of file
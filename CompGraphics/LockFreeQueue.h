@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Ограниченная MPMC-очередь на кольцевом буфере (схема Вьюкова): у каждой ячейки свой
+// счетчик последовательности, push/pop - один CAS по позиции без блокировок.
+// Емкость округляется вверх до степени двойки. При переполнении TryPush возвращает false.
+template<typename T>
+class LockFreeQueue
+{
+public:
+	explicit LockFreeQueue(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity) size <<= 1;
+		m_cells.reset(new Cell[size]);
+		m_mask = size - 1;
+		for (size_t i = 0; i < size; ++i) m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	LockFreeQueue(const LockFreeQueue&) = delete;
+	LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+	bool TryPush(T value)
+	{
+		size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			}
+			else if (diff < 0) return false;
+			else pos = m_enqueuePos.load(std::memory_order_relaxed);
+		}
+		cell->data = std::move(value);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T& out)
+	{
+		size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0)
+			{
+				if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			}
+			else if (diff < 0) return false;
+			else pos = m_dequeuePos.load(std::memory_order_relaxed);
+		}
+		out = std::move(cell->data);
+		cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t Capacity() const { return m_mask + 1; }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask = 0;
+	alignas(64) std::atomic<size_t> m_enqueuePos{ 0 };
+	alignas(64) std::atomic<size_t> m_dequeuePos{ 0 };
+};
\ No newline at end of file
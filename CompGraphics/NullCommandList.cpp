@@ -0,0 +1,42 @@
+#include "NullCommandList.h"
+
+void NullCommandList::Hash(uint64_t value)
+{
+	for (int i = 0; i < 8; ++i, value >>= 8)
+	{
+		m_stats.streamHash ^= value & 0xff;
+		m_stats.streamHash *= 1099511628211ull;
+	}
+}
+
+void NullCommandList::Replay(const std::vector<CommandPacket>& packets)
+{
+	for (const CommandPacket& packet : packets)
+	{
+		switch (packet.type)
+		{
+		case CommandPacket::SetPipeline: ++m_stats.pipelineChanges; break;
+		case CommandPacket::SetMesh: ++m_stats.meshChanges; break;
+		case CommandPacket::SetTable: ++m_stats.tableChanges; break;
+		case CommandPacket::SetMaterial: ++m_stats.materialChanges; break;
+		case CommandPacket::Draw:
+			++m_stats.draws;
+			m_stats.instances += packet.instanceCount;
+			m_stats.indices += (uint64_t)packet.value * packet.instanceCount;
+			break;
+		}
+		Hash((uint64_t)packet.type << 32 | packet.value);
+		Hash((uint64_t)packet.start << 32 | packet.instanceStart);
+		Hash(packet.instanceCount);
+		Hash(packet.material);
+	}
+	m_stats.packets += packets.size();
+}
+
+void NullCommandList::Draw(uint32_t vertexCount)
+{
+	++m_stats.packets;
+	++m_stats.draws;
+	++m_stats.instances;
+	Hash((uint64_t)CommandPacket::Draw << 32 | vertexCount);
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "DrawPackets.h"
+
+// Безголовый приемник кадра: принимает те же пакеты, что SubmitDrawList переигрывает в D3D12,
+// и записи констант, но ничего не выполняет - только считает. Хеш потока команд меняется,
+// если меняется хоть одна команда: по нему прогоны сравниваются между сборками
+class NullCommandList
+{
+public:
+	struct Stats
+	{
+		uint64_t packets = 0;
+		uint64_t draws = 0;
+		uint64_t instances = 0;
+		uint64_t indices = 0;
+		uint64_t pipelineChanges = 0;
+		uint64_t meshChanges = 0;
+		uint64_t tableChanges = 0;
+		uint64_t materialChanges = 0;
+		uint64_t constantBytes = 0;
+		// FNV-1a по всем командам
+		uint64_t streamHash = 14695981039346656037ull;
+	};
+
+	void Replay(const std::vector<CommandPacket>& packets);
+	// Отрисовка без пакета (полноэкранный проход)
+	void Draw(uint32_t vertexCount);
+	// Байты, которые кадр записал бы в буферы констант
+	void WriteConstants(size_t bytes) { m_stats.constantBytes += bytes; }
+
+	const Stats& GetStats() const { return m_stats; }
+	void ResetStats() { m_stats = Stats(); }
+
+private:
+	void Hash(uint64_t value);
+
+	Stats m_stats;
+};
\ No newline at end of file
@@ -1,9 +1,12 @@
 #include "OBJLoader.h"
+#include "VirtualFileSystem.h"
 #include <fstream>
 #include <sstream>
 #include <map>
 #include <tuple>
 #include <algorithm>
+#include <cfloat>
+#include <cmath>
 
 static std::string Trim(const std::string& s)
 {
@@ -11,21 +14,35 @@ static std::string Trim(const std::string& s)
 	size_t b = s.find_last_not_of(" \t\r\n");
 	return (a == std::string::npos) ? "" : s.substr(a, b - a + 1);
 }
-static std::string DirOf(const std::string& path)
-{
-	size_t p = path.find_last_of("/\\");
-	return (p == std::string::npos) ? "" : path.substr(0, p + 1);
-}
 static int ResolveIndex(int idx, int total)
 {
 	if (idx < 0) return total + idx;
 	return idx - 1;
 }
 
-bool ObjLoader::LoadMtl(const std::string& mtlPath, std::vector<Material>& mats)
+bool ObjLoader::ReadText(const std::string& path, const FileReader& reader, std::string& text)
 {
-	std::ifstream f(mtlPath);
+	if (reader)
+	{
+		std::vector<uint8_t> bytes;
+		if (!reader(path, bytes)) return false;
+		text.assign(bytes.begin(), bytes.end());
+		return true;
+	}
+	std::ifstream f(path, std::ios::binary);
 	if (!f.is_open()) return false;
+	std::ostringstream ss;
+	ss << f.rdbuf();
+	text = ss.str();
+	return true;
+}
+
+bool ObjLoader::LoadMtl(const std::string& mtlPath, std::vector<Material>& mats, const FileReader& reader)
+{
+	std::string text;
+	if (!ReadText(mtlPath, reader, text)) return false;
+	std::istringstream f(text);
+	const std::string dir = VirtualFileSystem::DirOf(mtlPath);
 	std::string line;
 	int curIdx = -1;
 	while (std::getline(f, line))
@@ -74,40 +91,38 @@ bool ObjLoader::LoadMtl(const std::string& mtlPath, std::vector<Material>& mats)
 			{
 				std::string tex;
 				std::getline(ss, tex);
-				tex = Trim(tex);
-				for (char& c : tex) if (c == '\\') c = '/';
-				if (tex.size() > 2 && tex[0] == '.' && tex[1] == '/')
-					tex = tex.substr(2);
-				cur.diffuseTexture = tex;
+				// Путь к текстуре сразу относительно рабочего каталога / корня VFS
+				cur.diffuseTexture = VirtualFileSystem::Join(dir, Trim(tex));
 			}
 		}
 	}
 	return true;
 }
 
-bool ObjLoader::Load(const std::string& path, ObjMesh& out)
+bool ObjLoader::Load(const std::string& path, ObjMesh& out, const FileReader& reader)
 {
-	std::ifstream f(path);
-	if (!f.is_open()) return false;
-	const std::string dir = DirOf(path);
+	std::string text;
+	if (!ReadText(path, reader, text)) return false;
+	std::istringstream f(text);
+	const std::string dir = VirtualFileSystem::DirOf(path);
 	std::vector<XMFLOAT3> positions;
 	std::vector<XMFLOAT3> normals;
 	std::vector<XMFLOAT2> uvs;
-	std::map<std::tuple<int, int, int>, UINT> vertexMap;
+	std::map<std::tuple<int, int, int>, uint32_t> vertexMap;
 	int curMatIdx = -1;
 	auto CloseSubset = [&]()
 		{
 			if (!out.subsets.empty())
 			{
 				MeshSubset& last = out.subsets.back();
-				last.indexCount = (UINT)out.indices.size() - last.indexStart;
+				last.indexCount = (uint32_t)out.indices.size() - last.indexStart;
 			}
 		};
 	auto OpenSubset = [&](int matIdx)
 		{
 			CloseSubset();
 			MeshSubset s;
-			s.indexStart = (UINT)out.indices.size();
+			s.indexStart = (uint32_t)out.indices.size();
 			s.indexCount = 0;
 			s.materialIdx = matIdx;
 			out.subsets.push_back(s);
@@ -145,7 +160,8 @@ bool ObjLoader::Load(const std::string& path, ObjMesh& out)
 		{
 			std::string mtlFile;
 			ss >> mtlFile;
-			LoadMtl(dir + mtlFile, out.materials);
+			out.materialLibraries.push_back(VirtualFileSystem::Join(dir, mtlFile));
+			LoadMtl(out.materialLibraries.back(), out.materials, reader);
 		}
 		else if (token == "usemtl")
 		{
@@ -165,7 +181,7 @@ bool ObjLoader::Load(const std::string& path, ObjMesh& out)
 		}
 		else if (token == "f")
 		{
-			std::vector<UINT> faceVerts;
+			std::vector<uint32_t> faceVerts;
 			std::string vert;
 			while (ss >> vert)
 			{
@@ -179,7 +195,7 @@ bool ObjLoader::Load(const std::string& path, ObjMesh& out)
 				int tIdx = (ti != 0) ? ResolveIndex(ti, (int)uvs.size()) : -1;
 				int nIdx = (ni != 0) ? ResolveIndex(ni, (int)normals.size()) : -1;
 				std::tuple<int, int, int> key(pIdx, tIdx, nIdx);
-				std::map<std::tuple<int, int, int>, UINT>::iterator it = vertexMap.find(key);
+				std::map<std::tuple<int, int, int>, uint32_t>::iterator it = vertexMap.find(key);
 				if (it == vertexMap.end())
 				{
 					ObjMesh::Vertex v;
@@ -189,7 +205,7 @@ bool ObjLoader::Load(const std::string& path, ObjMesh& out)
 						? uvs[tIdx] : XMFLOAT2(0, 0);
 					v.Normal = (nIdx >= 0 && nIdx < (int)normals.size())
 						? normals[nIdx] : XMFLOAT3(0, 1, 0);
-					UINT newIdx = (UINT)out.vertices.size();
+					uint32_t newIdx = (uint32_t)out.vertices.size();
 					out.vertices.push_back(v);
 					vertexMap[key] = newIdx;
 					faceVerts.push_back(newIdx);
@@ -215,5 +231,31 @@ bool ObjLoader::Load(const std::string& path, ObjMesh& out)
 			nonEmpty.push_back(out.subsets[i]);
 	}
 	out.subsets = nonEmpty;
+	ComputeSubsetBounds(out);
 	return !out.vertices.empty();
+}
+
+void ObjLoader::ComputeSubsetBounds(ObjMesh& mesh)
+{
+	for (MeshSubset& s : mesh.subsets)
+	{
+		if (s.indexCount == 0) continue;
+		XMVECTOR lo = XMVectorReplicate(FLT_MAX);
+		XMVECTOR hi = XMVectorReplicate(-FLT_MAX);
+		for (uint32_t i = s.indexStart; i < s.indexStart + s.indexCount; ++i)
+		{
+			XMVECTOR p = XMLoadFloat3(&mesh.vertices[mesh.indices[i]].Position);
+			lo = XMVectorMin(lo, p);
+			hi = XMVectorMax(hi, p);
+		}
+		XMVECTOR center = XMVectorScale(XMVectorAdd(lo, hi), 0.5f);
+		float radius = 0.f;
+		for (uint32_t i = s.indexStart; i < s.indexStart + s.indexCount; ++i)
+		{
+			XMVECTOR p = XMLoadFloat3(&mesh.vertices[mesh.indices[i]].Position);
+			radius = std::max(radius, XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(p, center))));
+		}
+		XMStoreFloat3(&s.center, center);
+		s.radius = sqrtf(radius);
+	}
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 #include <DirectXMath.h>
@@ -15,9 +15,16 @@ struct Material
 };
 struct MeshSubset
 {
-	UINT indexStart = 0;
-	UINT indexCount = 0;
+	uint32_t indexStart = 0;
+	uint32_t indexCount = 0;
 	int materialIdx = -1;
+	// Ограничивающая сфера в пространстве модели
+	XMFLOAT3 center = { 0.f, 0.f, 0.f };
+	float radius = 0.f;
+	// Копии сабсета - ObjMesh::instances[instanceStart, instanceStart + instanceCount);
+	// 0 - сабсет рисуется один раз как есть
+	uint32_t instanceStart = 0;
+	uint32_t instanceCount = 0;
 };
 struct ObjMesh
 {
@@ -28,15 +35,27 @@ struct ObjMesh
 		XMFLOAT2 TexCoord;
 	};
 	std::vector<Vertex> vertices;
-	std::vector<UINT> indices;
+	std::vector<uint32_t> indices;
 	std::vector<MeshSubset> subsets;
 	std::vector<Material> materials;
+	// Пути MTL-файлов из mtllib (для горячей перезагрузки)
+	std::vector<std::string> materialLibraries;
+	// Матрицы копий сабсетов: из пространства их вершин в пространство модели.
+	// ObjLoader их не заполняет - только InstanceDuplicateGeometry
+	std::vector<XMFLOAT4X4> instances;
 };
 class ObjLoader
 {
 public:
-	static bool Load(const std::string& path, ObjMesh& out);
+	// Чтение файла целиком; false - файла нет
+	typedef std::function<bool(const std::string& path, std::vector<uint8_t>& bytes)> FileReader;
+	// Без reader файлы читаются напрямую с диска (так работают AssetCooker и FrameBenchmark).
+	// Пути MTL и текстур собираются по правилам VirtualFileSystem
+	static bool Load(const std::string& path, ObjMesh& out, const FileReader& reader = nullptr);
+	// Сферы сабсетов по их вершинам: центр - середина AABB
+	static void ComputeSubsetBounds(ObjMesh& mesh);
 private:
 	static bool LoadMtl(const std::string& mtlPath,
-		std::vector<Material>& materials);
+		std::vector<Material>& materials, const FileReader& reader);
+	static bool ReadText(const std::string& path, const FileReader& reader, std::string& text);
 };
\ No newline at end of file
@@ -0,0 +1,304 @@
+#include "OcclusionBuffer.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <unordered_map>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+
+static const uint32_t kTilesX = OcclusionBuffer::Width / OcclusionBuffer::TileWidth;
+static const uint32_t kTilesY = OcclusionBuffer::Height / OcclusionBuffer::TileHeight;
+// Заслонитель закрывает, только если он ближе на эту долю: треугольники самого объекта,
+// лежащие на грани его AABB, не должны закрывать его из-за округления
+static const float kDepthBias = 1e-3f;
+
+static void ToScreen(const XMFLOAT4& v, float& x, float& y, float& invW)
+{
+	invW = 1.f / v.w;
+	x = (v.x * invW * 0.5f + 0.5f) * OcclusionBuffer::Width;
+	y = (0.5f - v.y * invW * 0.5f) * OcclusionBuffer::Height;
+}
+
+void OcclusionBuffer::Render(FXMMATRIX viewProj, const std::vector<XMFLOAT3>& triangles, JobSystem* jobs)
+{
+	const auto start = std::chrono::steady_clock::now();
+	XMStoreFloat4x4(&m_viewProj, viewProj);
+	m_clip.resize(triangles.size());
+	for (size_t i = 0; i < triangles.size(); ++i) XMStoreFloat4(&m_clip[i], XMVector3Transform(XMLoadFloat3(&triangles[i]), viewProj));
+	Setup(m_clip.data(), m_clip.size());
+
+	auto raster = [this](size_t tile) { RasterizeTile((uint32_t)tile); };
+	if (jobs) jobs->ParallelFor(kTilesX * kTilesY, raster);
+	else for (size_t tile = 0; tile < kTilesX * kTilesY; ++tile) raster(tile);
+	m_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Отсечение ближней плоскостью z >= 0, перевод в пиксели и раскладка по корзинам плиток.
+// Дешевле растеризации, поэтому на вызывающем потоке
+void OcclusionBuffer::Setup(const XMFLOAT4* clip, size_t count)
+{
+	m_triangles.clear();
+	m_bins.resize(kTilesX * kTilesY);
+	for (auto& bin : m_bins) bin.clear();
+
+	for (size_t t = 0; t + 2 < count; t += 3)
+	{
+		// Вершина за ближней плоскостью заменяется точками пересечения ее ребер
+		XMFLOAT4 poly[4];
+		int n = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			const XMFLOAT4& a = clip[t + i];
+			const XMFLOAT4& b = clip[t + (i + 1) % 3];
+			if (a.z >= 0.f) poly[n++] = a;
+			if ((a.z >= 0.f) != (b.z >= 0.f))
+			{
+				const float k = a.z / (a.z - b.z);
+				poly[n++] = XMFLOAT4(a.x + (b.x - a.x) * k, a.y + (b.y - a.y) * k, 0.f, a.w + (b.w - a.w) * k);
+			}
+		}
+		for (int i = 1; i + 1 < n; ++i)
+		{
+			const XMFLOAT4* v[3] = { &poly[0], &poly[i], &poly[i + 1] };
+			float x[3], y[3], d[3];
+			for (int k = 0; k < 3; ++k) ToScreen(*v[k], x[k], y[k], d[k]);
+			const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (fabsf(area) < 1e-6f) continue;
+
+			ScreenTriangle tri;
+			tri.minX = std::max(0, (int)floorf(std::min(x[0], std::min(x[1], x[2]))));
+			tri.maxX = std::min((int)Width - 1, (int)ceilf(std::max(x[0], std::max(x[1], x[2]))));
+			tri.minY = std::max(0, (int)floorf(std::min(y[0], std::min(y[1], y[2]))));
+			tri.maxY = std::min((int)Height - 1, (int)ceilf(std::max(y[0], std::max(y[1], y[2]))));
+			if (tri.minX > tri.maxX || tri.minY > tri.maxY) continue;
+
+			// Ребро i -> j; обход выравнивается знаком площади - грани рисуются с обеих сторон.
+			// Ребра и глубина сдвинуты на полпикселя к худшему углу: значение в центре пикселя
+			// равно значению в самом внешнем (для глубины - самом дальнем) углу его квадрата
+			const float sign = area > 0.f ? 1.f : -1.f;
+			for (int e = 0; e < 3; ++e)
+			{
+				const int j = (e + 1) % 3;
+				tri.edgeA[e] = -(y[j] - y[e]) * sign;
+				tri.edgeB[e] = (x[j] - x[e]) * sign;
+				tri.edgeC[e] = -(tri.edgeA[e] * x[e] + tri.edgeB[e] * y[e]) - 0.5f * (fabsf(tri.edgeA[e]) + fabsf(tri.edgeB[e]));
+			}
+			tri.depthA = ((d[1] - d[0]) * (y[2] - y[0]) - (d[2] - d[0]) * (y[1] - y[0])) / area;
+			tri.depthB = ((d[2] - d[0]) * (x[1] - x[0]) - (d[1] - d[0]) * (x[2] - x[0])) / area;
+			tri.depthC = d[0] - tri.depthA * x[0] - tri.depthB * y[0] - 0.5f * (fabsf(tri.depthA) + fabsf(tri.depthB));
+			tri.minDepth = std::min(d[0], std::min(d[1], d[2]));
+
+			const uint32_t index = (uint32_t)m_triangles.size();
+			m_triangles.push_back(tri);
+			for (int ty = tri.minY / (int)TileHeight; ty <= tri.maxY / (int)TileHeight; ++ty)
+				for (int tx = tri.minX / (int)TileWidth; tx <= tri.maxX / (int)TileWidth; ++tx)
+					m_bins[ty * kTilesX + tx].push_back(index);
+		}
+	}
+}
+
+// Плитку пишет только свой поток. Покрытие внутреннее консервативное: пиксель покрыт, только если
+// весь его квадрат внутри треугольника, и пишется самая дальняя глубина по квадрату. Тогда
+// в каждом записанном пикселе заслонитель не дальше записанного значения
+void OcclusionBuffer::RasterizeTile(uint32_t tile)
+{
+	const int tileX = (int)(tile % kTilesX * TileWidth), tileY = (int)(tile / kTilesX * TileHeight);
+	for (int y = tileY; y < tileY + (int)TileHeight; ++y)
+		std::fill_n(&m_depth[(size_t)y * Width + tileX], TileWidth, 0.f);
+
+	for (uint32_t index : m_bins[tile])
+	{
+		const ScreenTriangle& t = m_triangles[index];
+		// Четверки пикселей выровнены по 4 и не выходят за плитку
+		const int minX = std::max(t.minX, tileX) & ~3, maxX = std::min(t.maxX, tileX + (int)TileWidth - 1);
+		const int minY = std::max(t.minY, tileY), maxY = std::min(t.maxY, tileY + (int)TileHeight - 1);
+		for (int y = minY; y <= maxY; ++y)
+		{
+			float* row = &m_depth[(size_t)y * Width];
+			const float py = y + 0.5f;
+#ifdef OCCLUSION_USE_SSE2
+			const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)minX), offsets);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.edgeA[0]), px), _mm_set1_ps(t.edgeB[0] * py + t.edgeC[0]));
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.edgeA[1]), px), _mm_set1_ps(t.edgeB[1] * py + t.edgeC[1]));
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.edgeA[2]), px), _mm_set1_ps(t.edgeB[2] * py + t.edgeC[2]));
+			__m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.depthA), px), _mm_set1_ps(t.depthB * py + t.depthC));
+			const __m128 minDepth = _mm_set1_ps(t.minDepth);
+			const __m128 step0 = _mm_set1_ps(t.edgeA[0] * 4.f), step1 = _mm_set1_ps(t.edgeA[1] * 4.f);
+			const __m128 step2 = _mm_set1_ps(t.edgeA[2] * 4.f), depthStep = _mm_set1_ps(t.depthA * 4.f);
+			const __m128 zero = _mm_setzero_ps();
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(e0, zero), _mm_cmpgt_ps(e1, zero)), _mm_cmpgt_ps(e2, zero));
+				if (_mm_movemask_ps(inside))
+				{
+					const __m128 old = _mm_loadu_ps(row + x);
+					// Ошибка округления плоскости не уводит глубину дальше самой дальней вершины
+					const __m128 nearer = _mm_max_ps(old, _mm_max_ps(depth, minDepth));
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+				}
+				e0 = _mm_add_ps(e0, step0);
+				e1 = _mm_add_ps(e1, step1);
+				e2 = _mm_add_ps(e2, step2);
+				depth = _mm_add_ps(depth, depthStep);
+			}
+#else
+			for (int x = minX; x <= maxX; ++x)
+			{
+				const float px = x + 0.5f;
+				bool inside = true;
+				for (int e = 0; e < 3 && inside; ++e) inside = t.edgeA[e] * px + t.edgeB[e] * py + t.edgeC[e] > 0.f;
+				if (inside) row[x] = std::max(row[x], std::max(t.depthA * px + t.depthB * py + t.depthC, t.minDepth));
+			}
+#endif
+		}
+	}
+}
+
+bool OcclusionBuffer::IsOccluded(const float sphere[4]) const
+{
+	if (sphere[3] < 0.f) return false;
+	const XMMATRIX viewProj = XMLoadFloat4x4(&m_viewProj);
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearest = 0.f;
+	for (int c = 0; c < 8; ++c)
+	{
+		const XMVECTOR corner = XMVectorSet(sphere[0] + (c & 1 ? sphere[3] : -sphere[3]),
+			sphere[1] + (c & 2 ? sphere[3] : -sphere[3]), sphere[2] + (c & 4 ? sphere[3] : -sphere[3]), 1.f);
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(corner, viewProj));
+		// Угол перед ближней плоскостью: экранный прямоугольник не ограничен
+		if (clip.z < 0.f || clip.w <= 0.f) return false;
+		float x, y, invW;
+		ToScreen(clip, x, y, invW);
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::max(nearest, invW);
+	}
+	// Все пиксели, которых касается прямоугольник; целиком за экраном решает отсечение пирамидой
+	const int x0 = std::max(0, (int)floorf(minX)), x1 = std::min((int)Width - 1, (int)floorf(maxX));
+	const int y0 = std::max(0, (int)floorf(minY)), y1 = std::min((int)Height - 1, (int)floorf(maxY));
+	if (x0 > x1 || y0 > y1) return false;
+	const float limit = nearest * (1.f + kDepthBias);
+
+	for (int y = y0; y <= y1; ++y)
+	{
+		const float* row = &m_depth[(size_t)y * Width];
+#ifdef OCCLUSION_USE_SSE2
+		const __m128 limit4 = _mm_set1_ps(limit);
+		const __m128 first = _mm_set1_ps((float)x0), last = _mm_set1_ps((float)x1);
+		for (int x = x0 & ~3; x <= x1; x += 4)
+		{
+			const __m128 lanes = _mm_add_ps(_mm_set1_ps((float)x), _mm_setr_ps(0.f, 1.f, 2.f, 3.f));
+			const __m128 inRect = _mm_and_ps(_mm_cmpge_ps(lanes, first), _mm_cmple_ps(lanes, last));
+			if (_mm_movemask_ps(_mm_and_ps(inRect, _mm_cmple_ps(_mm_loadu_ps(row + x), limit4)))) return false;
+		}
+#else
+		for (int x = x0; x <= x1; ++x)
+			if (row[x] <= limit) return false;
+#endif
+	}
+	return true;
+}
+
+std::vector<XMFLOAT3> SelectOccluders(const ObjMesh& mesh, size_t maxTriangles)
+{
+	// Треугольник сабсета (номер первого индекса) и его копия; площадь у копий одна
+	struct Candidate
+	{
+		float area;
+		uint32_t index;
+		uint32_t copy;
+	};
+	std::vector<Candidate> candidates;
+	for (const MeshSubset& sub : mesh.subsets)
+	{
+		const uint32_t copies = sub.instanceCount ? sub.instanceCount : 1;
+		for (uint32_t i = sub.indexStart; i + 2 < sub.indexStart + sub.indexCount; i += 3)
+		{
+			const XMVECTOR p0 = XMLoadFloat3(&mesh.vertices[mesh.indices[i]].Position);
+			const XMVECTOR p1 = XMLoadFloat3(&mesh.vertices[mesh.indices[i + 1]].Position);
+			const XMVECTOR p2 = XMLoadFloat3(&mesh.vertices[mesh.indices[i + 2]].Position);
+			const float area = 0.5f * XMVectorGetX(XMVector3Length(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0))));
+			for (uint32_t c = 0; c < copies; ++c)
+				candidates.push_back({ area, i, sub.instanceCount ? sub.instanceStart + c : UINT32_MAX });
+		}
+	}
+	if (candidates.size() > maxTriangles)
+	{
+		std::nth_element(candidates.begin(), candidates.begin() + maxTriangles, candidates.end(),
+			[](const Candidate& a, const Candidate& b) { return a.area > b.area; });
+		candidates.resize(maxTriangles);
+	}
+	// Порядок не зависит от nth_element
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+		return a.index != b.index ? a.index < b.index : a.copy < b.copy; });
+
+	std::vector<XMFLOAT3> triangles;
+	triangles.reserve(candidates.size() * 3);
+	for (const Candidate& c : candidates)
+	{
+		const XMMATRIX world = c.copy == UINT32_MAX ? XMMatrixIdentity() : XMLoadFloat4x4(&mesh.instances[c.copy]);
+		for (uint32_t k = 0; k < 3; ++k)
+		{
+			XMFLOAT3 p;
+			XMStoreFloat3(&p, XMVector3Transform(XMLoadFloat3(&mesh.vertices[mesh.indices[c.index + k]].Position), world));
+			triangles.push_back(p);
+		}
+	}
+	return triangles;
+}
+
+void SplitSubsetsByCell(ObjMesh& mesh, float cellSize)
+{
+	if (cellSize <= 0.f) return;
+	std::vector<uint32_t> indices;
+	std::vector<MeshSubset> subsets;
+	indices.reserve(mesh.indices.size());
+	for (const MeshSubset& sub : mesh.subsets)
+	{
+		if (sub.instanceCount || sub.indexCount < 3)
+		{
+			MeshSubset kept = sub;
+			kept.indexStart = (uint32_t)indices.size();
+			indices.insert(indices.end(), mesh.indices.begin() + sub.indexStart, mesh.indices.begin() + sub.indexStart + sub.indexCount);
+			subsets.push_back(kept);
+			continue;
+		}
+		// Ячейки в порядке первого треугольника
+		std::unordered_map<uint64_t, uint32_t> cellIndex;
+		std::vector<std::vector<uint32_t>> cells;
+		for (uint32_t i = sub.indexStart; i + 2 < sub.indexStart + sub.indexCount; i += 3)
+		{
+			XMFLOAT3 center;
+			XMStoreFloat3(&center, XMVectorScale(XMVectorAdd(XMVectorAdd(
+				XMLoadFloat3(&mesh.vertices[mesh.indices[i]].Position), XMLoadFloat3(&mesh.vertices[mesh.indices[i + 1]].Position)),
+				XMLoadFloat3(&mesh.vertices[mesh.indices[i + 2]].Position)), 1.f / 3.f));
+			const uint64_t cx = (uint64_t)((int64_t)floorf(center.x / cellSize) & 0x1fffff);
+			const uint64_t cy = (uint64_t)((int64_t)floorf(center.y / cellSize) & 0x1fffff);
+			const uint64_t cz = (uint64_t)((int64_t)floorf(center.z / cellSize) & 0x1fffff);
+			auto it = cellIndex.emplace(cx << 42 | cy << 21 | cz, (uint32_t)cells.size());
+			if (it.second) cells.emplace_back();
+			cells[it.first->second].push_back(i);
+		}
+		for (const std::vector<uint32_t>& cell : cells)
+		{
+			MeshSubset part = sub;
+			part.indexStart = (uint32_t)indices.size();
+			for (uint32_t i : cell) indices.insert(indices.end(), mesh.indices.begin() + i, mesh.indices.begin() + i + 3);
+			part.indexCount = (uint32_t)indices.size() - part.indexStart;
+			subsets.push_back(part);
+		}
+	}
+	mesh.indices.swap(indices);
+	mesh.subsets.swap(subsets);
+	ObjLoader::ComputeSubsetBounds(mesh);
+}
\ No newline at end of file
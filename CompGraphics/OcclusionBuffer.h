@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "OBJLoader.h"
+
+class JobSystem;
+
+// Программное отсечение перекрытых объектов. Крупные треугольники сцены (упрощенные
+// заслонители) растеризуются в маленький буфер глубины на CPU, по плиткам на потоках
+// JobSystem, четыре пикселя строки за раз (SSE2). Глубина - 1/w: линейна в экранных
+// координатах, точнее z/w вдали и не требует дальней плоскости. Буфер пуст (0) - ничего нет.
+// Заслонитель пишет только пиксели, которые покрывает целиком, и самую дальнюю глубину по пикселю.
+// Сфера отрисовки закрыта, если во всех пикселях ее экранного прямоугольника заслонитель
+// ближе ближайшего угла ее AABB. Ошибка возможна только в сторону "видимо".
+// Без D3D; IsOccluded можно звать с нескольких потоков после Render.
+class OcclusionBuffer
+{
+public:
+	static const uint32_t Width = 256;
+	static const uint32_t Height = 128;
+	static const uint32_t TileWidth = 64;
+	static const uint32_t TileHeight = 32;
+
+	// triangles - тройки вершин в мировом пространстве; обе стороны (PSO без отсечения граней)
+	void Render(DirectX::FXMMATRIX viewProj, const std::vector<DirectX::XMFLOAT3>& triangles, JobSystem* jobs);
+	// sphere - центр и радиус как в RetainedDrawList; радиус < 0 - всегда видима
+	bool IsOccluded(const float sphere[4]) const;
+
+	const float* GetDepth() const { return m_depth.data(); }
+	// Треугольники после отсечения ближней плоскостью и вырожденных, время последнего Render
+	uint32_t GetRasterizedCount() const { return (uint32_t)m_triangles.size(); }
+	double GetRenderMilliseconds() const { return m_milliseconds; }
+
+private:
+	// Треугольник в пикселях: ребра e = a x + b y + c (весь пиксель внутри - все три > 0 в его
+	// центре) и плоскость 1/w (в центре - самая дальняя по пикселю)
+	struct ScreenTriangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC;
+		float minDepth;
+		int minX, maxX, minY, maxY;
+	};
+
+	void Setup(const DirectX::XMFLOAT4* clip, size_t count);
+	void RasterizeTile(uint32_t tile);
+
+	DirectX::XMFLOAT4X4 m_viewProj = {};
+	std::vector<DirectX::XMFLOAT4> m_clip;
+	std::vector<float> m_depth = std::vector<float>(Width * Height, 0.f);
+	std::vector<ScreenTriangle> m_triangles;
+	std::vector<std::vector<uint32_t>> m_bins;
+	double m_milliseconds = 0.0;
+};
+
+// Заслонители сцены: самые крупные треугольники (не больше maxTriangles), копии сабсетов
+// переведены своими матрицами в пространство модели
+std::vector<DirectX::XMFLOAT3> SelectOccluders(const ObjMesh& mesh, size_t maxTriangles);
+// Сабсеты без копий режутся по ячейкам сетки cellSize (по центрам треугольников): сабсет на
+// весь атриум не закрывается ничем, а куски стен и галерей - закрываются. Сферы пересчитываются
+void SplitSubsetsByCell(ObjMesh& mesh, float cellSize);
\ No newline at end of file
@@ -0,0 +1,528 @@
+#include "PotentiallyVisibleSet.h"
+#include "OcclusionBuffer.h"
+#include "FlyCamera.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+using namespace DirectX;
+
+#pragma pack(push, 1)
+struct PvsHeader
+{
+	char magic[4];
+	uint32_t version;
+	float origin[3];
+	float cellSize;
+	uint32_t dims[3];
+	uint32_t block;
+	uint32_t clusters;
+	uint64_t fingerprint;
+	uint32_t sets;
+	uint32_t indexBytes;
+	uint32_t dataSize;
+};
+#pragma pack(pop)
+
+static const uint32_t kVersion = 2;
+// Ребро блока в ячейках
+static const uint32_t kBlock = 4;
+// Больше ячеек сетка не получает: размер ячейки растет
+static const uint32_t kMaxCells = 1u << 18;
+static const float kNearPlane = 1.0f;
+static const float kFarPlane = 100000.0f;
+
+uint32_t CountClusters(const ObjMesh& mesh)
+{
+	uint32_t count = 0;
+	for (const MeshSubset& sub : mesh.subsets) count += sub.instanceCount ? sub.instanceCount : 1;
+	return count;
+}
+
+// Как AddMeshDraws для блока с единичной матрицей
+std::vector<float> ClusterSpheres(const ObjMesh& mesh)
+{
+	std::vector<float> spheres;
+	spheres.reserve(CountClusters(mesh) * 4);
+	for (const MeshSubset& sub : mesh.subsets)
+	{
+		if (!sub.instanceCount)
+		{
+			spheres.insert(spheres.end(), { sub.center.x, sub.center.y, sub.center.z, sub.radius });
+			continue;
+		}
+		for (uint32_t c = 0; c < sub.instanceCount; ++c)
+		{
+			const XMMATRIX w = XMLoadFloat4x4(&mesh.instances[sub.instanceStart + c]);
+			const float scale = std::max(XMVectorGetX(XMVector3Length(w.r[0])),
+				std::max(XMVectorGetX(XMVector3Length(w.r[1])), XMVectorGetX(XMVector3Length(w.r[2]))));
+			XMFLOAT3 center;
+			XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&sub.center), w));
+			spheres.insert(spheres.end(), { center.x, center.y, center.z, sub.radius * scale });
+		}
+	}
+	return spheres;
+}
+
+uint64_t PotentiallyVisibleSet::Fingerprint(const ObjMesh& mesh)
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](uint32_t value) {
+		for (int i = 0; i < 4; ++i, value >>= 8) hash = (hash ^ (value & 0xff)) * 1099511628211ull;
+		};
+	mix((uint32_t)mesh.subsets.size());
+	mix((uint32_t)mesh.instances.size());
+	for (const MeshSubset& sub : mesh.subsets)
+	{
+		mix(sub.indexStart);
+		mix(sub.indexCount);
+		mix((uint32_t)sub.materialIdx);
+		mix(sub.instanceCount);
+	}
+	// Сдвинутая или измененная геометрия при тех же диапазонах - другой набор. Сферы
+	// округляются до 1/8 единицы, чтобы разница в последних битах между сборками не мешала
+	for (float v : ClusterSpheres(mesh)) mix((uint32_t)(int32_t)lroundf(v * 8.0f));
+	return hash;
+}
+
+// Поле - байт способа и данные: 0 - байты как есть, 1 - байты 0x00 и 0xff с длиной своей
+// серии (1..255), остальные как есть. Серии выбираются, только если так короче
+static void EncodeRuns(const std::vector<uint8_t>& bits, std::vector<uint8_t>& out)
+{
+	const size_t start = out.size();
+	out.push_back(1);
+	for (size_t i = 0; i < bits.size();)
+	{
+		const uint8_t value = bits[i];
+		if (value != 0x00 && value != 0xff)
+		{
+			out.push_back(bits[i++]);
+			continue;
+		}
+		size_t run = 0;
+		while (i + run < bits.size() && run < 255 && bits[i + run] == value) ++run;
+		out.push_back(value);
+		out.push_back((uint8_t)run);
+		i += run;
+	}
+	if (out.size() - start - 1 >= bits.size())
+	{
+		out.resize(start);
+		out.push_back(0);
+		out.insert(out.end(), bits.begin(), bits.end());
+	}
+}
+
+static void DecodeRuns(const uint8_t* data, size_t size, std::vector<uint8_t>& bits)
+{
+	if (size == 0) return;
+	if (data[0] == 0)
+	{
+		memcpy(bits.data(), data + 1, std::min(size - 1, bits.size()));
+		return;
+	}
+	size_t o = 0;
+	for (size_t i = 1; i < size && o < bits.size(); ++i)
+	{
+		const uint8_t value = data[i];
+		if (value != 0x00 && value != 0xff)
+		{
+			bits[o++] = value;
+			continue;
+		}
+		const size_t run = i + 1 < size ? data[++i] : 0;
+		for (size_t r = 0; r < run && o < bits.size(); ++r) bits[o++] = value;
+	}
+}
+
+// Код Мортона 10-битных координат: близкие кластеры - близкие биты
+static uint32_t Morton(uint32_t x, uint32_t y, uint32_t z)
+{
+	uint32_t code = 0;
+	for (uint32_t b = 0; b < 10; ++b)
+		code |= ((x >> b & 1) << (3 * b)) | ((y >> b & 1) << (3 * b + 1)) | ((z >> b & 1) << (3 * b + 2));
+	return code;
+}
+
+static float Halton(uint32_t index, uint32_t base)
+{
+	float result = 0.f, fraction = 1.f;
+	for (; index; index /= base)
+	{
+		fraction /= base;
+		result += fraction * (index % base);
+	}
+	return result;
+}
+
+static uint32_t BlockDim(uint32_t cells)
+{
+	return (cells + kBlock - 1) / kBlock;
+}
+
+static bool InFrustum(const float planes[6][4], const float* s)
+{
+	for (int p = 0; p < 6; ++p)
+		if (planes[p][0] * s[0] + planes[p][1] * s[1] + planes[p][2] * s[2] + planes[p][3] < -s[3]) return false;
+	return true;
+}
+
+PotentiallyVisibleSet::BakeReport PotentiallyVisibleSet::Bake(const ObjMesh& mesh, const BakeOptions& options, JobSystem* jobs)
+{
+	const auto start = std::chrono::steady_clock::now();
+	Clear();
+	BakeReport report;
+	const std::vector<float> spheres = ClusterSpheres(mesh);
+	const uint32_t clusters = (uint32_t)(spheres.size() / 4);
+	if (clusters == 0 || options.cellSize <= 0.f) return report;
+
+	// Объем - вершины сабсетов без копий и сферы копий
+	XMVECTOR lo = XMVectorReplicate(FLT_MAX), hi = XMVectorReplicate(-FLT_MAX);
+	uint32_t cluster = 0;
+	for (const MeshSubset& sub : mesh.subsets)
+	{
+		if (sub.instanceCount)
+		{
+			for (uint32_t c = 0; c < sub.instanceCount; ++c, ++cluster)
+			{
+				const float* s = &spheres[(size_t)cluster * 4];
+				lo = XMVectorMin(lo, XMVectorSet(s[0] - s[3], s[1] - s[3], s[2] - s[3], 0.f));
+				hi = XMVectorMax(hi, XMVectorSet(s[0] + s[3], s[1] + s[3], s[2] + s[3], 0.f));
+			}
+			continue;
+		}
+		for (uint32_t i = sub.indexStart; i < sub.indexStart + sub.indexCount; ++i)
+		{
+			const XMVECTOR p = XMLoadFloat3(&mesh.vertices[mesh.indices[i]].Position);
+			lo = XMVectorMin(lo, p);
+			hi = XMVectorMax(hi, p);
+		}
+		++cluster;
+	}
+	XMFLOAT3 extent;
+	XMStoreFloat3(&m_origin, lo);
+	XMStoreFloat3(&extent, XMVectorMax(XMVectorSubtract(hi, lo), XMVectorZero()));
+	m_cellSize = options.cellSize;
+	for (;;)
+	{
+		m_dims[0] = std::max(1u, (uint32_t)ceilf(extent.x / m_cellSize));
+		m_dims[1] = std::max(1u, (uint32_t)ceilf(extent.y / m_cellSize));
+		m_dims[2] = std::max(1u, (uint32_t)ceilf(extent.z / m_cellSize));
+		if ((uint64_t)m_dims[0] * m_dims[1] * m_dims[2] <= kMaxCells) break;
+		m_cellSize *= 1.25f;
+	}
+	const uint32_t cells = GetCellCount();
+	const size_t setBytes = (clusters + 7) / 8;
+	// Поля хранятся в порядке кривой Мортона по центрам кластеров: соседние по сцене кластеры
+	// видны вместе, и серии 0x00 и 0xff становятся длинными. position[c] - место кластера
+	std::vector<uint32_t> codes(clusters), position(clusters);
+	for (uint32_t c = 0; c < clusters; ++c)
+	{
+		const float* s = &spheres[(size_t)c * 4];
+		auto grid = [](float v, float lo, float size) { return (uint32_t)std::min(1023.f, std::max(0.f, (v - lo) / std::max(size, 1e-3f) * 1024.f)); };
+		codes[c] = Morton(grid(s[0], m_origin.x, extent.x), grid(s[1], m_origin.y, extent.y), grid(s[2], m_origin.z, extent.z));
+	}
+	m_order.resize(clusters);
+	for (uint32_t c = 0; c < clusters; ++c) m_order[c] = c;
+	std::stable_sort(m_order.begin(), m_order.end(), [&](uint32_t a, uint32_t b) { return codes[a] < codes[b]; });
+	for (uint32_t i = 0; i < clusters; ++i) position[m_order[i]] = i;
+	const std::vector<XMFLOAT3> occluders = SelectOccluders(mesh, options.occluderTriangles);
+	const uint32_t samples = std::max(1u, options.samplesPerCell);
+
+	static const XMFLOAT3 kFaces[6][2] = {
+		{ { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } }, { { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } },
+		{ { 0.f, 1.f, 0.f }, { 0.f, 0.f, 1.f } }, { { 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f } },
+		{ { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f } }, { { 0.f, 0.f, -1.f }, { 0.f, 1.f, 0.f } } };
+	const XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.f, kNearPlane, kFarPlane);
+
+	std::vector<std::vector<uint8_t>> cellBits(cells);
+	auto bakeCell = [&](size_t cell) {
+		OcclusionBuffer buffer;
+		std::vector<uint8_t>& bits = cellBits[cell];
+		bits.assign(setBytes, 0);
+		std::vector<uint32_t> hidden(clusters);
+		for (uint32_t c = 0; c < clusters; ++c) hidden[c] = c;
+
+		// Точки - последовательность Халтона, одна и та же во всех ячейках: у ячеек открытого
+		// пространства выходят одинаковые наборы, а не наборы со своим шумом выборки
+		const uint32_t ix = (uint32_t)(cell % m_dims[0]), iy = (uint32_t)(cell / m_dims[0] % m_dims[1]);
+		const uint32_t iz = (uint32_t)(cell / m_dims[0] / m_dims[1]);
+		for (uint32_t s = 0; s < samples && !hidden.empty(); ++s)
+		{
+			const XMVECTOR eye = XMVectorSet(m_origin.x + (ix + Halton(s + 1, 2)) * m_cellSize,
+				m_origin.y + (iy + Halton(s + 1, 3)) * m_cellSize, m_origin.z + (iz + Halton(s + 1, 5)) * m_cellSize, 1.f);
+			for (int f = 0; f < 6 && !hidden.empty(); ++f)
+			{
+				const XMMATRIX viewProj = XMMatrixLookToLH(eye, XMLoadFloat3(&kFaces[f][0]), XMLoadFloat3(&kFaces[f][1])) * proj;
+				float planes[6][4];
+				FlyCamera::ExtractFrustum(viewProj, planes);
+				buffer.Render(viewProj, occluders, nullptr);
+				size_t kept = 0;
+				for (uint32_t c : hidden)
+				{
+					const float* sphere = &spheres[(size_t)c * 4];
+					if (InFrustum(planes, sphere) && !buffer.IsOccluded(sphere)) bits[position[c] >> 3] |= (uint8_t)(1u << (position[c] & 7));
+					else hidden[kept++] = c;
+				}
+				hidden.resize(kept);
+			}
+		}
+		};
+	if (jobs) jobs->ParallelFor(cells, bakeCell);
+	else for (size_t cell = 0; cell < cells; ++cell) bakeCell(cell);
+
+	// Одинаковые поля (пустые отличия, закрытые помещения) - один раз
+	std::map<std::vector<uint8_t>, uint32_t> sets;
+	m_offsets.assign(1, 0);
+	auto addSet = [&](const std::vector<uint8_t>& bits) {
+		auto it = sets.emplace(bits, (uint32_t)sets.size());
+		if (it.second)
+		{
+			EncodeRuns(bits, m_data);
+			m_offsets.push_back((uint32_t)m_data.size());
+		}
+		return it.first->second;
+		};
+	const uint32_t blocksX = BlockDim(m_dims[0]), blocksY = BlockDim(m_dims[1]), blocksZ = BlockDim(m_dims[2]);
+	std::vector<std::vector<uint8_t>> blockBits((size_t)blocksX * blocksY * blocksZ, std::vector<uint8_t>(setBytes, 0));
+	auto blockOf = [&](uint32_t cell) {
+		const uint32_t x = cell % m_dims[0], y = cell / m_dims[0] % m_dims[1], z = cell / m_dims[0] / m_dims[1];
+		return ((z / kBlock) * blocksY + y / kBlock) * blocksX + x / kBlock;
+		};
+	uint64_t visible = 0;
+	for (uint32_t cell = 0; cell < cells; ++cell)
+	{
+		std::vector<uint8_t>& block = blockBits[blockOf(cell)];
+		for (size_t i = 0; i < setBytes; ++i)
+		{
+			block[i] |= cellBits[cell][i];
+			for (uint8_t b = cellBits[cell][i]; b; b &= b - 1) ++visible;
+		}
+	}
+	m_blockSets.resize(blockBits.size());
+	for (size_t b = 0; b < blockBits.size(); ++b) m_blockSets[b] = addSet(blockBits[b]);
+	m_cellSets.resize(cells);
+	std::vector<uint8_t> delta(setBytes);
+	for (uint32_t cell = 0; cell < cells; ++cell)
+	{
+		const std::vector<uint8_t>& block = blockBits[blockOf(cell)];
+		for (size_t i = 0; i < setBytes; ++i) delta[i] = block[i] & (uint8_t)~cellBits[cell][i];
+		m_cellSets[cell] = addSet(delta);
+	}
+	m_clusters = clusters;
+	m_fingerprint = Fingerprint(mesh);
+	m_bits.assign(setBytes, 0xff);
+	m_packed.assign(setBytes, 0);
+	m_delta.assign(setBytes, 0);
+
+	std::vector<uint8_t> serialized;
+	Serialize(serialized);
+	memcpy(report.dims, m_dims, sizeof(m_dims));
+	report.cellSize = m_cellSize;
+	report.cells = cells;
+	report.clusters = clusters;
+	report.uniqueSets = (uint32_t)sets.size();
+	report.rawBytes = (size_t)cells * setBytes;
+	report.bytes = serialized.size();
+	report.visibleFraction = (double)visible / ((double)cells * clusters);
+	report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return report;
+}
+
+// Номера полей - по 2 байта, если полей не больше 65536
+static void WriteIndices(const std::vector<uint32_t>& indices, uint32_t indexBytes, uint8_t*& p)
+{
+	for (uint32_t index : indices)
+	{
+		if (indexBytes == 2)
+		{
+			const uint16_t value = (uint16_t)index;
+			memcpy(p, &value, 2);
+		}
+		else memcpy(p, &index, 4);
+		p += indexBytes;
+	}
+}
+
+static bool ReadIndices(std::vector<uint32_t>& indices, uint32_t indexBytes, uint32_t limit, const uint8_t*& p)
+{
+	for (uint32_t& index : indices)
+	{
+		if (indexBytes == 2)
+		{
+			uint16_t value;
+			memcpy(&value, p, 2);
+			index = value;
+		}
+		else memcpy(&index, p, 4);
+		p += indexBytes;
+		if (index >= limit) return false;
+	}
+	return true;
+}
+
+// Длина поля EncodeRuns, распаковывающегося ровно в setBytes байт; 0 - поле испорчено
+static size_t FieldSize(const uint8_t* data, size_t size, size_t setBytes)
+{
+	if (size == 0) return 0;
+	if (data[0] == 0) return size > setBytes ? setBytes + 1 : 0;
+	size_t i = 1, o = 0;
+	while (o < setBytes)
+	{
+		if (i >= size) return 0;
+		if (data[i] != 0x00 && data[i] != 0xff)
+		{
+			++i;
+			++o;
+			continue;
+		}
+		if (i + 1 >= size || data[i + 1] == 0) return 0;
+		o += data[i + 1];
+		i += 2;
+	}
+	return o == setBytes ? i : 0;
+}
+
+void PotentiallyVisibleSet::Serialize(std::vector<uint8_t>& out) const
+{
+	PvsHeader header = {};
+	memcpy(header.magic, "PVS1", 4);
+	header.version = kVersion;
+	header.origin[0] = m_origin.x;
+	header.origin[1] = m_origin.y;
+	header.origin[2] = m_origin.z;
+	header.cellSize = m_cellSize;
+	memcpy(header.dims, m_dims, sizeof(m_dims));
+	header.block = kBlock;
+	header.clusters = m_clusters;
+	header.fingerprint = m_fingerprint;
+	header.sets = m_offsets.empty() ? 0 : (uint32_t)m_offsets.size() - 1;
+	header.indexBytes = header.sets <= 65536 ? 2 : 4;
+	header.dataSize = (uint32_t)m_data.size();
+
+	// Смещения полей не хранятся: поле само знает свою длину, Load их восстанавливает
+	out.resize(sizeof(header) + m_order.size() * 4 + (m_blockSets.size() + m_cellSets.size()) * header.indexBytes + m_data.size());
+	uint8_t* p = out.data();
+	memcpy(p, &header, sizeof(header));
+	p += sizeof(header);
+	if (!m_order.empty()) memcpy(p, m_order.data(), m_order.size() * 4);
+	p += m_order.size() * 4;
+	WriteIndices(m_blockSets, header.indexBytes, p);
+	WriteIndices(m_cellSets, header.indexBytes, p);
+	if (!m_data.empty()) memcpy(p, m_data.data(), m_data.size());
+}
+
+bool PotentiallyVisibleSet::Load(const uint8_t* data, size_t size)
+{
+	Clear();
+	PvsHeader header;
+	if (size < sizeof(header)) return false;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, "PVS1", 4) != 0 || header.version != kVersion || header.cellSize <= 0.f ||
+		header.block != kBlock || (header.indexBytes != 2 && header.indexBytes != 4) || header.clusters == 0) return false;
+	const uint64_t cells = (uint64_t)header.dims[0] * header.dims[1] * header.dims[2];
+	if (cells == 0 || cells > kMaxCells) return false;
+	const uint64_t blocks = (uint64_t)BlockDim(header.dims[0]) * BlockDim(header.dims[1]) * BlockDim(header.dims[2]);
+	if (size != sizeof(header) + (uint64_t)header.clusters * 4 + (blocks + cells) * header.indexBytes + header.dataSize) return false;
+
+	const uint8_t* p = data + sizeof(header);
+	std::vector<uint32_t> order(header.clusters), blockSets((size_t)blocks), cellSets((size_t)cells);
+	memcpy(order.data(), p, order.size() * 4);
+	p += order.size() * 4;
+	// Перестановка кластеров: повтор вытеснил бы другой кластер, и он остался бы отсеченным
+	std::vector<bool> seen(header.clusters, false);
+	for (uint32_t cluster : order)
+	{
+		if (cluster >= header.clusters || seen[cluster]) return false;
+		seen[cluster] = true;
+	}
+	if (!ReadIndices(blockSets, header.indexBytes, header.sets, p) || !ReadIndices(cellSets, header.indexBytes, header.sets, p)) return false;
+
+	const size_t setBytes = (header.clusters + 7) / 8;
+	std::vector<uint32_t> offsets(1, 0);
+	offsets.reserve((size_t)header.sets + 1);
+	for (uint32_t s = 0; s < header.sets; ++s)
+	{
+		const size_t field = FieldSize(p + offsets.back(), header.dataSize - offsets.back(), setBytes);
+		if (field == 0) return false;
+		offsets.push_back(offsets.back() + (uint32_t)field);
+	}
+	if (offsets.back() != header.dataSize) return false;
+
+	m_origin = XMFLOAT3(header.origin[0], header.origin[1], header.origin[2]);
+	m_cellSize = header.cellSize;
+	memcpy(m_dims, header.dims, sizeof(m_dims));
+	m_fingerprint = header.fingerprint;
+	m_order.swap(order);
+	m_blockSets.swap(blockSets);
+	m_cellSets.swap(cellSets);
+	m_offsets.swap(offsets);
+	m_data.assign(p, p + header.dataSize);
+	m_clusters = header.clusters;
+	m_bits.assign(setBytes, 0xff);
+	m_packed.assign(setBytes, 0);
+	m_delta.assign(setBytes, 0);
+	return true;
+}
+
+void PotentiallyVisibleSet::Clear()
+{
+	m_origin = XMFLOAT3(0.f, 0.f, 0.f);
+	m_cellSize = 0.f;
+	m_dims[0] = m_dims[1] = m_dims[2] = 0;
+	m_clusters = 0;
+	m_fingerprint = 0;
+	m_order.clear();
+	m_blockSets.clear();
+	m_cellSets.clear();
+	m_offsets.clear();
+	m_data.clear();
+	m_selected = UINT64_MAX;
+	m_bits.clear();
+	m_packed.clear();
+	m_delta.clear();
+}
+
+bool PotentiallyVisibleSet::SelectCell(const XMFLOAT3& eye)
+{
+	if (IsEmpty()) return false;
+	const float fx = (eye.x - m_origin.x) / m_cellSize;
+	const float fy = (eye.y - m_origin.y) / m_cellSize;
+	const float fz = (eye.z - m_origin.z) / m_cellSize;
+	if (!(fx >= 0.f && fy >= 0.f && fz >= 0.f && fx < m_dims[0] && fy < m_dims[1] && fz < m_dims[2]))
+	{
+		if (m_selected != UINT64_MAX) std::fill(m_bits.begin(), m_bits.end(), (uint8_t)0xff);
+		m_selected = UINT64_MAX;
+		return false;
+	}
+	const uint32_t x = (uint32_t)fx, y = (uint32_t)fy, z = (uint32_t)fz;
+	const uint32_t blockSet = m_blockSets[((z / kBlock) * BlockDim(m_dims[1]) + y / kBlock) * BlockDim(m_dims[0]) + x / kBlock];
+	const uint32_t cellSet = m_cellSets[(z * m_dims[1] + y) * m_dims[0] + x];
+	const uint64_t selected = (uint64_t)blockSet << 32 | cellSet;
+	if (selected != m_selected)
+	{
+		DecodeRuns(&m_data[0] + m_offsets[blockSet], m_offsets[blockSet + 1] - m_offsets[blockSet], m_packed);
+		DecodeRuns(&m_data[0] + m_offsets[cellSet], m_offsets[cellSet + 1] - m_offsets[cellSet], m_delta);
+		std::fill(m_bits.begin(), m_bits.end(), (uint8_t)0);
+		for (uint32_t i = 0; i < m_clusters; ++i)
+		{
+			const uint32_t cluster = m_order[i];
+			if (m_packed[i >> 3] & ~m_delta[i >> 3] & (1u << (i & 7))) m_bits[cluster >> 3] |= (uint8_t)(1u << (cluster & 7));
+		}
+		m_selected = selected;
+	}
+	return true;
+}
+
+std::string PvsPathFor(const std::string& objPath)
+{
+	const size_t slash = objPath.find_last_of("/\\");
+	const size_t dot = objPath.find_last_of('.');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return objPath + ".pvs";
+	return objPath.substr(0, dot) + ".pvs";
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include "OBJLoader.h"
+
+class JobSystem;
+
+// Кластер - один экземпляр сабсета сцены: сабсеты по порядку, у сабсета с копиями - по
+// кластеру на копию. Сферы в пространстве модели (сцена рисуется с единичной матрицей)
+uint32_t CountClusters(const ObjMesh& mesh);
+std::vector<float> ClusterSpheres(const ObjMesh& mesh);
+
+// Заранее посчитанная видимость статической сцены. Объем сцены делится на ячейки сетки,
+// из нескольких точек каждой ячейки по шести граням куба растеризуются крупные треугольники
+// (OcclusionBuffer), и кластер видим из ячейки, если его сфера не закрыта хотя бы с одной
+// точки. Набор ячейки - битовое поле кластеров в порядке кривой Мортона. Соседние ячейки
+// видят почти одно и то же, поэтому блок 4x4x4 ячеек хранит объединение их наборов, а ячейка -
+// только кластеры блока, которых она не видит; одинаковые поля хранятся один раз, каждое
+// сжато кодированием серий байтов 0x00 и 0xff. Выборка точек, а не консервативная оценка: щель между точками может
+// спрятать кластер.
+// Ячейка камеры находится арифметикой, ее набор распаковывается при смене набора.
+// Без D3D; IsVisible можно звать с нескольких потоков после SelectCell.
+class PotentiallyVisibleSet
+{
+public:
+	struct BakeOptions
+	{
+		float cellSize = 250.f;
+		// Точки в ячейке, заслонителей - самых крупных треугольников
+		uint32_t samplesPerCell = 4;
+		size_t occluderTriangles = 65536;
+	};
+
+	struct BakeReport
+	{
+		// Сетка; размер ячейки больше заказанного, если ячеек вышло слишком много
+		uint32_t dims[3] = { 0, 0, 0 };
+		float cellSize = 0.f;
+		uint32_t cells = 0;
+		uint32_t clusters = 0;
+		uint32_t uniqueSets = 0;
+		// Наборы без сжатия и данные файла целиком
+		size_t rawBytes = 0;
+		size_t bytes = 0;
+		// Доля видимых кластеров, средняя по ячейкам
+		double visibleFraction = 0.0;
+		double milliseconds = 0.0;
+	};
+
+	// jobs == nullptr - все ячейки на вызывающем потоке; результат от числа потоков не зависит
+	BakeReport Bake(const ObjMesh& mesh, const BakeOptions& options, JobSystem* jobs);
+
+	void Serialize(std::vector<uint8_t>& out) const;
+	// false - не тот формат; набор остается пустым
+	bool Load(const uint8_t* data, size_t size);
+	void Clear();
+	bool IsEmpty() const { return m_clusters == 0; }
+
+	// Сабсеты, копии и сферы кластеров: набор от другого или измененного меша не применяется
+	static uint64_t Fingerprint(const ObjMesh& mesh);
+	uint64_t GetFingerprint() const { return m_fingerprint; }
+
+	// Набор для ячейки точки; false - точка вне сетки или набор пуст, видно все
+	bool SelectCell(const DirectX::XMFLOAT3& eye);
+	// По последнему SelectCell; кластер вне набора (UINT32_MAX - не кластер) видим
+	bool IsVisible(uint32_t cluster) const
+	{
+		return cluster >= m_clusters || (m_bits[cluster >> 3] >> (cluster & 7) & 1) != 0;
+	}
+
+	uint32_t GetClusterCount() const { return m_clusters; }
+	uint32_t GetCellCount() const { return m_dims[0] * m_dims[1] * m_dims[2]; }
+
+private:
+	DirectX::XMFLOAT3 m_origin = { 0.f, 0.f, 0.f };
+	float m_cellSize = 0.f;
+	uint32_t m_dims[3] = { 0, 0, 0 };
+	uint32_t m_clusters = 0;
+	uint64_t m_fingerprint = 0;
+	// Место в поле -> кластер
+	std::vector<uint32_t> m_order;
+	// Блок -> поле объединения, ячейка -> поле отличий, поле -> [m_offsets[s], m_offsets[s + 1])
+	// в m_data
+	std::vector<uint32_t> m_blockSets;
+	std::vector<uint32_t> m_cellSets;
+	std::vector<uint32_t> m_offsets;
+	std::vector<uint8_t> m_data;
+	// Распакованный набор по номерам кластеров: поля блока и ячейки, UINT64_MAX - видно все
+	uint64_t m_selected = UINT64_MAX;
+	std::vector<uint8_t> m_bits;
+	std::vector<uint8_t> m_packed;
+	std::vector<uint8_t> m_delta;
+};
+
+// sponza.obj -> sponza.pvs
+std::string PvsPathFor(const std::string& objPath);
\ No newline at end of file
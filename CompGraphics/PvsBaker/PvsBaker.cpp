@@ -0,0 +1,86 @@
+// PvsBaker - офлайн-расчет PotentiallyVisibleSet для статической сцены.
+//
+//   PvsBaker [-o sponza.pvs] [-cell 250] [-samples 4] [-occluders 65536] [-threads N] sponza.obj
+//       Готовит меш так же, как RenderingSystem::LoadSceneMesh (повторы - экземплярами,
+//       сабсеты - по ячейкам OCCLUSION_CELL_SIZE), делит его объем на ячейки -cell и
+//       считает видимые кластеры из -samples точек каждой ячейки по -occluders самым
+//       крупным треугольникам. Ячейки считаются на JobSystem (-threads вместе с основным,
+//       1 - без пула). По умолчанию пишет рядом с OBJ (sponza.pvs), откуда его берет
+//       RenderingSystem при загрузке сцены. Печатает время, размер и долю отсекаемого.
+#include "../OBJLoader.h"
+#include "../DuplicateGeometry.h"
+#include "../OcclusionBuffer.h"
+#include "../PotentiallyVisibleSet.h"
+#include "../SceneDraws.h"
+#include "../JobSystem.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	std::string scenePath, output;
+	PotentiallyVisibleSet::BakeOptions options;
+	int threads = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-o") && i + 1 < argc) output = argv[++i];
+		else if (!strcmp(argv[i], "-cell") && i + 1 < argc) options.cellSize = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-samples") && i + 1 < argc) options.samplesPerCell = (uint32_t)std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-occluders") && i + 1 < argc) options.occluderTriangles = (size_t)std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-threads") && i + 1 < argc) threads = atoi(argv[++i]);
+		else scenePath = argv[i];
+	}
+	if (scenePath.empty() || options.cellSize <= 0.f)
+	{
+		printf("usage: PvsBaker [-o <pvs>] [-cell 250] [-samples 4] [-occluders 65536] [-threads N] <scene.obj>\n");
+		return 1;
+	}
+	if (output.empty()) output = PvsPathFor(scenePath);
+
+	ObjMesh scene;
+	if (!ObjLoader::Load(scenePath, scene))
+	{
+		fprintf(stderr, "Failed to load %s\n", scenePath.c_str());
+		return 1;
+	}
+	InstanceDuplicateGeometry(scene);
+	SplitSubsetsByCell(scene, OCCLUSION_CELL_SIZE);
+
+	std::unique_ptr<JobSystem> jobs;
+	if (threads <= 0) jobs.reset(new JobSystem());
+	else if (threads > 1) jobs.reset(new JobSystem(threads - 1));
+
+	PotentiallyVisibleSet pvs;
+	const PotentiallyVisibleSet::BakeReport report = pvs.Bake(scene, options, jobs.get());
+	if (report.cells == 0)
+	{
+		fprintf(stderr, "%s: nothing to bake\n", scenePath.c_str());
+		return 1;
+	}
+	std::vector<uint8_t> bytes;
+	pvs.Serialize(bytes);
+	FILE* file = fopen(output.c_str(), "wb");
+	const bool written = file && fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	if (file) fclose(file);
+	if (!written)
+	{
+		fprintf(stderr, "Failed to write %s\n", output.c_str());
+		return 1;
+	}
+
+	printf("%s: %u clusters, %u cells (%ux%ux%u of %.0f), %u sample(s)/cell, %zu occluder triangles\n", scenePath.c_str(),
+		report.clusters, report.cells, report.dims[0], report.dims[1], report.dims[2], report.cellSize,
+		options.samplesPerCell, options.occluderTriangles);
+	printf("bake      %.1f ms on %u thread(s), %.2f ms/cell\n", report.milliseconds, jobs ? jobs->GetThreadCount() : 1,
+		report.milliseconds / report.cells);
+	printf("data      %u unique sets, %zu bytes raw -> %zu bytes written (%.1f%%)\n", report.uniqueSets, report.rawBytes,
+		report.bytes, report.rawBytes ? 100.0 * report.bytes / report.rawBytes : 0.0);
+	printf("culled    %.1f%% of clusters per cell on average\n", 100.0 * (1.0 - report.visibleFraction));
+	printf("%s written\n", output.c_str());
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "RainSimulation.h"
+
+using namespace DirectX;
+
+RainSimulation::RainSimulation(uint32_t seed)
+	: m_drops(MaxLights), m_rng(seed)
+{
+}
+
+// Не больше одной новой капли за кадр
+void RainSimulation::Update(float deltaTime)
+{
+	m_spawnTimer += deltaTime;
+	if (m_spawnTimer >= m_spawnInterval)
+	{
+		m_spawnTimer = 0.f;
+		for (Drop& drop : m_drops)
+		{
+			if (drop.active) continue;
+			std::uniform_real_distribution<float> x(m_spawnAreaMin.x, m_spawnAreaMax.x);
+			std::uniform_real_distribution<float> z(m_spawnAreaMin.z, m_spawnAreaMax.z);
+			drop.light.Position.x = x(m_rng);
+			drop.light.Position.z = z(m_rng);
+			drop.light.Position.y = m_spawnAreaMax.y;
+			drop.light.Position.w = 12.f;
+			drop.light.Color = XMFLOAT4(0.7f, 0.8f, 0.9f, 2.5f);
+			drop.active = true;
+			drop.velocity = XMFLOAT3(0.f, -m_fallSpeed, 0.f);
+			drop.lifeTime = 0.f;
+			break;
+		}
+	}
+	m_activeCount = 0;
+	for (Drop& drop : m_drops)
+	{
+		if (!drop.active) continue;
+		drop.light.Position.x += drop.velocity.x * deltaTime;
+		drop.light.Position.y += drop.velocity.y * deltaTime;
+		drop.light.Position.z += drop.velocity.z * deltaTime;
+		drop.lifeTime += deltaTime;
+		if (drop.light.Position.y <= m_floorY)
+		{
+			drop.light.Position.y = m_floorY;
+			drop.velocity = XMFLOAT3(0.f, 0.f, 0.f);
+			if (drop.lifeTime > m_maxLifeTime)
+			{
+				drop.active = false;
+				drop.light = {};
+			}
+		}
+		++m_activeCount;
+	}
+}
+
+void RainSimulation::Write(PointLight* out) const
+{
+	uint32_t idx = 0;
+	for (const Drop& drop : m_drops)
+		if (drop.active) out[idx++] = drop.light;
+	while (idx < MaxLights) out[idx++] = {};
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "SceneConstants.h"
+
+// Капли дождя - точечные источники прохода освещения: через равные промежутки появляются
+// в случайной точке над сценой, падают до пола и гаснут, пролежав на нем до конца жизни.
+// Свой генератор с заданным зерном: прогон по записанному вводу повторяется кадр в кадр.
+// Без D3D
+class RainSimulation
+{
+public:
+	static const uint32_t MaxLights = 300;
+
+	explicit RainSimulation(uint32_t seed = 1);
+
+	void Update(float deltaTime);
+	// MaxLights источников: активные подряд, остальные обнулены
+	void Write(PointLight* out) const;
+	uint32_t GetActiveCount() const { return m_activeCount; }
+
+private:
+	struct Drop
+	{
+		PointLight light{};
+		bool active = false;
+		DirectX::XMFLOAT3 velocity{ 0.f, -200.f, 0.f };
+		float lifeTime = 0.f;
+	};
+
+	std::vector<Drop> m_drops;
+	std::mt19937 m_rng;
+	float m_spawnTimer = 0.f;
+	float m_spawnInterval = 0.005f;
+	DirectX::XMFLOAT3 m_spawnAreaMin{ -800.f, 20.f, -350.f };
+	DirectX::XMFLOAT3 m_spawnAreaMax{ 750.f, 30.f, 300.f };
+	float m_floorY = -1.5f;
+	float m_fallSpeed = 80.f;
+	float m_maxLifeTime = 3.5f;
+	uint32_t m_activeCount = 0;
+};
\ No newline at end of file
@@ -0,0 +1,263 @@
+// RayBenchmark - построение TriangleBvh сцены и скорость лучей на CPU.
+//
+//   RayBenchmark [-threads N] [-width 1024] [-height 512] [-views 8] [-radius 10] sponza.obj [flight.txt]
+//       Меш готовится так же, как RenderingSystem::LoadSceneMesh. Дерево строится без пула
+//       и на JobSystem (-threads вместе с основным, 1 - без пула): печатается время, узлы,
+//       глубина, стоимость SAH и память. Из -views камер (кадры записанного полета, без
+//       записи - по кругу вокруг центра сцены) на каждый пиксель -width x -height пускается
+//       первичный луч, по одному и пакетами 2x2, затем из точек попадания - теневые лучи к
+//       солнцу с любым попаданием. Печатает Mrays/s каждого вида и расхождения пакетов с
+//       одиночными лучами; в конце - время шага камеры MoveSphere сферой -radius.
+#include "../OBJLoader.h"
+#include "../DuplicateGeometry.h"
+#include "../OcclusionBuffer.h"
+#include "../SceneDraws.h"
+#include "../FlyCamera.h"
+#include "../InputRecording.h"
+#include "../TriangleBvh.h"
+#include "../JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+typedef std::chrono::steady_clock Clock;
+
+static double Seconds(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	std::string scenePath, recordingPath;
+	int threads = 0, views = 8;
+	uint32_t width = 1024, height = 512;
+	float radius = 10.0f;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-threads") && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-width") && i + 1 < argc) width = (uint32_t)std::max(2, atoi(argv[++i])) & ~1u;
+		else if (!strcmp(argv[i], "-height") && i + 1 < argc) height = (uint32_t)std::max(2, atoi(argv[++i])) & ~1u;
+		else if (!strcmp(argv[i], "-views") && i + 1 < argc) views = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-radius") && i + 1 < argc) radius = (float)atof(argv[++i]);
+		else if (scenePath.empty()) scenePath = argv[i];
+		else recordingPath = argv[i];
+	}
+	if (scenePath.empty())
+	{
+		printf("usage: RayBenchmark [-threads N] [-width 1024] [-height 512] [-views 8] [-radius 10] <scene.obj> [recording]\n");
+		return 1;
+	}
+
+	ObjMesh scene;
+	if (!ObjLoader::Load(scenePath, scene))
+	{
+		fprintf(stderr, "Failed to load %s\n", scenePath.c_str());
+		return 1;
+	}
+	InstanceDuplicateGeometry(scene);
+	SplitSubsetsByCell(scene, OCCLUSION_CELL_SIZE);
+
+	std::unique_ptr<JobSystem> jobs;
+	if (threads <= 0) jobs.reset(new JobSystem());
+	else if (threads > 1) jobs.reset(new JobSystem(threads - 1));
+	const unsigned threadCount = jobs ? jobs->GetThreadCount() : 1;
+
+	TriangleBvh bvh;
+	const TriangleBvh::BuildReport serial = bvh.Build(scene, nullptr);
+	if (serial.triangles == 0)
+	{
+		fprintf(stderr, "%s: no triangles\n", scenePath.c_str());
+		return 1;
+	}
+	const TriangleBvh::BuildReport report = bvh.Build(scene, jobs.get());
+	printf("%s: %u triangles, %u nodes (%u leaves), depth %u, SAH cost %.1f, %.2f MB\n", scenePath.c_str(), report.triangles,
+		report.nodes, report.leaves, report.maxDepth, report.sahCost, report.bytes / 1048576.0);
+	printf("build     %.1f ms on 1 thread, %.1f ms on %u thread(s)\n", serial.milliseconds, report.milliseconds, report.threads);
+
+	// Камеры: кадры записи через равные промежутки или круг на высоте центра
+	std::vector<XMFLOAT4X4> cameras;
+	InputRecording recording;
+	if (!recordingPath.empty())
+	{
+		if (!recording.Load(recordingPath) || recording.GetFrameCount() == 0)
+		{
+			fprintf(stderr, "Failed to load recording %s\n", recordingPath.c_str());
+			return 1;
+		}
+		FlyCamera camera;
+		InputDevice input;
+		const size_t step = std::max<size_t>(1, recording.GetFrameCount() / views);
+		for (size_t f = 0; f < recording.GetFrameCount() && cameras.size() < (size_t)views; ++f)
+		{
+			input.SetSnapshot(recording.GetFrame(f).input);
+			camera.Update(recording.GetFrame(f).deltaTime, input);
+			if (f % step != step - 1) continue;
+			cameras.emplace_back();
+			XMStoreFloat4x4(&cameras.back(), camera.GetView());
+		}
+	}
+	else
+	{
+		XMFLOAT3 lo(FLT_MAX, FLT_MAX, FLT_MAX), hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const ObjMesh::Vertex& v : scene.vertices)
+		{
+			lo = XMFLOAT3(std::min(lo.x, v.Position.x), std::min(lo.y, v.Position.y), std::min(lo.z, v.Position.z));
+			hi = XMFLOAT3(std::max(hi.x, v.Position.x), std::max(hi.y, v.Position.y), std::max(hi.z, v.Position.z));
+		}
+		const XMVECTOR center = XMVectorSet(0.5f * (lo.x + hi.x), 0.5f * (lo.y + hi.y), 0.5f * (lo.z + hi.z), 1.f);
+		for (int v = 0; v < views; ++v)
+		{
+			const float angle = XM_2PI * v / views;
+			const XMVECTOR eye = XMVectorAdd(center, XMVectorSet(0.3f * (hi.x - lo.x) * cosf(angle), 0.f, 0.3f * (hi.z - lo.z) * sinf(angle), 0.f));
+			cameras.emplace_back();
+			XMStoreFloat4x4(&cameras.back(), XMMatrixLookAtLH(eye, center, XMVectorSet(0.f, 1.f, 0.f, 0.f)));
+		}
+	}
+
+	const size_t pixels = (size_t)width * height;
+	const float tanY = tanf(XMConvertToRadians(FlyCamera::FovY) * 0.5f), tanX = tanY * width / height;
+	const XMFLOAT3 sun(0.3f, 1.0f, 0.2f);
+	std::vector<TriangleBvh::Ray> primary(pixels), shadow(pixels);
+	std::vector<TriangleBvh::Hit> single(pixels), packet(pixels);
+	std::vector<uint8_t> singleShadow(pixels), packetShadow(pixels);
+	double primarySingle = 0.0, primaryPacket = 0.0, shadowSingle = 0.0, shadowPacket = 0.0;
+	uint64_t primaryRays = 0, shadowRays = 0, primaryMismatch = 0, shadowMismatch = 0;
+	// Строка пакетов 2x2 - одна задача
+	const size_t rowPairs = height / 2;
+	for (const XMFLOAT4X4& cameraView : cameras)
+	{
+		const XMMATRIX world = XMMatrixInverse(nullptr, XMLoadFloat4x4(&cameraView));
+		XMFLOAT3 right, up, forward, eye;
+		XMStoreFloat3(&right, world.r[0]);
+		XMStoreFloat3(&up, world.r[1]);
+		XMStoreFloat3(&forward, world.r[2]);
+		XMStoreFloat3(&eye, world.r[3]);
+		for (uint32_t y = 0; y < height; ++y)
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const float sx = ((x + 0.5f) / width * 2.f - 1.f) * tanX, sy = (1.f - (y + 0.5f) / height * 2.f) * tanY;
+				TriangleBvh::Ray& ray = primary[(size_t)y * width + x];
+				ray.origin = eye;
+				ray.direction = XMFLOAT3(forward.x + right.x * sx + up.x * sy, forward.y + right.y * sx + up.y * sy,
+					forward.z + right.z * sx + up.z * sy);
+			}
+
+		// Пакет - квадрат 2x2 соседних пикселей
+		auto quadRays = [&](const std::vector<TriangleBvh::Ray>& rays, size_t pair, uint32_t x, TriangleBvh::Ray quad[4], size_t index[4]) {
+			for (uint32_t k = 0; k < 4; ++k)
+			{
+				index[k] = (pair * 2 + k / 2) * width + x + (k & 1);
+				quad[k] = rays[index[k]];
+			}
+		};
+		Clock::time_point start = Clock::now();
+		auto runSingle = [&](size_t pair) {
+			for (size_t i = pair * 2 * width; i < (pair * 2 + 2) * width; ++i) bvh.Intersect(primary[i], single[i]);
+		};
+		if (jobs) jobs->ParallelFor(rowPairs, runSingle);
+		else for (size_t pair = 0; pair < rowPairs; ++pair) runSingle(pair);
+		primarySingle += Seconds(start);
+
+		start = Clock::now();
+		auto runPacket = [&](size_t pair) {
+			for (uint32_t x = 0; x < width; x += 2)
+			{
+				TriangleBvh::Ray quad[4];
+				TriangleBvh::Hit hits[4];
+				size_t index[4];
+				quadRays(primary, pair, x, quad, index);
+				bvh.IntersectPacket(quad, hits);
+				for (uint32_t k = 0; k < 4; ++k) packet[index[k]] = hits[k];
+			}
+		};
+		if (jobs) jobs->ParallelFor(rowPairs, runPacket);
+		else for (size_t pair = 0; pair < rowPairs; ++pair) runPacket(pair);
+		primaryPacket += Seconds(start);
+		primaryRays += pixels;
+
+		// Тени: из точки попадания, чуть над поверхностью со стороны камеры. Пиксели без
+		// попадания получают луч нулевой длины - в пакете он ничего не находит
+		size_t hits = 0;
+		for (size_t i = 0; i < pixels; ++i)
+		{
+			const TriangleBvh::Hit& hit = single[i];
+			if (packet[i].IsHit() != hit.IsHit() || fabsf(packet[i].t - hit.t) > 1e-4f * std::max(1.f, hit.t)) ++primaryMismatch;
+			TriangleBvh::Ray& ray = shadow[i];
+			ray.direction = sun;
+			if (!hit.IsHit())
+			{
+				ray.origin = eye;
+				ray.tMax = 0.f;
+				continue;
+			}
+			const XMFLOAT3& d = primary[i].direction;
+			XMFLOAT3 n = bvh.GetNormal(hit.triangle);
+			const float side = n.x * d.x + n.y * d.y + n.z * d.z > 0.f ? -1.f : 1.f;
+			ray.origin = XMFLOAT3(eye.x + d.x * hit.t + n.x * side * 0.01f, eye.y + d.y * hit.t + n.y * side * 0.01f,
+				eye.z + d.z * hit.t + n.z * side * 0.01f);
+			ray.tMax = FLT_MAX;
+			++hits;
+		}
+		start = Clock::now();
+		auto runShadowSingle = [&](size_t pair) {
+			for (size_t i = pair * 2 * width; i < (pair * 2 + 2) * width; ++i)
+				singleShadow[i] = shadow[i].tMax > 0.f && bvh.IsOccluded(shadow[i]);
+		};
+		if (jobs) jobs->ParallelFor(rowPairs, runShadowSingle);
+		else for (size_t pair = 0; pair < rowPairs; ++pair) runShadowSingle(pair);
+		shadowSingle += Seconds(start);
+
+		start = Clock::now();
+		auto runShadowPacket = [&](size_t pair) {
+			for (uint32_t x = 0; x < width; x += 2)
+			{
+				TriangleBvh::Ray quad[4];
+				bool occluded[4];
+				size_t index[4];
+				quadRays(shadow, pair, x, quad, index);
+				bvh.IsOccludedPacket(quad, occluded);
+				for (uint32_t k = 0; k < 4; ++k) packetShadow[index[k]] = occluded[k];
+			}
+		};
+		if (jobs) jobs->ParallelFor(rowPairs, runShadowPacket);
+		else for (size_t pair = 0; pair < rowPairs; ++pair) runShadowPacket(pair);
+		shadowPacket += Seconds(start);
+		shadowRays += hits;
+		for (size_t i = 0; i < pixels; ++i) shadowMismatch += singleShadow[i] != packetShadow[i];
+	}
+
+	printf("rays      %zu view(s) of %ux%u on %u thread(s)\n", cameras.size(), width, height, threadCount);
+	printf("primary   closest hit: %.2f Mrays/s single, %.2f Mrays/s packets of 4, %llu mismatch(es)\n",
+		primaryRays / primarySingle * 1e-6, primaryRays / primaryPacket * 1e-6, (unsigned long long)primaryMismatch);
+	printf("shadow    any hit:     %.2f Mrays/s single, %.2f Mrays/s packets of 4, %llu mismatch(es)\n",
+		shadowRays / shadowSingle * 1e-6, shadowRays / shadowPacket * 1e-6, (unsigned long long)shadowMismatch);
+
+	// Шаг камеры за кадр при 500 ед/с и 60 кадрах в секунду - в случайную сторону
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	const int sweeps = 10000;
+	Clock::time_point start = Clock::now();
+	XMFLOAT3 position;
+	XMStoreFloat3(&position, XMMatrixInverse(nullptr, XMLoadFloat4x4(&cameras[0])).r[3]);
+	uint32_t blocked = 0;
+	for (int i = 0; i < sweeps; ++i)
+	{
+		const XMFLOAT3 delta(unit(rng) * 8.f, unit(rng) * 8.f, unit(rng) * 8.f);
+		const XMFLOAT3 moved = bvh.MoveSphere(position, radius, delta);
+		if (fabsf(moved.x - position.x - delta.x) + fabsf(moved.y - position.y - delta.y) + fabsf(moved.z - position.z - delta.z) > 1e-3f) ++blocked;
+		position = moved;
+	}
+	printf("camera    MoveSphere radius %.1f: %.2f us/step, %.1f%% of steps touched geometry\n", radius,
+		Seconds(start) * 1e6 / sweeps, 100.0 * blocked / sweeps);
+	return 0;
+}
\ No newline at end of file
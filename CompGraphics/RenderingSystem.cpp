@@ -1,12 +1,23 @@
 ﻿#include "RenderingSystem.h"
 #include <stdexcept>
 #include <cmath>
+#include <map>
+#include <algorithm>
 #include "InputDevice.h"
+#include "TaskGraph.h"
 
 static void ThrowIfFailed(HRESULT hr) {
     if (FAILED(hr)) throw std::runtime_error("DirectX call failed");
 }
 
+static void AssignPermutation(GpuMaterial& mat) {
+    GeometryMaterialFeatures features;
+    features.diffuseMap = mat.hasTexture;
+    features.normalMap = mat.hasNormalMap;
+    features.displacementScale = mat.displacementScale;
+    mat.permutation = GeometryPermutationKey(features);
+}
+
 RenderingSystem::~RenderingSystem()
 {
     // Безопасная очистка: если устройство удалено (Device Removed), COM-вызовы могут падать.
@@ -15,10 +26,7 @@ RenderingSystem::~RenderingSystem()
         try { FlushCommandQueue(); }
         catch (...) {}
     }
-    if (m_constantBuffer && m_cbMapped) {
-        try { m_constantBuffer->Unmap(0, nullptr); }
-        catch (...) {}
-    }
+    m_loader.Shutdown();
     if (m_pointLightBuffer && m_pointLightsMapped) {
         try { m_pointLightBuffer->Unmap(0, nullptr); }
         catch (...) {}
@@ -32,54 +40,99 @@ RenderingSystem::~RenderingSystem()
     catch (...) {}
 }
 
-bool RenderingSystem::Init(HWND hwnd, int width, int height) {
+bool RenderingSystem::Init(HWND hwnd, int width, int height, std::function<void()> onDeviceReady) {
     m_width = width; m_height = height;
     HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
     if (FAILED(hr)) return false;
 
+    // Шаги инициализации - граф зависимостей: шейдеры компилируются параллельно с созданием
+    // устройства и ресурсов, PSO ждут только свои шейдеры и корневую сигнатуру.
+    // Список команд пишет одна цепочка задач, окно трогает только поток Init
+    TaskGraph graph;
     try {
-        CreateDevice();
-        CreateCommandObjects();
-        CreateSwapChain(hwnd, width, height);
-        CreateDescriptorHeaps();
-
-        CreateDefaultTextures();
-
-        CreateRenderTargetViews();
-        CreateDepthStencilView();
-        CreateFence();
-        CompileShaders();
-        CreateRootSignature();
-        CreatePipelineStateObject();
-        CreateCubeGeometry();
-        CreateConstantBuffer();
-
-        if (!m_gbuffer.Initialize(m_device.Get(), m_cbvSrvHeap.Get(), width, height)) {
-            OutputDebugStringA("GBuffer initialization failed!\n");
-            return false;
-        }
-
-        CompileGeometryShaders();
-        CompileLightingShaders();
-        CreateGeometryPassPSO();
-        CreateLightingRootSignature();
-        CreateLightingPassPSO();
-        CreateLightingResources();
-
-        CreateRainLightBuffer();
-        CreateRainLightSRV();
-
-        CreateScreenQuad();
-
-        ThrowIfFailed(m_cmdList->Close());
-        ID3D12CommandList* cmds[] = { m_cmdList.Get() };
-        m_cmdQueue->ExecuteCommandLists(1, cmds);
-        WaitForGPU();
+        CreateShaderCache();
+        const bool mainThread = true;
+        auto device = graph.Add("Device", [this]() { CreateDevice(); });
+        auto commands = graph.Add("CommandObjects", [this]() { CreateCommandObjects(); }, { device });
+        auto swapChain = graph.Add("SwapChain", [this, hwnd, width, height]() { CreateSwapChain(hwnd, width, height); }, { commands }, mainThread);
+        auto heaps = graph.Add("DescriptorHeaps", [this]() { CreateDescriptorHeaps(); }, { device });
+        auto uploadRing = graph.Add("UploadRing", [this]() {
+            if (!m_uploadRing.Init(m_device.Get(), UPLOAD_RING_SIZE))
+                throw std::runtime_error("Upload ring creation failed!\n");
+            }, { device });
+        graph.Add("RenderTargetViews", [this]() { CreateRenderTargetViews(); }, { swapChain, heaps });
+        graph.Add("DepthStencilView", [this]() { CreateDepthStencilView(); }, { heaps });
+        auto fence = graph.Add("Fence", [this]() { CreateFence(); }, { swapChain });
+        // Копирования из кольца отдаются до fence первой отправки, поэтому пишутся после Fence
+        auto defaults = graph.Add("DefaultTextures", [this]() { CreateDefaultTextures(); }, { commands, heaps, uploadRing, fence });
+        auto cube = graph.Add("CubeGeometry", [this]() { CreateCubeGeometry(); }, { defaults });
+        auto screenQuad = graph.Add("ScreenQuad", [this]() { CreateScreenQuad(); }, { cube });
+
+        // Сцена грузится в фоне, пока достраивается остальное
+        if (onDeviceReady) graph.Add("StartAssetLoads", onDeviceReady, { device, uploadRing }, mainThread);
+
+        auto compile = [this, &graph](const char* name, const char* file, const char* entry, const char* target, ComPtr<ID3DBlob>& blob) {
+            return graph.Add(name, [this, file, entry, target, &blob]() { CompileShader(file, entry, target, blob); });
+            };
+        auto phongVS = compile("PhongShader VSMain", "PhongShader.hlsl", "VSMain", "vs_5_0", m_phongVSBlob);
+        auto phongPS = compile("PhongShader PSMain", "PhongShader.hlsl", "PSMain", "ps_5_0", m_phongPSBlob);
+        auto lightingVS = compile("LightingPass VSMain", "LightingPass.hlsl", "VSMain", "vs_5_0", m_lightingVSBlob);
+        auto lightingPS = compile("LightingPass PSMain", "LightingPass.hlsl", "PSMain", "ps_5_0", m_lightingPSBlob);
+
+        auto rootSignature = graph.Add("RootSignature", [this]() { CreateRootSignature(); }, { device });
+        graph.Add("PhongPSO", [this]() { CreatePipelineStateObject(); }, { rootSignature, phongVS, phongPS });
+        // Общие для нескольких вариантов стадии компилирует первая задача, которой они нужны
+        for (uint32_t key = 0; key < GEOMETRY_PERMUTATION_COUNT; ++key)
+            graph.Add("GeometryPassPSO " + GeometryPermutationName(key), [this, key]() { CreateGeometryPassPSO(key); }, { rootSignature });
+        auto lightingRootSignature = graph.Add("LightingRootSignature", [this]() { CreateLightingRootSignature(); }, { device });
+        graph.Add("LightingPassPSO", [this]() { CreateLightingPassPSO(); }, { lightingRootSignature, lightingVS, lightingPS });
+
+        graph.Add("FrameConstants", [this]() { CreateFrameConstants(); }, { device });
+        graph.Add("GBuffer", [this, width, height]() {
+            if (!m_gbuffer.Initialize(m_device.Get(), width, height, &m_gpuHeaps))
+                throw std::runtime_error("GBuffer initialization failed!\n");
+            }, { heaps });
+        graph.Add("LightingResources", [this]() { CreateLightingResources(); }, { device });
+        auto rainLights = graph.Add("RainLightBuffer", [this]() { CreateRainLightBuffer(); }, { device });
+        graph.Add("RainLightSRV", [this]() { CreateRainLightSRV(); }, { rainLights, heaps });
+
+        graph.Add("SubmitInitCommands", [this]() {
+            ThrowIfFailed(m_cmdList->Close());
+            ID3D12CommandList* cmds[] = { m_cmdList.Get() };
+            m_cmdQueue->ExecuteCommandLists(1, cmds);
+            WaitForGPU();
+            }, { screenQuad });
+
+        graph.Run();
     }
     catch (const std::exception& e) {
         OutputDebugStringA(e.what());
         return false;
     }
+    graph.Report("RenderingSystem::Init");
+    m_jobs.reset(new JobSystem());
+    char msg[128];
+    sprintf_s(msg, "[ShaderCache] %u hits, %u compiled\n", m_shaderCache->GetHits(), m_shaderCache->GetMisses());
+    OutputDebugStringA(msg);
+#ifdef DRAW_LIST_BENCHMARK
+    for (const DrawList::SortTiming& t : DrawList::BenchmarkSort({ 10000, 30000, 100000 }, 20)) {
+        sprintf_s(msg, "[DrawList] %zu items: radix %.3f ms, std::sort %.3f ms\n", t.items, t.radixMilliseconds, t.stdSortMilliseconds);
+        OutputDebugStringA(msg);
+    }
+#endif
+#ifdef DRAW_PACKETS_BENCHMARK
+    for (const DrawPacketBuilder::BuildTiming& t : DrawPacketBuilder::BenchmarkBuild(100000, { 1, 2, 4, m_jobs->GetThreadCount() }, DRAW_PACKET_CHUNK, 20)) {
+        sprintf_s(msg, "[DrawPackets] %zu draws, %u threads: %.3f ms%s\n", t.draws, t.threads, t.milliseconds,
+            t.identical ? "" : ", DIFFERS from single thread");
+        OutputDebugStringA(msg);
+    }
+    // По 64 экземпляра на сабсет: сборка отрисовок и сжатие списка видимых экземпляров
+    for (const DrawPacketBuilder::BuildTiming& t : DrawPacketBuilder::BenchmarkBuild(16384, { 1, 2, 4, m_jobs->GetThreadCount() }, DRAW_PACKET_CHUNK, 20, 64)) {
+        sprintf_s(msg, "[Instancing] %zu instances, %u threads: %.3f ms, %u visible in %u draws%s\n", t.draws, t.threads,
+            t.milliseconds, t.instances, t.batches, t.identical ? "" : ", DIFFERS from single thread");
+        OutputDebugStringA(msg);
+    }
+#endif
 
     m_initialized = true;
     return true;
@@ -97,6 +150,7 @@ void RenderingSystem::CreateDevice() {
         if (SUCCEEDED(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&m_device)))) break;
     }
     if (!m_device) ThrowIfFailed(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&m_device)));
+    m_gpuHeaps.Init(m_device.Get(), GPU_HEAP_SIZE);
 }
 
 void RenderingSystem::CreateCommandObjects() {
@@ -136,67 +190,79 @@ void RenderingSystem::CreateDescriptorHeaps() {
 
     D3D12_DESCRIPTOR_HEAP_DESC cbvD{};
     cbvD.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    cbvD.NumDescriptors = 100 + (MAX_TEXTURES * 3);
+    cbvD.NumDescriptors = m_descriptors.GetCapacity();
     cbvD.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     ThrowIfFailed(m_device->CreateDescriptorHeap(&cbvD, IID_PPV_ARGS(&m_cbvSrvHeap)));
     m_cbvSrvDescSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    D3D12_DESCRIPTOR_HEAP_DESC stagingD{};
+    stagingD.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    stagingD.NumDescriptors = 1;
+    ThrowIfFailed(m_device->CreateDescriptorHeap(&stagingD, IID_PPV_ARGS(&m_stagingSrvHeap)));
 }
 
-void RenderingSystem::CreateDefaultTextures() {
-    D3D12_RESOURCE_DESC texDesc = {};
-    texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    texDesc.Width = 1; texDesc.Height = 1;
-    texDesc.DepthOrArraySize = 1; texDesc.MipLevels = 1;
-    texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    texDesc.SampleDesc.Count = 1;
-    texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-    CD3DX12_HEAP_PROPERTIES heapPropsDef(D3D12_HEAP_TYPE_DEFAULT);
-    m_device->CreateCommittedResource(&heapPropsDef, D3D12_HEAP_FLAG_NONE, &texDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_defaultDiffuseTex));
-    m_device->CreateCommittedResource(&heapPropsDef, D3D12_HEAP_FLAG_NONE, &texDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_defaultNormalTex));
-    m_device->CreateCommittedResource(&heapPropsDef, D3D12_HEAP_FLAG_NONE, &texDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_defaultDisplacementTex));
-
-    CD3DX12_HEAP_PROPERTIES heapPropsUp(D3D12_HEAP_TYPE_UPLOAD);
-    UINT64 uploadSize = GetRequiredIntermediateSize(m_defaultDiffuseTex.Get(), 0, 1);
-    CD3DX12_RESOURCE_DESC bufDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadSize);
-
-    m_device->CreateCommittedResource(&heapPropsUp, D3D12_HEAP_FLAG_NONE, &bufDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_defaultDiffuseUpload));
-    m_device->CreateCommittedResource(&heapPropsUp, D3D12_HEAP_FLAG_NONE, &bufDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_defaultNormalUpload));
-    m_device->CreateCommittedResource(&heapPropsUp, D3D12_HEAP_FLAG_NONE, &bufDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_defaultDisplacementUpload));
-
-    uint8_t diffData[4] = { 255, 255, 255, 255 };
-    uint8_t normData[4] = { 128, 128, 255, 255 };
-    uint8_t dispData[4] = { 128, 128, 128, 255 };
-
-    D3D12_SUBRESOURCE_DATA subD = {}; subD.pData = diffData; subD.RowPitch = 4; subD.SlicePitch = 4;
-    D3D12_SUBRESOURCE_DATA subN = {}; subN.pData = normData; subN.RowPitch = 4; subN.SlicePitch = 4;
-    D3D12_SUBRESOURCE_DATA subP = {}; subP.pData = dispData; subP.RowPitch = 4; subP.SlicePitch = 4;
-
-    UpdateSubresources(m_cmdList.Get(), m_defaultDiffuseTex.Get(), m_defaultDiffuseUpload.Get(), 0, 0, 1, &subD);
-    UpdateSubresources(m_cmdList.Get(), m_defaultNormalTex.Get(), m_defaultNormalUpload.Get(), 0, 0, 1, &subN);
-    UpdateSubresources(m_cmdList.Get(), m_defaultDisplacementTex.Get(), m_defaultDisplacementUpload.Get(), 0, 0, 1, &subP);
-
-    CD3DX12_RESOURCE_BARRIER barriers[3] = {
-        CD3DX12_RESOURCE_BARRIER::Transition(m_defaultDiffuseTex.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
-        CD3DX12_RESOURCE_BARRIER::Transition(m_defaultNormalTex.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
-        CD3DX12_RESOURCE_BARRIER::Transition(m_defaultDisplacementTex.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE)
-    };
-    m_cmdList->ResourceBarrier(3, barriers);
+D3D12_CPU_DESCRIPTOR_HANDLE RenderingSystem::SrvCpu(uint32_t index) const {
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_cbvSrvHeap->GetCPUDescriptorHandleForHeapStart(), (INT)index, m_cbvSrvDescSize);
+}
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE h(m_cbvSrvHeap->GetCPUDescriptorHandleForHeapStart(), 4, m_cbvSrvDescSize);
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MipLevels = 1;
+D3D12_GPU_DESCRIPTOR_HANDLE RenderingSystem::SrvGpu(uint32_t index) const {
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), (INT)index, m_cbvSrvDescSize);
+}
 
-    m_device->CreateShaderResourceView(m_defaultDiffuseTex.Get(), &srvDesc, h);
-    h.Offset(1, m_cbvSrvDescSize);
-    m_device->CreateShaderResourceView(m_defaultNormalTex.Get(), &srvDesc, h);
-    h.Offset(1, m_cbvSrvDescSize);
-    m_device->CreateShaderResourceView(m_defaultDisplacementTex.Get(), &srvDesc, h);
+uint32_t RenderingSystem::ResolveTable(const DescriptorAllocator::Handle& table) const {
+    if (table.IsEmpty()) return m_defaultSrvTable.index;
+    const uint32_t index = m_descriptors.Resolve(table);
+    if (index != DescriptorAllocator::InvalidIndex) return index;
+    // Материал пережил свою таблицу - ошибка владения, но дескрипторы уже могут принадлежать другому
+    char msg[128];
+    sprintf_s(msg, "[Descriptors] Stale table %u (generation %u), using defaults\n", table.index, table.generation);
+    OutputDebugStringA(msg);
+    return m_defaultSrvTable.index;
+}
 
-    m_currentSrvSlot = 7;
+void RenderingSystem::WriteMaterialTable(uint32_t index, ID3D12Resource* diffuse, ID3D12Resource* normal, ID3D12Resource* displacement) {
+    ID3D12Resource* textures[3] = {
+        diffuse ? diffuse : m_defaultDiffuseTex.Get(),
+        normal ? normal : m_defaultNormalTex.Get(),
+        displacement ? displacement : m_defaultDisplacementTex.Get()
+    };
+    for (uint32_t i = 0; i < 3; ++i) {
+        const D3D12_RESOURCE_DESC desc = textures[i]->GetDesc();
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.Format = desc.Format;
+        // t0 в GeometryPass - Texture2DArray
+        if (i == 0) {
+            srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+            srvDesc.Texture2DArray.MipLevels = 1;
+            srvDesc.Texture2DArray.ArraySize = desc.DepthOrArraySize;
+        }
+        else {
+            srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+            srvDesc.Texture2D.MipLevels = 1;
+        }
+        m_device->CreateShaderResourceView(textures[i], &srvDesc, SrvCpu(index + i));
+    }
+}
+
+void RenderingSystem::CreateDefaultTextures() {
+    auto create = [this](uint8_t r, uint8_t g, uint8_t b, ComPtr<ID3D12Resource>& texture) {
+        TextureLoader::TextureData td;
+        td.width = 1; td.height = 1; td.rowPitch = 4;
+        td.pixels = { r, g, b, 255 };
+        TextureLoader::TextureUpload upload;
+        if (!TextureLoader::PrepareTextureArray(m_device.Get(), { &td }, upload, &m_uploadRing, &m_gpuHeaps))
+            throw std::runtime_error("Default texture creation failed!\n");
+        TextureLoader::RecordTextureUpload(m_cmdList.Get(), upload, m_fenceValues[m_frameIndex]);
+        texture = upload.texture;
+        };
+    create(255, 255, 255, m_defaultDiffuseTex);
+    create(128, 128, 255, m_defaultNormalTex);
+    create(128, 128, 128, m_defaultDisplacementTex);
+
+    m_defaultSrvTable = m_descriptors.Allocate(3);
+    if (m_defaultSrvTable.IsEmpty()) throw std::runtime_error("Default descriptor table allocation failed!\n");
+    WriteMaterialTable(m_defaultSrvTable.index, nullptr, nullptr, nullptr);
 }
 
 void RenderingSystem::CreateRenderTargetViews() {
@@ -216,8 +282,7 @@ void RenderingSystem::CreateDepthStencilView() {
     d.Format = DXGI_FORMAT_D32_FLOAT; d.SampleDesc = { 1, 0 };
     d.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
     D3D12_CLEAR_VALUE cv{}; cv.Format = DXGI_FORMAT_D32_FLOAT; cv.DepthStencil.Depth = 1.0f;
-    CD3DX12_HEAP_PROPERTIES hp(D3D12_HEAP_TYPE_DEFAULT);
-    ThrowIfFailed(m_device->CreateCommittedResource(&hp, D3D12_HEAP_FLAG_NONE, &d, D3D12_RESOURCE_STATE_DEPTH_WRITE, &cv, IID_PPV_ARGS(&m_depthStencil)));
+    ThrowIfFailed(m_gpuHeaps.CreateResource(d, D3D12_RESOURCE_STATE_DEPTH_WRITE, &cv, m_depthStencil));
     m_device->CreateDepthStencilView(m_depthStencil.Get(), nullptr, m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
 }
 
@@ -227,47 +292,54 @@ void RenderingSystem::CreateFence() {
     m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 }
 
-void RenderingSystem::CompileShaders() {
-    UINT flags = 0;
-#ifdef _DEBUG
-    flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
-    ComPtr<ID3DBlob> errors;
-    HRESULT hr = D3DCompileFromFile(L"PhongShader.hlsl", nullptr, nullptr, "VSMain", "vs_5_0", flags, 0, &m_vsBlob, &errors);
-    if (FAILED(hr)) { if (errors) OutputDebugStringA((char*)errors->GetBufferPointer()); ThrowIfFailed(hr); }
-    hr = D3DCompileFromFile(L"PhongShader.hlsl", nullptr, nullptr, "PSMain", "ps_5_0", flags, 0, &m_psBlob, &errors);
-    if (FAILED(hr)) { if (errors) OutputDebugStringA((char*)errors->GetBufferPointer()); ThrowIfFailed(hr); }
-}
-
-void RenderingSystem::CompileGeometryShaders() {
-    UINT flags = 0;
-#ifdef _DEBUG
-    flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
-    ComPtr<ID3DBlob> errors;
-    HRESULT hr = D3DCompileFromFile(L"GeometryPass.hlsl", nullptr, nullptr, "VSMain", "vs_5_0", flags, 0, &m_vsBlob, &errors);
-    if (FAILED(hr)) { if (errors) OutputDebugStringA((char*)errors->GetBufferPointer()); ThrowIfFailed(hr); }
-
-    hr = D3DCompileFromFile(L"GeometryPass.hlsl", nullptr, nullptr, "HSMain", "hs_5_0", flags, 0, &m_hsBlob, &errors);
-    if (FAILED(hr)) { if (errors) OutputDebugStringA((char*)errors->GetBufferPointer()); ThrowIfFailed(hr); }
-
-    hr = D3DCompileFromFile(L"GeometryPass.hlsl", nullptr, nullptr, "DSMain", "ds_5_0", flags, 0, &m_dsBlob, &errors);
-    if (FAILED(hr)) { if (errors) OutputDebugStringA((char*)errors->GetBufferPointer()); ThrowIfFailed(hr); }
-
-    hr = D3DCompileFromFile(L"GeometryPass.hlsl", nullptr, nullptr, "PSMain", "ps_5_0", flags, 0, &m_psBlob, &errors);
-    if (FAILED(hr)) { if (errors) OutputDebugStringA((char*)errors->GetBufferPointer()); ThrowIfFailed(hr); }
+void RenderingSystem::CreateShaderCache() {
+    // Промах кэша - обычная компиляция из файла; include ищутся рядом с шейдером
+    CreateDirectoryA("shadercache", nullptr);
+    m_shaderCache.reset(new ShaderCache("shadercache", [](const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors) {
+        std::vector<D3D_SHADER_MACRO> macros;
+        for (const ShaderMacro& macro : request.defines) macros.push_back({ macro.name.c_str(), macro.value.c_str() });
+        macros.push_back({ nullptr, nullptr });
+        std::wstring file(request.file.begin(), request.file.end());
+        ComPtr<ID3DBlob> blob, errorBlob;
+        HRESULT hr = D3DCompileFromFile(file.c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+            request.entry.c_str(), request.target.c_str(), request.flags, 0, &blob, &errorBlob);
+        if (errorBlob) errors.assign((const char*)errorBlob->GetBufferPointer(), errorBlob->GetBufferSize());
+        if (FAILED(hr)) return false;
+        const uint8_t* p = (const uint8_t*)blob->GetBufferPointer();
+        bytecode.assign(p, p + blob->GetBufferSize());
+        return true;
+        }));
+
+    m_geometryShaders.reset(new VariantCache<ComPtr<ID3DBlob>>([this](uint32_t variant) {
+        static const char* const entries[] = { "VSMain", "HSMain", "DSMain", "PSMain" };
+        static const char* const targets[] = { "vs_5_0", "hs_5_0", "ds_5_0", "ps_5_0" };
+        const uint32_t stage = variant / GEOMETRY_PERMUTATION_COUNT;
+        std::vector<ShaderMacro> defines;
+        GeometryPermutationDefines(variant % GEOMETRY_PERMUTATION_COUNT, defines);
+        ComPtr<ID3DBlob> blob;
+        CompileShader("GeometryPass.hlsl", entries[stage], targets[stage], blob, defines);
+        return blob;
+        }));
 }
 
-void RenderingSystem::CompileLightingShaders() {
-    UINT flags = 0;
+void RenderingSystem::CompileShader(const char* file, const char* entry, const char* target, ComPtr<ID3DBlob>& blob,
+    const std::vector<ShaderMacro>& defines) const {
+    ShaderCompileRequest request;
+    request.file = file;
+    request.entry = entry;
+    request.target = target;
+    request.defines = defines;
 #ifdef _DEBUG
-    flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+    request.flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
-    ComPtr<ID3DBlob> errors;
-    HRESULT hr = D3DCompileFromFile(L"LightingPass.hlsl", nullptr, nullptr, "VSMain", "vs_5_0", flags, 0, &m_lightingVSBlob, &errors);
-    if (FAILED(hr)) { if (errors) OutputDebugStringA((char*)errors->GetBufferPointer()); ThrowIfFailed(hr); }
-    hr = D3DCompileFromFile(L"LightingPass.hlsl", nullptr, nullptr, "PSMain", "ps_5_0", flags, 0, &m_lightingPSBlob, &errors);
-    if (FAILED(hr)) { if (errors) OutputDebugStringA((char*)errors->GetBufferPointer()); ThrowIfFailed(hr); }
+    std::vector<uint8_t> bytecode;
+    std::string errors;
+    if (!m_shaderCache->Get(request, bytecode, errors)) {
+        OutputDebugStringA(errors.c_str());
+        throw std::runtime_error("Shader compilation failed");
+    }
+    ThrowIfFailed(D3DCreateBlob(bytecode.size(), &blob));
+    memcpy(blob->GetBufferPointer(), bytecode.data(), bytecode.size());
 }
 
 void RenderingSystem::CreateRootSignature() {
@@ -276,14 +348,23 @@ void RenderingSystem::CreateRootSignature() {
     srvRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0);
 
     // 2. Параметры корневой сигнатуры
-    CD3DX12_ROOT_PARAMETER params[2];
+    CD3DX12_ROOT_PARAMETER params[7];
 
-    // ВАЖНО: Индекс 0 должен быть CBV (константный буфер)
+    // ВАЖНО: Индекс 0 должен быть CBV (константы объекта, b0)
     params[0].InitAsConstantBufferView(0, 0, D3D12_SHADER_VISIBILITY_ALL);
 
     // Индекс 1 должен быть Descriptor Table (текстуры)
     params[1].InitAsDescriptorTable(1, &srvRange, D3D12_SHADER_VISIBILITY_ALL);
 
+    // Константы кадра (b1) и материала (b2)
+    params[2].InitAsConstantBufferView(1, 0, D3D12_SHADER_VISIBILITY_ALL);
+    params[3].InitAsConstantBufferView(2, 0, D3D12_SHADER_VISIBILITY_ALL);
+
+    // Экземпляры: начало отрисовки в списке видимых (b3), матрицы (t3), список видимых (t4)
+    params[4].InitAsConstants(1, 3, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    params[5].InitAsShaderResourceView(3, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    params[6].InitAsShaderResourceView(4, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
     // 3. Статический сэмплер
     CD3DX12_STATIC_SAMPLER_DESC sampler(0,
         D3D12_FILTER_MIN_MAG_MIP_LINEAR,
@@ -294,7 +375,7 @@ void RenderingSystem::CreateRootSignature() {
         D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK,
         0.0f, D3D12_SHADER_VISIBILITY_ALL);
 
-    CD3DX12_ROOT_SIGNATURE_DESC rsDesc(2, params, 1, &sampler, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    CD3DX12_ROOT_SIGNATURE_DESC rsDesc(_countof(params), params, 1, &sampler, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
     ComPtr<ID3DBlob> serialized, errors;
     HRESULT hr = D3D12SerializeRootSignature(&rsDesc, D3D_ROOT_SIGNATURE_VERSION_1, &serialized, &errors);
@@ -332,8 +413,8 @@ void RenderingSystem::CreatePipelineStateObject() {
     D3D12_GRAPHICS_PIPELINE_STATE_DESC pso{};
     pso.InputLayout = { layout, _countof(layout) };
     pso.pRootSignature = m_rootSignature.Get();
-    pso.VS = { m_vsBlob->GetBufferPointer(), m_vsBlob->GetBufferSize() };
-    pso.PS = { m_psBlob->GetBufferPointer(), m_psBlob->GetBufferSize() };
+    pso.VS = { m_phongVSBlob->GetBufferPointer(), m_phongVSBlob->GetBufferSize() };
+    pso.PS = { m_phongPSBlob->GetBufferPointer(), m_phongPSBlob->GetBufferSize() };
 
     D3D12_BLEND_DESC blendDesc = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
     blendDesc.RenderTarget[0].BlendEnable = TRUE;
@@ -352,26 +433,36 @@ void RenderingSystem::CreatePipelineStateObject() {
     ThrowIfFailed(m_device->CreateGraphicsPipelineState(&pso, IID_PPV_ARGS(&m_pso)));
 }
 
-void RenderingSystem::CreateGeometryPassPSO() {
+void RenderingSystem::CreateGeometryPassPSO(uint32_t key) {
     D3D12_INPUT_ELEMENT_DESC layout[] = {
         { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
         { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
         { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
     };
+    const bool tessellated = (key & GEOMETRY_TESSELLATED) != 0;
+    ComPtr<ID3DBlob> vs = m_geometryShaders->Get(GeometryStageVariant(key, GeometryStage::Vertex));
+    ComPtr<ID3DBlob> ps = m_geometryShaders->Get(GeometryStageVariant(key, GeometryStage::Pixel));
+    ComPtr<ID3DBlob> hs, ds;
+    if (tessellated) {
+        hs = m_geometryShaders->Get(GeometryStageVariant(key, GeometryStage::Hull));
+        ds = m_geometryShaders->Get(GeometryStageVariant(key, GeometryStage::Domain));
+    }
 
     D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
     psoDesc.InputLayout = { layout, _countof(layout) };
     psoDesc.pRootSignature = m_rootSignature.Get();
-    psoDesc.VS = { m_vsBlob->GetBufferPointer(), m_vsBlob->GetBufferSize() };
-    psoDesc.HS = { m_hsBlob->GetBufferPointer(), m_hsBlob->GetBufferSize() };
-    psoDesc.DS = { m_dsBlob->GetBufferPointer(), m_dsBlob->GetBufferSize() };
-    psoDesc.PS = { m_psBlob->GetBufferPointer(), m_psBlob->GetBufferSize() };
+    psoDesc.VS = { vs->GetBufferPointer(), vs->GetBufferSize() };
+    if (tessellated) {
+        psoDesc.HS = { hs->GetBufferPointer(), hs->GetBufferSize() };
+        psoDesc.DS = { ds->GetBufferPointer(), ds->GetBufferSize() };
+    }
+    psoDesc.PS = { ps->GetBufferPointer(), ps->GetBufferSize() };
 
     psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
     psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
     psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
     psoDesc.SampleMask = UINT_MAX;
-    psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_PATCH;
+    psoDesc.PrimitiveTopologyType = tessellated ? D3D12_PRIMITIVE_TOPOLOGY_TYPE_PATCH : D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
     psoDesc.NumRenderTargets = 3;
     psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
     psoDesc.RTVFormats[1] = DXGI_FORMAT_R16G16B16A16_FLOAT;
@@ -379,14 +470,14 @@ void RenderingSystem::CreateGeometryPassPSO() {
     psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
     psoDesc.SampleDesc = { 1, 0 };
 
-    ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_geometryPassPSO)));
+    ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_geometryPSOs[key])));
 
     // === WIREFRAME PSO ===
     psoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
     psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
     psoDesc.RasterizerState.AntialiasedLineEnable = FALSE; 
     psoDesc.RasterizerState.MultisampleEnable = FALSE;
-    ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_wireframePSO)));
+    ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_wireframePSOs[key])));
 }
 
 void RenderingSystem::CreateLightingPassPSO() {
@@ -432,39 +523,147 @@ void RenderingSystem::CreateCubeGeometry() {
     std::vector<UINT> i(idx.begin(), idx.end());
     MeshSubset sub; sub.indexStart = 0; sub.indexCount = 36;
     sub.materialIdx = 0;
+    sub.radius = sqrtf(3.f);
     m_subsets = { sub };
+    m_meshCopies[DRAW_MESH_SCENE].clear();
+    m_occluders.clear();
+    m_pvs.Clear();
+    m_sceneBvh.Clear();
+    m_instancesDirty = true;
 
     GpuMaterial mat; mat.diffuse = { 1.0f, 0.0f, 1.0f, 1.f };
     mat.specular = { 0.8f, 0.8f, 0.8f, 1.f };
     mat.shininess = 32.f; mat.hasTexture = false;
+    AssignPermutation(mat);
     m_gpuMaterials = { mat };
+    UploadMaterialConstants(m_gpuMaterials, m_materialConstants);
     UploadMeshToGpu(v, i);
 }
 
 void RenderingSystem::UploadMeshToGpu(const std::vector<Vertex>& verts, const std::vector<UINT>& indices) {
-    m_vertexBuffer.Reset(); m_indexBuffer.Reset();
-    auto upload = [&](const void* data, UINT sz, ComPtr<ID3D12Resource>& buf) {
-        CD3DX12_HEAP_PROPERTIES hp(D3D12_HEAP_TYPE_UPLOAD);
-        CD3DX12_RESOURCE_DESC rd = CD3DX12_RESOURCE_DESC::Buffer(sz);
-        ThrowIfFailed(m_device->CreateCommittedResource(&hp, D3D12_HEAP_FLAG_NONE, &rd, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&buf)));
-        void* p = nullptr; buf->Map(0, nullptr, &p); memcpy(p, data, sz);
-        buf->Unmap(0, nullptr);
-        };
     UINT vbSz = (UINT)(verts.size() * sizeof(Vertex));
     UINT ibSz = (UINT)(indices.size() * sizeof(UINT));
-    upload(verts.data(), vbSz, m_vertexBuffer);
-    upload(indices.data(), ibSz, m_indexBuffer);
+    BufferUpload vb, ib;
+    if (!PrepareBuffer(verts.data(), vbSz, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, vb) ||
+        !PrepareBuffer(indices.data(), ibSz, D3D12_RESOURCE_STATE_INDEX_BUFFER, ib))
+        throw std::runtime_error("Mesh buffer creation failed!\n");
+    RecordBufferUpload(vb);
+    RecordBufferUpload(ib);
+    m_vertexBuffer = vb.buffer;
+    m_indexBuffer = ib.buffer;
     m_vbView = { m_vertexBuffer->GetGPUVirtualAddress(), vbSz, sizeof(Vertex) };
     m_ibView = { m_indexBuffer->GetGPUVirtualAddress(), ibSz, DXGI_FORMAT_R32_UINT };
 }
 
-void RenderingSystem::CreateConstantBuffer() {
-    m_cbSlotSize = (sizeof(ConstantBufferData) + 255) & ~255;
-    UINT totalSize = m_cbSlotSize * MAX_SUBSETS * FRAME_COUNT;
-    CD3DX12_HEAP_PROPERTIES hp(D3D12_HEAP_TYPE_UPLOAD);
-    CD3DX12_RESOURCE_DESC rd = CD3DX12_RESOURCE_DESC::Buffer(totalSize);
-    ThrowIfFailed(m_device->CreateCommittedResource(&hp, D3D12_HEAP_FLAG_NONE, &rd, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_constantBuffer)));
-    m_constantBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_cbMapped));
+void RenderingSystem::CreateFrameConstants() {
+    if (!m_frameConstants.Init(m_device.Get(), FRAME_COUNT, FRAME_CONSTANTS_SIZE))
+        throw std::runtime_error("Frame constants creation failed!\n");
+}
+
+// Старый буфер читают кадры до fence текущего. Буфер не переносится дефрагментацией:
+// адреса блоков хранятся в материалах
+bool RenderingSystem::UploadMaterialConstants(std::vector<GpuMaterial>& materials, ComPtr<ID3D12Resource>& buffer) {
+    RetireResource(std::move(buffer));
+    for (auto& m : materials) m.constants = 0;
+    if (materials.empty()) return true;
+
+    std::vector<MaterialConstants> blocks(materials.size());
+    for (size_t i = 0; i < materials.size(); ++i) {
+        const GpuMaterial& m = materials[i];
+        MaterialConstants& c = blocks[i];
+        c.Diffuse = m.diffuse;
+        c.Specular = m.specular;
+        c.Specular.w = m.shininess;
+        c.UvRect = m.uvRect;
+        c.HasTexture = m.hasTexture ? 1 : 0;
+        c.DisplacementScale = m.displacementScale;
+        c.TexSlice = (float)m.textureSlice;
+    }
+    BufferUpload upload;
+    if (!PrepareBuffer(blocks.data(), (UINT)(blocks.size() * sizeof(MaterialConstants)),
+        D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, upload)) {
+        OutputDebugStringA("[Constants] Material constants buffer creation failed\n");
+        return false;
+    }
+    RecordBufferUpload(upload);
+    buffer = upload.buffer;
+    const D3D12_GPU_VIRTUAL_ADDRESS base = buffer->GetGPUVirtualAddress();
+    for (size_t i = 0; i < materials.size(); ++i) materials[i].constants = base + i * sizeof(MaterialConstants);
+    return true;
+}
+
+void RenderingSystem::BindFrameConstants(float totalTime) {
+    const FrameConstants frame = MakeFrameConstants(m_camera, (float)m_width / (float)m_height, totalTime, m_frameSettings, m_view);
+    const D3D12_GPU_VIRTUAL_ADDRESS address = m_frameConstants.Push(frame);
+    if (!address) throw std::runtime_error("Frame constants allocation failed");
+    m_cmdList->SetGraphicsRootConstantBufferView(2, address);
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS RenderingSystem::PushObjectConstants(const XMFLOAT2& texScroll) {
+    ObjectConstants block{};
+    block.TexScrollX = texScroll.x;
+    block.TexScrollY = texScroll.y;
+    const D3D12_GPU_VIRTUAL_ADDRESS address = m_frameConstants.Push(block);
+    if (!address) throw std::runtime_error("Frame constants allocation failed");
+    return address;
+}
+
+// Старый буфер читают кадры до fence текущего. Матрицы экземпляров идут за блоками мешей
+bool RenderingSystem::UploadObjectConstants() {
+    ObjectConstants blocks[DRAW_MESH_COUNT] = {};
+    // Текстура пня не прокручивается
+    blocks[DRAW_MESH_SCENE].TexScrollX = m_texScroll.x;
+    blocks[DRAW_MESH_SCENE].TexScrollY = m_texScroll.y;
+    const size_t instanceBytes = m_instances.size() * sizeof(InstanceData);
+    std::vector<uint8_t> data(sizeof(blocks) + instanceBytes);
+    memcpy(data.data(), blocks, sizeof(blocks));
+    memcpy(data.data() + sizeof(blocks), m_instances.data(), instanceBytes);
+    BufferUpload upload;
+    if (!PrepareBuffer(data.data(), (UINT)data.size(),
+        D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, upload)) {
+        OutputDebugStringA("[Constants] Object constants buffer creation failed\n");
+        return false;
+    }
+    RecordBufferUpload(upload);
+    RetireResource(std::move(m_objectConstants));
+    m_objectConstants = upload.buffer;
+    const D3D12_GPU_VIRTUAL_ADDRESS base = m_objectConstants->GetGPUVirtualAddress();
+    for (UINT i = 0; i < DRAW_MESH_COUNT; ++i) m_objectAddresses[i] = base + i * sizeof(ObjectConstants);
+    m_instanceAddress = base + sizeof(blocks);
+    m_objectsDirty = false;
+    return true;
+}
+
+void RenderingSystem::PrepareObjectConstants() {
+    if (m_instancesDirty) RebuildInstances();
+    if (!m_objectsDirty || UploadObjectConstants()) return;
+    m_objectAddresses[DRAW_MESH_SCENE] = PushObjectConstants(m_texScroll);
+    m_objectAddresses[DRAW_MESH_STUMP] = PushObjectConstants(XMFLOAT2(0.0f, 0.0f));
+    m_instanceAddress = m_frameConstants.Push(m_instances.data(), m_instances.size() * sizeof(InstanceData));
+    if (!m_instanceAddress) throw std::runtime_error("Frame constants allocation failed");
+}
+
+void RenderingSystem::AddStumpInstance(const XMFLOAT3& position)
+{
+    m_stumpPositions.push_back(position);
+    m_instancesDirty = true;
+}
+
+void RenderingSystem::RebuildInstances()
+{
+    m_instances.clear();
+    for (auto& blocks : m_meshInstances) blocks.clear();
+    m_meshInstances[DRAW_MESH_SCENE].push_back((uint32_t)m_instances.size());
+    AppendMeshInstances(XMMatrixIdentity(), m_meshCopies[DRAW_MESH_SCENE], m_instances);
+    for (const XMFLOAT3& position : m_stumpPositions)
+    {
+        m_meshInstances[DRAW_MESH_STUMP].push_back((uint32_t)m_instances.size());
+        AppendMeshInstances(StumpWorld(position), m_meshCopies[DRAW_MESH_STUMP], m_instances);
+    }
+    m_instancesDirty = false;
+    m_objectsDirty = true;
+    MarkDrawsDirty(DRAW_MESH_SCENE);
+    MarkDrawsDirty(DRAW_MESH_STUMP);
 }
 
 void RenderingSystem::CreateScreenQuad() {
@@ -476,218 +675,868 @@ void RenderingSystem::CreateScreenQuad() {
         {XMFLOAT3(1, 1,0), XMFLOAT2(1,0)}
     };
     UINT sz = sizeof(vertices);
-    CD3DX12_HEAP_PROPERTIES hp(D3D12_HEAP_TYPE_UPLOAD);
-    CD3DX12_RESOURCE_DESC rd = CD3DX12_RESOURCE_DESC::Buffer(sz);
-    ThrowIfFailed(m_device->CreateCommittedResource(
-        &hp, D3D12_HEAP_FLAG_NONE, &rd,
-        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_screenQuadVB)
-    ));
-    UINT8* pData;
-    ThrowIfFailed(m_screenQuadVB->Map(0, nullptr, reinterpret_cast<void**>(&pData)));
-    memcpy(pData, vertices, sz); m_screenQuadVB->Unmap(0, nullptr);
+    BufferUpload vb;
+    if (!PrepareBuffer(vertices, sz, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, vb))
+        throw std::runtime_error("Screen quad creation failed!\n");
+    RecordBufferUpload(vb);
+    m_screenQuadVB = vb.buffer;
     m_screenQuadVBView = { m_screenQuadVB->GetGPUVirtualAddress(), sz, sizeof(SQV) };
 }
 
-bool RenderingSystem::LoadObj(const std::string& path) {
-    if (m_initialized) FlushCommandQueue();
-    ObjMesh mesh;
-    if (!ObjLoader::Load(path, mesh)) return false;
-
+static std::vector<Vertex> ToVertices(const ObjMesh& mesh) {
     std::vector<Vertex> verts(mesh.vertices.size());
     for (size_t i = 0; i < verts.size(); ++i) {
         verts[i].Position = mesh.vertices[i].Position;
         verts[i].Normal = mesh.vertices[i].Normal;
         verts[i].TexCoord = mesh.vertices[i].TexCoord;
     }
-    m_subsets = mesh.subsets;
-    std::string dir; size_t p = path.find_last_of("/\\");
-    if (p != std::string::npos) dir = path.substr(0, p + 1);
+    return verts;
+}
 
-    ThrowIfFailed(m_cmdAllocators[m_frameIndex]->Reset());
-    ThrowIfFailed(m_cmdList->Reset(m_cmdAllocators[m_frameIndex].Get(), nullptr));
+static void ApplyMaterialConstants(const Material& src, GpuMaterial& dst) {
+    dst.diffuse = src.diffuse; dst.specular = src.specular; dst.shininess = src.shininess;
+    if (dst.diffuse.x == 0 && dst.diffuse.y == 0 && dst.diffuse.z == 0) dst.diffuse = XMFLOAT4(0.7f, 0.7f, 0.7f, 1.0f);
+}
+
+// Сцена OBJ: в пуле - разбор, декодирование, упаковка текстур и заполнение буферов загрузки;
+// на потоке отрисовки - только дескрипторы и команды копирования
+class RenderingSystem::SceneUpload : public PendingUpload {
+public:
+    // preferLoose - перезагрузка после правки: файлы каталога вместо записей архива
+    explicit SceneUpload(RenderingSystem& rs, bool preferLoose = false) : m_rs(rs), m_preferLoose(preferLoose) {}
+    bool Prepare(const std::string& path);
+    bool Prepare(const std::string& path, const ObjMesh& mesh);
+    bool Record() override;
+    void MakeVisible() override;
+
+private:
+    void PrepareTextures(const ObjMesh& mesh);
+
+    RenderingSystem& m_rs;
+    bool m_preferLoose = false;
+    std::string m_path;
+    std::vector<std::string> m_libraries;
+    std::map<std::string, SceneTexture> m_textures;
+    std::vector<Material> m_materials;
+    std::vector<MeshSubset> m_subsets;
+    std::vector<XMFLOAT4X4> m_copies;
+    std::vector<XMFLOAT3> m_occluders;
+    PotentiallyVisibleSet m_pvs;
+    TriangleBvh m_bvh;
+    BufferUpload m_vertices;
+    BufferUpload m_indices;
+    D3D12_VERTEX_BUFFER_VIEW m_vbView{};
+    D3D12_INDEX_BUFFER_VIEW m_ibView{};
+    TexturePacker::Result m_packed;
+    std::vector<int> m_materialTexture;
+    std::vector<TextureLoader::TextureUpload> m_groupUploads;
+    std::vector<GpuTextureGroup> m_groups;
+    std::vector<GpuMaterial> m_gpuMaterials;
+};
+
+bool RenderingSystem::SceneUpload::Prepare(const std::string& path) {
+    ObjMesh mesh;
+    if (!m_rs.LoadSceneMesh(path, mesh, m_preferLoose)) return false;
+    return Prepare(path, mesh);
+}
 
-    LoadMaterials(mesh, dir);
-    UploadMeshToGpu(verts, mesh.indices);
+bool RenderingSystem::SceneUpload::Prepare(const std::string& path, const ObjMesh& mesh) {
+    m_path = VirtualFileSystem::Normalize(path);
+    m_libraries = mesh.materialLibraries;
+    m_materials = mesh.materials;
+    m_subsets = mesh.subsets;
+    m_copies = mesh.instances;
+    m_occluders = SelectOccluders(mesh, OCCLUSION_OCCLUDERS);
+    m_rs.LoadScenePvs(path, mesh, m_pvs);
+    m_rs.BuildSceneBvh(mesh, m_bvh);
 
-    ThrowIfFailed(m_cmdList->Close());
-    ID3D12CommandList* cmds[] = { m_cmdList.Get() };
-    m_cmdQueue->ExecuteCommandLists(1, cmds);
-    WaitForGPU();
-    for (auto& mat : m_gpuMaterials) mat.textureUpload.Reset();
+    std::vector<Vertex> verts = ToVertices(mesh);
+    UINT vbSz = (UINT)(verts.size() * sizeof(Vertex));
+    UINT ibSz = (UINT)(mesh.indices.size() * sizeof(UINT));
+    if (!m_rs.PrepareBuffer(verts.data(), vbSz, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, m_vertices)) return false;
+    if (!m_rs.PrepareBuffer(mesh.indices.data(), ibSz, D3D12_RESOURCE_STATE_INDEX_BUFFER, m_indices)) return false;
+    m_vbView = { m_vertices.buffer->GetGPUVirtualAddress(), vbSz, sizeof(Vertex) };
+    m_ibView = { m_indices.buffer->GetGPUVirtualAddress(), ibSz, DXGI_FORMAT_R32_UINT };
+
+    PrepareTextures(mesh);
     return true;
 }
 
-void RenderingSystem::LoadMaterials(const ObjMesh& mesh, const std::string& baseDir) {
-    m_gpuMaterials.clear();
-    if (mesh.materials.empty()) {
-        GpuMaterial def; def.diffuse = { 0.8f,0.8f,0.8f,1.f };
-        def.specular = { 0.5f,0.5f,0.5f,1.f };
-        def.shininess = 32.f; def.hasTexture = false; m_gpuMaterials.push_back(def); return;
-    }
-    m_gpuMaterials.resize(mesh.materials.size());
+void RenderingSystem::SceneUpload::PrepareTextures(const ObjMesh& mesh) {
+    // Декодируем каждую диффузную текстуру один раз, даже если на нее ссылаются несколько материалов
+    std::vector<std::string> paths;
+    std::map<std::string, int> pathIndex;
+    std::vector<int> materialPath(mesh.materials.size(), -1);
     for (size_t i = 0; i < mesh.materials.size(); ++i) {
-        const Material& src = mesh.materials[i];
-        GpuMaterial& dst = m_gpuMaterials[i];
-        dst.diffuse = src.diffuse; dst.specular = src.specular; dst.shininess = src.shininess;
-        if (dst.diffuse.x == 0 && dst.diffuse.y == 0 && dst.diffuse.z == 0) dst.diffuse = XMFLOAT4(0.7f, 0.7f, 0.7f, 1.0f);
-        dst.srvHeapIndex = m_currentSrvSlot;
-        CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_cbvSrvHeap->GetCPUDescriptorHandleForHeapStart(), m_currentSrvSlot, m_cbvSrvDescSize);
+        const std::string& tex = mesh.materials[i].diffuseTexture;
+        if (tex.empty()) continue;
+        auto it = pathIndex.emplace(tex, (int)paths.size()).first;
+        if (it->second == (int)paths.size()) paths.push_back(tex);
+        materialPath[i] = it->second;
+    }
 
-        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
-        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srvDesc.Texture2D.MipLevels = 1;
-
-        if (!src.diffuseTexture.empty()) {
-            std::wstring wpath(baseDir.begin(), baseDir.end());
-            std::wstring wtex(src.diffuseTexture.begin(), src.diffuseTexture.end());
-            wpath += wtex;
-
-            TextureLoader::TextureData td;
-            if (TextureLoader::LoadFromFile(wpath, td) && TextureLoader::CreateTexture(m_device.Get(), m_cmdList.Get(), td, dst.texture, dst.textureUpload)) {
-                srvDesc.Format = td.format;
-                m_device->CreateShaderResourceView(dst.texture.Get(), &srvDesc, srvHandle);
-                dst.hasTexture = true;
-            }
-            else {
-                m_device->CreateShaderResourceView(m_defaultDiffuseTex.Get(), &srvDesc, srvHandle);
+    std::vector<TextureLoader::TextureData> decoded;
+    std::vector<bool> loaded;
+    m_rs.LoadTextures(paths, decoded, loaded, m_preferLoose);
+
+    std::vector<TextureLoader::TextureData> textures;
+    std::vector<int> textureOfPath(paths.size(), -1);
+    for (size_t p = 0; p < paths.size(); ++p) {
+        if (!loaded[p]) continue;
+        textureOfPath[p] = (int)textures.size();
+        textures.push_back(std::move(decoded[p]));
+    }
+    m_materialTexture.assign(mesh.materials.size(), -1);
+    for (size_t i = 0; i < mesh.materials.size(); ++i)
+        if (materialPath[i] >= 0) m_materialTexture[i] = textureOfPath[materialPath[i]];
+    for (const std::string& path : paths) m_textures[path] = SceneTexture();
+
+    std::vector<TexturePacker::Input> inputs(textures.size());
+    for (size_t i = 0; i < textures.size(); ++i)
+        inputs[i] = { textures[i].width, textures[i].height, (uint32_t)textures[i].format };
+    TexturePacker::Settings settings;
+    m_packed = TexturePacker::Pack(inputs, settings);
+    const uint32_t padding = TexturePacker::Padding(settings);
+
+    // Где лежит каждая текстура - для горячей перезагрузки на месте
+    for (size_t p = 0; p < paths.size(); ++p) {
+        int t = textureOfPath[p];
+        if (t < 0) continue;
+        const PackedTextureRef& r = m_packed.refs[t];
+        SceneTexture& info = m_textures[paths[p]];
+        info.group = r.group;
+        info.slice = r.slice;
+        info.x = r.x;
+        info.y = r.y;
+        info.width = textures[t].width;
+        info.height = textures[t].height;
+        info.format = textures[t].format;
+        info.atlas = r.group >= 0 && m_packed.groups[r.group].kind == TexturePackGroup::Kind::Atlas;
+        info.padding = info.atlas ? padding : 0;
+    }
+
+    m_groupUploads.resize(m_packed.groups.size());
+    for (size_t g = 0; g < m_packed.groups.size(); ++g) {
+        const TexturePackGroup& group = m_packed.groups[g];
+
+        TextureLoader::TextureData atlas;
+        std::vector<const TextureLoader::TextureData*> slices;
+        if (group.kind == TexturePackGroup::Kind::Atlas) {
+            atlas.width = group.width;
+            atlas.height = group.height;
+            atlas.format = (DXGI_FORMAT)group.format;
+            atlas.rowPitch = group.width * 4;
+            atlas.pixels.assign((size_t)atlas.rowPitch * group.height, 0);
+            for (int m : group.members) {
+                const PackedTextureRef& r = m_packed.refs[m];
+                TexturePacker::BlitToAtlas(textures[m].pixels.data(), textures[m].width, textures[m].height,
+                    atlas.pixels.data(), atlas.width, r.x, r.y, padding);
             }
+            slices.push_back(&atlas);
         }
         else {
-            m_device->CreateShaderResourceView(m_defaultDiffuseTex.Get(), &srvDesc, srvHandle);
+            for (int m : group.members) slices.push_back(&textures[m]);
         }
-        srvHandle.Offset(1, m_cbvSrvDescSize);
-        m_device->CreateShaderResourceView(m_defaultNormalTex.Get(), &srvDesc, srvHandle);
-        srvHandle.Offset(1, m_cbvSrvDescSize);
-        m_device->CreateShaderResourceView(m_defaultDisplacementTex.Get(), &srvDesc, srvHandle);
+        if (!TextureLoader::PrepareTextureArray(m_rs.m_device.Get(), slices, m_groupUploads[g], &m_rs.m_uploadRing, &m_rs.m_gpuHeaps))
+            m_groupUploads[g] = TextureLoader::TextureUpload();
+    }
+}
+
+bool RenderingSystem::SceneUpload::Record() {
+    RenderingSystem& rs = m_rs;
+    // Таблицы выделяются до записи копирований: без места загрузка не начинается
+    m_groups.resize(m_groupUploads.size());
+    for (size_t g = 0; g < m_groupUploads.size(); ++g) {
+        if (!m_groupUploads[g].texture) continue;
+        m_groups[g].srvTable = rs.m_descriptors.Allocate(3);
+        if (!m_groups[g].srvTable.IsEmpty()) continue;
+        for (auto& group : m_groups) rs.m_descriptors.Free(group.srvTable, 0);
+        OutputDebugStringA("[SceneUpload] Descriptor heap exhausted\n");
+        return false;
+    }
+
+    rs.RecordBufferUpload(m_vertices);
+    rs.RecordBufferUpload(m_indices);
+    if (m_materials.empty()) {
+        GpuMaterial def; def.diffuse = { 0.8f,0.8f,0.8f,1.f };
+        def.specular = { 0.5f,0.5f,0.5f,1.f };
+        def.shininess = 32.f; def.hasTexture = false; AssignPermutation(def); m_gpuMaterials.push_back(def);
+        return true;
+    }
 
-        m_currentSrvSlot += 3;
+    // Одна таблица [diffuse array, normal, displacement] на группу вместо таблицы на материал
+    for (size_t g = 0; g < m_groupUploads.size(); ++g) {
+        TextureLoader::TextureUpload& upload = m_groupUploads[g];
+        GpuTextureGroup& gpu = m_groups[g];
+        if (!upload.texture) continue;
+        TextureLoader::RecordTextureUpload(rs.m_cmdList.Get(), upload, rs.m_fenceValues[rs.m_frameIndex]);
+        gpu.texture = upload.texture;
+        rs.WriteMaterialTable(gpu.srvTable.index, gpu.texture.Get(), nullptr, nullptr);
+    }
+    m_groupUploads.clear();
+
+    m_gpuMaterials.resize(m_materials.size());
+    UINT texturedMaterials = 0;
+    for (size_t i = 0; i < m_materials.size(); ++i) {
+        const Material& src = m_materials[i];
+        GpuMaterial& dst = m_gpuMaterials[i];
+        ApplyMaterialConstants(src, dst);
+        AssignPermutation(dst);
+
+        int t = m_materialTexture[i];
+        if (t < 0) continue;
+        const PackedTextureRef& r = m_packed.refs[t];
+        if (r.group < 0 || m_groups[r.group].srvTable.IsEmpty()) continue;
+        dst.srvTable = m_groups[r.group].srvTable;
+        dst.textureSlice = r.slice;
+        dst.uvRect = XMFLOAT4(r.uvRect[0], r.uvRect[1], r.uvRect[2], r.uvRect[3]);
+        dst.hasTexture = true;
+        AssignPermutation(dst);
+        ++texturedMaterials;
     }
+
+    char msg[256];
+    sprintf_s(msg, "[TexturePacker] %u textures -> %u arrays + %u atlases, efficiency %.1f%%, descriptor tables %u -> %u\n",
+        m_packed.stats.inputTextures, m_packed.stats.arrays, m_packed.stats.atlases, m_packed.stats.efficiency * 100.0,
+        texturedMaterials, (UINT)m_groups.size());
+    OutputDebugStringA(msg);
+
+    UINT perPermutation[GEOMETRY_PERMUTATION_COUNT] = {};
+    for (const MeshSubset& sub : m_subsets)
+        if (sub.materialIdx >= 0 && sub.materialIdx < (int)m_gpuMaterials.size()) ++perPermutation[m_gpuMaterials[sub.materialIdx].permutation];
+    for (uint32_t key = 0; key < GEOMETRY_PERMUTATION_COUNT; ++key) {
+        if (perPermutation[key] == 0) continue;
+        sprintf_s(msg, "[Permutations] %s: %u subsets\n", GeometryPermutationName(key).c_str(), perPermutation[key]);
+        OutputDebugStringA(msg);
+    }
+    return true;
 }
 
-bool RenderingSystem::LoadStump(const std::string& path) {
-    if (m_initialized) FlushCommandQueue();
-    ThrowIfFailed(m_cmdAllocators[m_frameIndex]->Reset());
-    ThrowIfFailed(m_cmdList->Reset(m_cmdAllocators[m_frameIndex].Get(), nullptr));
+void RenderingSystem::SceneUpload::MakeVisible() {
+    // Старые буферы, текстуры и таблицы могут читать кадры, которые еще на GPU
+    for (auto& group : m_rs.m_textureGroups) {
+        m_rs.RetireResource(group.texture);
+        m_rs.m_descriptors.Free(group.srvTable, m_rs.m_fenceValues[m_rs.m_frameIndex]);
+    }
+    m_rs.RetireResource(m_rs.m_vertexBuffer);
+    m_rs.RetireResource(m_rs.m_indexBuffer);
+
+    m_rs.m_textureGroups = std::move(m_groups);
+    m_rs.m_gpuMaterials = std::move(m_gpuMaterials);
+    m_rs.UploadMaterialConstants(m_rs.m_gpuMaterials, m_rs.m_materialConstants);
+    m_rs.m_subsets = std::move(m_subsets);
+    m_rs.m_meshCopies[DRAW_MESH_SCENE] = std::move(m_copies);
+    m_rs.m_occluders = std::move(m_occluders);
+    m_rs.m_pvs = std::move(m_pvs);
+    m_rs.m_sceneBvh = std::move(m_bvh);
+    m_rs.m_instancesDirty = true;
+    m_rs.m_vertexBuffer = m_vertices.buffer;
+    m_rs.m_indexBuffer = m_indices.buffer;
+    m_rs.m_vbView = m_vbView;
+    m_rs.m_ibView = m_ibView;
+    m_rs.m_scenePath = m_path;
+    m_rs.m_sceneLibraries = std::move(m_libraries);
+    m_rs.m_sceneMaterials = std::move(m_materials);
+    m_rs.m_sceneTextures = std::move(m_textures);
+    m_rs.MarkDrawsDirty(DRAW_MESH_SCENE);
+
+    // Копирования выполнены, ресурсы в рабочих состояниях - их можно переносить
+    for (const auto& group : m_rs.m_textureGroups)
+        if (group.texture) m_rs.m_gpuHeaps.SetRelocatable(group.texture.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    m_rs.m_gpuHeaps.SetRelocatable(m_rs.m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+    m_rs.m_gpuHeaps.SetRelocatable(m_rs.m_indexBuffer.Get(), D3D12_RESOURCE_STATE_INDEX_BUFFER);
+    m_rs.m_gpuHeaps.LogStats("Scene loaded");
+}
 
+// Пень: меш и три текстуры (basecolor, normal, displacement) в одной таблице дескрипторов
+class RenderingSystem::StumpUpload : public PendingUpload {
+public:
+    explicit StumpUpload(RenderingSystem& rs, bool preferLoose = false) : m_rs(rs), m_preferLoose(preferLoose) {}
+    bool Prepare(const std::string& path);
+    bool Record() override;
+    void MakeVisible() override;
+
+private:
+    RenderingSystem& m_rs;
+    bool m_preferLoose = false;
+    std::string m_path;
+    std::vector<MeshSubset> m_subsets;
+    BufferUpload m_vertices;
+    BufferUpload m_indices;
+    D3D12_VERTEX_BUFFER_VIEW m_vbView{};
+    D3D12_INDEX_BUFFER_VIEW m_ibView{};
+    TextureLoader::TextureUpload m_diffuse;
+    TextureLoader::TextureUpload m_normal;
+    TextureLoader::TextureUpload m_displacement;
+    GpuMaterial m_material;
+};
+
+bool RenderingSystem::StumpUpload::Prepare(const std::string& path) {
     ObjMesh mesh;
-    if (!ObjLoader::Load(path, mesh)) {
+    if (!m_rs.LoadMesh(path, mesh, m_preferLoose)) {
         return false;
     }
+    m_path = VirtualFileSystem::Normalize(path);
+    m_subsets = mesh.subsets;
 
-    std::vector<Vertex> verts(mesh.vertices.size());
-    for (size_t i = 0; i < verts.size(); ++i) {
-        verts[i].Position = mesh.vertices[i].Position;
-        verts[i].Normal = mesh.vertices[i].Normal;
-        verts[i].TexCoord = mesh.vertices[i].TexCoord;
+    std::vector<Vertex> verts = ToVertices(mesh);
+    UINT vbSz = (UINT)(verts.size() * sizeof(Vertex));
+    UINT ibSz = (UINT)(mesh.indices.size() * sizeof(UINT));
+    if (!m_rs.PrepareBuffer(verts.data(), vbSz, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, m_vertices)) {
+        return false;
+    }
+    if (!m_rs.PrepareBuffer(mesh.indices.data(), ibSz, D3D12_RESOURCE_STATE_INDEX_BUFFER, m_indices)) {
+        return false;
     }
-    m_stumpSubsets = mesh.subsets;
+    m_vbView = { m_vertices.buffer->GetGPUVirtualAddress(), vbSz, sizeof(Vertex) };
+    m_ibView = { m_indices.buffer->GetGPUVirtualAddress(), ibSz, DXGI_FORMAT_R32_UINT };
+
+    // Текстуры пня лежат в textures/<имя obj>/ и различаются по суффиксу имени файла
+    const std::string texDir = "textures/" + VirtualFileSystem::StemOf(path);
+    std::string diffPath, normPath, dispPath;
+    m_rs.m_vfs.FindInDirectory(texDir, "basecolor", diffPath);
+    m_rs.m_vfs.FindInDirectory(texDir, "normal", normPath);
+    m_rs.m_vfs.FindInDirectory(texDir, "displacement", dispPath);
+
+#ifdef TEXTURE_DECODER_BENCHMARK
+    for (const std::string& bench : { diffPath, normPath }) {
+        std::string disk = m_rs.m_vfs.GetDiskPath(bench);
+        if (!disk.empty()) TextureLoader::BenchmarkDecoders(std::wstring(disk.begin(), disk.end()), 5);
+    }
+#endif
 
-    m_stumpMaterials.clear();
-    m_stumpMaterials.resize(1);
-    GpuMaterial& mat = m_stumpMaterials[0];
-    mat.diffuse = { 0.8f, 0.8f, 0.8f, 1.0f };
+    std::vector<TextureLoader::TextureData> textures;
+    std::vector<bool> loaded;
+    m_rs.LoadTextures({ diffPath, normPath, dispPath }, textures, loaded, m_preferLoose);
+    auto prepare = [&](size_t i, TextureLoader::TextureUpload& upload) {
+        if (loaded[i] && TextureLoader::PrepareTextureArray(m_rs.m_device.Get(), { &textures[i] }, upload, &m_rs.m_uploadRing, &m_rs.m_gpuHeaps))
+            return true;
+        upload = TextureLoader::TextureUpload();
+        return false;
+        };
+    prepare(0, m_diffuse);
+    prepare(1, m_normal);
+    if (prepare(2, m_displacement))
+        OutputDebugStringA("[LoadStump] Displacement map loaded successfully (PNG)\n");
+    else
+        OutputDebugStringA("[LoadStump] WARNING: Displacement map FAILED to load, using default (gray=0.5)\n");
+    return true;
+}
+
+bool RenderingSystem::StumpUpload::Record() {
+    RenderingSystem& rs = m_rs;
+    GpuMaterial& mat = m_material;
+    mat.srvTable = rs.m_descriptors.Allocate(3);
+    if (mat.srvTable.IsEmpty()) {
+        OutputDebugStringA("[LoadStump] Descriptor heap exhausted\n");
+        return false;
+    }
+    const UINT64 fence = rs.m_fenceValues[rs.m_frameIndex];
+    rs.RecordBufferUpload(m_vertices);
+    rs.RecordBufferUpload(m_indices);
+    mat.diffuse = { 1.0f, 0.0f, 0.0f, 1.0f };
     mat.specular = { 0.5f, 0.5f, 0.5f, 1.0f };
     mat.shininess = 32.0f;
-    mat.srvHeapIndex = m_currentSrvSlot;
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(
-        m_cbvSrvHeap->GetCPUDescriptorHandleForHeapStart(),
-        m_currentSrvSlot,
-        m_cbvSrvDescSize
-    );
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MipLevels = 1;
+    // basecolor, normal, displacement; чего нет - берется текстура по умолчанию
+    auto record = [&](TextureLoader::TextureUpload& upload, ComPtr<ID3D12Resource>& texture) {
+        if (!upload.texture) return;
+        TextureLoader::RecordTextureUpload(rs.m_cmdList.Get(), upload, fence);
+        texture = upload.texture;
+        };
+    record(m_diffuse, mat.texture);
+    record(m_normal, mat.normalTexture);
+    record(m_displacement, mat.displacementTexture);
+    rs.WriteMaterialTable(mat.srvTable.index, mat.texture.Get(), mat.normalTexture.Get(), mat.displacementTexture.Get());
+    mat.hasTexture = mat.texture != nullptr;
+
+    // Без карты высот тесселяция ничего не сдвигает - пень рисуется списком треугольников
+    mat.hasNormalMap = m_normal.texture != nullptr;
+    mat.displacementScale = m_displacement.texture ? 15.0f : 0.0f;
+    AssignPermutation(mat);
+    m_diffuse = m_normal = m_displacement = TextureLoader::TextureUpload();
+    return true;
+}
 
-    // diffuse (BaseColor)
-    {
-        std::wstring diffPath = L"textures/broken_stump/Broken_Stump_rkswd_High_4K_BaseColor.jpg";
-        TextureLoader::TextureData td;
-        if (TextureLoader::LoadFromFile(diffPath, td) &&
-            TextureLoader::CreateTexture(m_device.Get(), m_cmdList.Get(), td, mat.texture, mat.textureUpload)) {
-            srvDesc.Format = td.format;
-            m_device->CreateShaderResourceView(mat.texture.Get(), &srvDesc, srvHandle);
-            mat.hasTexture = true;
-        }
-        else {
-            m_device->CreateShaderResourceView(m_defaultDiffuseTex.Get(), &srvDesc, srvHandle);
-        }
-        srvHandle.Offset(1, m_cbvSrvDescSize);
+void RenderingSystem::StumpUpload::MakeVisible() {
+    for (auto& m : m_rs.m_stumpMaterials) {
+        m_rs.m_descriptors.Free(m.srvTable, m_rs.m_fenceValues[m_rs.m_frameIndex]);
+        m_rs.RetireResource(m.texture);
+        m_rs.RetireResource(m.normalTexture);
+        m_rs.RetireResource(m.displacementTexture);
     }
+    m_rs.RetireResource(m_rs.m_stumpVertexBuffer);
+    m_rs.RetireResource(m_rs.m_stumpIndexBuffer);
+
+    m_rs.m_stumpMaterials = { m_material };
+    m_rs.UploadMaterialConstants(m_rs.m_stumpMaterials, m_rs.m_stumpMaterialConstants);
+    m_rs.m_stumpSubsets = std::move(m_subsets);
+    m_rs.m_stumpVertexBuffer = m_vertices.buffer;
+    m_rs.m_stumpIndexBuffer = m_indices.buffer;
+    m_rs.m_stumpVbView = m_vbView;
+    m_rs.m_stumpIbView = m_ibView;
+    m_rs.m_stumpPath = m_path;
+    m_rs.MarkDrawsDirty(DRAW_MESH_STUMP);
+
+    for (const auto& m : m_rs.m_stumpMaterials) {
+        for (const auto* texture : { &m.texture, &m.normalTexture, &m.displacementTexture })
+            if (*texture) m_rs.m_gpuHeaps.SetRelocatable(texture->Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    }
+    m_rs.m_gpuHeaps.SetRelocatable(m_rs.m_stumpVertexBuffer.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+    m_rs.m_gpuHeaps.SetRelocatable(m_rs.m_stumpIndexBuffer.Get(), D3D12_RESOURCE_STATE_INDEX_BUFFER);
+}
 
-    // normal map
-    {
-        std::wstring normPath = L"textures/broken_stump/Broken_Stump_rkswd_High_4K_Normal.jpg";
-        TextureLoader::TextureData td;
-        if (TextureLoader::LoadFromFile(normPath, td) &&
-            TextureLoader::CreateTexture(m_device.Get(), m_cmdList.Get(), td, mat.normalTexture, mat.normalUpload)) {
-            srvDesc.Format = td.format;
-            m_device->CreateShaderResourceView(mat.normalTexture.Get(), &srvDesc, srvHandle);
-        }
-        else {
-            m_device->CreateShaderResourceView(m_defaultNormalTex.Get(), &srvDesc, srvHandle);
-        }
-        srvHandle.Offset(1, m_cbvSrvDescSize);
+// Одна текстура сцены изменилась, размер и формат те же: перезаписываем ее слой массива
+// или прямоугольник атласа на месте, без пересборки групп и дескрипторов
+class RenderingSystem::TextureReload : public PendingUpload {
+public:
+    TextureReload(RenderingSystem& rs, const SceneTexture& info, ComPtr<ID3D12Resource> target)
+        : m_rs(rs), m_info(info), m_target(std::move(target)) {}
+    bool Prepare(const TextureLoader::TextureData& td);
+    bool Record() override;
+    void MakeVisible() override {}
+
+private:
+    RenderingSystem& m_rs;
+    SceneTexture m_info;
+    ComPtr<ID3D12Resource> m_target;
+    TextureLoader::TextureUpload m_upload;
+};
+
+bool RenderingSystem::TextureReload::Prepare(const TextureLoader::TextureData& td) {
+    if (!m_info.atlas) return TextureLoader::PrepareTextureRegion(m_rs.m_device.Get(), td, m_upload, &m_rs.m_uploadRing);
+
+    // В атласе вокруг текстуры рамка из повторенных краев - пишем ее вместе с текстурой
+    const uint32_t pad = m_info.padding;
+    TextureLoader::TextureData padded;
+    padded.width = td.width + 2 * pad;
+    padded.height = td.height + 2 * pad;
+    padded.format = td.format;
+    padded.rowPitch = padded.width * 4;
+    padded.pixels.assign((size_t)padded.rowPitch * padded.height, 0);
+    TexturePacker::BlitToAtlas(td.pixels.data(), td.width, td.height, padded.pixels.data(), padded.width, pad, pad, pad);
+    return TextureLoader::PrepareTextureRegion(m_rs.m_device.Get(), padded, m_upload, &m_rs.m_uploadRing);
+}
+
+bool RenderingSystem::TextureReload::Record() {
+    const UINT pad = m_info.padding;
+    TextureLoader::RecordTextureRegionUpdate(m_rs.m_cmdList.Get(), m_upload, m_target.Get(),
+        m_info.slice, m_info.x - pad, m_info.y - pad, m_rs.m_fenceValues[m_rs.m_frameIndex]);
+    return true;
+}
+
+// Изменился OBJ или MTL, а текстуры материалов те же: меняем константы материалов и,
+// если менялся OBJ, вершины с индексами; текстуры и дескрипторы остаются прежними
+class RenderingSystem::MaterialReload : public PendingUpload {
+public:
+    explicit MaterialReload(RenderingSystem& rs) : m_rs(rs) {}
+    bool Prepare(const std::string& path, const ObjMesh& mesh, bool geometry);
+    bool Record() override;
+    void MakeVisible() override;
+
+private:
+    RenderingSystem& m_rs;
+    std::vector<Material> m_materials;
+    bool m_geometry = false;
+    std::vector<MeshSubset> m_subsets;
+    std::vector<XMFLOAT4X4> m_copies;
+    std::vector<XMFLOAT3> m_occluders;
+    PotentiallyVisibleSet m_pvs;
+    TriangleBvh m_bvh;
+    BufferUpload m_vertices;
+    BufferUpload m_indices;
+    D3D12_VERTEX_BUFFER_VIEW m_vbView{};
+    D3D12_INDEX_BUFFER_VIEW m_ibView{};
+};
+
+bool RenderingSystem::MaterialReload::Prepare(const std::string& path, const ObjMesh& mesh, bool geometry) {
+    m_materials = mesh.materials;
+    m_geometry = geometry;
+    if (!geometry) return true;
+
+    m_subsets = mesh.subsets;
+    m_copies = mesh.instances;
+    m_occluders = SelectOccluders(mesh, OCCLUSION_OCCLUDERS);
+    m_rs.LoadScenePvs(path, mesh, m_pvs);
+    m_rs.BuildSceneBvh(mesh, m_bvh);
+    std::vector<Vertex> verts = ToVertices(mesh);
+    UINT vbSz = (UINT)(verts.size() * sizeof(Vertex));
+    UINT ibSz = (UINT)(mesh.indices.size() * sizeof(UINT));
+    if (!m_rs.PrepareBuffer(verts.data(), vbSz, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, m_vertices)) return false;
+    if (!m_rs.PrepareBuffer(mesh.indices.data(), ibSz, D3D12_RESOURCE_STATE_INDEX_BUFFER, m_indices)) return false;
+    m_vbView = { m_vertices.buffer->GetGPUVirtualAddress(), vbSz, sizeof(Vertex) };
+    m_ibView = { m_indices.buffer->GetGPUVirtualAddress(), ibSz, DXGI_FORMAT_R32_UINT };
+    return true;
+}
+
+bool RenderingSystem::MaterialReload::Record() {
+    if (!m_geometry) return true;
+    m_rs.RecordBufferUpload(m_vertices);
+    m_rs.RecordBufferUpload(m_indices);
+    return true;
+}
+
+void RenderingSystem::MaterialReload::MakeVisible() {
+    // Сцену могли заменить целиком, пока шла перезагрузка
+    if (m_materials.size() != m_rs.m_gpuMaterials.size()) return;
+    for (size_t i = 0; i < m_materials.size(); ++i) ApplyMaterialConstants(m_materials[i], m_rs.m_gpuMaterials[i]);
+    m_rs.UploadMaterialConstants(m_rs.m_gpuMaterials, m_rs.m_materialConstants);
+    m_rs.m_sceneMaterials = std::move(m_materials);
+    m_rs.MarkDrawsDirty(DRAW_MESH_SCENE);
+    if (!m_geometry) return;
+
+    m_rs.RetireResource(m_rs.m_vertexBuffer);
+    m_rs.RetireResource(m_rs.m_indexBuffer);
+    m_rs.m_subsets = std::move(m_subsets);
+    m_rs.m_meshCopies[DRAW_MESH_SCENE] = std::move(m_copies);
+    m_rs.m_occluders = std::move(m_occluders);
+    m_rs.m_pvs = std::move(m_pvs);
+    m_rs.m_sceneBvh = std::move(m_bvh);
+    m_rs.m_instancesDirty = true;
+    m_rs.m_vertexBuffer = m_vertices.buffer;
+    m_rs.m_indexBuffer = m_indices.buffer;
+    m_rs.m_vbView = m_vbView;
+    m_rs.m_ibView = m_ibView;
+    m_rs.m_gpuHeaps.SetRelocatable(m_rs.m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+    m_rs.m_gpuHeaps.SetRelocatable(m_rs.m_indexBuffer.Get(), D3D12_RESOURCE_STATE_INDEX_BUFFER);
+}
+
+AsyncLoadHandle RenderingSystem::LoadObjAsync(const std::string& path) {
+    return m_loader.Submit(path, [this, path]() -> std::unique_ptr<PendingUpload> {
+        std::unique_ptr<SceneUpload> upload(new SceneUpload(*this));
+        if (!upload->Prepare(path)) return nullptr;
+        return std::unique_ptr<PendingUpload>(upload.release());
+        });
+}
+
+AsyncLoadHandle RenderingSystem::LoadStumpAsync(const std::string& path, bool preferLoose) {
+    return m_loader.Submit(path, [this, path, preferLoose]() -> std::unique_ptr<PendingUpload> {
+        std::unique_ptr<StumpUpload> upload(new StumpUpload(*this, preferLoose));
+        if (!upload->Prepare(path)) return nullptr;
+        return std::unique_ptr<PendingUpload>(upload.release());
+        });
+}
+
+bool RenderingSystem::LoadObj(const std::string& path) {
+    return FinishLoad(LoadObjAsync(path));
+}
+
+bool RenderingSystem::LoadStump(const std::string& path) {
+    return FinishLoad(LoadStumpAsync(path));
+}
+
+// Блокирующая загрузка ждет только пул: копирование пишется в начало следующих кадров
+// (PumpLoads в BeginFrame), и ресурсы становятся видимыми, когда пройден их fence
+bool RenderingSystem::FinishLoad(const AsyncLoadHandle& handle) {
+    handle.WaitForCpu();
+    return !handle.IsFailed();
+}
+
+void RenderingSystem::PumpLoads(UINT maxUploads) {
+    const UINT64 completed = m_fence->GetCompletedValue();
+    m_uploadRing.Reclaim(completed);
+    m_descriptors.Reclaim(completed);
+    m_loader.Pump(completed, m_fenceValues[m_frameIndex], maxUploads);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < m_heapMoves.size(); ++i) {
+        if (m_heapMoves[i].first > completed) m_heapMoves[kept++] = std::move(m_heapMoves[i]);
+        else CompleteHeapMove(m_heapMoves[i].second);
     }
+    m_heapMoves.resize(kept);
 
-    // displacement map
-    {
-        std::wstring dispPath = L"textures/broken_stump/DisplacementMap.png";
-        TextureLoader::TextureData td;
-        if (TextureLoader::LoadFromFile(dispPath, td) &&
-            TextureLoader::CreateTexture(m_device.Get(), m_cmdList.Get(), td, mat.displacementTexture, mat.displacementUpload)) {
-            srvDesc.Format = td.format;
-            m_device->CreateShaderResourceView(mat.displacementTexture.Get(), &srvDesc, srvHandle);
-            OutputDebugStringA("[LoadStump] Displacement map loaded successfully (PNG)\n");
+    if (m_retiredResources.Reclaim(completed)) m_gpuHeaps.Trim();
+}
+
+// Ресурс мог использоваться в записываемом кадре: живет до его fence
+void RenderingSystem::RetireResource(ComPtr<ID3D12Resource> resource) {
+    if (resource) m_retiredResources.Retire(std::move(resource), m_fenceValues[m_frameIndex]);
+}
+
+// Копирования пишутся в начало кадра; сам кадр читает еще старые ресурсы. Пока идет
+// горячая перезагрузка, не переносим: TextureReload пишет в текстуру, взятую при запуске
+void RenderingSystem::DefragmentHeaps() {
+    if (!m_reloads.empty()) return;
+    std::vector<GpuHeapAllocator::Move> moves;
+    m_gpuHeaps.Defragment(m_cmdList.Get(), DEFRAG_BYTES_PER_FRAME, DEFRAG_MIN_FRAGMENTATION, moves);
+    if (moves.empty()) return;
+    char msg[128];
+    sprintf_s(msg, "[GpuHeap] Defragmenting: %zu resources moved\n", moves.size());
+    OutputDebugStringA(msg);
+    for (auto& move : moves) m_heapMoves.emplace_back(m_fenceValues[m_frameIndex], std::move(move));
+}
+
+// Копия готова и совпадает с оригиналом: владелец переключается на нее. Текстура получает
+// новую таблицу дескрипторов, старую и оригинал кадры на GPU читают до fence текущего кадра
+void RenderingSystem::CompleteHeapMove(GpuHeapAllocator::Move& move) {
+    ID3D12Resource* from = move.from.Get();
+    auto retable = [this](DescriptorAllocator::Handle& table, const GpuMaterial* stump, ID3D12Resource* diffuse) {
+        ID3D12Resource* normal = stump ? stump->normalTexture.Get() : nullptr;
+        ID3D12Resource* displacement = stump ? stump->displacementTexture.Get() : nullptr;
+        DescriptorAllocator::Handle fresh = m_descriptors.Allocate(3);
+        if (fresh.IsEmpty()) {
+            // Куча заполнена: переписываем на месте, оба содержимых одинаковы
+            WriteMaterialTable(table.index, diffuse, normal, displacement);
+            return;
         }
-        else {
-            m_device->CreateShaderResourceView(m_defaultDisplacementTex.Get(), &srvDesc, srvHandle);
-            OutputDebugStringA("[LoadStump] WARNING: Displacement map FAILED to load, using default (gray=0.5)\n");
+        WriteMaterialTable(fresh.index, diffuse, normal, displacement);
+        for (auto& m : m_gpuMaterials)
+            if (m.srvTable == table) m.srvTable = fresh;
+        m_descriptors.Free(table, m_fenceValues[m_frameIndex]);
+        table = fresh;
+        // Записи списков хранят разрешенный индекс таблицы
+        MarkDrawsDirty(stump ? DRAW_MESH_STUMP : DRAW_MESH_SCENE);
+        };
+
+    D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    bool owned = true;
+    if (m_vertexBuffer.Get() == from) {
+        m_vertexBuffer = move.to;
+        m_vbView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
+        state = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+    }
+    else if (m_indexBuffer.Get() == from) {
+        m_indexBuffer = move.to;
+        m_ibView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
+        state = D3D12_RESOURCE_STATE_INDEX_BUFFER;
+    }
+    else if (m_stumpVertexBuffer.Get() == from) {
+        m_stumpVertexBuffer = move.to;
+        m_stumpVbView.BufferLocation = m_stumpVertexBuffer->GetGPUVirtualAddress();
+        state = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+    }
+    else if (m_stumpIndexBuffer.Get() == from) {
+        m_stumpIndexBuffer = move.to;
+        m_stumpIbView.BufferLocation = m_stumpIndexBuffer->GetGPUVirtualAddress();
+        state = D3D12_RESOURCE_STATE_INDEX_BUFFER;
+    }
+    else {
+        owned = false;
+        for (auto& group : m_textureGroups) {
+            if (group.texture.Get() != from) continue;
+            group.texture = move.to;
+            retable(group.srvTable, nullptr, group.texture.Get());
+            owned = true;
+        }
+        for (auto& m : m_stumpMaterials) {
+            ComPtr<ID3D12Resource>* textures[] = { &m.texture, &m.normalTexture, &m.displacementTexture };
+            for (auto* texture : textures) {
+                if (texture->Get() != from) continue;
+                *texture = move.to;
+                retable(m.srvTable, &m, m.texture.Get());
+                owned = true;
+            }
         }
     }
 
-    m_currentSrvSlot += 3;
+    RetireResource(move.from);
+    // Владельца заменили целиком, пока шло копирование, - копия не нужна
+    if (owned) m_gpuHeaps.SetRelocatable(move.to.Get(), state);
+    else RetireResource(move.to);
+}
 
-    auto upload = [&](const void* data, UINT sz, ComPtr<ID3D12Resource>& buf) {
-        CD3DX12_HEAP_PROPERTIES hp(D3D12_HEAP_TYPE_UPLOAD);
-        CD3DX12_RESOURCE_DESC rd = CD3DX12_RESOURCE_DESC::Buffer(sz);
-        HRESULT hr = m_device->CreateCommittedResource(&hp, D3D12_HEAP_FLAG_NONE, &rd,
-            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&buf));
-        if (FAILED(hr)) return false;
-        void* p = nullptr;
-        buf->Map(0, nullptr, &p);
-        memcpy(p, data, sz);
-        buf->Unmap(0, nullptr);
-        return true;
-        };
+// Можно с любого потока: буфер создается сразу, данные копируются в кольцо загрузки
+bool RenderingSystem::PrepareBuffer(const void* data, UINT size, D3D12_RESOURCE_STATES state, BufferUpload& out) {
+    CD3DX12_RESOURCE_DESC rd = CD3DX12_RESOURCE_DESC::Buffer(size);
+    HRESULT hr = m_gpuHeaps.CreateResource(rd, D3D12_RESOURCE_STATE_COMMON, nullptr, out.buffer);
+    if (FAILED(hr)) return false;
+    if (!m_uploadRing.Allocate(size, 16, out.staging)) return false;
+    memcpy(out.staging.GetCPU(), data, size);
+    out.size = size;
+    out.state = state;
+    return true;
+}
 
-    UINT vbSz = (UINT)(verts.size() * sizeof(Vertex));
-    UINT ibSz = (UINT)(mesh.indices.size() * sizeof(UINT));
-    if (!upload(verts.data(), vbSz, m_stumpVertexBuffer)) {
-        return false;
+// Буфер из COMMON неявно переходит в COPY_DEST при копировании; выделение в кольце
+// освобождается после fence текущего кадра
+void RenderingSystem::RecordBufferUpload(BufferUpload& upload) {
+    m_cmdList->CopyBufferRegion(upload.buffer.Get(), 0, upload.staging.GetResource(), upload.staging.GetOffset(), upload.size);
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(upload.buffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, upload.state);
+    m_cmdList->ResourceBarrier(1, &barrier);
+    upload.staging.Retire(m_fenceValues[m_frameIndex]);
+}
+
+bool RenderingSystem::MountDirectory(const std::string& directory, const std::string& mountPoint) {
+    if (!m_vfs.MountDirectory(directory, mountPoint)) return false;
+    m_mounts.emplace_back(directory, mountPoint);
+    if (m_watcher) m_watcher->Watch(directory, mountPoint);
+    return true;
+}
+
+bool RenderingSystem::MountArchive(const std::string& path) {
+    return m_vfs.MountArchive(path);
+}
+
+void RenderingSystem::EnableHotReload() {
+    if (m_watcher) return;
+    m_watcher.reset(new FileWatcher());
+    for (const auto& mount : m_mounts) m_watcher->Watch(mount.first, mount.second);
+}
+
+AsyncLoadHandle RenderingSystem::ReloadSceneTexture(const std::string& path) {
+    const SceneTexture info = m_sceneTextures[path];
+    ComPtr<ID3D12Resource> target;
+    if (info.group >= 0 && info.group < (int)m_textureGroups.size()) target = m_textureGroups[info.group].texture;
+    const std::string scenePath = m_scenePath;
+    return m_loader.Submit(path, [this, path, info, target, scenePath]() -> std::unique_ptr<PendingUpload> {
+        std::vector<TextureLoader::TextureData> textures;
+        std::vector<bool> loaded;
+        LoadTextures({ path }, textures, loaded, true);
+        if (!loaded[0]) return nullptr;
+        const TextureLoader::TextureData& td = textures[0];
+        if (target && td.width == info.width && td.height == info.height && td.format == info.format) {
+            std::unique_ptr<TextureReload> upload(new TextureReload(*this, info, target));
+            if (!upload->Prepare(td)) return nullptr;
+            return std::unique_ptr<PendingUpload>(upload.release());
+        }
+        // Размер или формат изменился - прежняя раскладка по группам не подходит
+        OutputDebugStringA("[HotReload] Texture layout changed, rebuilding scene materials\n");
+        std::unique_ptr<SceneUpload> scene(new SceneUpload(*this, true));
+        if (!scene->Prepare(scenePath)) return nullptr;
+        return std::unique_ptr<PendingUpload>(scene.release());
+        });
+}
+
+AsyncLoadHandle RenderingSystem::ReloadSceneMesh(bool geometry) {
+    const std::string scenePath = m_scenePath;
+    const std::vector<Material> current = m_sceneMaterials;
+    return m_loader.Submit(scenePath, [this, scenePath, current, geometry]() -> std::unique_ptr<PendingUpload> {
+        ObjMesh mesh;
+        if (!LoadSceneMesh(scenePath, mesh, true)) return nullptr;
+        bool sameTextures = mesh.materials.size() == current.size();
+        for (size_t i = 0; sameTextures && i < current.size(); ++i)
+            sameTextures = mesh.materials[i].name == current[i].name && mesh.materials[i].diffuseTexture == current[i].diffuseTexture;
+        if (sameTextures) {
+            std::unique_ptr<MaterialReload> upload(new MaterialReload(*this));
+            if (!upload->Prepare(scenePath, mesh, geometry)) return nullptr;
+            return std::unique_ptr<PendingUpload>(upload.release());
+        }
+        std::unique_ptr<SceneUpload> scene(new SceneUpload(*this, true));
+        if (!scene->Prepare(scenePath, mesh)) return nullptr;
+        return std::unique_ptr<PendingUpload>(scene.release());
+        });
+}
+
+// Изменения берутся только после паузы в событиях по файлу; пока перезагрузка того же ассета
+// не закончилась, следующее изменение ждет, чтобы результаты не пришли в обратном порядке
+void RenderingSystem::PollHotReload() {
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < m_reloads.size();) {
+        const PendingReload& r = m_reloads[i];
+        if (!r.handle.IsFinished()) { ++i; continue; }
+        char msg[512];
+        sprintf_s(msg, "[HotReload] %s %s: %.1f ms from file change to frame\n", r.path.c_str(),
+            r.handle.IsResident() ? "reloaded" : "FAILED", std::chrono::duration<double, std::milli>(now - r.changed).count());
+        OutputDebugStringA(msg);
+        m_reloads.erase(m_reloads.begin() + i);
     }
-    if (!upload(mesh.indices.data(), ibSz, m_stumpIndexBuffer)) {
-        return false;
+
+    std::vector<FileWatcher::Change> changes;
+    changes.swap(m_deferredChanges);
+    m_watcher->Poll(changes);
+    const std::string stumpDir = "textures/" + VirtualFileSystem::StemOf(m_stumpPath) + "/";
+    for (const FileWatcher::Change& change : changes) {
+        const std::string& path = change.path;
+        // Новые, еще не проиндексированные файлы не перезагружаются. Файл, перекрытый архивом,
+        // перезагружается с диска: запись архива собрана до правки
+        if (!m_vfs.HasLooseFile(path)) continue;
+
+        std::string key;
+        if (m_sceneTextures.count(path)) key = path;
+        else if (!m_scenePath.empty() && (path == m_scenePath ||
+            std::find(m_sceneLibraries.begin(), m_sceneLibraries.end(), path) != m_sceneLibraries.end())) key = m_scenePath;
+        else if (!m_stumpPath.empty() && (path == m_stumpPath || path.compare(0, stumpDir.size(), stumpDir) == 0)) key = m_stumpPath;
+        else continue;
+
+        bool busy = false;
+        for (const PendingReload& r : m_reloads) busy = busy || r.key == key;
+        // Текстура могла переезжать в куче - перезапись на месте ждет окончания переноса
+        busy = busy || (m_sceneTextures.count(path) && !m_heapMoves.empty());
+        if (busy) {
+            m_deferredChanges.push_back(change);
+            continue;
+        }
+
+        AsyncLoadHandle handle;
+        if (key == m_stumpPath) handle = LoadStumpAsync(m_stumpPath, true);
+        else if (key == m_scenePath) handle = ReloadSceneMesh(path == m_scenePath);
+        else handle = ReloadSceneTexture(path);
+        m_reloads.push_back({ handle, key, path, change.firstSeen });
     }
+}
 
-    m_stumpVbView = { m_stumpVertexBuffer->GetGPUVirtualAddress(), vbSz, sizeof(Vertex) };
-    m_stumpIbView = { m_stumpIndexBuffer->GetGPUVirtualAddress(), ibSz, DXGI_FORMAT_R32_UINT };
+// Собранный меш лежит под "<obj>#vertices" и т.д., а сам OBJ - в каталоге: при preferLoose
+// архив пропускается, если OBJ есть на диске
+bool RenderingSystem::LoadMesh(const std::string& path, ObjMesh& mesh, bool preferLoose) const {
+    const AssetArchive* archive = preferLoose && m_vfs.HasLooseFile(path) ? nullptr : m_vfs.FindArchive(path + "#vertices");
+    if (archive && archive->ReadMesh(path, mesh)) return true;
+    return ObjLoader::Load(path, mesh, [this, preferLoose](const std::string& file, std::vector<uint8_t>& bytes) {
+        return m_vfs.ReadFile(file, bytes, preferLoose);
+        });
+}
 
-    ThrowIfFailed(m_cmdList->Close());
-    ID3D12CommandList* cmds[] = { m_cmdList.Get() };
-    m_cmdQueue->ExecuteCommandLists(1, cmds);
-    WaitForGPU();
+// Сначала повторы становятся экземплярами, затем остальное режется на ячейки для буфера перекрытия
+bool RenderingSystem::LoadSceneMesh(const std::string& path, ObjMesh& mesh, bool preferLoose) const {
+    if (!LoadMesh(path, mesh, preferLoose)) return false;
+    const DuplicateGeometryReport report = InstanceDuplicateGeometry(mesh);
+    SplitSubsetsByCell(mesh, OCCLUSION_CELL_SIZE);
+    char msg[512];
+    sprintf_s(msg, "[Duplicates] %s: %u components, %u prototypes replace %u copies; vertices %zu -> %zu, indices %zu -> %zu, "
+        "%.2f -> %.2f MB (%.1f%% saved), %.1f ms\n", path.c_str(), report.components, report.prototypes, report.copies,
+        report.verticesBefore, report.verticesAfter, report.indicesBefore, report.indicesAfter,
+        report.bytesBefore / 1048576.0, report.bytesAfter / 1048576.0,
+        report.bytesBefore ? 100.0 * (1.0 - (double)report.bytesAfter / report.bytesBefore) : 0.0, report.milliseconds);
+    OutputDebugStringA(msg);
+    return true;
+}
 
-    for (auto& m : m_stumpMaterials) {
-        m.textureUpload.Reset();
-        m.normalUpload.Reset();
-        m.displacementUpload.Reset();
+void RenderingSystem::LoadScenePvs(const std::string& path, const ObjMesh& mesh, PotentiallyVisibleSet& pvs) const {
+    pvs.Clear();
+    const std::string pvsPath = PvsPathFor(path);
+    std::vector<uint8_t> bytes;
+    if (!m_vfs.ReadFile(pvsPath, bytes)) return;
+    char msg[512];
+    if (!pvs.Load(bytes.data(), bytes.size()) || pvs.GetFingerprint() != PotentiallyVisibleSet::Fingerprint(mesh) ||
+        pvs.GetClusterCount() != CountClusters(mesh)) {
+        pvs.Clear();
+        sprintf_s(msg, "[PVS] %s does not match %s, rebake with PvsBaker\n", pvsPath.c_str(), path.c_str());
+        OutputDebugStringA(msg);
+        return;
     }
+    sprintf_s(msg, "[PVS] %s: %u clusters, %u cells, %zu bytes\n", pvsPath.c_str(), pvs.GetClusterCount(), pvs.GetCellCount(), bytes.size());
+    OutputDebugStringA(msg);
+}
 
-    return true;
+// Поток загрузчика: JobSystem занят кадрами, поэтому дерево строится на одном потоке
+void RenderingSystem::BuildSceneBvh(const ObjMesh& mesh, TriangleBvh& bvh) const {
+    const TriangleBvh::BuildReport report = bvh.Build(mesh, nullptr);
+    char msg[256];
+    sprintf_s(msg, "[BVH] %u triangles, %u nodes, depth %u, %.2f MB, %.1f ms\n", report.triangles, report.nodes,
+        report.maxDepth, report.bytes / 1048576.0, report.milliseconds);
+    OutputDebugStringA(msg);
+}
+
+// Текстуры из архива уже декодированы; файлы с диска читаются одной пачкой
+// и декодируются по мере прихода, пока остальные еще читаются
+void RenderingSystem::LoadTextures(const std::vector<std::string>& paths, std::vector<TextureLoader::TextureData>& textures, std::vector<bool>& loaded, bool preferLoose) const {
+    textures.assign(paths.size(), TextureLoader::TextureData());
+    loaded.assign(paths.size(), false);
+    std::vector<std::string> filePaths;
+    std::vector<size_t> fileIndex;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (paths[i].empty()) continue;
+        const AssetArchive* archive = m_vfs.FindArchive(paths[i], preferLoose);
+        if (archive) {
+            loaded[i] = archive->ReadTexture(paths[i], textures[i]);
+            continue;
+        }
+        filePaths.push_back(paths[i]);
+        fileIndex.push_back(i);
+    }
+    m_vfs.ReadFiles(filePaths, [&](size_t f, bool ok, std::vector<uint8_t>& bytes) {
+        size_t i = fileIndex[f];
+        loaded[i] = ok && TextureLoader::LoadFromMemory(bytes.data(), bytes.size(), textures[i]);
+        }, preferLoose);
 }
 
 void RenderingSystem::CreateLightingResources() {
@@ -708,7 +1557,6 @@ void RenderingSystem::CreateRainLightBuffer() {
     ThrowIfFailed(m_device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &resourceDesc,
         D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_pointLightBuffer)));
     m_pointLightBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_pointLightsMapped));
-    m_rainLights.resize(MAX_RAIN_LIGHTS);
 }
 
 void RenderingSystem::CreateRainLightSRV() {
@@ -720,70 +1568,27 @@ void RenderingSystem::CreateRainLightSRV() {
     srvDesc.Buffer.NumElements = MAX_RAIN_LIGHTS;
     srvDesc.Buffer.StructureByteStride = sizeof(PointLight);
     srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
-    CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(m_cbvSrvHeap->GetCPUDescriptorHandleForHeapStart(), 3, m_cbvSrvDescSize);
-    m_device->CreateShaderResourceView(m_pointLightBuffer.Get(), &srvDesc, srvHandle);
-}
-
-void RenderingSystem::UpdateRainLights(float deltaTime) {
-    m_spawnTimer += deltaTime;
-    if (m_spawnTimer >= m_spawnInterval) {
-        m_spawnTimer = 0.f;
-        for (auto& light : m_rainLights) {
-            if (!light.active) {
-                light.data.Position.x = m_spawnAreaMin.x + ((float)rand() / RAND_MAX) * (m_spawnAreaMax.x - m_spawnAreaMin.x);
-                light.data.Position.z = m_spawnAreaMin.z + ((float)rand() / RAND_MAX) * (m_spawnAreaMax.z - m_spawnAreaMin.z);
-                light.data.Position.y = m_spawnAreaMax.y;
-                light.data.Position.w = 12.f;
-                light.data.Color = XMFLOAT4(0.7f, 0.8f, 0.9f, 2.5f);
-                light.active = true;
-                light.velocity = XMFLOAT3(0.f, -80.f, 0.f);
-                light.lifeTime = 0.f;
-                break;
-            }
-        }
-    }
-    m_activeLightCount = 0;
-    for (auto& light : m_rainLights) {
-        if (!light.active) continue;
-        light.data.Position.x += light.velocity.x * deltaTime;
-        light.data.Position.y += light.velocity.y * deltaTime;
-        light.data.Position.z += light.velocity.z * deltaTime;
-        light.lifeTime += deltaTime;
-        if (light.data.Position.y <= m_floorY) {
-            light.data.Position.y = m_floorY;
-            light.velocity = XMFLOAT3(0.f, 0.f, 0.f);
-            if (light.lifeTime > 3.5f) {
-                light.active = false;
-                light.data = {};
-            }
-        }
-        m_activeLightCount++;
-    }
-    UploadRainLightsToGPU();
+    m_device->CreateShaderResourceView(m_pointLightBuffer.Get(), &srvDesc, m_stagingSrvHeap->GetCPUDescriptorHandleForHeapStart());
 }
 
 void RenderingSystem::UploadRainLightsToGPU() {
-    if (!m_pointLightsMapped) return;
-    UINT idx = 0;
-    for (const auto& rl : m_rainLights) {
-        if (rl.active && idx < MAX_RAIN_LIGHTS) m_pointLightsMapped[idx++] = rl.data;
-    }
-    while (idx < MAX_RAIN_LIGHTS) m_pointLightsMapped[idx++] = {};
+    if (m_pointLightsMapped) m_rain.Write(m_pointLightsMapped);
 }
 
 void RenderingSystem::AddLight() {
     if (!m_lightMappedData) return;
-    memset(m_lightMappedData, 0, sizeof(LightBufferData));
-    m_lightMappedData->DirLightDir = XMFLOAT4(0.0f, 1.0f, 0.0f, 0.0f);
-    m_lightMappedData->DirLightColor = XMFLOAT4(1.0f, 1.0f, 0.7f, 2.0f);
-    m_lightMappedData->AmbientColor = XMFLOAT4(0.3f, 0.3f, 0.12f, 0.15f);
-    m_lightMappedData->NumSpotLights = 0;
-    m_lightMappedData->EyePos = XMFLOAT4(m_eye.x, m_eye.y, m_eye.z, 1.0f);
+    *m_lightMappedData = MakeLightConstants(m_camera.GetEye());
 }
 
 void RenderingSystem::BeginFrame(const float clearColor[4]) {
     ThrowIfFailed(m_cmdAllocators[m_frameIndex]->Reset());
     ThrowIfFailed(m_cmdList->Reset(m_cmdAllocators[m_frameIndex].Get(), nullptr));
+    // Не больше одной готовой фоновой загрузки за кадр, чтобы не было рывка
+    m_frameConstants.BeginFrame(m_frameIndex);
+    m_drawCount = 0;
+    PumpLoads(1);
+    if (m_watcher) PollHotReload();
+    DefragmentHeaps();
     CD3DX12_RESOURCE_BARRIER b = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(),
         D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
     m_cmdList->ResourceBarrier(1, &b);
@@ -799,16 +1604,44 @@ void RenderingSystem::BeginFrame(const float clearColor[4]) {
 }
 
 void RenderingSystem::DrawScene(float totalTime, float deltaTime) {
+#ifdef FRAME_CONSTANTS_BENCHMARK
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+#endif
+    PrepareObjectConstants();
     if (m_useDeferredRendering) {
         AddLight();
         RenderGeometryPass(totalTime);
         m_gbuffer.TransitionToRead(m_cmdList.Get());
-        UpdateRainLights(deltaTime);
+        m_rain.Update(deltaTime);
+        UploadRainLightsToGPU();
         RenderLightingPass();
     }
     else {
         RenderForwardPass(totalTime);
     }
+#ifdef FRAME_CONSTANTS_BENCHMARK
+    // Сколько байт констант пишет кадр и сколько стоит запись кадра на CPU; для сравнения -
+    // сколько писали бы полные 256-байтные блоки на каждую отрисовку
+    LARGE_INTEGER end, freq;
+    QueryPerformanceCounter(&end);
+    ConstantsBenchmark& bench = m_constantsBenchmark;
+    const FrameConstantAllocator::Stats& stats = m_frameConstants.GetStats();
+    bench.recordTicks += end.QuadPart - start.QuadPart;
+    bench.bytesWritten += stats.bytesWritten;
+    bench.draws += m_drawCount;
+    if (++bench.frames == 300) {
+        QueryPerformanceFrequency(&freq);
+        char msg[256];
+        sprintf_s(msg, "[Constants] %u frames: %.0f draws, %.0f bytes written/frame (per-draw blocks: %.0f), "
+            "record %.3f ms/frame, frame buffer %llu KB in %u page(s)\n",
+            bench.frames, (double)bench.draws / bench.frames, (double)bench.bytesWritten / bench.frames,
+            (double)bench.draws * 256.0 / bench.frames, bench.recordTicks * 1000.0 / freq.QuadPart / bench.frames,
+            stats.capacity >> 10, stats.pages);
+        OutputDebugStringA(msg);
+        bench = ConstantsBenchmark();
+    }
+#endif
 }
 
 void RenderingSystem::EndFrame() {
@@ -822,6 +1655,16 @@ void RenderingSystem::EndFrame() {
     MoveToNextFrame();
 }
 
+// PSO и топология меняются только при смене варианта; сабсеты отсортированы по варианту
+void RenderingSystem::SetGeometryPermutation(uint32_t key, uint32_t& bound)
+{
+    if (key == bound) return;
+    m_cmdList->SetPipelineState(m_wireframeMode ? m_wireframePSOs[key].Get() : m_geometryPSOs[key].Get());
+    m_cmdList->IASetPrimitiveTopology((key & GEOMETRY_TESSELLATED) ? D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST
+        : D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    bound = key;
+}
+
 void RenderingSystem::RenderGeometryPass(float totalTime)
 {
     m_gbuffer.TransitionToWrite(m_cmdList.Get());
@@ -834,98 +1677,24 @@ void RenderingSystem::RenderGeometryPass(float totalTime)
     m_cmdList->RSSetViewports(1, &vp);
     m_cmdList->RSSetScissorRects(1, &sc);
 
-    if (m_wireframeMode) {
-        m_cmdList->SetPipelineState(m_wireframePSO.Get());
-    }
-    else {
-        m_cmdList->SetPipelineState(m_geometryPassPSO.Get());
-    }
-
     m_cmdList->SetGraphicsRootSignature(m_rootSignature.Get());
     ID3D12DescriptorHeap* heaps[] = { m_cbvSrvHeap.Get() };
     m_cmdList->SetDescriptorHeaps(1, heaps);
-    m_cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-
-    // sponza
-    m_cmdList->IASetVertexBuffers(0, 1, &m_vbView);
-    m_cmdList->IASetIndexBuffer(&m_ibView);
-
-    XMMATRIX world = XMMatrixIdentity();
-    XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&m_eye), XMLoadFloat3(&m_target), XMLoadFloat3(&m_up));
-    float aspect = (float)m_width / (float)m_height;
-    XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(60.f), aspect, 0.1f, 5000.f);
-    XMMATRIX wit = XMMatrixTranspose(XMMatrixInverse(nullptr, world));
-
-    for (UINT subIdx = 0; subIdx < m_subsets.size(); ++subIdx)
-    {
-        const MeshSubset& sub = m_subsets[subIdx];
-        if (sub.indexCount == 0) continue;
-
-        int matIdx = (sub.materialIdx >= 0 && sub.materialIdx < (int)m_gpuMaterials.size()) ? sub.materialIdx : 0;
-        const GpuMaterial& mat = m_gpuMaterials.empty() ? GpuMaterial{} : m_gpuMaterials[matIdx];
-
-        UINT slotIdx = m_frameIndex * MAX_SUBSETS + (subIdx % MAX_SUBSETS);
-        UINT8* slotPtr = reinterpret_cast<UINT8*>(m_cbMapped) + slotIdx * m_cbSlotSize;
-        D3D12_GPU_VIRTUAL_ADDRESS cbAddr = m_constantBuffer->GetGPUVirtualAddress() + slotIdx * m_cbSlotSize;
-
-        ConstantBufferData cb{};
-        XMStoreFloat4x4(&cb.World, XMMatrixTranspose(world));
-        XMStoreFloat4x4(&cb.View, XMMatrixTranspose(view));
-        XMStoreFloat4x4(&cb.Proj, XMMatrixTranspose(proj));
-        XMStoreFloat4x4(&cb.WorldInvTranspose, XMMatrixTranspose(wit));
-        cb.MaterialDiffuse = mat.diffuse;
-        cb.MaterialSpecular = mat.specular;
-        cb.MaterialSpecular.w = mat.shininess;
-        cb.HasTexture = mat.hasTexture ? 1 : 0;
-        cb.TexTilingX = m_texTiling.x;
-        cb.TexTilingY = m_texTiling.y;
-        cb.TexScrollX = m_texScroll.x;
-        cb.TexScrollY = m_texScroll.y;
-        cb.TotalTime = totalTime;
-        cb.EyePosW = m_eye;
-        cb.DisplacementScale = 0.0f;
-        cb.TessNearDist = m_tesselationNearDist;
-        cb.TessFarDist = m_tesselationFarDist;
-
-        memcpy(slotPtr, &cb, sizeof(cb));
-        m_cmdList->SetGraphicsRootConstantBufferView(0, cbAddr);
-
-        if (mat.srvHeapIndex >= 0)
-        {
-            CD3DX12_GPU_DESCRIPTOR_HANDLE srvH(m_cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), mat.srvHeapIndex, m_cbvSrvDescSize);
-            m_cmdList->SetGraphicsRootDescriptorTable(1, srvH);
-        }
-        else
-        {
-            CD3DX12_GPU_DESCRIPTOR_HANDLE nullH(m_cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), 4, m_cbvSrvDescSize);
-            m_cmdList->SetGraphicsRootDescriptorTable(1, nullH);
-        }
-        m_cmdList->DrawIndexedInstanced(sub.indexCount, 1, sub.indexStart, 0, 0);
-    }
+    BindFrameConstants(totalTime);
+    PrepareDraws(DRAW_PASS_GEOMETRY);
+    SubmitDrawList(DRAW_PASS_GEOMETRY);
 
     // stump
     if (m_stumpVertexBuffer.Get() && !m_stumpSubsets.empty())
     {
-        XMFLOAT2 savedTexScroll = m_texScroll;
-        m_texScroll = { 0.0f, 0.0f };
+        XMVECTOR stumpPos = XMLoadFloat3(&STUMP_POSITION);
 
-        m_cmdList->IASetVertexBuffers(0, 1, &m_stumpVbView);
-        m_cmdList->IASetIndexBuffer(&m_stumpIbView);
-
-        XMMATRIX stumpWorld = XMMatrixScaling(500.0f, 500.0f, 500.0f) *
-            XMMatrixRotationZ(XMConvertToRadians(-90.0f)) *
-            XMMatrixTranslation(1000.0f, 100.0f, 80.0f);
-        XMMATRIX stumpWit = XMMatrixTranspose(XMMatrixInverse(nullptr, stumpWorld));
-
-        XMFLOAT3 stumpPosF(1000.0f, 100.0f, 80.0f);
-        XMVECTOR stumpPos = XMLoadFloat3(&stumpPosF);
-
-        XMVECTOR eyePos = XMLoadFloat3(&m_eye);
+        XMVECTOR eyePos = XMLoadFloat3(&m_camera.GetEye());
         XMVECTOR distVec = stumpPos - eyePos;
         float distanceToStump = XMVector3Length(distVec).m128_f32[0];
 
-        float minDist = m_tesselationNearDist;
-        float maxDist = m_tesselationFarDist;
+        float minDist = m_frameSettings.tessNearDist;
+        float maxDist = m_frameSettings.tessFarDist;
         float maxTess = 32.0f;
         float minTess = 2.0f;
         float expectedTess = minTess;
@@ -944,70 +1713,180 @@ void RenderingSystem::RenderGeometryPass(float totalTime)
                 distanceToStump, expectedTess, minDist, maxDist);
             OutputDebugStringA(debugMsg);
         }
+    }
+}
+
+void RenderingSystem::MarkDrawsDirty(uint32_t mesh)
+{
+    for (auto& list : m_retainedDraws) list.MarkDirty(mesh);
+}
+
+void RenderingSystem::UpdateRetainedDraws(RetainedDrawList& list, uint32_t pass)
+{
+    UpdateDirtyDraws(list, [&](uint32_t mesh) {
+        if (mesh == DRAW_MESH_SCENE)
+            AddDraws(list, pass, mesh, m_subsets, m_gpuMaterials, m_meshInstances[mesh]);
+        // Прямой проход рисует только сцену
+        else if (pass == DRAW_PASS_GEOMETRY && m_stumpVertexBuffer.Get())
+            AddDraws(list, pass, mesh, m_stumpSubsets, m_stumpMaterials, m_meshInstances[mesh]);
+    });
+}
+
+void RenderingSystem::PrepareDraws(uint32_t pass)
+{
+#ifdef RETAINED_DRAW_LIST_BENCHMARK
+    LARGE_INTEGER start, retained, end;
+    QueryPerformanceCounter(&start);
+#endif
+    RetainedDrawList& list = m_retainedDraws[pass];
+    UpdateRetainedDraws(list, pass);
+    const DrawCulling culling = BuildVisibleDraws(list, m_view, m_occlusionCulling ? &m_occlusion : nullptr, m_occluders,
+        m_pvsCulling ? &m_pvs : nullptr, m_jobs.get(), m_drawPackets);
+    const OcclusionBuffer* occlusion = culling.occlusion;
+    const PotentiallyVisibleSet* pvs = culling.pvs;
+
+#ifdef OCCLUSION_CULLING_BENCHMARK
+    if (occlusion || pvs) {
+        OcclusionBenchmark& bench = m_occlusionBenchmark;
+        if (occlusion) bench.rasterMs += m_occlusion.GetRenderMilliseconds();
+        bench.tested += m_drawPackets.GetInstanceCount() + m_drawPackets.GetOccludedCount() + m_drawPackets.GetPvsCulledCount();
+        bench.pvsCulled += m_drawPackets.GetPvsCulledCount();
+        bench.occluded += m_drawPackets.GetOccludedCount();
+        if (++bench.frames == 300) {
+            char msg[256];
+            sprintf_s(msg, "[Occlusion] %u frames: raster %.3f ms/frame, %u occluder triangles, culled %.1f%% of frustum-visible draws "
+                "by PVS and %.1f%% by the buffer\n", bench.frames, bench.rasterMs / bench.frames, m_occlusion.GetRasterizedCount(),
+                bench.tested ? 100.0 * bench.pvsCulled / bench.tested : 0.0, bench.tested ? 100.0 * bench.occluded / bench.tested : 0.0);
+            OutputDebugStringA(msg);
+            bench = OcclusionBenchmark();
+        }
+    }
+#endif
+
+#ifdef RETAINED_DRAW_LIST_BENCHMARK
+    // Прежний путь на тех же данных: блоки объектов в кольцо кадра, все записи и сортировка
+    // заново, пакеты на одном потоке. Пакеты обоих путей должны совпадать
+    QueryPerformanceCounter(&retained);
+    PushObjectConstants(m_texScroll);
+    PushObjectConstants(XMFLOAT2(0.0f, 0.0f));
+    m_frameConstants.Push(m_instances.data(), m_instances.size() * sizeof(InstanceData));
+    m_rebuiltDraws.MarkAllDirty();
+    UpdateRetainedDraws(m_rebuiltDraws, pass);
+    m_rebuiltPackets.Build(m_rebuiltDraws, m_view.frustum, nullptr, 0, occlusion, pvs);
+    QueryPerformanceCounter(&end);
+
+    RetainedBenchmark& bench = m_retainedBenchmark;
+    if (m_drawPackets.GetPackets() != m_rebuiltPackets.GetPackets() ||
+        m_drawPackets.GetInstances() != m_rebuiltPackets.GetInstances()) ++bench.mismatches;
+    bench.retainedTicks += retained.QuadPart - start.QuadPart;
+    bench.rebuildTicks += end.QuadPart - retained.QuadPart;
+    if (++bench.frames == 300) {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        const double toUs = 1e6 / (double)freq.QuadPart / bench.frames;
+        const RetainedDrawList::Stats& stats = list.GetStats();
+        char msg[256];
+        sprintf_s(msg, "[RetainedDraws] %u frames: rebuild %.1f us/frame, retained %.1f us/frame, visible %u of %u "
+            "in %u draws, builds %u, mismatches %u\n", bench.frames, bench.rebuildTicks * toUs, bench.retainedTicks * toUs,
+            m_drawPackets.GetInstanceCount(), stats.draws, m_drawPackets.GetDrawCount(), stats.builds, bench.mismatches);
+        OutputDebugStringA(msg);
+        bench = RetainedBenchmark();
+    }
+#endif
+}
 
-        for (UINT subIdx = 0; subIdx < m_stumpSubsets.size(); ++subIdx)
+// Отрисовка читает только поля списка, а не GpuMaterial
+void RenderingSystem::AddDraws(RetainedDrawList& list, uint32_t pass, uint32_t mesh, const std::vector<MeshSubset>& subsets,
+    const std::vector<GpuMaterial>& materials, const std::vector<uint32_t>& instances)
+{
+    std::vector<DrawMaterial> drawMaterials(materials.size());
+    for (size_t i = 0; i < materials.size(); ++i)
+    {
+        const GpuMaterial& mat = materials[i];
+        drawMaterials[i].pipeline = pass == DRAW_PASS_GEOMETRY ? mat.permutation : 0;
+        drawMaterials[i].table = ResolveTable(mat.srvTable);
+        drawMaterials[i].constants = mat.constants;
+        drawMaterials[i].displacementScale = mat.displacementScale;
+    }
+    AddMeshDraws(list, pass, mesh, subsets, drawMaterials, instances, m_instances, mesh == DRAW_MESH_SCENE);
+}
+
+// Повторы состояния убраны при сборке пакетов
+void RenderingSystem::SubmitDrawList(uint32_t pass)
+{
+    // Номера видимых экземпляров - в кольцо кадра; отрисовка читает свои с gInstanceBase
+    const std::vector<uint32_t>& visible = m_drawPackets.GetInstances();
+    if (!visible.empty())
+    {
+        const D3D12_GPU_VIRTUAL_ADDRESS visibleAddress = m_frameConstants.Push(visible.data(), visible.size() * sizeof(uint32_t));
+        if (!visibleAddress) throw std::runtime_error("Frame constants allocation failed");
+        m_cmdList->SetGraphicsRootShaderResourceView(5, m_instanceAddress);
+        m_cmdList->SetGraphicsRootShaderResourceView(6, visibleAddress);
+    }
+    const D3D12_VERTEX_BUFFER_VIEW* vertexBuffers[DRAW_MESH_COUNT] = { &m_vbView, &m_stumpVbView };
+    const D3D12_INDEX_BUFFER_VIEW* indexBuffers[DRAW_MESH_COUNT] = { &m_ibView, &m_stumpIbView };
+    uint32_t boundPermutation = UINT32_MAX;
+    for (const CommandPacket& packet : m_drawPackets.GetPackets())
+    {
+        switch (packet.type)
         {
-            const MeshSubset& sub = m_stumpSubsets[subIdx];
-            if (sub.indexCount == 0) continue;
-
-            UINT slotIdx = m_frameIndex * MAX_SUBSETS + 200 + subIdx;
-            if (slotIdx >= MAX_SUBSETS * FRAME_COUNT) slotIdx = 0;
-
-            UINT8* slotPtr = reinterpret_cast<UINT8*>(m_cbMapped) + slotIdx * m_cbSlotSize;
-            D3D12_GPU_VIRTUAL_ADDRESS cbAddr = m_constantBuffer->GetGPUVirtualAddress() + slotIdx * m_cbSlotSize;
-
-            ConstantBufferData cb{};
-            XMStoreFloat4x4(&cb.World, XMMatrixTranspose(stumpWorld));
-            XMStoreFloat4x4(&cb.View, XMMatrixTranspose(view));
-            XMStoreFloat4x4(&cb.Proj, XMMatrixTranspose(proj));
-            XMStoreFloat4x4(&cb.WorldInvTranspose, stumpWit);
-            cb.MaterialDiffuse = { 1.0f, 0.0f, 0.0f, 1.0f };
-            cb.MaterialSpecular = { 0.5f, 0.5f, 0.5f, 32.0f };
-            cb.HasTexture = 1;
-            cb.TexTilingX = m_texTiling.x;
-            cb.TexTilingY = m_texTiling.y;
-            cb.TexScrollX = m_texScroll.x;
-            cb.TexScrollY = m_texScroll.y;
-            cb.TotalTime = totalTime;
-            cb.EyePosW = m_eye;
-            cb.DisplacementScale = 15.0f;
-            cb.TessNearDist = m_tesselationNearDist;
-            cb.TessFarDist = m_tesselationFarDist;
-
-            memcpy(slotPtr, &cb, sizeof(cb));
-            m_cmdList->SetGraphicsRootConstantBufferView(0, cbAddr);
-
-            int matIdx = (sub.materialIdx >= 0 && sub.materialIdx < (int)m_stumpMaterials.size()) ? sub.materialIdx : 0;
-            const GpuMaterial& mat = m_stumpMaterials.empty() ? GpuMaterial{} : m_stumpMaterials[matIdx];
-
-            if (mat.srvHeapIndex >= 0)
-            {
-                CD3DX12_GPU_DESCRIPTOR_HANDLE srvH(m_cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), mat.srvHeapIndex, m_cbvSrvDescSize);
-                m_cmdList->SetGraphicsRootDescriptorTable(1, srvH);
-            }
-            else
-            {
-                CD3DX12_GPU_DESCRIPTOR_HANDLE nullH(m_cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), 4, m_cbvSrvDescSize);
-                m_cmdList->SetGraphicsRootDescriptorTable(1, nullH);
-            }
-            m_cmdList->DrawIndexedInstanced(sub.indexCount, 1, sub.indexStart, 0, 0);
+        case CommandPacket::SetPipeline:
+            if (pass == DRAW_PASS_GEOMETRY) SetGeometryPermutation(packet.value, boundPermutation);
+            break;
+        case CommandPacket::SetMesh:
+            m_cmdList->IASetVertexBuffers(0, 1, vertexBuffers[packet.value]);
+            m_cmdList->IASetIndexBuffer(indexBuffers[packet.value]);
+            m_cmdList->SetGraphicsRootConstantBufferView(0, m_objectAddresses[packet.value]);
+            break;
+        case CommandPacket::SetTable:
+            m_cmdList->SetGraphicsRootDescriptorTable(1, SrvGpu(packet.value));
+            break;
+        case CommandPacket::SetMaterial:
+            m_cmdList->SetGraphicsRootConstantBufferView(3, packet.material);
+            break;
+        case CommandPacket::Draw:
+            m_cmdList->SetGraphicsRoot32BitConstant(4, packet.instanceStart, 0);
+            m_cmdList->DrawIndexedInstanced(packet.value, packet.instanceCount, packet.start, 0, 0);
+            ++m_drawCount;
+            break;
         }
+    }
 
-        m_texScroll = savedTexScroll;
-        m_cmdList->IASetVertexBuffers(0, 1, &m_vbView);
-        m_cmdList->IASetIndexBuffer(&m_ibView);
+#ifdef DRAW_LIST_BENCHMARK
+    static int frameCounter = 0;
+    if (++frameCounter % 300 == 0)
+    {
+        // Сколько переключений убрала сортировка относительно порядка сабсетов в файле
+        const DrawList& draws = m_retainedDraws[pass].GetList();
+        const DrawList::StateChanges unsorted = draws.CountStateChanges(false);
+        const DrawList::StateChanges sorted = draws.CountStateChanges(true);
+        char msg[256];
+        sprintf_s(msg, "[DrawList] %u draws: PSO %u -> %u, mesh %u -> %u, table %u -> %u, material %u -> %u, removed %u\n",
+            sorted.draws, unsorted.pipelines, sorted.pipelines, unsorted.meshes, sorted.meshes, unsorted.tables, sorted.tables,
+            unsorted.materials, sorted.materials, unsorted.Total() - min(unsorted.Total(), sorted.Total()));
+        OutputDebugStringA(msg);
     }
+#endif
 }
 
 void RenderingSystem::RenderLightingPass() {
+    // Таблица кадра: SRV GBuffer пересоздаются при OnResize, поэтому копируются каждый кадр
+    const uint32_t table = m_descriptors.AllocateTransient(Gbuffer::COUNT + 1, m_fenceValues[m_frameIndex]);
+    if (table == DescriptorAllocator::InvalidIndex) {
+        OutputDebugStringA("[Descriptors] No transient range for the lighting pass\n");
+        return;
+    }
+    m_device->CopyDescriptorsSimple(Gbuffer::COUNT, SrvCpu(table), m_gbuffer.GetSrvStart(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    m_device->CopyDescriptorsSimple(1, SrvCpu(table + Gbuffer::COUNT), m_stagingSrvHeap->GetCPUDescriptorHandleForHeapStart(),
+        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
     CD3DX12_CPU_DESCRIPTOR_HANDLE rtv(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescSize);
     m_cmdList->OMSetRenderTargets(1, &rtv, FALSE, nullptr);
     m_cmdList->SetPipelineState(m_lightingPassPSO.Get());
     m_cmdList->SetGraphicsRootSignature(m_lightingRootSignature.Get());
     ID3D12DescriptorHeap* heaps[] = { m_cbvSrvHeap.Get() };
     m_cmdList->SetDescriptorHeaps(1, heaps);
-    CD3DX12_GPU_DESCRIPTOR_HANDLE srvHandle(m_cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), 0, m_cbvSrvDescSize);
-    m_cmdList->SetGraphicsRootDescriptorTable(1, srvHandle);
+    m_cmdList->SetGraphicsRootDescriptorTable(1, SrvGpu(table));
     if (m_lightBuffer) m_cmdList->SetGraphicsRootConstantBufferView(0, m_lightBuffer->GetGPUVirtualAddress());
     m_cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     m_cmdList->IASetVertexBuffers(0, 0, nullptr);
@@ -1024,54 +1903,10 @@ void RenderingSystem::RenderForwardPass(float totalTime) {
     m_cmdList->SetDescriptorHeaps(1, heaps);
 
     m_cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    m_cmdList->IASetVertexBuffers(0, 1, &m_vbView);
-    m_cmdList->IASetIndexBuffer(&m_ibView);
-
-    XMMATRIX world = XMMatrixIdentity();
-    XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&m_eye), XMLoadFloat3(&m_target), XMLoadFloat3(&m_up));
-    float aspect = (float)m_width / (float)m_height;
-    XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(60.f), aspect, 0.1f, 5000.f);
-    XMMATRIX wit = XMMatrixTranspose(XMMatrixInverse(nullptr, world));
-
-    for (UINT subIdx = 0; subIdx < m_subsets.size(); ++subIdx) {
-        const MeshSubset& sub = m_subsets[subIdx];
-        if (sub.indexCount == 0) continue;
-
-        int matIdx = (sub.materialIdx >= 0 && sub.materialIdx < (int)m_gpuMaterials.size()) ? sub.materialIdx : 0;
-        const GpuMaterial& mat = m_gpuMaterials.empty() ? GpuMaterial{} : m_gpuMaterials[matIdx];
-
-        UINT slotIdx = m_frameIndex * MAX_SUBSETS + (subIdx % MAX_SUBSETS);
-        UINT8* slotPtr = reinterpret_cast<UINT8*>(m_cbMapped) + slotIdx * m_cbSlotSize;
-        D3D12_GPU_VIRTUAL_ADDRESS cbAddr = m_constantBuffer->GetGPUVirtualAddress() + slotIdx * m_cbSlotSize;
-
-        ConstantBufferData cb{};
-        XMStoreFloat4x4(&cb.World, XMMatrixTranspose(world));
-        XMStoreFloat4x4(&cb.View, XMMatrixTranspose(view));
-        XMStoreFloat4x4(&cb.Proj, XMMatrixTranspose(proj));
-        XMStoreFloat4x4(&cb.WorldInvTranspose, XMMatrixTranspose(wit));
-        cb.MaterialDiffuse = mat.diffuse;
-        cb.MaterialSpecular = mat.specular;
-        cb.MaterialSpecular.w = mat.shininess;
-        cb.HasTexture = mat.hasTexture ? 1 : 0;
-        cb.TexTilingX = m_texTiling.x;
-        cb.TexTilingY = m_texTiling.y;
-        cb.TotalTime = totalTime;
-        cb.TexScrollX = m_texScroll.x;
-        cb.TexScrollY = m_texScroll.y;
-        memcpy(slotPtr, &cb, sizeof(cb));
-
-        m_cmdList->SetGraphicsRootConstantBufferView(0, cbAddr);
-
-        if (mat.srvHeapIndex >= 0) {
-            CD3DX12_GPU_DESCRIPTOR_HANDLE srvH(m_cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), mat.srvHeapIndex, m_cbvSrvDescSize);
-            m_cmdList->SetGraphicsRootDescriptorTable(1, srvH);
-        }
-        else {
-            CD3DX12_GPU_DESCRIPTOR_HANDLE nullH(m_cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), 4, m_cbvSrvDescSize);
-            m_cmdList->SetGraphicsRootDescriptorTable(1, nullH);
-        }
-        m_cmdList->DrawIndexedInstanced(sub.indexCount, 1, sub.indexStart, 0, 0);
-    }
+    BindFrameConstants(totalTime);
+
+    PrepareDraws(DRAW_PASS_FORWARD);
+    SubmitDrawList(DRAW_PASS_FORWARD);
 }
 
 void RenderingSystem::UpdateCamera(float deltaTime, const InputDevice& input) {
@@ -1086,82 +1921,129 @@ void RenderingSystem::UpdateCamera(float deltaTime, const InputDevice& input) {
         m_tKeyPressed = false;
     }
 
+    if (input.IsKeyDown('O')) {
+        if (!m_oKeyPressed) {
+            m_occlusionCulling = !m_occlusionCulling;
+            m_oKeyPressed = true;
+            OutputDebugStringA(m_occlusionCulling ? "Occlusion culling: ON\n" : "Occlusion culling: OFF\n");
+        }
+    }
+    else {
+        m_oKeyPressed = false;
+    }
+
+    if (input.IsKeyDown('P')) {
+        if (!m_pKeyPressed) {
+            m_pvsCulling = !m_pvsCulling;
+            m_pKeyPressed = true;
+            OutputDebugStringA(m_pvsCulling ? "PVS culling: ON\n" : "PVS culling: OFF\n");
+        }
+    }
+    else {
+        m_pKeyPressed = false;
+    }
+
     static float lastPrint = 0;
     if (input.IsKeyDown('1')) {
-        m_tesselationNearDist = max(10.0f, m_tesselationNearDist - 10.0f);
+        m_frameSettings.tessNearDist = max(10.0f, m_frameSettings.tessNearDist - 10.0f);
         if (m_totalTime - lastPrint > 0.1f) {
             char msg[128];
-            sprintf_s(msg, "Tess Near Dist: %.1f\n", m_tesselationNearDist);
+            sprintf_s(msg, "Tess Near Dist: %.1f\n", m_frameSettings.tessNearDist);
             OutputDebugStringA(msg);
             lastPrint = m_totalTime;
         }
     }
     if (input.IsKeyDown('2')) {
-        m_tesselationNearDist += 10.0f;
+        m_frameSettings.tessNearDist += 10.0f;
         if (m_totalTime - lastPrint > 0.1f) {
             char msg[128];
-            sprintf_s(msg, "Tess Near Dist: %.1f\n", m_tesselationNearDist);
+            sprintf_s(msg, "Tess Near Dist: %.1f\n", m_frameSettings.tessNearDist);
             OutputDebugStringA(msg);
             lastPrint = m_totalTime;
         }
     }
     if (input.IsKeyDown('3')) {
-        m_tesselationFarDist = max(100.0f, m_tesselationFarDist - 50.0f);
+        m_frameSettings.tessFarDist = max(100.0f, m_frameSettings.tessFarDist - 50.0f);
         if (m_totalTime - lastPrint > 0.1f) {
             char msg[128];
-            sprintf_s(msg, "Tess Far Dist: %.1f\n", m_tesselationFarDist);
+            sprintf_s(msg, "Tess Far Dist: %.1f\n", m_frameSettings.tessFarDist);
             OutputDebugStringA(msg);
             lastPrint = m_totalTime;
         }
     }
     if (input.IsKeyDown('4')) {
-        m_tesselationFarDist += 50.0f;
+        m_frameSettings.tessFarDist += 50.0f;
         if (m_totalTime - lastPrint > 0.1f) {
             char msg[128];
-            sprintf_s(msg, "Tess Far Dist: %.1f\n", m_tesselationFarDist);
+            sprintf_s(msg, "Tess Far Dist: %.1f\n", m_frameSettings.tessFarDist);
             OutputDebugStringA(msg);
             lastPrint = m_totalTime;
         }
     }
 
-    float moveSpeed = m_cameraSpeed * deltaTime;
-    XMFLOAT3 moveDelta = { 0, 0, 0 };
-    if (input.IsKeyDown('W')) moveDelta.z += moveSpeed; if (input.IsKeyDown('S')) moveDelta.z -= moveSpeed;
-    if (input.IsKeyDown('A')) moveDelta.x -= moveSpeed; if (input.IsKeyDown('D')) moveDelta.x += moveSpeed;
-    if (input.IsKeyDown('Q')) moveDelta.y -= moveSpeed; if (input.IsKeyDown('E')) moveDelta.y += moveSpeed;
-    if (input.MouseDX() != 0 || input.MouseDY() != 0) {
-        float mouseSensitivity = 0.005f;
-        m_cameraYaw += input.MouseDX() * mouseSensitivity; m_cameraPitch += input.MouseDY() * mouseSensitivity;
-        if (m_cameraPitch < -XM_PIDIV2 + 0.1f) m_cameraPitch = -XM_PIDIV2 + 0.1f;
-        if (m_cameraPitch > XM_PIDIV2 - 0.1f) m_cameraPitch = XM_PIDIV2 - 0.1f;
-    }
-    float rotateSpeed = 1.0f * deltaTime;
-    if (input.IsKeyDown(VK_LEFT)) m_cameraYaw += rotateSpeed; if (input.IsKeyDown(VK_RIGHT)) m_cameraYaw -= rotateSpeed;
-    if (input.IsKeyDown(VK_UP)) { m_cameraPitch += rotateSpeed; if (m_cameraPitch > XM_PIDIV2 - 0.1f) m_cameraPitch = XM_PIDIV2 - 0.1f; }
-    if (input.IsKeyDown(VK_DOWN)) { m_cameraPitch -= rotateSpeed; if (m_cameraPitch < -XM_PIDIV2 + 0.1f) m_cameraPitch = -XM_PIDIV2 + 0.1f; }
-    XMMATRIX rotationMatrix = XMMatrixRotationRollPitchYaw(m_cameraPitch, m_cameraYaw, 0);
-    XMVECTOR moveVector = XMLoadFloat3(&moveDelta); moveVector = XMVector3TransformNormal(moveVector, rotationMatrix);
-    XMVECTOR eyePos = XMLoadFloat3(&m_eye); eyePos = eyePos + moveVector; XMStoreFloat3(&m_eye, eyePos);
-    XMVECTOR forward = XMVectorSet(0, 0, 1, 0);
-    forward = XMVector3TransformNormal(forward, rotationMatrix);
-    XMVECTOR targetPos = eyePos + forward; XMStoreFloat3(&m_target, targetPos);
-}
-
-float RenderingSystem::GetVerticalAngle() const {
-    XMVECTOR eye = XMLoadFloat3(&m_eye); XMVECTOR target = XMLoadFloat3(&m_target);
-    XMVECTOR viewDir = XMVector3Normalize(target - eye); XMFLOAT3 dir; XMStoreFloat3(&dir, viewDir);
-    float horizLength = sqrtf(dir.x * dir.x + dir.z * dir.z);
-    return atan2f(dir.y, horizLength);
+    // Сдвиг свободной камеры проверяется сферой: вдоль стен она скользит, сквозь - не проходит
+    if (UpdateSceneCamera(m_camera, m_cameraCollision, m_sceneBvh, deltaTime, input))
+        OutputDebugStringA(m_cameraCollision.enabled ? "Camera collision: ON\n" : "Camera collision: OFF\n");
+
+    if (input.IsMouseDown(1)) {
+        if (!m_pickPressed) PickUnderCursor(input);
+        m_pickPressed = true;
+    }
+    else {
+        m_pickPressed = false;
+    }
+}
+
+void RenderingSystem::PickUnderCursor(const InputDevice& input)
+{
+    if (m_sceneBvh.IsEmpty() || m_width <= 0 || m_height <= 0) return;
+    // Луч из глаза через пиксель курсора: базис камеры из обратной view
+    const XMMATRIX world = XMMatrixInverse(nullptr, m_camera.GetView());
+    const float tanY = tanf(XMConvertToRadians(FlyCamera::FovY) * 0.5f);
+    const float sx = ((input.MouseX() + 0.5f) / m_width * 2.0f - 1.0f) * tanY * m_width / m_height;
+    const float sy = (1.0f - (input.MouseY() + 0.5f) / m_height * 2.0f) * tanY;
+    TriangleBvh::Ray ray;
+    ray.origin = m_camera.GetEye();
+    XMStoreFloat3(&ray.direction, XMVectorAdd(world.r[2], XMVectorAdd(XMVectorScale(world.r[0], sx), XMVectorScale(world.r[1], sy))));
+
+    TriangleBvh::Hit hit;
+    char msg[256];
+    if (!m_sceneBvh.Intersect(ray, hit))
+    {
+        OutputDebugStringA("[Pick] nothing under the cursor\n");
+        return;
+    }
+    const XMFLOAT3& o = ray.origin;
+    const XMFLOAT3& d = ray.direction;
+    const XMFLOAT3 normal = m_sceneBvh.GetNormal(hit.triangle);
+    const uint32_t subset = m_sceneBvh.GetSubset(hit.triangle);
+    const int material = subset < m_subsets.size() ? m_subsets[subset].materialIdx : -1;
+    const char* name = material >= 0 && material < (int)m_sceneMaterials.size() ? m_sceneMaterials[material].name.c_str() : "-";
+    sprintf_s(msg, "[Pick] subset %u (%s) at (%.1f, %.1f, %.1f), normal (%.2f, %.2f, %.2f), distance %.1f\n", subset, name,
+        o.x + d.x * hit.t, o.y + d.y * hit.t, o.z + d.z * hit.t, normal.x, normal.y, normal.z,
+        hit.t * XMVectorGetX(XMVector3Length(XMLoadFloat3(&d))));
+    OutputDebugStringA(msg);
 }
 
+// Глубина и цели GBuffer уходят в очередь освобождения и новые создаются рядом со старыми.
+// Ждать приходится только задних буферов: ResizeBuffers требует, чтобы GPU с ними закончил
 void RenderingSystem::OnResize(int width, int height) {
     if (!m_initialized || (m_width == width && m_height == height)) return;
-    m_width = width; m_height = height; FlushCommandQueue();
-    for (auto& rt : m_renderTargets) rt.Reset(); m_depthStencil.Reset();
+    m_width = width; m_height = height;
+    std::vector<ComPtr<ID3D12Resource>> targets;
+    m_gbuffer.ReleaseTargets(targets);
+    targets.push_back(std::move(m_depthStencil));
+    for (auto& target : targets) RetireResource(std::move(target));
+
+    WaitForFence(m_fenceValues[m_frameIndex] - 1);
+    for (auto& rt : m_renderTargets) rt.Reset();
     ThrowIfFailed(m_swapChain->ResizeBuffers(FRAME_COUNT, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0));
+    // Кадры нумеруются заново с текущего значения: fence в очереди остаются монотонными
+    const UINT64 next = m_fenceValues[m_frameIndex];
     m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+    m_fenceValues[m_frameIndex] = next;
     CreateRenderTargetViews(); CreateDepthStencilView();
-    m_gbuffer.Initialize(m_device.Get(), m_cbvSrvHeap.Get(), width, height);
+    m_gbuffer.Initialize(m_device.Get(), width, height, &m_gpuHeaps);
 }
 
 void RenderingSystem::WaitForGPU() {
@@ -1173,6 +2055,13 @@ void RenderingSystem::WaitForGPU() {
     }
 }
 
+// Последнее выставленное значение - m_fenceValues[m_frameIndex] - 1
+void RenderingSystem::WaitForFence(UINT64 value) {
+    if (m_fence->GetCompletedValue() >= value) return;
+    ThrowIfFailed(m_fence->SetEventOnCompletion(value, m_fenceEvent));
+    WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
+}
+
 void RenderingSystem::MoveToNextFrame() {
     const UINT64 cur = m_fenceValues[m_frameIndex];
     ThrowIfFailed(m_cmdQueue->Signal(m_fence.Get(), cur));
@@ -10,10 +10,39 @@
 #include <vector>
 #include <array>
 #include <algorithm>
+#include <map>
+#include <chrono>
+#include <memory>
+#include <functional>
 #include "d3dx12.h"
 #include "OBJLoader.h"
 #include "TextureLoader.h"
+#include "TexturePacker.h"
+#include "AssetArchive.h"
+#include "VirtualFileSystem.h"
+#include "AsyncLoader.h"
+#include "UploadRing.h"
+#include "GpuHeapAllocator.h"
+#include "DeferredReleaseQueue.h"
+#include "DescriptorAllocator.h"
+#include "DrawList.h"
+#include "RetainedDrawList.h"
+#include "DrawPackets.h"
+#include "JobSystem.h"
+#include "FrameConstantAllocator.h"
+#include "FileWatcher.h"
+#include "ShaderCache.h"
+#include "GeometryPermutation.h"
 #include "InputDevice.h"
+#include "SceneConstants.h"
+#include "SceneDraws.h"
+#include "SceneFrame.h"
+#include "DuplicateGeometry.h"
+#include "OcclusionBuffer.h"
+#include "PotentiallyVisibleSet.h"
+#include "TriangleBvh.h"
+#include "FlyCamera.h"
+#include "RainSimulation.h"
 #include "Gbuffer.h"
 
 #pragma comment(lib, "d3d12.lib")
@@ -26,65 +55,31 @@ using namespace DirectX;
 
 struct Vertex { XMFLOAT3 Position; XMFLOAT3 Normal; XMFLOAT2 TexCoord; };
 
-struct alignas(256) ConstantBufferData {
-    XMFLOAT4X4 World;
-    XMFLOAT4X4 View;
-    XMFLOAT4X4 Proj;
-    XMFLOAT4X4 WorldInvTranspose;
-    XMFLOAT4 MaterialDiffuse;
-    XMFLOAT4 MaterialSpecular;
-
-    int HasTexture;
-    float TexTilingX;
-    float TexTilingY;
-    float TotalTime;
-
-    float TexScrollX;
-    float TexScrollY;
-    XMFLOAT2 Pad1;
-
-    XMFLOAT3 EyePosW;
-    float DisplacementScale;
-
-    float TessNearDist;
-    float TessFarDist;
-    XMFLOAT2 Pad2;
-};
-
 struct GpuMaterial {
     ComPtr<ID3D12Resource> texture;
-    ComPtr<ID3D12Resource> textureUpload;
     ComPtr<ID3D12Resource> normalTexture;
-    ComPtr<ID3D12Resource> normalUpload;
     ComPtr<ID3D12Resource> displacementTexture;
-    ComPtr<ID3D12Resource> displacementUpload;
 
-    int srvHeapIndex = -1;
+    // Таблица [diffuse array, normal, displacement]; пустая - текстуры по умолчанию
+    DescriptorAllocator::Handle srvTable;
+    UINT textureSlice = 0;
+    XMFLOAT4 uvRect = { 0.f, 0.f, 1.f, 1.f };
     XMFLOAT4 diffuse = { 0.8f, 0.8f, 0.8f, 1.f };
     XMFLOAT4 specular = { 0.5f, 0.5f, 0.5f, 1.f };
     float shininess = 32.f;
     bool hasTexture = false;
+    bool hasNormalMap = false;
+    float displacementScale = 0.f;
+    // Ключ варианта PSO геометрического прохода (GeometryPermutationKey)
+    uint32_t permutation = 0;
+    // Блок MaterialConstants; 0 - константы еще не загружены, материал не рисуется
+    D3D12_GPU_VIRTUAL_ADDRESS constants = 0;
 };
 
-struct PointLight {
-    XMFLOAT4 Position;
-    XMFLOAT4 Color;
-};
-
-struct SpotLight {
-    XMFLOAT4 Position;
-    XMFLOAT4 Direction;
-    XMFLOAT4 Color;
-};
-
-struct alignas(256) LightBufferData {
-    XMFLOAT4 DirLightDir;
-    XMFLOAT4 DirLightColor;
-    SpotLight SpotLights[2];
-    int NumSpotLights;
-    XMFLOAT3 Pad0;
-    XMFLOAT4 AmbientColor;
-    XMFLOAT4 EyePos;
+// Массив или атлас диффузных текстур, общий для нескольких материалов
+struct GpuTextureGroup {
+    ComPtr<ID3D12Resource> texture;
+    DescriptorAllocator::Handle srvTable;
 };
 
 class RenderingSystem
@@ -92,22 +87,51 @@ class RenderingSystem
 public:
     static constexpr UINT FRAME_COUNT = 2;
     static constexpr UINT MAX_TEXTURES = 128;
-    static constexpr UINT MAX_SUBSETS = 512;
-    static constexpr UINT MAX_RAIN_LIGHTS = 300;
+    static constexpr UINT MAX_RAIN_LIGHTS = RainSimulation::MaxLights;
+    static constexpr UINT SRV_HEAP_SIZE = 100 + MAX_TEXTURES * 3;
+    // Таблицы одного кадра (проход освещения) в конце кучи, сверх SRV_HEAP_SIZE
+    static constexpr UINT TRANSIENT_DESCRIPTORS = 64;
+    // Больше - отдельный буфер загрузки, без ожидания GPU
+    static constexpr UINT64 UPLOAD_RING_SIZE = 64ull << 20;
+    // Ресурсы DEFAULT-кучи размещаются в кучах такого размера; больше - отдельный ресурс
+    static constexpr UINT64 GPU_HEAP_SIZE = 64ull << 20;
+    // Дефрагментация куч: сколько копировать за кадр и с какой фрагментации начинать
+    static constexpr UINT64 DEFRAG_BYTES_PER_FRAME = 4ull << 20;
+    static constexpr double DEFRAG_MIN_FRAGMENTATION = 0.25;
+    // Начальный буфер констант кадра на слот; растет до реального числа блоков
+    static constexpr UINT64 FRAME_CONSTANTS_SIZE = 64ull << 10;
 
     RenderingSystem() = default;
     ~RenderingSystem();
 
-    bool Init(HWND hwnd, int width, int height);
+    // onDeviceReady вызывается на потоке Init сразу после создания устройства,
+    // пока компилируются шейдеры, - здесь удобно запускать фоновые загрузки
+    bool Init(HWND hwnd, int width, int height, std::function<void()> onDeviceReady = nullptr);
     void BeginFrame(const float clearColor[4]);
     void DrawScene(float totalTime, float deltaTime);
     void EndFrame();
     void OnResize(int width, int height);
+    // Ждут только разбор и декодирование; меш появится в одном из следующих кадров
     bool LoadObj(const std::string& path);
     bool LoadStump(const std::string& path);
-
-    void SetTexTiling(float x, float y) { m_texTiling = { x, y }; }
-    void SetTexScroll(float x, float y) { m_texScroll = { x, y }; }
+    // Разбор и декодирование идут в пуле потоков, кадры продолжают рисоваться; меш появляется
+    // в кадре, когда пройден fence кадра, в котором записано его копирование
+    AsyncLoadHandle LoadObjAsync(const std::string& path);
+    // preferLoose - файлы каталога вместо перекрывающих их записей архива (горячая перезагрузка)
+    AsyncLoadHandle LoadStumpAsync(const std::string& path, bool preferLoose = false);
+    // Все загрузки идут через VFS; смонтированный позже архив перекрывает файлы каталога.
+    // Монтировать только пока нет фоновых загрузок: пул читает индекс VFS без блокировок
+    bool MountDirectory(const std::string& directory, const std::string& mountPoint = "");
+    bool MountArchive(const std::string& path);
+    // Следит за смонтированными каталогами: измененные текстуры, OBJ и MTL сцены и файлы пня
+    // перезагружаются в фоне и подменяются на границе кадра
+    void EnableHotReload();
+
+    void SetTexTiling(float x, float y) { m_frameSettings.texTiling = { x, y }; }
+    void SetTexScroll(float x, float y) { m_texScroll = { x, y }; m_objectsDirty = true; }
+    // Еще один пень; одинаковые сабсеты всех пней рисуются одной отрисовкой с экземплярами
+    void AddStumpInstance(const XMFLOAT3& position);
+    // Камера сталкивается со сценой (клавиша C), правая кнопка мыши - луч под курсором в лог
     void UpdateCamera(float deltaTime, const InputDevice& input);
     void SetDeferredRendering(bool enable) { m_useDeferredRendering = enable; }
 
@@ -119,36 +143,111 @@ private:
     void CreateRenderTargetViews();
     void CreateDepthStencilView();
     void CreateFence();
-    void CompileShaders();
-    void CompileGeometryShaders();
-    void CompileLightingShaders();
+    void CreateShaderCache();
+    void CompileShader(const char* file, const char* entry, const char* target, ComPtr<ID3DBlob>& blob,
+        const std::vector<ShaderMacro>& defines = {}) const;
     void CreateRootSignature();
     void CreatePipelineStateObject();
-    void CreateGeometryPassPSO();
+    void CreateGeometryPassPSO(uint32_t key);
     void CreateLightingRootSignature();
     void CreateLightingPassPSO();
     void CreateCubeGeometry();
     void UploadMeshToGpu(const std::vector<Vertex>& verts, const std::vector<UINT>& indices);
     void CreateScreenQuad();
-    void CreateConstantBuffer();
-    void LoadMaterials(const ObjMesh& mesh, const std::string& baseDir);
+    void CreateFrameConstants();
+    // Блоки MaterialConstants в новом буфере; копирование пишется в текущий список команд
+    bool UploadMaterialConstants(std::vector<GpuMaterial>& materials, ComPtr<ID3D12Resource>& buffer);
+    // Заодно обновляет вид отсечения m_view
+    void BindFrameConstants(float totalTime);
+    D3D12_GPU_VIRTUAL_ADDRESS PushObjectConstants(const XMFLOAT2& texScroll);
+    // Блоки мешей по номеру меша и матрицы экземпляров в новом буфере; false - старый буфер остается
+    bool UploadObjectConstants();
+    // Блоки экземпляров всех мешей по m_stumpPositions и m_meshCopies; записи отрисовок заново
+    void RebuildInstances();
+    // Адреса m_objectAddresses и m_instanceAddress на этот кадр: буфер объектов или, если
+    // загрузить не удалось, кольцо кадра
+    void PrepareObjectConstants();
+    // Записи меша во всех проходах строятся заново перед следующей отрисовкой
+    void MarkDrawsDirty(uint32_t mesh);
+    // Строит грязные слоты списка заново и сортирует его, если что-то изменилось
+    void UpdateRetainedDraws(RetainedDrawList& list, uint32_t pass);
+    // Обновление списка прохода, отсечение по m_view и буферу перекрытия, пакеты отрисовки
+    // в m_drawPackets
+    void PrepareDraws(uint32_t pass);
+    void AddDraws(RetainedDrawList& list, uint32_t pass, uint32_t mesh, const std::vector<MeshSubset>& subsets,
+        const std::vector<GpuMaterial>& materials, const std::vector<uint32_t>& instances);
+    // Переигрывает m_drawPackets в список команд
+    void SubmitDrawList(uint32_t pass);
+    class SceneUpload;
+    class StumpUpload;
+    class TextureReload;
+    class MaterialReload;
+    // Место текстуры сцены в группах TexturePacker
+    struct SceneTexture {
+        int group = -1;
+        UINT slice = 0;
+        UINT x = 0, y = 0;
+        UINT width = 0, height = 0;
+        DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+        bool atlas = false;
+        UINT padding = 0;
+    };
+    struct PendingReload {
+        AsyncLoadHandle handle;
+        std::string key;
+        std::string path;
+        std::chrono::steady_clock::time_point changed;
+    };
+    AsyncLoadHandle ReloadSceneTexture(const std::string& path);
+    AsyncLoadHandle ReloadSceneMesh(bool geometry);
+    void PollHotReload();
+    bool LoadMesh(const std::string& path, ObjMesh& mesh, bool preferLoose = false) const;
+    // LoadMesh и замена повторяющихся кусков сцены экземплярами
+    bool LoadSceneMesh(const std::string& path, ObjMesh& mesh, bool preferLoose = false) const;
+    // Набор PvsBaker рядом со сценой; нет файла или он от другого меша - пустой набор
+    void LoadScenePvs(const std::string& path, const ObjMesh& mesh, PotentiallyVisibleSet& pvs) const;
+    void BuildSceneBvh(const ObjMesh& mesh, TriangleBvh& bvh) const;
+    void PickUnderCursor(const InputDevice& input);
+    void LoadTextures(const std::vector<std::string>& paths, std::vector<TextureLoader::TextureData>& textures, std::vector<bool>& loaded, bool preferLoose = false) const;
+    // Буфер в DEFAULT-куче и его данные в кольце загрузки, копирование еще не записано
+    struct BufferUpload {
+        ComPtr<ID3D12Resource> buffer;
+        UploadRing::Allocation staging;
+        UINT size = 0;
+        D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON;
+    };
+    bool PrepareBuffer(const void* data, UINT size, D3D12_RESOURCE_STATES state, BufferUpload& out);
+    void RecordBufferUpload(BufferUpload& upload);
+    bool FinishLoad(const AsyncLoadHandle& handle);
+    void PumpLoads(UINT maxUploads);
+    void RetireResource(ComPtr<ID3D12Resource> resource);
+    void DefragmentHeaps();
+    void CompleteHeapMove(GpuHeapAllocator::Move& move);
     void CreateLightingResources();
     void CreateRainLightBuffer();
     void CreateRainLightSRV();
     void CreateDefaultTextures();
-
+    D3D12_CPU_DESCRIPTOR_HANDLE SrvCpu(uint32_t index) const;
+    D3D12_GPU_DESCRIPTOR_HANDLE SrvGpu(uint32_t index) const;
+    // Индекс таблицы для отрисовки: пустая или освобожденная - таблица по умолчанию
+    uint32_t ResolveTable(const DescriptorAllocator::Handle& table) const;
+    // nullptr - текстура по умолчанию
+    void WriteMaterialTable(uint32_t index, ID3D12Resource* diffuse, ID3D12Resource* normal, ID3D12Resource* displacement);
+
+    void SetGeometryPermutation(uint32_t key, uint32_t& bound);
     void RenderGeometryPass(float totalTime);
     void RenderLightingPass();
     void RenderForwardPass(float totalTime);
-    void UpdateRainLights(float deltaTime);
     void UploadRainLightsToGPU();
     void AddLight();
     void WaitForGPU();
+    void WaitForFence(UINT64 value);
     void FlushCommandQueue();
     void MoveToNextFrame();
-    float GetVerticalAngle() const;
 
     ComPtr<ID3D12Device> m_device;
+    // Сразу после устройства: размещенные в кучах ресурсы объявлены ниже и уничтожаются раньше
+    GpuHeapAllocator m_gpuHeaps;
     ComPtr<IDXGIFactory6> m_factory;
     ComPtr<ID3D12CommandQueue> m_cmdQueue;
     ComPtr<ID3D12GraphicsCommandList> m_cmdList;
@@ -166,15 +265,14 @@ private:
     HANDLE m_fenceEvent = nullptr;
 
     ComPtr<ID3D12RootSignature> m_rootSignature;
+    std::unique_ptr<ShaderCache> m_shaderCache;
     ComPtr<ID3D12PipelineState> m_pso;
-    ComPtr<ID3DBlob> m_vsBlob;
-    ComPtr<ID3DBlob> m_psBlob;
-
-    ComPtr<ID3DBlob> m_hsBlob;
-    ComPtr<ID3DBlob> m_dsBlob;
-
-    ComPtr<ID3D12PipelineState> m_geometryPassPSO;
-    ComPtr<ID3D12PipelineState> m_wireframePSO;
+    ComPtr<ID3DBlob> m_phongVSBlob;
+    ComPtr<ID3DBlob> m_phongPSBlob;
+    // Стадии вариантов геометрического прохода по GeometryStageVariant
+    std::unique_ptr<VariantCache<ComPtr<ID3DBlob>>> m_geometryShaders;
+    ComPtr<ID3D12PipelineState> m_geometryPSOs[GEOMETRY_PERMUTATION_COUNT];
+    ComPtr<ID3D12PipelineState> m_wireframePSOs[GEOMETRY_PERMUTATION_COUNT];
     ComPtr<ID3D12PipelineState> m_lightingPassPSO;
     ComPtr<ID3D12RootSignature> m_lightingRootSignature;
     ComPtr<ID3DBlob> m_lightingVSBlob;
@@ -186,6 +284,8 @@ private:
     D3D12_INDEX_BUFFER_VIEW m_ibView{};
     std::vector<MeshSubset> m_subsets;
     std::vector<GpuMaterial> m_gpuMaterials;
+    ComPtr<ID3D12Resource> m_materialConstants;
+    std::vector<GpuTextureGroup> m_textureGroups;
 
     ComPtr<ID3D12Resource> m_stumpVertexBuffer;
     ComPtr<ID3D12Resource> m_stumpIndexBuffer;
@@ -193,55 +293,123 @@ private:
     D3D12_INDEX_BUFFER_VIEW m_stumpIbView{};
     std::vector<MeshSubset> m_stumpSubsets;
     std::vector<GpuMaterial> m_stumpMaterials;
+    ComPtr<ID3D12Resource> m_stumpMaterialConstants;
+
+    // Через кольцо идут все копирования CPU -> GPU. Объявлено раньше m_loader и m_reloads:
+    // незаписанные загрузки возвращают свои выделения при разрушении
+    UploadRing m_uploadRing;
+    VirtualFileSystem m_vfs;
+    AsyncLoader m_loader;
+    // Замененные ресурсы живут до прохождения fence кадра, в котором их заменили
+    DeferredReleaseQueue<ComPtr<ID3D12Resource>> m_retiredResources;
+    // Переносы дефрагментации: владелец переключается на копию после fence кадра копирования
+    std::vector<std::pair<UINT64, GpuHeapAllocator::Move>> m_heapMoves;
+
+    // Горячая перезагрузка: что загружено и откуда
+    std::vector<std::pair<std::string, std::string>> m_mounts;
+    std::unique_ptr<FileWatcher> m_watcher;
+    std::string m_scenePath;
+    std::vector<std::string> m_sceneLibraries;
+    std::vector<Material> m_sceneMaterials;
+    std::map<std::string, SceneTexture> m_sceneTextures;
+    std::string m_stumpPath;
+    std::vector<PendingReload> m_reloads;
+    std::vector<FileWatcher::Change> m_deferredChanges;
 
     ComPtr<ID3D12Resource> m_defaultDiffuseTex;
     ComPtr<ID3D12Resource> m_defaultNormalTex;
     ComPtr<ID3D12Resource> m_defaultDisplacementTex;
-    ComPtr<ID3D12Resource> m_defaultDiffuseUpload;
-    ComPtr<ID3D12Resource> m_defaultNormalUpload;
-    ComPtr<ID3D12Resource> m_defaultDisplacementUpload;
-
-    UINT m_currentSrvSlot = 7;
 
-    ComPtr<ID3D12Resource> m_constantBuffer;
-    ConstantBufferData* m_cbMapped = nullptr;
-    UINT m_cbSlotSize = 0;
+    // Таблицы материалов выдаются и возвращаются по fence - перезагрузки не исчерпывают кучу
+    DescriptorAllocator m_descriptors{ SRV_HEAP_SIZE, TRANSIENT_DESCRIPTORS };
+    DescriptorAllocator::Handle m_defaultSrvTable;
+    // Невидимая шейдерам куча: SRV источников дождя, копируется в таблицу освещения каждый кадр
+    ComPtr<ID3D12DescriptorHeap> m_stagingSrvHeap;
+
+    FrameConstantAllocator m_frameConstants;
+    // Сцена - один экземпляр с единичной матрицей, пни - по позициям. Буфер объектов
+    // переписывается при смене прокрутки текстуры и экземпляров
+    std::vector<XMFLOAT3> m_stumpPositions{ STUMP_POSITION };
+    // Копии сабсетов меша (ObjMesh::instances)
+    std::vector<XMFLOAT4X4> m_meshCopies[DRAW_MESH_COUNT];
+    std::vector<InstanceData> m_instances;
+    // Номера блоков AppendMeshInstances каждого меша в m_instances
+    std::vector<uint32_t> m_meshInstances[DRAW_MESH_COUNT];
+    bool m_instancesDirty = true;
+    ComPtr<ID3D12Resource> m_objectConstants;
+    D3D12_GPU_VIRTUAL_ADDRESS m_objectAddresses[DRAW_MESH_COUNT]{};
+    D3D12_GPU_VIRTUAL_ADDRESS m_instanceAddress = 0;
+    bool m_objectsDirty = true;
+#ifdef FRAME_CONSTANTS_BENCHMARK
+    struct ConstantsBenchmark {
+        UINT frames = 0;
+        UINT64 draws = 0;
+        UINT64 bytesWritten = 0;
+        LONGLONG recordTicks = 0;
+    } m_constantsBenchmark;
+#endif
+    UINT m_drawCount = 0;
+    // Отрисовки проходов по DRAW_PASS_*, слоты - меши DRAW_MESH_*
+    RetainedDrawList m_retainedDraws[DRAW_PASS_COUNT] = { RetainedDrawList(DRAW_MESH_COUNT), RetainedDrawList(DRAW_MESH_COUNT) };
+    // Вид камеры последнего BindFrameConstants
+    FrameView m_view;
+    // Крупные треугольники сцены растеризуются на CPU каждый кадр; клавиша O
+    std::vector<XMFLOAT3> m_occluders;
+    OcclusionBuffer m_occlusion;
+    bool m_occlusionCulling = true;
+    bool m_oKeyPressed = false;
+    // Заранее посчитанная видимость кластеров сцены по ячейке камеры; клавиша P
+    PotentiallyVisibleSet m_pvs;
+    bool m_pvsCulling = true;
+    bool m_pKeyPressed = false;
+#ifdef OCCLUSION_CULLING_BENCHMARK
+    struct OcclusionBenchmark {
+        UINT frames = 0;
+        double rasterMs = 0.0;
+        UINT64 tested = 0;
+        UINT64 pvsCulled = 0;
+        UINT64 occluded = 0;
+    } m_occlusionBenchmark;
+#endif
+    // Пакеты собираются кусками на потоках пула, результат не зависит от числа потоков
+    std::unique_ptr<JobSystem> m_jobs;
+    DrawPacketBuilder m_drawPackets;
+#ifdef RETAINED_DRAW_LIST_BENCHMARK
+    // Для сравнения: тот же список, собранный заново, как до удерживаемого списка
+    struct RetainedBenchmark {
+        UINT frames = 0;
+        LONGLONG rebuildTicks = 0;
+        LONGLONG retainedTicks = 0;
+        UINT mismatches = 0;
+    } m_retainedBenchmark;
+    RetainedDrawList m_rebuiltDraws{ DRAW_MESH_COUNT };
+    DrawPacketBuilder m_rebuiltPackets;
+#endif
 
     ComPtr<ID3D12Resource> m_lightBuffer;
     LightBufferData* m_lightMappedData = nullptr;
     ComPtr<ID3D12Resource> m_pointLightBuffer;
     PointLight* m_pointLightsMapped = nullptr;
-    struct RainLight { PointLight data; bool active = false; XMFLOAT3 velocity{ 0.f, -200.f, 0.f }; float lifeTime = 0.f; };
-    std::vector<RainLight> m_rainLights;
-    float m_spawnTimer = 0.f;
-    float m_spawnInterval = 0.005f;
-    XMFLOAT3 m_spawnAreaMin{ -800.f, 20.f, -350.f };
-    XMFLOAT3 m_spawnAreaMax{ 750.f, 30.f, 300.f };
-    float m_floorY = -1.5f;
-    UINT m_activeLightCount = 0;
+    RainSimulation m_rain;
 
     Gbuffer m_gbuffer;
     ComPtr<ID3D12Resource> m_depthStencil;
     ComPtr<ID3D12Resource> m_screenQuadVB;
     D3D12_VERTEX_BUFFER_VIEW m_screenQuadVBView{};
 
-    XMFLOAT2 m_texTiling = { 1.f, 1.f };
+    FrameSettings m_frameSettings;
     XMFLOAT2 m_texScroll = { 0.05f, 0.f };
     int m_width = 0;
     int m_height = 0;
-    XMFLOAT3 m_eye = { -80.f, 20.f, -20.f };
-    XMFLOAT3 m_target = { 0.f, 10.f, 0.f };
-    XMFLOAT3 m_up = { 0.f, 1.f, 0.f };
-    float m_cameraSpeed = 500.0f;
-    float m_cameraYaw = 0.0f;
-    float m_cameraPitch = 0.0f;
+    FlyCamera m_camera;
     float m_totalTime = 0.0f;
     bool m_initialized = false;
     bool m_useDeferredRendering = true;
 
     bool m_wireframeMode = false;
     bool m_tKeyPressed = false;
-    
-    float m_tesselationNearDist = 200.0f;  
-    float m_tesselationFarDist = 1500.0f;  
+    // Треугольники сцены для лучей с CPU; строится вместе с загрузкой меша
+    TriangleBvh m_sceneBvh;
+    CameraCollision m_cameraCollision;
+    bool m_pickPressed = false;
 };
\ No newline at end of file
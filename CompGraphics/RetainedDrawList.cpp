@@ -0,0 +1,76 @@
+#include "RetainedDrawList.h"
+
+RetainedDrawList::RetainedDrawList(uint32_t slotCount)
+	: m_slots(slotCount), m_dirty(slotCount, true)
+{
+}
+
+void RetainedDrawList::MarkDirty(uint32_t slot)
+{
+	m_dirty[slot] = true;
+}
+
+void RetainedDrawList::MarkAllDirty()
+{
+	for (size_t i = 0; i < m_dirty.size(); ++i) m_dirty[i] = true;
+}
+
+void RetainedDrawList::ClearSlot(uint32_t slot)
+{
+	m_slots[slot].clear();
+	m_dirty[slot] = false;
+	m_changed = true;
+	++m_stats.rebuiltSlots;
+}
+
+void RetainedDrawList::Add(uint32_t slot, const Draw& draw)
+{
+	m_slots[slot].push_back(draw);
+	m_changed = true;
+}
+
+bool RetainedDrawList::Update()
+{
+	if (!m_changed) return false;
+	m_list.Clear();
+	m_spheres.clear();
+	m_clusters.clear();
+	for (const std::vector<Draw>& slot : m_slots)
+	{
+		for (const Draw& d : slot)
+		{
+			m_list.Add(d.key, d.pipeline, d.mesh, d.table, d.material, d.indexStart, d.indexCount, d.instance);
+			m_spheres.insert(m_spheres.end(), d.sphere, d.sphere + 4);
+			m_clusters.push_back(d.cluster);
+		}
+	}
+	m_list.Sort();
+	m_changed = false;
+	++m_stats.builds;
+	m_stats.draws = (uint32_t)m_list.GetSize();
+	return true;
+}
+
+const std::vector<uint32_t>& RetainedDrawList::Cull(const float planes[6][4])
+{
+	m_visible.clear();
+	CullRange(planes, 0, m_list.GetSize(), m_visible);
+	m_stats.visible = (uint32_t)m_visible.size();
+	return m_visible;
+}
+
+void RetainedDrawList::CullRange(const float planes[6][4], size_t begin, size_t end, std::vector<uint32_t>& out) const
+{
+	for (size_t i = begin; i < end; ++i)
+	{
+		const uint32_t item = m_list.GetOrder(i);
+		const float* s = &m_spheres[(size_t)item * 4];
+		bool inside = true;
+		if (s[3] >= 0.f)
+		{
+			for (int p = 0; p < 6 && inside; ++p)
+				inside = planes[p][0] * s[0] + planes[p][1] * s[1] + planes[p][2] * s[2] + planes[p][3] >= -s[3];
+		}
+		if (inside) out.push_back(item);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "DrawList.h"
+
+// Отрисовки, которые живут между кадрами. Записи разбиты на слоты (меши): слот строится
+// заново, только когда его пометили грязным - сменились сабсеты, материалы или таблицы
+// дескрипторов. Отсортированный порядок пересобирается лишь после такой пересборки,
+// а на кадр остается отсечение ограничивающих сфер по пирамиде видимости.
+// Ключи без глубины: порядок не зависит от камеры. Без D3D, только поток отрисовки.
+class RetainedDrawList
+{
+public:
+	struct Draw
+	{
+		uint64_t key = 0;
+		uint32_t pipeline = 0;
+		uint32_t mesh = 0;
+		uint32_t table = 0;
+		uint64_t material = 0;
+		uint32_t indexStart = 0;
+		uint32_t indexCount = 0;
+		// Номер экземпляра в буфере экземпляров
+		uint32_t instance = 0;
+		// Номер кластера PotentiallyVisibleSet; UINT32_MAX - не входит в наборы
+		uint32_t cluster = UINT32_MAX;
+		// Центр в мировом пространстве и радиус; радиус < 0 - не отсекается
+		float sphere[4] = { 0.f, 0.f, 0.f, -1.f };
+	};
+
+	struct Stats
+	{
+		// Пересборки порядка и слотов с начала работы
+		uint32_t builds = 0;
+		uint32_t rebuiltSlots = 0;
+		uint32_t draws = 0;
+		// Прошли отсечение в последнем Cull
+		uint32_t visible = 0;
+	};
+
+	// Все слоты изначально грязные
+	explicit RetainedDrawList(uint32_t slotCount);
+
+	void MarkDirty(uint32_t slot);
+	void MarkAllDirty();
+	bool IsDirty(uint32_t slot) const { return m_dirty[slot]; }
+
+	// Убирает записи слота и снимает пометку; новые записи добавляются через Add
+	void ClearSlot(uint32_t slot);
+	void Add(uint32_t slot, const Draw& draw);
+
+	// Собирает и сортирует список, если слоты менялись. true - список перестроен
+	bool Update();
+	// Плоскости (a, b, c, d) с нормалями внутрь: точка видима, если ax + by + cz + d >= 0.
+	// Возвращает номера элементов GetList() в отсортированном порядке
+	const std::vector<uint32_t>& Cull(const float planes[6][4]);
+	// То же для мест [begin, end) отсортированного порядка; дописывает в out. Можно звать
+	// с нескольких потоков, пока список не меняется
+	void CullRange(const float planes[6][4], size_t begin, size_t end, std::vector<uint32_t>& out) const;
+
+	const DrawList& GetList() const { return m_list; }
+	// Сфера элемента GetList(): центр и радиус
+	const float* GetSphere(uint32_t item) const { return &m_spheres[(size_t)item * 4]; }
+	uint32_t GetCluster(uint32_t item) const { return m_clusters[item]; }
+	const std::vector<uint32_t>& GetVisible() const { return m_visible; }
+	const Stats& GetStats() const { return m_stats; }
+
+private:
+	std::vector<std::vector<Draw>> m_slots;
+	std::vector<bool> m_dirty;
+	bool m_changed = true;
+	DrawList m_list;
+	// Сферы элементов m_list по номеру элемента
+	std::vector<float> m_spheres;
+	std::vector<uint32_t> m_clusters;
+	std::vector<uint32_t> m_visible;
+	Stats m_stats;
+};
\ No newline at end of file
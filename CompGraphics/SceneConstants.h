@@ -0,0 +1,73 @@
+#pragma once
+#include <DirectXMath.h>
+
+// Раскладки констант шейдеров сцены на стороне C++ (SceneConstants.hlsli, LightingPass.hlsl).
+// Без D3D: блоки заполняет и безголовый прогон кадра FrameBenchmark
+
+// Константы геометрии разделены по частоте смены:
+// b0 - меш, общее для всех экземпляров; блоки всех мешей и матрицы экземпляров в одном
+// DEFAULT-буфере, переписываются только при изменении
+struct alignas(256) ObjectConstants
+{
+	float TexScrollX;
+	float TexScrollY;
+	DirectX::XMFLOAT2 Pad;
+};
+
+// t3 - экземпляр меша, матрицы в раскладке шейдера (транспонированные)
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInvTranspose;
+};
+
+// b1 - кадр, один блок на проход
+struct FrameConstants
+{
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Proj;
+	DirectX::XMFLOAT3 EyePosW;
+	float TotalTime;
+	float TexTilingX;
+	float TexTilingY;
+	float TessNearDist;
+	float TessFarDist;
+};
+
+// b2 - материал, блоки всех материалов меша в одном DEFAULT-буфере, загружаются с мешем
+struct alignas(256) MaterialConstants
+{
+	DirectX::XMFLOAT4 Diffuse;
+	// w - shininess
+	DirectX::XMFLOAT4 Specular;
+	DirectX::XMFLOAT4 UvRect;
+	int HasTexture;
+	float DisplacementScale;
+	float TexSlice;
+	float Pad;
+};
+
+// Проход освещения: источники дождя - структурированный буфер, остальное - один блок
+struct PointLight
+{
+	DirectX::XMFLOAT4 Position;
+	DirectX::XMFLOAT4 Color;
+};
+
+struct SpotLight
+{
+	DirectX::XMFLOAT4 Position;
+	DirectX::XMFLOAT4 Direction;
+	DirectX::XMFLOAT4 Color;
+};
+
+struct alignas(256) LightBufferData
+{
+	DirectX::XMFLOAT4 DirLightDir;
+	DirectX::XMFLOAT4 DirLightColor;
+	SpotLight SpotLights[2];
+	int NumSpotLights;
+	DirectX::XMFLOAT3 Pad0;
+	DirectX::XMFLOAT4 AmbientColor;
+	DirectX::XMFLOAT4 EyePos;
+};
\ No newline at end of file
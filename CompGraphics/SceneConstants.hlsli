@@ -0,0 +1,67 @@
+// Константы геометрии по частоте смены; раскладка совпадает с ObjectConstants,
+// FrameConstants, MaterialConstants и InstanceData в SceneConstants.h
+
+// Меш: общее для всех его экземпляров
+cbuffer ObjectCB : register(b0)
+{
+    float gTexScrollX;
+    float gTexScrollY;
+    float2 gObjectPad;
+};
+
+// Кадр: камера, время, общие настройки
+cbuffer FrameCB : register(b1)
+{
+    float4x4 gView;
+    float4x4 gProj;
+    float3 gEyePosW;
+    float gTotalTime;
+    float gTexTilingX;
+    float gTexTilingY;
+    float gTessNearDist;
+    float gTessFarDist;
+};
+
+// Материал: загружается вместе с мешем
+cbuffer MaterialCB : register(b2)
+{
+    float4 gMaterialDiffuse;
+    float4 gMaterialSpecular;
+    float4 gUvRect;
+    int gHasTexture;
+    float gDisplacementScale;
+    float gTexSlice;
+    float gMaterialPad;
+};
+
+// Отрисовка: где в gVisibleInstances начинаются ее экземпляры
+cbuffer DrawCB : register(b3)
+{
+    uint gInstanceBase;
+};
+
+// Матрицы экземпляров мешей; переписываются только при изменении
+struct InstanceData
+{
+    float4x4 World;
+    float4x4 WorldInvTranspose;
+};
+StructuredBuffer<InstanceData> gInstances : register(t3);
+
+// Видимые экземпляры кадра подряд по отрисовкам
+StructuredBuffer<uint> gVisibleInstances : register(t4);
+
+InstanceData LoadInstance(uint instanceID)
+{
+    return gInstances[gVisibleInstances[gInstanceBase + instanceID]];
+}
+
+// Диффузная текстура материала: слой массива или прямоугольник атласа (gTexSlice, gUvRect).
+// Повтор внутри прямоугольника делаем вручную, градиенты берем от исходных UV, чтобы на
+// границе повтора не было шва
+float4 SampleDiffuse(Texture2DArray diffuseMap, SamplerState samp, float2 uv)
+{
+    float2 scale = gUvRect.zw;
+    float2 atlasUV = gUvRect.xy + frac(uv) * scale;
+    return diffuseMap.SampleGrad(samp, float3(atlasUV, gTexSlice), ddx(uv) * scale, ddy(uv) * scale);
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "SceneDraws.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+XMMATRIX StumpWorld(const XMFLOAT3& position)
+{
+	return XMMatrixScaling(500.0f, 500.0f, 500.0f) *
+		XMMatrixRotationZ(XMConvertToRadians(-90.0f)) *
+		XMMatrixTranslationFromVector(XMLoadFloat3(&position));
+}
+
+InstanceData MakeInstance(FXMMATRIX world)
+{
+	InstanceData instance;
+	XMStoreFloat4x4(&instance.World, XMMatrixTranspose(world));
+	XMStoreFloat4x4(&instance.WorldInvTranspose, XMMatrixTranspose(XMMatrixInverse(nullptr, world)));
+	return instance;
+}
+
+void AppendMeshInstances(FXMMATRIX world, const std::vector<XMFLOAT4X4>& copies, std::vector<InstanceData>& out)
+{
+	out.push_back(MakeInstance(world));
+	for (const XMFLOAT4X4& copy : copies) out.push_back(MakeInstance(XMLoadFloat4x4(&copy) * world));
+}
+
+void AddMeshDraws(RetainedDrawList& list, uint32_t pass, uint32_t mesh, const std::vector<MeshSubset>& subsets,
+	const std::vector<DrawMaterial>& materials, const std::vector<uint32_t>& instances,
+	const std::vector<InstanceData>& instanceData, bool clusters)
+{
+	if (materials.empty()) return;
+	// Номера кластеров идут по всем сабсетам, и по пропущенным
+	uint32_t cluster = 0;
+	for (const MeshSubset& sub : subsets)
+	{
+		const uint32_t firstCluster = cluster;
+		cluster += sub.instanceCount ? sub.instanceCount : 1;
+		if (sub.indexCount == 0) continue;
+		const uint32_t matIdx = (sub.materialIdx >= 0 && sub.materialIdx < (int)materials.size()) ? sub.materialIdx : 0;
+		const DrawMaterial& mat = materials[matIdx];
+		if (!mat.constants) continue;
+
+		RetainedDrawList::Draw draw;
+		draw.pipeline = mat.pipeline;
+		draw.mesh = mesh;
+		draw.table = mat.table;
+		draw.material = mat.constants;
+		draw.indexStart = sub.indexStart;
+		draw.indexCount = sub.indexCount;
+		draw.key = DrawList::MakeKey(pass, draw.pipeline, mesh, draw.table, matIdx, 0);
+		const XMVECTOR center = XMLoadFloat3(&sub.center);
+		const uint32_t copies = sub.instanceCount ? sub.instanceCount : 1;
+		for (size_t b = 0; b < instances.size(); ++b)
+			for (uint32_t c = 0; c < copies; ++c)
+			{
+				const uint32_t block = instances[b];
+				draw.instance = sub.instanceCount ? block + 1 + sub.instanceStart + c : block;
+				draw.cluster = clusters && b == 0 ? firstCluster + c : UINT32_MAX;
+				const XMMATRIX w = XMMatrixTranspose(XMLoadFloat4x4(&instanceData[draw.instance].World));
+				const float scale = std::max(XMVectorGetX(XMVector3Length(w.r[0])),
+					std::max(XMVectorGetX(XMVector3Length(w.r[1])), XMVectorGetX(XMVector3Length(w.r[2]))));
+				XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(draw.sphere), XMVector3Transform(center, w));
+				// Смещение тесселяции выходит за вершины на displacementScale
+				draw.sphere[3] = sub.radius * scale + fabsf(mat.displacementScale);
+				list.Add(mesh, draw);
+			}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "OBJLoader.h"
+#include "RetainedDrawList.h"
+#include "SceneConstants.h"
+
+// Проходы и меши - поля ключа DrawList и слоты RetainedDrawList
+static const uint32_t DRAW_PASS_GEOMETRY = 0;
+static const uint32_t DRAW_PASS_FORWARD = 1;
+static const uint32_t DRAW_PASS_COUNT = 2;
+static const uint32_t DRAW_MESH_SCENE = 0;
+static const uint32_t DRAW_MESH_STUMP = 1;
+static const uint32_t DRAW_MESH_COUNT = 2;
+// Столько мест отсортированного списка отсекает и переводит в пакеты одна задача
+static const size_t DRAW_PACKET_CHUNK = 256;
+// Сабсеты сцены режутся на куски такого размера, чтобы буфер перекрытия мог их отбросить;
+// заслонителей - столько самых крупных треугольников сцены
+static const float OCCLUSION_CELL_SIZE = 400.0f;
+static const size_t OCCLUSION_OCCLUDERS = 4096;
+// Свободная камера - сфера такого радиуса против TriangleBvh сцены
+static const float CAMERA_COLLISION_RADIUS = 10.0f;
+
+// Пень стоит в position (первый - в STUMP_POSITION), масштаб 500, повернут на -90 градусов вокруг Z
+static const DirectX::XMFLOAT3 STUMP_POSITION = { 1000.0f, 100.0f, 80.0f };
+DirectX::XMMATRIX StumpWorld(const DirectX::XMFLOAT3& position);
+
+// Матрицы экземпляра в раскладке шейдера
+InstanceData MakeInstance(DirectX::FXMMATRIX world);
+// Блок экземпляра объекта в буфере экземпляров: матрица world, за ней копии сабсетов
+// (ObjMesh::instances), умноженные на нее. Номер первой записи блока передается в AddMeshDraws
+void AppendMeshInstances(DirectX::FXMMATRIX world, const std::vector<DirectX::XMFLOAT4X4>& copies,
+	std::vector<InstanceData>& out);
+
+// Что записи отрисовки нужно от материала
+struct DrawMaterial
+{
+	// Вариант PSO прохода
+	uint32_t pipeline = 0;
+	uint32_t table = 0;
+	// Адрес блока MaterialConstants; 0 - материал не рисуется
+	uint64_t constants = 0;
+	float displacementScale = 0.f;
+};
+
+// Записи сабсетов меша в слот mesh, по записи на экземпляр; instances - номера блоков
+// AppendMeshInstances в instanceData, сабсет с копиями дает запись на каждую копию блока.
+// Не зависят от камеры: ключ без глубины, сфера сабсета переводится в мир один раз.
+// Экземпляры сабсета идут подряд с одним ключом - сортировка их не разделяет, и видимые
+// DrawPacketBuilder собирает в одну отрисовку.
+// clusters - записи первого блока получают номера кластеров PVS (CountClusters)
+void AddMeshDraws(RetainedDrawList& list, uint32_t pass, uint32_t mesh, const std::vector<MeshSubset>& subsets,
+	const std::vector<DrawMaterial>& materials, const std::vector<uint32_t>& instances,
+	const std::vector<InstanceData>& instanceData, bool clusters = false);
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "SceneFrame.h"
+#include "FlyCamera.h"
+#include "TriangleBvh.h"
+#include "RetainedDrawList.h"
+#include "DrawPackets.h"
+#include "OcclusionBuffer.h"
+#include "PotentiallyVisibleSet.h"
+
+using namespace DirectX;
+
+FrameConstants MakeFrameConstants(const FlyCamera& camera, float aspect, float totalTime, const FrameSettings& settings,
+	FrameView& view)
+{
+	const XMMATRIX v = camera.GetView();
+	const XMMATRIX proj = camera.GetProj(aspect);
+	FrameConstants frame = {};
+	XMStoreFloat4x4(&frame.View, XMMatrixTranspose(v));
+	XMStoreFloat4x4(&frame.Proj, XMMatrixTranspose(proj));
+	frame.EyePosW = camera.GetEye();
+	frame.TotalTime = totalTime;
+	frame.TexTilingX = settings.texTiling.x;
+	frame.TexTilingY = settings.texTiling.y;
+	frame.TessNearDist = settings.tessNearDist;
+	frame.TessFarDist = settings.tessFarDist;
+
+	XMStoreFloat4x4(&view.viewProj, v * proj);
+	FlyCamera::ExtractFrustum(v * proj, view.frustum);
+	view.eye = camera.GetEye();
+	return frame;
+}
+
+LightBufferData MakeLightConstants(const XMFLOAT3& eye)
+{
+	LightBufferData light = {};
+	light.DirLightDir = XMFLOAT4(0.0f, 1.0f, 0.0f, 0.0f);
+	light.DirLightColor = XMFLOAT4(1.0f, 1.0f, 0.7f, 2.0f);
+	light.AmbientColor = XMFLOAT4(0.3f, 0.3f, 0.12f, 0.15f);
+	light.NumSpotLights = 0;
+	light.EyePos = XMFLOAT4(eye.x, eye.y, eye.z, 1.0f);
+	return light;
+}
+
+bool UpdateSceneCamera(FlyCamera& camera, CameraCollision& collision, const TriangleBvh& bvh, float deltaTime,
+	const InputDevice& input)
+{
+	const bool toggled = input.IsKeyDown('C') && !collision.keyDown;
+	if (toggled) collision.enabled = !collision.enabled;
+	collision.keyDown = input.IsKeyDown('C');
+
+	const XMFLOAT3 eye = camera.GetEye();
+	camera.Update(deltaTime, input);
+	if (collision.enabled && !bvh.IsEmpty())
+	{
+		const XMFLOAT3& moved = camera.GetEye();
+		const XMFLOAT3 delta(moved.x - eye.x, moved.y - eye.y, moved.z - eye.z);
+		camera.SetEye(bvh.MoveSphere(eye, CAMERA_COLLISION_RADIUS, delta));
+	}
+	return toggled;
+}
+
+void UpdateDirtyDraws(RetainedDrawList& list, const std::function<void(uint32_t mesh)>& addDraws)
+{
+	for (uint32_t mesh = 0; mesh < DRAW_MESH_COUNT; ++mesh)
+	{
+		if (!list.IsDirty(mesh)) continue;
+		list.ClearSlot(mesh);
+		addDraws(mesh);
+	}
+	list.Update();
+}
+
+DrawCulling BuildVisibleDraws(const RetainedDrawList& list, const FrameView& view, OcclusionBuffer* occlusion,
+	const std::vector<XMFLOAT3>& occluders, PotentiallyVisibleSet* pvs, JobSystem* jobs, DrawPacketBuilder& packets)
+{
+	DrawCulling culling;
+	if (occlusion && !occluders.empty())
+	{
+		occlusion->Render(XMLoadFloat4x4(&view.viewProj), occluders, jobs);
+		culling.occlusion = occlusion;
+	}
+	if (pvs && pvs->SelectCell(view.eye)) culling.pvs = pvs;
+	packets.Build(list, view.frustum, jobs, DRAW_PACKET_CHUNK, culling.occlusion, culling.pvs);
+	return culling;
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <DirectXMath.h>
+#include "SceneConstants.h"
+#include "SceneDraws.h"
+
+class FlyCamera;
+class InputDevice;
+class TriangleBvh;
+class JobSystem;
+class RetainedDrawList;
+class DrawPacketBuilder;
+class OcclusionBuffer;
+class PotentiallyVisibleSet;
+
+// Кадр сцены без D3D: то, что RenderingSystem пишет в буферы констант и передает сборке
+// пакетов, FrameBenchmark повторяет теми же функциями
+
+// Настройки кадра, которые меняются во время работы (тесселяция - клавишами 1-4)
+struct FrameSettings
+{
+	DirectX::XMFLOAT2 texTiling = { 2.0f, 2.0f };
+	float tessNearDist = 200.0f;
+	float tessFarDist = 1500.0f;
+};
+
+// Вид камеры для отсечения: viewProj для буфера перекрытия, плоскости пирамиды (нормали внутрь)
+// и глаз для выбора ячейки PVS
+struct FrameView
+{
+	DirectX::XMFLOAT4X4 viewProj = {};
+	float frustum[6][4] = {};
+	DirectX::XMFLOAT3 eye = { 0.f, 0.f, 0.f };
+};
+
+// Блок кадра геометрического и прямого проходов; заодно вид камеры для отсечения
+FrameConstants MakeFrameConstants(const FlyCamera& camera, float aspect, float totalTime, const FrameSettings& settings,
+	FrameView& view);
+// Направленный свет сцены и глаз для прохода освещения; точечные источники - отдельным буфером
+LightBufferData MakeLightConstants(const DirectX::XMFLOAT3& eye);
+
+// Столкновения свободной камеры; C переключает их по нажатию
+struct CameraCollision
+{
+	bool enabled = true;
+	bool keyDown = false;
+};
+// Шаг камеры по вводу кадра. Сдвиг проверяется сферой CAMERA_COLLISION_RADIUS против bvh, если
+// столкновения включены и bvh построен: вдоль стен камера скользит, сквозь - не проходит.
+// true - C переключил столкновения в этом кадре
+bool UpdateSceneCamera(FlyCamera& camera, CameraCollision& collision, const TriangleBvh& bvh, float deltaTime,
+	const InputDevice& input);
+
+// Грязные слоты списка заново: addDraws(mesh) добавляет записи меша в очищенный слот
+// (AddMeshDraws), затем RetainedDrawList::Update
+void UpdateDirtyDraws(RetainedDrawList& list, const std::function<void(uint32_t mesh)>& addDraws);
+
+// Чем отсекался кадр; nullptr - проверка не делалась
+struct DrawCulling
+{
+	const OcclusionBuffer* occlusion = nullptr;
+	const PotentiallyVisibleSet* pvs = nullptr;
+};
+// Пакеты видимых записей списка для вида view. occlusion (или nullptr) растеризует occluders,
+// если они есть; pvs (или nullptr) проверяется, если в наборе есть ячейка глаза
+DrawCulling BuildVisibleDraws(const RetainedDrawList& list, const FrameView& view, OcclusionBuffer* occlusion,
+	const std::vector<DirectX::XMFLOAT3>& occluders, PotentiallyVisibleSet* pvs, JobSystem* jobs,
+	DrawPacketBuilder& packets);
\ No newline at end of file
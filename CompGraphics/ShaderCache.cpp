@@ -0,0 +1,160 @@
+#include "ShaderCache.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+static const uint32_t kCacheMagic = 0x31434853; // 'SHC1'
+// Увеличивать при изменении формата записи или способа построения ключа
+static const uint32_t kCacheVersion = 1;
+
+struct ShaderCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint64_t size;
+};
+
+// FNV-1a, 64 бита
+static void HashBytes(uint64_t& hash, const void* data, size_t size)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= p[i];
+		hash *= 1099511628211ull;
+	}
+}
+
+// С длиной, чтобы "ab"+"c" и "a"+"bc" давали разные ключи
+static void HashString(uint64_t& hash, const std::string& s)
+{
+	const uint64_t size = s.size();
+	HashBytes(hash, &size, sizeof(size));
+	HashBytes(hash, s.data(), s.size());
+}
+
+static std::string DirectoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+ShaderCache::ShaderCache(const std::string& directory, Compiler compiler)
+	: m_directory(directory), m_compiler(std::move(compiler))
+{
+	if (!m_directory.empty() && m_directory.back() != '/' && m_directory.back() != '\\') m_directory += '/';
+}
+
+// Include ищутся относительно включающего файла, как в D3D_COMPILE_STANDARD_FILE_INCLUDE.
+// Ненайденный include входит в ключ только именем - компиляция все равно упадет.
+void ShaderCache::HashFile(const std::string& path, uint64_t& hash, std::set<std::string>& visited) const
+{
+	HashString(hash, path);
+	if (!visited.insert(path).second) return;
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return;
+	std::stringstream text;
+	text << file.rdbuf();
+	const std::string source = text.str();
+	HashString(hash, source);
+
+	std::istringstream lines(source);
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		size_t p = line.find_first_not_of(" \t");
+		if (p == std::string::npos || line.compare(p, 8, "#include") != 0) continue;
+		size_t open = line.find_first_of("\"<", p + 8);
+		if (open == std::string::npos) continue;
+		size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+		if (close == std::string::npos) continue;
+		HashFile(DirectoryOf(path) + line.substr(open + 1, close - open - 1), hash, visited);
+	}
+}
+
+uint64_t ShaderCache::ComputeKey(const ShaderCompileRequest& request) const
+{
+	uint64_t hash = 14695981039346656037ull;
+	HashBytes(hash, &kCacheVersion, sizeof(kCacheVersion));
+	std::set<std::string> visited;
+	HashFile(request.file, hash, visited);
+	for (const ShaderMacro& macro : request.defines)
+	{
+		HashString(hash, macro.name);
+		HashString(hash, macro.value);
+	}
+	HashString(hash, request.entry);
+	HashString(hash, request.target);
+	HashBytes(hash, &request.flags, sizeof(request.flags));
+	return hash;
+}
+
+// Имя без хэша исходника: после правки шейдера запись перезаписывается, а не копится рядом.
+// Макросы в имени, чтобы разные варианты одного шейдера не вытесняли друг друга.
+std::string ShaderCache::EntryPath(const ShaderCompileRequest& request) const
+{
+	uint64_t definesHash = 14695981039346656037ull;
+	for (const ShaderMacro& macro : request.defines)
+	{
+		HashString(definesHash, macro.name);
+		HashString(definesHash, macro.value);
+	}
+	std::string stem = request.file.substr(DirectoryOf(request.file).size());
+	size_t dot = stem.find_last_of('.');
+	if (dot != std::string::npos) stem.resize(dot);
+
+	char name[64];
+	snprintf(name, sizeof(name), ".%08x.%x.cso", (uint32_t)(definesHash ^ (definesHash >> 32)), request.flags);
+	return m_directory + stem + "." + request.entry + "." + request.target + name;
+}
+
+bool ShaderCache::Load(const std::string& path, uint64_t key, std::vector<uint8_t>& bytecode) const
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	ShaderCacheHeader header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+	if (header.magic != kCacheMagic || header.version != kCacheVersion || header.key != key) return false;
+	bytecode.resize((size_t)header.size);
+	return header.size == 0 || (bool)file.read(reinterpret_cast<char*>(bytecode.data()), header.size);
+}
+
+void ShaderCache::Store(const std::string& path, uint64_t key, const std::vector<uint8_t>& bytecode)
+{
+	// Пишем во временный файл и переименовываем: прерванная запись не оставит битый кэш
+	const std::string temp = path + ".tmp" + std::to_string(m_tempCounter++);
+	bool written = false;
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) return;
+		ShaderCacheHeader header{ kCacheMagic, kCacheVersion, key, bytecode.size() };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(bytecode.data()), bytecode.size());
+		written = (bool)file;
+	}
+	if (written)
+	{
+		std::remove(path.c_str());
+		written = std::rename(temp.c_str(), path.c_str()) == 0;
+	}
+	if (!written) std::remove(temp.c_str());
+}
+
+bool ShaderCache::Get(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors)
+{
+	const uint64_t key = ComputeKey(request);
+	const std::string path = EntryPath(request);
+	if (!m_directory.empty() && Load(path, key, bytecode))
+	{
+		++m_hits;
+		return true;
+	}
+
+	++m_misses;
+	bytecode.clear();
+	if (!m_compiler(request, bytecode, errors)) return false;
+	if (!m_directory.empty()) Store(path, key, bytecode);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+struct ShaderMacro
+{
+	std::string name;
+	std::string value;
+};
+
+struct ShaderCompileRequest
+{
+	std::string file;
+	std::string entry;
+	std::string target;
+	std::vector<ShaderMacro> defines;
+	uint32_t flags = 0;
+};
+
+// Кэш байткода шейдеров на диске. Ключ - хэш текста файла и всех его #include, макросов,
+// точки входа, профиля и флагов компиляции; компилятор вызывается только при промахе.
+// Сам кэш не зависит от D3D: компилятор передается снаружи, поэтому кэш можно проверять
+// с заглушкой. Get можно вызывать из нескольких потоков одновременно.
+class ShaderCache
+{
+public:
+	// false - ошибка компиляции, текст в errors
+	using Compiler = std::function<bool(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors)>;
+
+	// Каталог должен существовать; без каталога кэш только компилирует
+	ShaderCache(const std::string& directory, Compiler compiler);
+
+	bool Get(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors);
+
+	uint64_t ComputeKey(const ShaderCompileRequest& request) const;
+	std::string EntryPath(const ShaderCompileRequest& request) const;
+
+	uint32_t GetHits() const { return m_hits; }
+	uint32_t GetMisses() const { return m_misses; }
+
+private:
+	void HashFile(const std::string& path, uint64_t& hash, std::set<std::string>& visited) const;
+	bool Load(const std::string& path, uint64_t key, std::vector<uint8_t>& bytecode) const;
+	void Store(const std::string& path, uint64_t key, const std::vector<uint8_t>& bytecode);
+
+	std::string m_directory;
+	Compiler m_compiler;
+	std::atomic<uint32_t> m_hits{ 0 };
+	std::atomic<uint32_t> m_misses{ 0 };
+	std::atomic<uint32_t> m_tempCounter{ 0 };
+};
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "TaskGraph.h"
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+
+TaskGraph::TaskId TaskGraph::Add(const std::string& name, std::function<void()> work, const std::vector<TaskId>& deps, bool mainThread)
+{
+	const TaskId id = m_tasks.size();
+	for (TaskId dep : deps)
+		if (dep >= id) throw std::out_of_range("TaskGraph: dependency on a task that is not added yet");
+
+	Task task;
+	task.name = name;
+	task.work = std::move(work);
+	task.deps = deps;
+	task.mainThread = mainThread;
+	m_tasks.push_back(std::move(task));
+	for (TaskId dep : deps) m_tasks[dep].dependents.push_back(id);
+	return id;
+}
+
+void TaskGraph::Run(unsigned workerCount)
+{
+	if (workerCount == 0)
+		workerCount = std::min(std::max(std::thread::hardware_concurrency(), 2u) - 1, 7u);
+	m_threadCount = workerCount + 1;
+	m_start = std::chrono::steady_clock::now();
+	m_done = 0;
+	m_running = 0;
+	m_error = nullptr;
+	m_ready.clear();
+	m_readyMain.clear();
+	for (TaskId id = 0; id < m_tasks.size(); ++id)
+	{
+		Task& task = m_tasks[id];
+		task.remaining = task.deps.size();
+		if (task.remaining == 0) (task.mainThread ? m_readyMain : m_ready).push_back(id);
+	}
+
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i <= workerCount; ++i)
+		workers.emplace_back([this, i]() { ThreadLoop(i); });
+	ThreadLoop(0);
+	for (std::thread& t : workers) t.join();
+
+	m_wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+	if (m_error) std::rethrow_exception(m_error);
+}
+
+void TaskGraph::ThreadLoop(unsigned thread)
+{
+	const bool isMain = thread == 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		m_wake.wait(lock, [this, isMain]() {
+			return Finished() || (!m_error && (!m_ready.empty() || (isMain && !m_readyMain.empty())));
+			});
+		if (Finished()) return;
+
+		std::deque<TaskId>& queue = isMain && !m_readyMain.empty() ? m_readyMain : m_ready;
+		const TaskId id = queue.front();
+		queue.pop_front();
+		Task& task = m_tasks[id];
+		++m_running;
+		task.thread = thread;
+		task.startMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+		lock.unlock();
+
+		std::exception_ptr error;
+		try
+		{
+			task.work();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		lock.lock();
+		task.endMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+		--m_running;
+		if (error)
+		{
+			if (!m_error) m_error = error;
+		}
+		else
+		{
+			++m_done;
+			for (TaskId next : task.dependents)
+			{
+				Task& dependent = m_tasks[next];
+				if (--dependent.remaining == 0) (dependent.mainThread ? m_readyMain : m_ready).push_back(next);
+			}
+		}
+		m_wake.notify_all();
+	}
+}
+
+void TaskGraph::Report(const char* title) const
+{
+	if (m_tasks.empty()) return;
+
+	double work = 0.0;
+	TaskId last = 0;
+	for (TaskId id = 0; id < m_tasks.size(); ++id)
+	{
+		work += m_tasks[id].endMs - m_tasks[id].startMs;
+		if (m_tasks[id].endMs > m_tasks[last].endMs) last = id;
+	}
+
+	char msg[512];
+	sprintf_s(msg, "[TaskGraph] %s: %.1f ms wall, %.1f ms of work on %u threads (x%.1f)\n",
+		title, m_wallMs, work, m_threadCount, m_wallMs > 0.0 ? work / m_wallMs : 0.0);
+	OutputDebugStringA(msg);
+
+	// От последней задачи назад через зависимость, завершившуюся позже всех: она и держала старт
+	std::vector<TaskId> path;
+	for (TaskId id = last;;)
+	{
+		path.push_back(id);
+		const Task& task = m_tasks[id];
+		if (task.deps.empty()) break;
+		id = *std::max_element(task.deps.begin(), task.deps.end(),
+			[this](TaskId a, TaskId b) { return m_tasks[a].endMs < m_tasks[b].endMs; });
+	}
+
+	OutputDebugStringA("[TaskGraph] Critical path:\n");
+	double ready = 0.0;
+	for (auto it = path.rbegin(); it != path.rend(); ++it)
+	{
+		const Task& task = m_tasks[*it];
+		// Ожидание - от готовности зависимостей до старта (свободного потока не было)
+		sprintf_s(msg, "[TaskGraph]   %-32s %8.1f ms  (at %7.1f, waited %5.1f ms, thread %u)\n",
+			task.name.c_str(), task.endMs - task.startMs, task.startMs, task.startMs - ready, task.thread);
+		OutputDebugStringA(msg);
+		ready = task.endMs;
+	}
+}
\ No newline at end of file
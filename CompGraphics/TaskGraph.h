@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Граф задач запуска: задача стартует, как только выполнены все ее зависимости.
+// Зависимости - только уже добавленные задачи, поэтому циклов не бывает.
+// Задачи mainThread выполняет только поток, вызвавший Run (окно, цепочка списка команд).
+// После Run отчет показывает критический путь - цепочку задач, которая задержала конец графа.
+class TaskGraph
+{
+public:
+	using TaskId = size_t;
+
+	TaskId Add(const std::string& name, std::function<void()> work, const std::vector<TaskId>& deps = {}, bool mainThread = false);
+
+	// 0 потоков - по числу ядер, вызывающий поток тоже выполняет задачи.
+	// Если задача бросила исключение, новые задачи не запускаются, а исключение пробрасывается
+	// после завершения уже начатых.
+	void Run(unsigned workerCount = 0);
+
+	// Пишет в отладочный вывод время графа, суммарную работу и критический путь
+	void Report(const char* title) const;
+
+	double GetWallMs() const { return m_wallMs; }
+
+private:
+	struct Task
+	{
+		std::string name;
+		std::function<void()> work;
+		std::vector<TaskId> deps;
+		std::vector<TaskId> dependents;
+		bool mainThread = false;
+		size_t remaining = 0;
+		double startMs = 0.0;
+		double endMs = 0.0;
+		unsigned thread = 0;
+	};
+
+	void ThreadLoop(unsigned thread);
+	bool Finished() const { return m_done == m_tasks.size() || (m_error && m_running == 0); }
+
+	std::vector<Task> m_tasks;
+	std::chrono::steady_clock::time_point m_start;
+	double m_wallMs = 0.0;
+	unsigned m_threadCount = 0;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<TaskId> m_ready;
+	std::deque<TaskId> m_readyMain;
+	size_t m_done = 0;
+	size_t m_running = 0;
+	std::exception_ptr m_error;
+};
\ No newline at end of file
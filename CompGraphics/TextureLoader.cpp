@@ -1,58 +1,232 @@
 #include "TextureLoader.h"
+#include "JpegDecoder.h"
 #include <wincodec.h>
 #include <stdexcept>
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <shared_mutex>
+
+// Список бэкендов читают потоки AsyncLoader; RegisterDecoder может прийти в любой момент
+static std::shared_mutex& DecodersMutex()
+{
+	static std::shared_mutex mutex;
+	return mutex;
+}
+
+std::vector<std::unique_ptr<ImageDecoder>>& TextureLoader::Decoders()
+{
+	static std::vector<std::unique_ptr<ImageDecoder>> decoders = [] {
+		std::vector<std::unique_ptr<ImageDecoder>> d;
+		d.emplace_back(new SimdJpegDecoder());
+		d.emplace_back(new StbImageDecoder());
+		return d;
+	}();
+	return decoders;
+}
+
+void TextureLoader::RegisterDecoder(std::unique_ptr<ImageDecoder> decoder)
+{
+	if (!decoder) return;
+	std::unique_lock<std::shared_mutex> lock(DecodersMutex());
+	Decoders().insert(Decoders().begin(), std::move(decoder));
+}
+
+bool TextureLoader::ReadFileBytes(const std::wstring& path, std::vector<uint8_t>& bytes)
+{
+	std::string narrowPath(path.begin(), path.end());
+	std::ifstream f(narrowPath, std::ios::binary | std::ios::ate);
+	if (!f.is_open()) return false;
+	std::streamsize size = f.tellg();
+	if (size <= 0) return false;
+	bytes.resize((size_t)size);
+	f.seekg(0);
+	return (bool)f.read(reinterpret_cast<char*>(bytes.data()), size);
+}
 
 bool TextureLoader::LoadFromFile(const std::wstring& path, TextureData& out)
 {
+	std::vector<uint8_t> bytes;
+	if (!ReadFileBytes(path, bytes)) return false;
+	return LoadFromMemory(bytes.data(), bytes.size(), out);
+}
+
+bool TextureLoader::LoadFromMemory(const uint8_t* data, size_t size, TextureData& out)
+{
+	// Бэкенды перебираются по приоритету: если быстрый путь не справился
+	// (например, progressive JPEG), изображение достается следующему
+	std::shared_lock<std::shared_mutex> lock(DecodersMutex());
+	for (const auto& decoder : Decoders())
+	{
+		if (!decoder->CanDecode(data, size)) continue;
+		DecodedImage img;
+		if (!decoder->Decode(data, size, img)) continue;
+
+		out.width = img.width;
+		out.height = img.height;
+		out.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		out.rowPitch = img.width * 4;
+		out.pixels = std::move(img.pixels);
+		return true;
+	}
+	return false;
+}
+
+void TextureLoader::BenchmarkDecoders(const std::wstring& path, int iterations)
+{
+	std::vector<uint8_t> bytes;
+	if (!ReadFileBytes(path, bytes) || iterations <= 0) return;
+
 	std::string narrowPath(path.begin(), path.end());
+	std::shared_lock<std::shared_mutex> lock(DecodersMutex());
+	for (const auto& decoder : Decoders())
+	{
+		if (!decoder->CanDecode(bytes.data(), bytes.size())) continue;
+		DecodedImage img;
+		double best = 0.0;
+		bool ok = true;
+		for (int i = 0; i < iterations && ok; ++i)
+		{
+			auto t0 = std::chrono::high_resolution_clock::now();
+			ok = decoder->Decode(bytes.data(), bytes.size(), img);
+			std::chrono::duration<double> dt = std::chrono::high_resolution_clock::now() - t0;
+			if (i == 0 || dt.count() < best) best = dt.count();
+		}
+		char msg[512];
+		if (ok)
+		{
+			double mpix = (double)img.width * img.height / 1e6;
+			sprintf_s(msg, "[Decode] %s | %s | %ux%u | %.2f ms | %.1f MPix/s\n",
+				narrowPath.c_str(), decoder->GetName(), img.width, img.height, best * 1000.0, mpix / best);
+		}
+		else
+		{
+			sprintf_s(msg, "[Decode] %s | %s | unsupported\n", narrowPath.c_str(), decoder->GetName());
+		}
+		OutputDebugStringA(msg);
+	}
+}
 
-	int w, h, channels;
-	unsigned char* data = stbi_load(narrowPath.c_str(), &w, &h, &channels, 4);
-	if (!data) return false;
+bool TextureLoader::CreateTexture(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const TextureData& data, ComPtr<ID3D12Resource>& texture, ComPtr<ID3D12Resource>& uploadBuf)
+{
+	return CreateTextureArray(device, cmdList, { &data }, texture, uploadBuf);
+}
 
-	out.width = (UINT)w;
-	out.height = (UINT)h;
-	out.format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	out.rowPitch = (UINT)w * 4;
-	out.pixels.assign(data, data + (size_t)w * h * 4);
+bool TextureLoader::CreateTextureArray(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const std::vector<const TextureData*>& slices, ComPtr<ID3D12Resource>& texture, ComPtr<ID3D12Resource>& uploadBuf)
+{
+	TextureUpload upload;
+	if (!PrepareTextureArray(device, slices, upload)) return false;
+	// Без кольца буфер загрузки держит вызывающий, пока GPU не выполнит копирование
+	uploadBuf = upload.staging.GetResourcePtr();
+	RecordTextureUpload(cmdList, upload, 0);
+	texture = upload.texture;
+	return true;
+}
 
-	stbi_image_free(data);
+bool TextureLoader::AllocateStaging(ID3D12Device* device, UploadRing* ring, UINT64 size, TextureUpload& out)
+{
+	bool ok = ring
+		? ring->Allocate(size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, out.staging)
+		: UploadRing::AllocateDedicated(device, size, out.staging);
+	if (!ok) return false;
+	for (D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout : out.layouts)
+		layout.Offset += out.staging.GetOffset();
 	return true;
 }
 
-bool TextureLoader::CreateTexture(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const TextureData& data, ComPtr<ID3D12Resource>& texture, ComPtr<ID3D12Resource>& uploadBuf)
+bool TextureLoader::PrepareTextureArray(ID3D12Device* device, const std::vector<const TextureData*>& slices, TextureUpload& out, UploadRing* ring, GpuHeapAllocator* heaps)
 {
+	if (slices.empty()) return false;
+	const TextureData& first = *slices[0];
+	const UINT count = (UINT)slices.size();
 	D3D12_RESOURCE_DESC texDesc{};
 	texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-	texDesc.Width = data.width;
-	texDesc.Height = data.height;
-	texDesc.DepthOrArraySize = 1;
+	texDesc.Width = first.width;
+	texDesc.Height = first.height;
+	texDesc.DepthOrArraySize = (UINT16)count;
 	texDesc.MipLevels = 1;
-	texDesc.Format = data.format;
+	texDesc.Format = first.format;
 	texDesc.SampleDesc = { 1, 0 };
-	CD3DX12_HEAP_PROPERTIES defHeap(D3D12_HEAP_TYPE_DEFAULT);
-	HRESULT hr = device->CreateCommittedResource(
-		&defHeap, D3D12_HEAP_FLAG_NONE, &texDesc,
-		D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
-		IID_PPV_ARGS(&texture));
+	HRESULT hr;
+	if (heaps)
+		hr = heaps->CreateResource(texDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, out.texture);
+	else
+	{
+		CD3DX12_HEAP_PROPERTIES defHeap(D3D12_HEAP_TYPE_DEFAULT);
+		hr = device->CreateCommittedResource(
+			&defHeap, D3D12_HEAP_FLAG_NONE, &texDesc,
+			D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+			IID_PPV_ARGS(&out.texture));
+	}
 	if (FAILED(hr)) return false;
+
+	out.layouts.resize(count);
+	std::vector<UINT> numRows(count);
+	std::vector<UINT64> rowSizes(count);
 	UINT64 uploadSize = 0;
-	device->GetCopyableFootprints(&texDesc, 0, 1, 0, nullptr, nullptr, nullptr, &uploadSize);
-	CD3DX12_HEAP_PROPERTIES upHeap(D3D12_HEAP_TYPE_UPLOAD);
-	CD3DX12_RESOURCE_DESC upDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadSize);
-	hr = device->CreateCommittedResource(
-		&upHeap, D3D12_HEAP_FLAG_NONE, &upDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-		IID_PPV_ARGS(&uploadBuf));
-	if (FAILED(hr)) return false;
-	D3D12_SUBRESOURCE_DATA subData{};
-	subData.pData = data.pixels.data();
-	subData.RowPitch = data.rowPitch;
-	subData.SlicePitch = (LONG_PTR)data.rowPitch * data.height; 
-	UpdateSubresources(cmdList, texture.Get(), uploadBuf.Get(), 0, 0, 1, &subData);
-	CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	device->GetCopyableFootprints(&texDesc, 0, count, 0, out.layouts.data(), numRows.data(), rowSizes.data(), &uploadSize);
+	if (!AllocateStaging(device, ring, uploadSize, out)) return false;
+
+	for (UINT i = 0; i < count; ++i)
+	{
+		const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout = out.layouts[i];
+		const uint8_t* src = slices[i]->pixels.data();
+		uint8_t* dst = out.staging.GetCPU() + (layout.Offset - out.staging.GetOffset());
+		for (UINT row = 0; row < numRows[i]; ++row)
+			memcpy(dst + (size_t)row * layout.Footprint.RowPitch, src + (size_t)row * slices[i]->rowPitch, (size_t)rowSizes[i]);
+	}
+	out.format = first.format;
+	out.arraySize = count;
+	return true;
+}
+
+void TextureLoader::RecordTextureUpload(ID3D12GraphicsCommandList* cmdList, TextureUpload& upload, uint64_t fence)
+{
+	for (UINT i = 0; i < (UINT)upload.layouts.size(); ++i)
+	{
+		CD3DX12_TEXTURE_COPY_LOCATION dst(upload.texture.Get(), i);
+		CD3DX12_TEXTURE_COPY_LOCATION src(upload.staging.GetResource(), upload.layouts[i]);
+		cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+	}
+	CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(upload.texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 	cmdList->ResourceBarrier(1, &barrier);
+	upload.staging.Retire(fence);
+}
+
+bool TextureLoader::PrepareTextureRegion(ID3D12Device* device, const TextureData& data, TextureUpload& out, UploadRing* ring)
+{
+	D3D12_RESOURCE_DESC desc{};
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	desc.Width = data.width;
+	desc.Height = data.height;
+	desc.DepthOrArraySize = 1;
+	desc.MipLevels = 1;
+	desc.Format = data.format;
+	desc.SampleDesc = { 1, 0 };
+
+	out.layouts.resize(1);
+	UINT numRows = 0;
+	UINT64 rowSize = 0, uploadSize = 0;
+	device->GetCopyableFootprints(&desc, 0, 1, 0, out.layouts.data(), &numRows, &rowSize, &uploadSize);
+	if (!AllocateStaging(device, ring, uploadSize, out)) return false;
+
+	for (UINT row = 0; row < numRows; ++row)
+		memcpy(out.staging.GetCPU() + (size_t)row * out.layouts[0].Footprint.RowPitch,
+			data.pixels.data() + (size_t)row * data.rowPitch, (size_t)rowSize);
+	out.format = data.format;
+	out.arraySize = 1;
 	return true;
+}
+
+void TextureLoader::RecordTextureRegionUpdate(ID3D12GraphicsCommandList* cmdList, TextureUpload& upload, ID3D12Resource* texture, UINT subresource, UINT x, UINT y, uint64_t fence)
+{
+	CD3DX12_RESOURCE_BARRIER toCopy = CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST, subresource);
+	cmdList->ResourceBarrier(1, &toCopy);
+	CD3DX12_TEXTURE_COPY_LOCATION dst(texture, subresource);
+	CD3DX12_TEXTURE_COPY_LOCATION src(upload.staging.GetResource(), upload.layouts[0]);
+	cmdList->CopyTextureRegion(&dst, x, y, 0, &src, nullptr);
+	CD3DX12_RESOURCE_BARRIER toRead = CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, subresource);
+	cmdList->ResourceBarrier(1, &toRead);
+	upload.staging.Retire(fence);
 }
\ No newline at end of file
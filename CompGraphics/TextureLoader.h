@@ -5,7 +5,11 @@
 #include <wrl/client.h>
 #include <string>
 #include <vector>
+#include <memory>
 #include "d3dx12.h"
+#include "ImageDecoder.h"
+#include "UploadRing.h"
+#include "GpuHeapAllocator.h"
 using Microsoft::WRL::ComPtr;
 
 class TextureLoader
@@ -19,7 +23,24 @@ public:
 		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
 		UINT rowPitch = 0;
 	};
+	// Текстура в DEFAULT-куче и заполненная память загрузки, копирование еще не записано.
+	// Смещения layouts - в ресурсе staging, с учетом смещения выделения
+	struct TextureUpload
+	{
+		ComPtr<ID3D12Resource> texture;
+		UploadRing::Allocation staging;
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts;
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		UINT arraySize = 0;
+	};
 	static bool LoadFromFile(const std::wstring& path, TextureData& out);
+	static bool LoadFromMemory(const uint8_t* data, size_t size, TextureData& out);
+
+	// Новый бэкенд получает наивысший приоритет; можно звать и во время фоновых загрузок -
+	// регистрация ждет конца уже идущих декодирований
+	static void RegisterDecoder(std::unique_ptr<ImageDecoder> decoder);
+	// Декодирует файл каждым подходящим бэкендом и пишет MPix/s в отладочный вывод
+	static void BenchmarkDecoders(const std::wstring& path, int iterations);
 
 	static bool CreateTexture(
 		ID3D12Device* device,
@@ -27,4 +48,45 @@ public:
 		const TextureData& data,
 		ComPtr<ID3D12Resource>& texture,
 		ComPtr<ID3D12Resource>& uploadBuf);
+
+	// Все слои должны совпадать по размеру и формату
+	static bool CreateTextureArray(
+		ID3D12Device* device,
+		ID3D12GraphicsCommandList* cmdList,
+		const std::vector<const TextureData*>& slices,
+		ComPtr<ID3D12Resource>& texture,
+		ComPtr<ID3D12Resource>& uploadBuf);
+
+	// CreateTextureArray в два шага: Prepare создает ресурсы и копирует пиксели в память загрузки
+	// (можно с любого потока - устройство D3D12 и UploadRing потокобезопасны), Record пишет
+	// копирование и барьер и отдает память загрузки до fence. Без ring - отдельный буфер,
+	// без heaps - отдельный ресурс текстуры
+	static bool PrepareTextureArray(
+		ID3D12Device* device,
+		const std::vector<const TextureData*>& slices,
+		TextureUpload& out,
+		UploadRing* ring = nullptr,
+		GpuHeapAllocator* heaps = nullptr);
+	static void RecordTextureUpload(ID3D12GraphicsCommandList* cmdList, TextureUpload& upload, uint64_t fence);
+
+	// Обновление части существующей текстуры (слой массива или прямоугольник атласа):
+	// Prepare заполняет только память загрузки, Record копирует ее в subresource по (x, y)
+	static bool PrepareTextureRegion(
+		ID3D12Device* device,
+		const TextureData& data,
+		TextureUpload& out,
+		UploadRing* ring = nullptr);
+	static void RecordTextureRegionUpdate(
+		ID3D12GraphicsCommandList* cmdList,
+		TextureUpload& upload,
+		ID3D12Resource* texture,
+		UINT subresource,
+		UINT x,
+		UINT y,
+		uint64_t fence);
+
+private:
+	static std::vector<std::unique_ptr<ImageDecoder>>& Decoders();
+	static bool ReadFileBytes(const std::wstring& path, std::vector<uint8_t>& bytes);
+	static bool AllocateStaging(ID3D12Device* device, UploadRing* ring, UINT64 size, TextureUpload& out);
 };
\ No newline at end of file
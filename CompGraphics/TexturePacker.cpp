@@ -0,0 +1,167 @@
+#include "TexturePacker.h"
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <cstring>
+
+static uint32_t AlignUp(uint32_t v, uint32_t a) { return (v + a - 1) / a * a; }
+
+uint32_t TexturePacker::Padding(const Settings& settings)
+{
+	uint32_t mips = std::max(1u, std::min(settings.mipLevels, 8u));
+	return 1u << (mips - 1);
+}
+
+TexturePacker::Result TexturePacker::Pack(const std::vector<Input>& textures, const Settings& settings)
+{
+	Result result;
+	result.refs.resize(textures.size());
+	result.stats.inputTextures = (uint32_t)textures.size();
+
+	const uint32_t pad = Padding(settings);
+	std::map<std::tuple<uint32_t, uint32_t, uint32_t>, std::vector<int>> buckets;
+	for (int i = 0; i < (int)textures.size(); ++i)
+	{
+		const Input& t = textures[i];
+		if (t.width == 0 || t.height == 0) continue;
+		buckets[std::make_tuple(t.format, t.width, t.height)].push_back(i);
+	}
+
+	// Одинаковые по размеру и формату - в массив; одиночные мелкие - кандидаты в атлас
+	std::map<uint32_t, std::vector<int>> atlasCandidates;
+	for (const auto& b : buckets)
+	{
+		const std::vector<int>& members = b.second;
+		const Input& first = textures[members[0]];
+		bool small = first.width <= settings.maxAtlasTexture && first.height <= settings.maxAtlasTexture &&
+			AlignUp(first.width + 2 * pad, pad) <= settings.atlasSize &&
+			AlignUp(first.height + 2 * pad, pad) <= settings.atlasSize;
+		if (members.size() == 1 && small)
+		{
+			atlasCandidates[first.format].push_back(members[0]);
+			continue;
+		}
+		TexturePackGroup g;
+		g.kind = TexturePackGroup::Kind::Array;
+		g.width = first.width;
+		g.height = first.height;
+		g.format = first.format;
+		g.slices = (uint32_t)members.size();
+		g.members = members;
+		for (uint32_t s = 0; s < g.slices; ++s)
+		{
+			PackedTextureRef& r = result.refs[members[s]];
+			r.group = (int)result.groups.size();
+			r.slice = s;
+		}
+		result.groups.push_back(g);
+	}
+
+	for (auto& fc : atlasCandidates)
+	{
+		std::vector<int>& cands = fc.second;
+		std::sort(cands.begin(), cands.end(), [&](int a, int b) {
+			if (textures[a].height != textures[b].height) return textures[a].height > textures[b].height;
+			if (textures[a].width != textures[b].width) return textures[a].width > textures[b].width;
+			return a < b;
+			});
+
+		// Полочная упаковка: текстуры отсортированы по высоте, полка растет вниз
+		size_t next = 0;
+		while (next < cands.size())
+		{
+			if (cands.size() - next == 1)
+			{
+				// Атлас из одной текстуры смысла не имеет
+				int idx = cands[next++];
+				TexturePackGroup g;
+				g.kind = TexturePackGroup::Kind::Array;
+				g.width = textures[idx].width;
+				g.height = textures[idx].height;
+				g.format = fc.first;
+				g.slices = 1;
+				g.members.push_back(idx);
+				result.refs[idx].group = (int)result.groups.size();
+				result.groups.push_back(g);
+				break;
+			}
+
+			TexturePackGroup g;
+			g.kind = TexturePackGroup::Kind::Atlas;
+			g.format = fc.first;
+			g.slices = 1;
+			const int groupIdx = (int)result.groups.size();
+
+			uint32_t shelfX = 0, shelfY = 0, shelfH = 0, usedW = 0;
+			while (next < cands.size())
+			{
+				int idx = cands[next];
+				uint32_t cw = AlignUp(textures[idx].width + 2 * pad, pad);
+				uint32_t ch = AlignUp(textures[idx].height + 2 * pad, pad);
+				if (shelfX + cw > settings.atlasSize)
+				{
+					shelfY += shelfH;
+					shelfX = 0;
+					shelfH = 0;
+				}
+				if (shelfY + ch > settings.atlasSize) break;
+
+				PackedTextureRef& r = result.refs[idx];
+				r.group = groupIdx;
+				r.x = shelfX + pad;
+				r.y = shelfY + pad;
+				g.members.push_back(idx);
+				shelfX += cw;
+				shelfH = std::max(shelfH, ch);
+				usedW = std::max(usedW, shelfX);
+				++next;
+			}
+			g.width = usedW;
+			g.height = shelfY + shelfH;
+
+			result.groups.push_back(g);
+			for (int member : g.members)
+			{
+				PackedTextureRef& r = result.refs[member];
+				r.uvRect[0] = (float)r.x / g.width;
+				r.uvRect[1] = (float)r.y / g.height;
+				r.uvRect[2] = (float)textures[member].width / g.width;
+				r.uvRect[3] = (float)textures[member].height / g.height;
+			}
+		}
+	}
+
+	for (const TexturePackGroup& g : result.groups)
+	{
+		if (g.kind == TexturePackGroup::Kind::Atlas) ++result.stats.atlases;
+		else ++result.stats.arrays;
+		result.stats.allocatedTexels += (uint64_t)g.width * g.height * g.slices;
+		for (int m : g.members)
+			result.stats.usedTexels += (uint64_t)textures[m].width * textures[m].height;
+	}
+	if (result.stats.allocatedTexels > 0)
+		result.stats.efficiency = (double)result.stats.usedTexels / (double)result.stats.allocatedTexels;
+	return result;
+}
+
+void TexturePacker::BlitToAtlas(const uint8_t* src, uint32_t width, uint32_t height,
+	uint8_t* atlas, uint32_t atlasWidth, uint32_t x, uint32_t y, uint32_t padding)
+{
+	const size_t srcPitch = (size_t)width * 4;
+	const size_t dstPitch = (size_t)atlasWidth * 4;
+	const int pad = (int)padding;
+	for (int dy = -pad; dy < (int)height + pad; ++dy)
+	{
+		uint32_t sy = (uint32_t)((dy % (int)height + (int)height) % (int)height);
+		const uint8_t* srcRow = src + sy * srcPitch;
+		uint8_t* dstRow = atlas + (size_t)(y + dy) * dstPitch + (size_t)x * 4;
+		memcpy(dstRow, srcRow, srcPitch);
+		for (int dx = 1; dx <= pad; ++dx)
+		{
+			uint32_t left = (uint32_t)(((-dx) % (int)width + (int)width) % (int)width);
+			uint32_t right = (uint32_t)((dx - 1) % (int)width);
+			memcpy(dstRow - (size_t)dx * 4, srcRow + left * 4, 4);
+			memcpy(dstRow + srcPitch + (size_t)(dx - 1) * 4, srcRow + right * 4, 4);
+		}
+	}
+}
\ No newline at end of file
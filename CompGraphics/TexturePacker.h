@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Группа текстур, которая на GPU становится одним ресурсом Texture2DArray:
+// либо массив одинаковых по размеру/формату текстур (по слою на каждую),
+// либо атлас из мелких текстур (один слой).
+struct TexturePackGroup
+{
+	enum class Kind { Array, Atlas };
+	Kind kind = Kind::Array;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t format = 0;
+	uint32_t slices = 0;
+	std::vector<int> members;
+};
+
+// Где оказалась входная текстура
+struct PackedTextureRef
+{
+	int group = -1;
+	uint32_t slice = 0;
+	uint32_t x = 0, y = 0;
+	float uvRect[4] = { 0.f, 0.f, 1.f, 1.f }; // offset.xy, scale.zw
+};
+
+struct TexturePackStats
+{
+	uint32_t inputTextures = 0;
+	uint32_t arrays = 0;
+	uint32_t atlases = 0;
+	uint64_t usedTexels = 0;
+	uint64_t allocatedTexels = 0;
+	double efficiency = 0.0;
+};
+
+class TexturePacker
+{
+public:
+	struct Input
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t format = 0;
+	};
+	struct Settings
+	{
+		uint32_t atlasSize = 4096;
+		// В атлас идут только текстуры не больше этого размера и без пары того же размера
+		uint32_t maxAtlasTexture = 512;
+		// Поля и выравнивание прямоугольников рассчитаны на столько мип-уровней. Текстуры
+		// создаются без мипов (TextureLoader), поля в пиксель хватает билинейной фильтрации
+		uint32_t mipLevels = 1;
+	};
+	struct Result
+	{
+		std::vector<TexturePackGroup> groups;
+		std::vector<PackedTextureRef> refs;
+		TexturePackStats stats;
+	};
+
+	static Result Pack(const std::vector<Input>& textures, const Settings& settings);
+	static uint32_t Padding(const Settings& settings);
+
+	// Копирует RGBA8 текстуру в атлас и заполняет поля по правилу wrap,
+	// чтобы билинейная фильтрация на краю прямоугольника вела себя как D3D12_TEXTURE_ADDRESS_MODE_WRAP
+	static void BlitToAtlas(const uint8_t* src, uint32_t width, uint32_t height,
+		uint8_t* atlas, uint32_t atlasWidth, uint32_t x, uint32_t y, uint32_t padding);
+};
\ No newline at end of file
@@ -0,0 +1,301 @@
+#include "TlsfAllocator.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static uint32_t LowestBit(uint64_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, mask);
+	return index;
+#else
+	return (uint32_t)__builtin_ctzll(mask);
+#endif
+}
+
+static uint32_t HighestBit(uint64_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, mask);
+	return index;
+#else
+	return 63 - (uint32_t)__builtin_clzll(mask);
+#endif
+}
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity) : m_capacity(capacity)
+{
+	for (auto& row : m_freeHeads)
+		for (uint32_t& head : row) head = None;
+	if (capacity == 0) return;
+	m_firstBlock = NewBlock();
+	m_blocks[m_firstBlock].size = capacity;
+	InsertFree(m_firstBlock);
+}
+
+// Первый уровень - степень двойки размера, второй делит ее на SL_COUNT равных классов
+void TlsfAllocator::Mapping(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+	if (size < SL_COUNT)
+	{
+		fl = 0;
+		sl = (uint32_t)size;
+		return;
+	}
+	const uint32_t log = HighestBit(size);
+	fl = log - SL_BITS + 1;
+	sl = (uint32_t)(size >> (log - SL_BITS)) - SL_COUNT;
+}
+
+// Класс округляется вверх: любой блок из найденного списка не меньше size
+uint32_t TlsfAllocator::FindFree(uint64_t size) const
+{
+	if (size >= SL_COUNT)
+	{
+		const uint64_t round = (1ull << (HighestBit(size) - SL_BITS)) - 1;
+		if (size > ~0ull - round) return None;
+		size += round;
+	}
+	uint32_t fl, sl;
+	Mapping(size, fl, sl);
+	uint32_t slMap = m_slBitmap[fl] & (~0u << sl);
+	if (!slMap)
+	{
+		const uint64_t flMap = fl + 1 < 64 ? m_flBitmap & (~0ull << (fl + 1)) : 0;
+		if (!flMap) return None;
+		fl = LowestBit(flMap);
+		slMap = m_slBitmap[fl];
+	}
+	return m_freeHeads[fl][LowestBit(slMap)];
+}
+
+uint32_t TlsfAllocator::NewBlock()
+{
+	uint32_t b;
+	if (!m_unusedBlocks.empty())
+	{
+		b = m_unusedBlocks.back();
+		m_unusedBlocks.pop_back();
+		m_blocks[b] = Block();
+	}
+	else
+	{
+		b = (uint32_t)m_blocks.size();
+		m_blocks.emplace_back();
+	}
+	m_blocks[b].used = true;
+	return b;
+}
+
+void TlsfAllocator::InsertFree(uint32_t b)
+{
+	Block& block = m_blocks[b];
+	uint32_t fl, sl;
+	Mapping(block.size, fl, sl);
+	block.free = true;
+	block.movable = false;
+	block.prevFree = None;
+	block.nextFree = m_freeHeads[fl][sl];
+	if (block.nextFree != None) m_blocks[block.nextFree].prevFree = b;
+	m_freeHeads[fl][sl] = b;
+	m_flBitmap |= 1ull << fl;
+	m_slBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::RemoveFree(uint32_t b)
+{
+	Block& block = m_blocks[b];
+	uint32_t fl, sl;
+	Mapping(block.size, fl, sl);
+	if (block.prevFree != None) m_blocks[block.prevFree].nextFree = block.nextFree;
+	else m_freeHeads[fl][sl] = block.nextFree;
+	if (block.nextFree != None) m_blocks[block.nextFree].prevFree = block.prevFree;
+	if (m_freeHeads[fl][sl] == None)
+	{
+		m_slBitmap[fl] &= ~(1u << sl);
+		if (!m_slBitmap[fl]) m_flBitmap &= ~(1ull << fl);
+	}
+	block.free = false;
+	block.prevFree = block.nextFree = None;
+}
+
+bool TlsfAllocator::Fits(const Block& block, uint64_t size, uint64_t alignment)
+{
+	const uint64_t aligned = AlignUp(block.offset, alignment);
+	return aligned >= block.offset && aligned - block.offset <= block.size && block.size - (aligned - block.offset) >= size;
+}
+
+uint32_t TlsfAllocator::Carve(uint32_t b, uint64_t size, uint64_t alignment)
+{
+	RemoveFree(b);
+	const uint64_t padding = AlignUp(m_blocks[b].offset, alignment) - m_blocks[b].offset;
+	if (padding > 0)
+	{
+		// Хвост выравнивания перед выделением остается свободным блоком
+		const uint32_t head = NewBlock();
+		Block& pad = m_blocks[head];
+		Block& block = m_blocks[b];
+		pad.offset = block.offset;
+		pad.size = padding;
+		pad.prevPhys = block.prevPhys;
+		pad.nextPhys = b;
+		if (pad.prevPhys != None) m_blocks[pad.prevPhys].nextPhys = head;
+		else m_firstBlock = head;
+		block.prevPhys = head;
+		block.offset += padding;
+		block.size -= padding;
+		InsertFree(head);
+	}
+	if (m_blocks[b].size > size)
+	{
+		const uint32_t tail = NewBlock();
+		Block& rest = m_blocks[tail];
+		Block& block = m_blocks[b];
+		rest.offset = block.offset + size;
+		rest.size = block.size - size;
+		rest.prevPhys = b;
+		rest.nextPhys = block.nextPhys;
+		if (rest.nextPhys != None) m_blocks[rest.nextPhys].prevPhys = tail;
+		block.nextPhys = tail;
+		block.size = size;
+		InsertFree(tail);
+	}
+	Block& block = m_blocks[b];
+	block.alignment = alignment;
+	block.movable = false;
+	m_used += size;
+	++m_allocations;
+	return b;
+}
+
+uint32_t TlsfAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	if (size == 0 || alignment == 0 || (alignment & (alignment - 1))) return InvalidHandle;
+	// Сначала без запаса на выравнивание: часто первый блок найденного списка уже выровнен
+	uint32_t b = FindFree(size);
+	if (b == None || !Fits(m_blocks[b], size, alignment))
+	{
+		if (size > ~0ull - (alignment - 1)) return InvalidHandle;
+		b = FindFree(size + alignment - 1);
+	}
+	if (b == None)
+	{
+		// Округление класса вверх пропускает блоки того же класса, в которые size все же влезает
+		uint32_t fl, sl;
+		Mapping(size, fl, sl);
+		for (b = m_freeHeads[fl][sl]; b != None && !Fits(m_blocks[b], size, alignment); b = m_blocks[b].nextFree) {}
+	}
+	if (b == None) return InvalidHandle;
+	return Carve(b, size, alignment);
+}
+
+void TlsfAllocator::Free(uint32_t handle)
+{
+	uint32_t b = handle;
+	m_used -= m_blocks[b].size;
+	--m_allocations;
+
+	const uint32_t prev = m_blocks[b].prevPhys;
+	if (prev != None && m_blocks[prev].free)
+	{
+		RemoveFree(prev);
+		m_blocks[prev].size += m_blocks[b].size;
+		m_blocks[prev].nextPhys = m_blocks[b].nextPhys;
+		if (m_blocks[b].nextPhys != None) m_blocks[m_blocks[b].nextPhys].prevPhys = prev;
+		m_blocks[b].used = false;
+		m_unusedBlocks.push_back(b);
+		b = prev;
+	}
+	const uint32_t next = m_blocks[b].nextPhys;
+	if (next != None && m_blocks[next].free)
+	{
+		RemoveFree(next);
+		m_blocks[b].size += m_blocks[next].size;
+		m_blocks[b].nextPhys = m_blocks[next].nextPhys;
+		if (m_blocks[next].nextPhys != None) m_blocks[m_blocks[next].nextPhys].prevPhys = b;
+		m_blocks[next].used = false;
+		m_unusedBlocks.push_back(next);
+	}
+	InsertFree(b);
+}
+
+TlsfAllocator::Stats TlsfAllocator::GetStats() const
+{
+	Stats stats;
+	stats.capacity = m_capacity;
+	stats.used = m_used;
+	stats.allocations = m_allocations;
+	for (uint32_t b = m_firstBlock; b != None; b = m_blocks[b].nextPhys)
+	{
+		if (!m_blocks[b].free) continue;
+		++stats.freeBlocks;
+		if (m_blocks[b].size > stats.largestFree) stats.largestFree = m_blocks[b].size;
+	}
+	const uint64_t free = m_capacity - m_used;
+	stats.fragmentation = free ? 1.0 - (double)stats.largestFree / (double)free : 0.0;
+	return stats;
+}
+
+bool TlsfAllocator::PlanMove(uint32_t& from, uint32_t& to)
+{
+	std::vector<uint32_t> order;
+	for (uint32_t b = m_firstBlock; b != None; b = m_blocks[b].nextPhys) order.push_back(b);
+
+	for (size_t i = order.size(); i-- > 0;)
+	{
+		const Block& victim = m_blocks[order[i]];
+		if (victim.free || !victim.movable) continue;
+		for (size_t j = 0; j < i; ++j)
+		{
+			const Block& hole = m_blocks[order[j]];
+			if (!hole.free || !Fits(hole, victim.size, victim.alignment)) continue;
+			from = order[i];
+			to = Carve(order[j], victim.size, victim.alignment);
+			m_blocks[from].movable = false;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TlsfAllocator::Validate() const
+{
+	uint64_t offset = 0, used = 0;
+	uint32_t allocations = 0, prev = None;
+	size_t blocks = 0;
+	for (uint32_t b = m_firstBlock; b != None; b = m_blocks[b].nextPhys)
+	{
+		const Block& block = m_blocks[b];
+		if (!block.used || block.offset != offset || block.size == 0 || block.prevPhys != prev) return false;
+		// Два свободных соседа должны были слиться
+		if (block.free && prev != None && m_blocks[prev].free) return false;
+		if (!block.free)
+		{
+			if (block.offset % block.alignment) return false;
+			used += block.size;
+			++allocations;
+		}
+		else
+		{
+			uint32_t fl, sl;
+			Mapping(block.size, fl, sl);
+			if (!(m_slBitmap[fl] & (1u << sl)) || !(m_flBitmap & (1ull << fl))) return false;
+			bool listed = false;
+			for (uint32_t f = m_freeHeads[fl][sl]; f != None && !listed; f = m_blocks[f].nextFree) listed = f == b;
+			if (!listed) return false;
+		}
+		offset += block.size;
+		prev = b;
+		++blocks;
+	}
+	if (m_capacity && offset != m_capacity) return false;
+	if (used != m_used || allocations != m_allocations) return false;
+	return blocks + m_unusedBlocks.size() == m_blocks.size();
+}
\ No newline at end of file
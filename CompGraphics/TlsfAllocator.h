@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Two-Level Segregated Fit поверх диапазона [0, capacity): поиск и освобождение за O(1),
+// соседние свободные блоки сливаются сразу. Хранит только смещения, поэтому не зависит
+// от D3D и проверяется на CPU. Не потокобезопасен - синхронизирует владелец.
+class TlsfAllocator
+{
+public:
+	static const uint32_t InvalidHandle = ~0u;
+
+	struct Stats
+	{
+		uint64_t capacity = 0;
+		uint64_t used = 0;
+		uint64_t largestFree = 0;
+		uint32_t allocations = 0;
+		uint32_t freeBlocks = 0;
+		// 1 - largestFree / свободно: 0 - все свободное место одним куском
+		double fragmentation = 0.0;
+	};
+
+	explicit TlsfAllocator(uint64_t capacity);
+
+	// alignment - степень двойки. InvalidHandle - нет подходящего свободного блока
+	uint32_t Allocate(uint64_t size, uint64_t alignment);
+	void Free(uint32_t handle);
+
+	uint64_t GetOffset(uint32_t handle) const { return m_blocks[handle].offset; }
+	uint64_t GetSize(uint32_t handle) const { return m_blocks[handle].size; }
+	bool IsEmpty() const { return m_allocations == 0; }
+	Stats GetStats() const;
+
+	// Дефрагментация: переносить можно только отмеченные выделения
+	void SetMovable(uint32_t handle, bool movable) { m_blocks[handle].movable = movable; }
+	// Выбирает самое дальнее переносимое выделение, для которого есть свободный блок ниже,
+	// и занимает место под копию в первом таком блоке. Оба выделения снимаются с переноса;
+	// старое владелец освобождает сам, когда GPU закончит копирование
+	bool PlanMove(uint32_t& from, uint32_t& to);
+
+	// Проверка связности блоков, списков и битовых масок - для отладки
+	bool Validate() const;
+
+private:
+	static const uint32_t SL_BITS = 4;
+	static const uint32_t SL_COUNT = 1u << SL_BITS;
+	static const uint32_t FL_COUNT = 64 - SL_BITS + 1;
+	static const uint32_t None = ~0u;
+
+	struct Block
+	{
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint64_t alignment = 1;
+		uint32_t prevPhys = None;
+		uint32_t nextPhys = None;
+		uint32_t prevFree = None;
+		uint32_t nextFree = None;
+		bool free = false;
+		bool movable = false;
+		bool used = false;
+	};
+
+	static void Mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+	uint32_t FindFree(uint64_t size) const;
+	uint32_t NewBlock();
+	void InsertFree(uint32_t b);
+	void RemoveFree(uint32_t b);
+	// Занимает [aligned, aligned + size) в свободном блоке b, остатки возвращает в списки
+	uint32_t Carve(uint32_t b, uint64_t size, uint64_t alignment);
+	static bool Fits(const Block& block, uint64_t size, uint64_t alignment);
+
+	uint64_t m_capacity;
+	uint64_t m_used = 0;
+	uint32_t m_allocations = 0;
+	std::vector<Block> m_blocks;
+	std::vector<uint32_t> m_unusedBlocks;
+	uint32_t m_firstBlock = None;
+	uint64_t m_flBitmap = 0;
+	uint32_t m_slBitmap[FL_COUNT] = {};
+	uint32_t m_freeHeads[FL_COUNT][SL_COUNT];
+};
\ No newline at end of file
@@ -0,0 +1,859 @@
+#include "TriangleBvh.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+
+static const uint32_t kBins = 16;
+static const uint32_t kMaxLeaf = 8;
+// Стоимость проверки узла относительно проверки треугольника
+static const float kTraversalCost = 1.0f;
+// Глубже делим пополам по медиане: дерево не глубже kMaxDepth, стек обхода на месте
+static const uint32_t kMedianDepth = 32;
+static const uint32_t kMaxDepth = 64;
+// Диапазоны больше этого делятся по очереди с раскладкой по корзинам на потоках,
+// меньшие - отдельными поддеревьями. Не зависит от числа потоков, поэтому и дерево тоже
+static const uint32_t kSubtreeTriangles = 8192;
+static const uint32_t kChunkTriangles = 8192;
+// Выход из AABB чуть отодвигается: луч вдоль ребра или грани узла не должен терять попадание
+// из-за округления, а треугольник тоже может найтись немного за своим ребром
+static const float kRobustFar = 1.00001f;
+// На столько долей радиуса сфера останавливается до препятствия
+static const float kSkinFraction = 0.01f;
+
+struct Box
+{
+	float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	void Grow(const Box& b)
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			min[a] = std::min(min[a], b.min[a]);
+			max[a] = std::max(max[a], b.max[a]);
+		}
+	}
+	void Grow(const float p[3])
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			min[a] = std::min(min[a], p[a]);
+			max[a] = std::max(max[a], p[a]);
+		}
+	}
+	float Area() const
+	{
+		const float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+		return x < 0.f ? 0.f : 2.f * (x * y + y * z + z * x);
+	}
+};
+
+struct Bin
+{
+	Box box;
+	uint32_t count = 0;
+};
+
+struct TriangleBvh::BuildRange
+{
+	uint32_t begin, end;
+	uint32_t node;
+	uint32_t depth;
+};
+
+struct TriangleBvh::Prims
+{
+	std::vector<Box> boxes;
+	std::vector<float> centers;
+	uint32_t* order;
+
+	const float* Center(uint32_t prim) const { return &centers[prim * 3]; }
+};
+
+static void ForChunks(JobSystem* jobs, size_t count, const std::function<void(size_t)>& work)
+{
+	if (jobs && count > 1) jobs->ParallelFor(count, work);
+	else for (size_t i = 0; i < count; ++i) work(i);
+}
+
+static uint32_t BinOf(float center, float min, float scale)
+{
+	const int bin = (int)((center - min) * scale);
+	return bin < 0 ? 0 : (bin >= (int)kBins ? kBins - 1 : (uint32_t)bin);
+}
+
+static void Sub(const float a[3], const float b[3], float out[3])
+{
+	out[0] = a[0] - b[0];
+	out[1] = a[1] - b[1];
+	out[2] = a[2] - b[2];
+}
+
+static float Dot(const float a[3], const float b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Cross(const float a[3], const float b[3], float out[3])
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Ноль в направлении дал бы 0 * inf на границе слоя
+static float SafeInverse(float d)
+{
+	return 1.f / (fabsf(d) > 1e-20f ? d : (d < 0.f ? -1e-20f : 1e-20f));
+}
+
+void TriangleBvh::Clear()
+{
+	m_nodes.clear();
+	m_triangles.clear();
+	m_subsets.clear();
+	m_order.clear();
+}
+
+TriangleBvh::BuildReport TriangleBvh::Build(const ObjMesh& mesh, JobSystem* jobs)
+{
+	const auto start = std::chrono::steady_clock::now();
+	Clear();
+	BuildReport report;
+	report.threads = jobs ? jobs->GetThreadCount() : 1;
+
+	// Копии сабсетов переводятся своими матрицами, как у заслонителей
+	std::vector<Triangle> triangles;
+	std::vector<uint32_t> subsets;
+	for (size_t s = 0; s < mesh.subsets.size(); ++s)
+	{
+		const MeshSubset& sub = mesh.subsets[s];
+		const uint32_t copies = sub.instanceCount ? sub.instanceCount : 1;
+		for (uint32_t c = 0; c < copies; ++c)
+		{
+			const XMMATRIX world = sub.instanceCount ? XMLoadFloat4x4(&mesh.instances[sub.instanceStart + c]) : XMMatrixIdentity();
+			for (uint32_t i = sub.indexStart; i + 2 < sub.indexStart + sub.indexCount; i += 3)
+			{
+				XMFLOAT3 p[3];
+				for (uint32_t k = 0; k < 3; ++k)
+					XMStoreFloat3(&p[k], XMVector3Transform(XMLoadFloat3(&mesh.vertices[mesh.indices[i + k]].Position), world));
+				Triangle tri;
+				const float v1[3] = { p[1].x, p[1].y, p[1].z }, v2[3] = { p[2].x, p[2].y, p[2].z };
+				tri.v0[0] = p[0].x; tri.v0[1] = p[0].y; tri.v0[2] = p[0].z;
+				Sub(v1, tri.v0, tri.e1);
+				Sub(v2, tri.v0, tri.e2);
+				triangles.push_back(tri);
+				subsets.push_back((uint32_t)s);
+			}
+		}
+	}
+	const uint32_t count = (uint32_t)triangles.size();
+	if (count == 0) return report;
+
+	Prims prims;
+	prims.boxes.resize(count);
+	prims.centers.resize(count * 3);
+	ForChunks(jobs, (count + kChunkTriangles - 1) / kChunkTriangles, [&](size_t chunk) {
+		const uint32_t end = std::min(count, (uint32_t)(chunk + 1) * kChunkTriangles);
+		for (uint32_t i = (uint32_t)chunk * kChunkTriangles; i < end; ++i)
+		{
+			const Triangle& tri = triangles[i];
+			float v1[3], v2[3];
+			for (int a = 0; a < 3; ++a)
+			{
+				v1[a] = tri.v0[a] + tri.e1[a];
+				v2[a] = tri.v0[a] + tri.e2[a];
+			}
+			Box& box = prims.boxes[i];
+			box.Grow(tri.v0);
+			box.Grow(v1);
+			box.Grow(v2);
+			for (int a = 0; a < 3; ++a) prims.centers[i * 3 + a] = 0.5f * (box.min[a] + box.max[a]);
+		}
+	});
+	m_order.resize(count);
+	for (uint32_t i = 0; i < count; ++i) m_order[i] = i;
+	prims.order = m_order.data();
+
+	// Верх дерева: крупные диапазоны делятся по одному, корзины считаются на потоках
+	m_nodes.resize(1);
+	std::vector<BuildRange> pending(1, BuildRange{ 0, count, 0, 0 });
+	std::vector<BuildRange> subtrees;
+	while (!pending.empty())
+	{
+		const BuildRange range = pending.back();
+		pending.pop_back();
+		report.maxDepth = std::max(report.maxDepth, range.depth);
+		if (range.end - range.begin <= kSubtreeTriangles)
+		{
+			subtrees.push_back(range);
+			continue;
+		}
+		uint32_t mid, axis;
+		if (!SplitRange(prims, range, jobs, m_nodes, mid, axis)) continue;
+		const uint32_t child = (uint32_t)m_nodes.size();
+		m_nodes.resize(child + 2);
+		m_nodes[range.node].first = child;
+		m_nodes[range.node].count = 0;
+		m_nodes[range.node].axis = (uint16_t)axis;
+		pending.push_back(BuildRange{ mid, range.end, child + 1, range.depth + 1 });
+		pending.push_back(BuildRange{ range.begin, mid, child, range.depth + 1 });
+	}
+
+	// Поддеревья - каждое в свой массив, потом по порядку в общий
+	std::vector<std::vector<Node>> locals(subtrees.size());
+	std::vector<uint32_t> depths(subtrees.size(), 0);
+	ForChunks(jobs, subtrees.size(), [&](size_t i) {
+		BuildRange root = subtrees[i];
+		root.node = 0;
+		locals[i].resize(1);
+		depths[i] = root.depth;
+		BuildSubtree(prims, root, locals[i], depths[i]);
+	});
+	for (size_t i = 0; i < subtrees.size(); ++i)
+	{
+		const uint32_t base = (uint32_t)m_nodes.size();
+		const std::vector<Node>& local = locals[i];
+		for (size_t n = 0; n < local.size(); ++n)
+		{
+			Node node = local[n];
+			if (node.count == 0) node.first = base + node.first - 1;
+			if (n == 0) m_nodes[subtrees[i].node] = node;
+			else m_nodes.push_back(node);
+		}
+		report.maxDepth = std::max(report.maxDepth, depths[i]);
+	}
+
+	// Треугольники в порядке листов
+	m_triangles.resize(count);
+	m_subsets.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		m_triangles[i] = triangles[m_order[i]];
+		m_subsets[i] = subsets[m_order[i]];
+	}
+
+	Box rootBox;
+	for (int a = 0; a < 3; ++a)
+	{
+		rootBox.min[a] = m_nodes[0].min[a];
+		rootBox.max[a] = m_nodes[0].max[a];
+	}
+	const float rootArea = std::max(rootBox.Area(), FLT_MIN);
+	for (const Node& node : m_nodes)
+	{
+		Box box;
+		for (int a = 0; a < 3; ++a)
+		{
+			box.min[a] = node.min[a];
+			box.max[a] = node.max[a];
+		}
+		report.sahCost += box.Area() / rootArea * (node.count ? (float)node.count : kTraversalCost);
+		if (node.count) ++report.leaves;
+	}
+	report.triangles = count;
+	report.nodes = (uint32_t)m_nodes.size();
+	report.bytes = m_nodes.size() * sizeof(Node) + m_triangles.size() * sizeof(Triangle) + m_subsets.size() * sizeof(uint32_t);
+	report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return report;
+}
+
+// Границы узла range.node и решение: лист или деление [begin, mid) и [mid, end) по оси axis
+bool TriangleBvh::SplitRange(const Prims& prims, const BuildRange& range, JobSystem* jobs, std::vector<Node>& nodes,
+	uint32_t& mid, uint32_t& axis)
+{
+	const uint32_t count = range.end - range.begin;
+	const uint32_t chunks = jobs ? (count + kChunkTriangles - 1) / kChunkTriangles : 1;
+	const uint32_t chunkSize = (count + chunks - 1) / chunks;
+	uint32_t* order = prims.order;
+
+	// Границы треугольников и их центров; min и max не зависят от порядка слияния.
+	// Без потоков кусок один и обходится без выделения памяти
+	Box localBoxes[2];
+	std::vector<Box> sharedBoxes(chunks > 1 ? chunks * 2 : 0);
+	Box* chunkBoxes = chunks > 1 ? sharedBoxes.data() : localBoxes;
+	ForChunks(jobs, chunks, [&](size_t chunk) {
+		const uint32_t begin = range.begin + (uint32_t)chunk * chunkSize;
+		const uint32_t end = std::min(range.end, begin + chunkSize);
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			chunkBoxes[chunk * 2].Grow(prims.boxes[order[i]]);
+			chunkBoxes[chunk * 2 + 1].Grow(prims.Center(order[i]));
+		}
+	});
+	Box bounds, centers;
+	for (uint32_t c = 0; c < chunks; ++c)
+	{
+		bounds.Grow(chunkBoxes[c * 2]);
+		centers.Grow(chunkBoxes[c * 2 + 1]);
+	}
+	Node& node = nodes[range.node];
+	for (int a = 0; a < 3; ++a)
+	{
+		node.min[a] = bounds.min[a];
+		node.max[a] = bounds.max[a];
+	}
+	node.first = range.begin;
+	node.count = (uint16_t)count;
+	node.axis = 0;
+	if (count <= 1) return false;
+
+	// Самая длинная ось центров - для деления по медиане
+	uint32_t longest = 0;
+	for (uint32_t a = 1; a < 3; ++a)
+		if (centers.max[a] - centers.min[a] > centers.max[longest] - centers.min[longest]) longest = a;
+	const bool flat = !(centers.max[longest] > centers.min[longest]);
+
+	uint32_t bestAxis = UINT32_MAX, bestBin = 0;
+	float bestCost = FLT_MAX;
+	if (range.depth < kMedianDepth && !flat)
+	{
+		Bin bins[3][kBins];
+		std::vector<Bin> sharedBins(chunks > 1 ? chunks * 3 * kBins : 0);
+		Bin* chunkBins = chunks > 1 ? sharedBins.data() : &bins[0][0];
+		float scale[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			const float extent = centers.max[a] - centers.min[a];
+			scale[a] = extent > 0.f ? kBins / extent : 0.f;
+		}
+		ForChunks(jobs, chunks, [&](size_t chunk) {
+			Bin* bins = &chunkBins[chunk * 3 * kBins];
+			const uint32_t begin = range.begin + (uint32_t)chunk * chunkSize;
+			const uint32_t end = std::min(range.end, begin + chunkSize);
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const float* center = prims.Center(order[i]);
+				for (uint32_t a = 0; a < 3; ++a)
+				{
+					Bin& bin = bins[a * kBins + BinOf(center[a], centers.min[a], scale[a])];
+					bin.box.Grow(prims.boxes[order[i]]);
+					++bin.count;
+				}
+			}
+		});
+		for (uint32_t c = 0; c < chunks && chunks > 1; ++c)
+			for (uint32_t a = 0; a < 3; ++a)
+				for (uint32_t b = 0; b < kBins; ++b)
+				{
+					const Bin& from = chunkBins[(c * 3 + a) * kBins + b];
+					bins[a][b].box.Grow(from.box);
+					bins[a][b].count += from.count;
+				}
+
+		// Площади и число треугольников слева от каждой границы корзин и справа
+		const float invArea = 1.f / std::max(bounds.Area(), FLT_MIN);
+		for (uint32_t a = 0; a < 3; ++a)
+		{
+			if (scale[a] == 0.f) continue;
+			float leftArea[kBins], rightArea[kBins];
+			uint32_t leftCount[kBins], rightCount[kBins];
+			Box left, right;
+			uint32_t nl = 0, nr = 0;
+			for (uint32_t b = 0; b + 1 < kBins; ++b)
+			{
+				left.Grow(bins[a][b].box);
+				nl += bins[a][b].count;
+				leftArea[b] = left.Area();
+				leftCount[b] = nl;
+				const uint32_t rb = kBins - 1 - b;
+				right.Grow(bins[a][rb].box);
+				nr += bins[a][rb].count;
+				rightArea[rb - 1] = right.Area();
+				rightCount[rb - 1] = nr;
+			}
+			for (uint32_t b = 0; b + 1 < kBins; ++b)
+			{
+				if (leftCount[b] == 0 || rightCount[b] == 0) continue;
+				const float cost = kTraversalCost + (leftArea[b] * leftCount[b] + rightArea[b] * rightCount[b]) * invArea;
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = a;
+					bestBin = b;
+				}
+			}
+		}
+		if (count <= kMaxLeaf && bestCost >= (float)count) return false;
+	}
+	else if (count <= kMaxLeaf) return false;
+
+	if (bestAxis != UINT32_MAX)
+	{
+		const float min = centers.min[bestAxis], scale = kBins / (centers.max[bestAxis] - centers.min[bestAxis]);
+		mid = (uint32_t)(std::partition(order + range.begin, order + range.end, [&](uint32_t prim) {
+			return BinOf(prims.Center(prim)[bestAxis], min, scale) <= bestBin; }) - order);
+		axis = bestAxis;
+		return true;
+	}
+	// Центры совпадают или дерево слишком глубокое: пополам по медиане
+	mid = range.begin + count / 2;
+	std::nth_element(order + range.begin, order + mid, order + range.end, [&](uint32_t a, uint32_t b) {
+		const float ca = prims.Center(a)[longest], cb = prims.Center(b)[longest];
+		return ca != cb ? ca < cb : a < b; });
+	axis = longest;
+	return true;
+}
+
+void TriangleBvh::BuildSubtree(const Prims& prims, const BuildRange& root, std::vector<Node>& nodes, uint32_t& maxDepth)
+{
+	std::vector<BuildRange> stack(1, root);
+	while (!stack.empty())
+	{
+		const BuildRange range = stack.back();
+		stack.pop_back();
+		maxDepth = std::max(maxDepth, range.depth);
+		uint32_t mid, axis;
+		if (!SplitRange(prims, range, nullptr, nodes, mid, axis)) continue;
+		const uint32_t child = (uint32_t)nodes.size();
+		nodes.resize(child + 2);
+		nodes[range.node].first = child;
+		nodes[range.node].count = 0;
+		nodes[range.node].axis = (uint16_t)axis;
+		stack.push_back(BuildRange{ mid, range.end, child + 1, range.depth + 1 });
+		stack.push_back(BuildRange{ range.begin, mid, child, range.depth + 1 });
+	}
+}
+
+// Вход луча в AABB, расширенный на expand; промах - false
+static bool SlabTest(const float min[3], const float max[3], const float o[3], const float inv[3], float tMax, float expand,
+	float& tNear)
+{
+	float t0 = 0.f, t1 = tMax;
+	for (int a = 0; a < 3; ++a)
+	{
+		float tn = (min[a] - expand - o[a]) * inv[a];
+		float tf = (max[a] + expand - o[a]) * inv[a];
+		if (tn > tf) std::swap(tn, tf);
+		t0 = tn > t0 ? tn : t0;
+		t1 = tf < t1 ? tf : t1;
+	}
+	tNear = t0;
+	return t0 <= t1 * kRobustFar;
+}
+
+// Мёллер - Трумбор с обеих сторон; порядок операций как у пакета, результаты совпадают
+static bool IntersectTriangle(const float v0[3], const float e1[3], const float e2[3], const float o[3], const float d[3],
+	float tMax, float& t, float& u, float& v)
+{
+	float p[3], s[3], q[3];
+	Cross(d, e2, p);
+	const float det = Dot(e1, p);
+	if (det == 0.f) return false;
+	const float inv = 1.f / det;
+	Sub(o, v0, s);
+	u = Dot(s, p) * inv;
+	if (!(u >= 0.f)) return false;
+	Cross(s, e1, q);
+	v = Dot(d, q) * inv;
+	if (!(v >= 0.f) || !(u + v <= 1.f)) return false;
+	t = Dot(e2, q) * inv;
+	return t > 0.f && t < tMax;
+}
+
+template <bool AnyHit>
+bool TriangleBvh::Traverse(const Ray& ray, Hit& hit) const
+{
+	hit = Hit();
+	if (m_nodes.empty()) return false;
+	const float o[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+	const float d[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+	const float inv[3] = { SafeInverse(d[0]), SafeInverse(d[1]), SafeInverse(d[2]) };
+	float tMax = ray.tMax, tNear;
+	if (!SlabTest(m_nodes[0].min, m_nodes[0].max, o, inv, tMax, 0.f, tNear)) return false;
+
+	// Отложенный дальний потомок и вход в него: после попадания ближе его можно не смотреть
+	struct Entry { uint32_t node; float tNear; };
+	Entry stack[kMaxDepth + 1];
+	uint32_t top = 0;
+	uint32_t index = 0;
+	for (;;)
+	{
+		const Node& node = m_nodes[index];
+		if (node.count)
+		{
+			for (uint32_t i = node.first; i < node.first + node.count; ++i)
+			{
+				const Triangle& tri = m_triangles[i];
+				float t, u, v;
+				if (!IntersectTriangle(tri.v0, tri.e1, tri.e2, o, d, tMax, t, u, v)) continue;
+				tMax = t;
+				hit.t = t;
+				hit.u = u;
+				hit.v = v;
+				hit.triangle = i;
+				if (AnyHit) return true;
+			}
+		}
+		else
+		{
+			uint32_t nearChild = node.first, farChild = node.first + 1;
+			float nearT, farT;
+			bool nearHit = SlabTest(m_nodes[nearChild].min, m_nodes[nearChild].max, o, inv, tMax, 0.f, nearT);
+			bool farHit = SlabTest(m_nodes[farChild].min, m_nodes[farChild].max, o, inv, tMax, 0.f, farT);
+			if (nearHit && farHit && farT < nearT)
+			{
+				std::swap(nearChild, farChild);
+				std::swap(nearT, farT);
+			}
+			else if (!nearHit && farHit)
+			{
+				index = farChild;
+				continue;
+			}
+			if (nearHit)
+			{
+				if (farHit) stack[top++] = Entry{ farChild, farT };
+				index = nearChild;
+				continue;
+			}
+		}
+		do
+		{
+			if (top == 0) return hit.IsHit();
+			--top;
+		} while (stack[top].tNear > tMax);
+		index = stack[top].node;
+	}
+}
+
+bool TriangleBvh::Intersect(const Ray& ray, Hit& hit) const
+{
+	return Traverse<false>(ray, hit);
+}
+
+bool TriangleBvh::IsOccluded(const Ray& ray) const
+{
+	Hit hit;
+	return Traverse<true>(ray, hit);
+}
+
+template <bool AnyHit>
+void TriangleBvh::TraversePacket(const Ray rays[PacketSize], Hit hits[PacketSize], bool occluded[PacketSize]) const
+{
+#ifdef BVH_USE_SSE2
+	for (uint32_t i = 0; i < PacketSize; ++i)
+	{
+		hits[i] = Hit();
+		occluded[i] = false;
+	}
+	if (m_nodes.empty()) return;
+
+	// Лучи по столбцам: компонента всех четырех в одном регистре
+	float dirs[3][PacketSize];
+	__m128 o[3], d[3], inv[3];
+	for (uint32_t i = 0; i < PacketSize; ++i)
+	{
+		dirs[0][i] = rays[i].direction.x;
+		dirs[1][i] = rays[i].direction.y;
+		dirs[2][i] = rays[i].direction.z;
+	}
+	o[0] = _mm_setr_ps(rays[0].origin.x, rays[1].origin.x, rays[2].origin.x, rays[3].origin.x);
+	o[1] = _mm_setr_ps(rays[0].origin.y, rays[1].origin.y, rays[2].origin.y, rays[3].origin.y);
+	o[2] = _mm_setr_ps(rays[0].origin.z, rays[1].origin.z, rays[2].origin.z, rays[3].origin.z);
+	for (int a = 0; a < 3; ++a)
+	{
+		d[a] = _mm_loadu_ps(dirs[a]);
+		inv[a] = _mm_setr_ps(SafeInverse(dirs[a][0]), SafeInverse(dirs[a][1]), SafeInverse(dirs[a][2]), SafeInverse(dirs[a][3]));
+	}
+	__m128 tMax = _mm_setr_ps(rays[0].tMax, rays[1].tMax, rays[2].tMax, rays[3].tMax);
+	__m128 hitU = _mm_setzero_ps(), hitV = _mm_setzero_ps();
+	__m128i hitTriangle = _mm_set1_epi32(-1);
+	// Лучи, которые еще ищут: у AnyHit попавший выбывает
+	__m128 active = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), robust = _mm_set1_ps(kRobustFar);
+
+	uint32_t stack[kMaxDepth + 1];
+	uint32_t top = 0;
+	uint32_t index = 0;
+	for (;;)
+	{
+		const Node& node = m_nodes[index];
+		__m128 tNear = zero, tFar = tMax;
+		for (int a = 0; a < 3; ++a)
+		{
+			const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[a]), o[a]), inv[a]);
+			const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[a]), o[a]), inv[a]);
+			tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+			tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+		}
+		const int lanes = _mm_movemask_ps(_mm_and_ps(active, _mm_cmple_ps(tNear, _mm_mul_ps(tFar, robust))));
+		if (lanes && node.count)
+		{
+			for (uint32_t i = node.first; i < node.first + node.count; ++i)
+			{
+				const Triangle& tri = m_triangles[i];
+				const __m128 e1x = _mm_set1_ps(tri.e1[0]), e1y = _mm_set1_ps(tri.e1[1]), e1z = _mm_set1_ps(tri.e1[2]);
+				const __m128 e2x = _mm_set1_ps(tri.e2[0]), e2y = _mm_set1_ps(tri.e2[1]), e2z = _mm_set1_ps(tri.e2[2]);
+				const __m128 px = _mm_sub_ps(_mm_mul_ps(d[1], e2z), _mm_mul_ps(d[2], e2y));
+				const __m128 py = _mm_sub_ps(_mm_mul_ps(d[2], e2x), _mm_mul_ps(d[0], e2z));
+				const __m128 pz = _mm_sub_ps(_mm_mul_ps(d[0], e2y), _mm_mul_ps(d[1], e2x));
+				const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+				const __m128 invDet = _mm_div_ps(one, det);
+				const __m128 sx = _mm_sub_ps(o[0], _mm_set1_ps(tri.v0[0]));
+				const __m128 sy = _mm_sub_ps(o[1], _mm_set1_ps(tri.v0[1]));
+				const __m128 sz = _mm_sub_ps(o[2], _mm_set1_ps(tri.v0[2]));
+				const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+				const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+				const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+				const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+				const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], qx), _mm_mul_ps(d[1], qy)), _mm_mul_ps(d[2], qz)), invDet);
+				const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+				__m128 mask = _mm_and_ps(active, _mm_cmpneq_ps(det, zero));
+				mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+				mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+				mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, tMax)));
+				if (!_mm_movemask_ps(mask)) continue;
+				tMax = _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, tMax));
+				hitU = _mm_or_ps(_mm_and_ps(mask, u), _mm_andnot_ps(mask, hitU));
+				hitV = _mm_or_ps(_mm_and_ps(mask, v), _mm_andnot_ps(mask, hitV));
+				const __m128i laneMask = _mm_castps_si128(mask);
+				hitTriangle = _mm_or_si128(_mm_and_si128(laneMask, _mm_set1_epi32((int)i)), _mm_andnot_si128(laneMask, hitTriangle));
+				if (AnyHit)
+				{
+					active = _mm_andnot_ps(mask, active);
+					if (!_mm_movemask_ps(active)) break;
+				}
+			}
+			if (AnyHit && !_mm_movemask_ps(active)) break;
+		}
+		else if (lanes)
+		{
+			// Ближний потомок - по знаку первого из попавших лучей
+			uint32_t lane = 0;
+			while (!(lanes & (1 << lane))) ++lane;
+			const bool negative = dirs[node.axis][lane] < 0.f;
+			stack[top++] = node.first + (negative ? 0 : 1);
+			index = node.first + (negative ? 1 : 0);
+			continue;
+		}
+		if (top == 0) break;
+		index = stack[--top];
+	}
+
+	alignas(16) float ts[PacketSize], us[PacketSize], vs[PacketSize];
+	alignas(16) uint32_t triangles[PacketSize];
+	_mm_store_ps(ts, tMax);
+	_mm_store_ps(us, hitU);
+	_mm_store_ps(vs, hitV);
+	_mm_store_si128(reinterpret_cast<__m128i*>(triangles), hitTriangle);
+	for (uint32_t i = 0; i < PacketSize; ++i)
+	{
+		occluded[i] = triangles[i] != UINT32_MAX;
+		if (!occluded[i]) continue;
+		hits[i].t = ts[i];
+		hits[i].u = us[i];
+		hits[i].v = vs[i];
+		hits[i].triangle = triangles[i];
+	}
+#else
+	for (uint32_t i = 0; i < PacketSize; ++i) occluded[i] = Traverse<AnyHit>(rays[i], hits[i]);
+#endif
+}
+
+void TriangleBvh::IntersectPacket(const Ray rays[PacketSize], Hit hits[PacketSize]) const
+{
+	bool occluded[PacketSize];
+	TraversePacket<false>(rays, hits, occluded);
+}
+
+void TriangleBvh::IsOccludedPacket(const Ray rays[PacketSize], bool occluded[PacketSize]) const
+{
+	Hit hits[PacketSize];
+	TraversePacket<true>(rays, hits, occluded);
+}
+
+// Наименьший корень a x^2 + b x + c в (0, maxRoot)
+static bool LowestRoot(float a, float b, float c, float maxRoot, float& root)
+{
+	if (a == 0.f) return false;
+	const float det = b * b - 4.f * a * c;
+	if (det < 0.f) return false;
+	const float sq = sqrtf(det);
+	float r1 = (-b - sq) / (2.f * a), r2 = (-b + sq) / (2.f * a);
+	if (r1 > r2) std::swap(r1, r2);
+	if (r1 > 0.f && r1 < maxRoot)
+	{
+		root = r1;
+		return true;
+	}
+	if (r2 > 0.f && r2 < maxRoot)
+	{
+		root = r2;
+		return true;
+	}
+	return false;
+}
+
+// Первое касание сферы c, r на пути d (доля из [0, best)) с треугольником: сначала его
+// внутренность, потом вершины и ребра. Нормаль - от точки касания к центру
+static bool SweepTriangle(const float v0[3], const float e1[3], const float e2[3], const float c[3], float r, const float d[3],
+	float& best, float normal[3])
+{
+	float n[3], toCenter[3];
+	Cross(e1, e2, n);
+	const float length = sqrtf(Dot(n, n));
+	if (length < 1e-12f) return false;
+	for (int a = 0; a < 3; ++a) n[a] /= length;
+	Sub(c, v0, toCenter);
+	float dist = Dot(n, toCenter);
+	if (dist < 0.f)
+	{
+		for (int a = 0; a < 3; ++a) n[a] = -n[a];
+		dist = -dist;
+	}
+	// Удаляется от плоскости или идет вдоль нее - треугольник не мешает
+	const float nd = Dot(n, d);
+	if (nd >= 0.f) return false;
+	float t0 = (dist - r) / -nd;
+	if (t0 >= best) return false;
+	if (t0 < 0.f) t0 = 0.f;
+
+	// Точка касания на плоскости внутри треугольника
+	float p[3], w[3];
+	for (int a = 0; a < 3; ++a) p[a] = c[a] + d[a] * t0 - n[a] * (dist + nd * t0);
+	Sub(p, v0, w);
+	const float d00 = Dot(e1, e1), d01 = Dot(e1, e2), d11 = Dot(e2, e2);
+	const float d20 = Dot(w, e1), d21 = Dot(w, e2);
+	const float denom = d00 * d11 - d01 * d01;
+	const float bv = (d11 * d20 - d01 * d21) / denom, bw = (d00 * d21 - d01 * d20) / denom;
+	if (bv >= 0.f && bw >= 0.f && bv + bw <= 1.f)
+	{
+		best = t0;
+		for (int a = 0; a < 3; ++a) normal[a] = n[a];
+		return true;
+	}
+
+	float verts[3][3];
+	for (int a = 0; a < 3; ++a)
+	{
+		verts[0][a] = v0[a];
+		verts[1][a] = v0[a] + e1[a];
+		verts[2][a] = v0[a] + e2[a];
+	}
+	const float dd = Dot(d, d);
+	float contact[3];
+	bool found = false;
+	for (int k = 0; k < 3; ++k)
+	{
+		float fromVertex[3], t;
+		Sub(c, verts[k], fromVertex);
+		const float cc = Dot(fromVertex, fromVertex) - r * r;
+		if (cc < 0.f) continue;
+		if (!LowestRoot(dd, 2.f * Dot(d, fromVertex), cc, best, t)) continue;
+		best = t;
+		for (int a = 0; a < 3; ++a) contact[a] = verts[k][a];
+		found = true;
+	}
+	for (int k = 0; k < 3; ++k)
+	{
+		const float* from = verts[k];
+		const float* to = verts[(k + 1) % 3];
+		float edge[3], toVertex[3], t;
+		Sub(to, from, edge);
+		Sub(from, c, toVertex);
+		const float ee = Dot(edge, edge), ed = Dot(edge, d), ev = Dot(edge, toVertex);
+		const float a = ee * -dd + ed * ed;
+		const float b = ee * 2.f * Dot(d, toVertex) - 2.f * ed * ev;
+		const float cc = ee * (r * r - Dot(toVertex, toVertex)) + ev * ev;
+		if (!LowestRoot(a, b, cc, best, t)) continue;
+		const float f = (ed * t - ev) / ee;
+		if (f < 0.f || f > 1.f) continue;
+		best = t;
+		for (int i = 0; i < 3; ++i) contact[i] = from[i] + edge[i] * f;
+		found = true;
+	}
+	if (!found) return false;
+	float away[3];
+	for (int a = 0; a < 3; ++a) away[a] = c[a] + d[a] * best - contact[a];
+	const float awayLength = sqrtf(Dot(away, away));
+	for (int a = 0; a < 3; ++a) normal[a] = awayLength > 0.f ? away[a] / awayLength : n[a];
+	return true;
+}
+
+bool TriangleBvh::SweepSphere(const XMFLOAT3& center, float radius, const XMFLOAT3& delta, float& fraction, XMFLOAT3& normal) const
+{
+	fraction = 1.f;
+	if (m_nodes.empty()) return false;
+	const float c[3] = { center.x, center.y, center.z };
+	const float d[3] = { delta.x, delta.y, delta.z };
+	if (Dot(d, d) == 0.f) return false;
+	const float inv[3] = { SafeInverse(d[0]), SafeInverse(d[1]), SafeInverse(d[2]) };
+
+	// Путь центра против AABB, расширенных на радиус
+	float best = 1.f, n[3] = {}, tNear;
+	bool found = false;
+	uint32_t stack[kMaxDepth + 1];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top)
+	{
+		const Node& node = m_nodes[stack[--top]];
+		if (!SlabTest(node.min, node.max, c, inv, best, radius, tNear)) continue;
+		if (node.count == 0)
+		{
+			stack[top++] = node.first + 1;
+			stack[top++] = node.first;
+			continue;
+		}
+		for (uint32_t i = node.first; i < node.first + node.count; ++i)
+		{
+			const Triangle& tri = m_triangles[i];
+			if (SweepTriangle(tri.v0, tri.e1, tri.e2, c, radius, d, best, n)) found = true;
+		}
+	}
+	if (!found) return false;
+	fraction = best;
+	normal = XMFLOAT3(n[0], n[1], n[2]);
+	return true;
+}
+
+XMFLOAT3 TriangleBvh::MoveSphere(const XMFLOAT3& center, float radius, const XMFLOAT3& delta) const
+{
+	XMVECTOR position = XMLoadFloat3(&center);
+	XMVECTOR move = XMLoadFloat3(&delta);
+	const float skin = radius * kSkinFraction;
+	// Несколько проходов: стена, угол со второй стеной, пол
+	for (int pass = 0; pass < 4; ++pass)
+	{
+		const float length = XMVectorGetX(XMVector3Length(move));
+		if (length <= skin * 0.01f) break;
+		XMFLOAT3 step, normal;
+		XMStoreFloat3(&step, move);
+		float fraction;
+		XMFLOAT3 from;
+		XMStoreFloat3(&from, position);
+		if (!SweepSphere(from, radius, step, fraction, normal))
+		{
+			position = XMVectorAdd(position, move);
+			break;
+		}
+		// До препятствия, не ближе skin, остаток пути - вдоль его касательной плоскости
+		const float travel = std::max(fraction * length - skin, 0.f);
+		position = XMVectorAdd(position, XMVectorScale(move, travel / length));
+		const XMVECTOR n = XMLoadFloat3(&normal);
+		const XMVECTOR rest = XMVectorScale(move, 1.f - fraction);
+		move = XMVectorSubtract(rest, XMVectorScale(n, XMVectorGetX(XMVector3Dot(rest, n))));
+	}
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, position);
+	return result;
+}
+
+XMFLOAT3 TriangleBvh::GetNormal(uint32_t triangle) const
+{
+	const Triangle& tri = m_triangles[triangle];
+	float n[3];
+	Cross(tri.e1, tri.e2, n);
+	const float length = sqrtf(Dot(n, n));
+	return length > 0.f ? XMFLOAT3(n[0] / length, n[1] / length, n[2] / length) : XMFLOAT3(0.f, 1.f, 0.f);
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "OBJLoader.h"
+
+class JobSystem;
+
+// Иерархия AABB над треугольниками сцены для лучей на CPU: выбор под курсором, расстановка,
+// столкновения камеры. Строится binned SAH: верхние узлы делятся с раскладкой по корзинам на
+// потоках JobSystem, поддеревья поменьше строятся целиком параллельно. Узел - 32 байта, братья
+// лежат рядом. Лучи - по одному или пакетом из четырех (SSE2, лучше всего из одной точки).
+// Результат не зависит от числа потоков. Без D3D; запросы можно звать с нескольких потоков.
+class TriangleBvh
+{
+public:
+	static const uint32_t PacketSize = 4;
+
+	// Направление не нормализуется: t измеряется в его длинах, попадание - в (0, tMax)
+	struct Ray
+	{
+		DirectX::XMFLOAT3 origin = { 0.f, 0.f, 0.f };
+		DirectX::XMFLOAT3 direction = { 0.f, 0.f, 1.f };
+		float tMax = FLT_MAX;
+	};
+
+	// Ближайшее попадание: треугольник и барицентрические u, v (вершина = v0 + u e1 + v e2)
+	struct Hit
+	{
+		float t = FLT_MAX;
+		float u = 0.f, v = 0.f;
+		uint32_t triangle = UINT32_MAX;
+		bool IsHit() const { return triangle != UINT32_MAX; }
+	};
+
+	struct BuildReport
+	{
+		uint32_t triangles = 0;
+		uint32_t nodes = 0;
+		uint32_t leaves = 0;
+		uint32_t maxDepth = 0;
+		// Ожидаемая стоимость луча в проверках узлов и треугольников
+		float sahCost = 0.f;
+		size_t bytes = 0;
+		unsigned threads = 1;
+		double milliseconds = 0.0;
+	};
+
+	// Все треугольники меша, копии сабсетов - в пространстве модели
+	BuildReport Build(const ObjMesh& mesh, JobSystem* jobs);
+	void Clear();
+	bool IsEmpty() const { return m_nodes.empty(); }
+
+	bool Intersect(const Ray& ray, Hit& hit) const;
+	// Любое попадание - для теней и видимости, без поиска ближайшего
+	bool IsOccluded(const Ray& ray) const;
+	void IntersectPacket(const Ray rays[PacketSize], Hit hits[PacketSize]) const;
+	void IsOccludedPacket(const Ray rays[PacketSize], bool occluded[PacketSize]) const;
+
+	// Сфера из center проходит путь delta: доля пути до первого касания и нормаль от точки
+	// касания к центру. Уже пересекающие сферу треугольники не мешают от них удаляться
+	bool SweepSphere(const DirectX::XMFLOAT3& center, float radius, const DirectX::XMFLOAT3& delta,
+		float& fraction, DirectX::XMFLOAT3& normal) const;
+	// Движение со скольжением вдоль препятствий; новое положение центра
+	DirectX::XMFLOAT3 MoveSphere(const DirectX::XMFLOAT3& center, float radius, const DirectX::XMFLOAT3& delta) const;
+
+	// По номеру из Hit: сабсет меша и единичная нормаль треугольника
+	uint32_t GetSubset(uint32_t triangle) const { return m_subsets[triangle]; }
+	DirectX::XMFLOAT3 GetNormal(uint32_t triangle) const;
+	uint32_t GetTriangleCount() const { return (uint32_t)m_triangles.size(); }
+	uint32_t GetNodeCount() const { return (uint32_t)m_nodes.size(); }
+
+private:
+	struct Node
+	{
+		float min[3];
+		// Лист - первый треугольник, иначе левый потомок (правый - следующий)
+		uint32_t first;
+		float max[3];
+		// 0 - внутренний узел
+		uint16_t count;
+		// Ось разбиения: ближний потомок выбирается по знаку луча
+		uint16_t axis;
+	};
+	// Вершина и два ребра - то, что нужно проверке Мёллера - Трумбора
+	struct Triangle
+	{
+		float v0[3], e1[3], e2[3];
+	};
+	struct BuildRange;
+	struct Prims;
+
+	bool SplitRange(const Prims& prims, const BuildRange& range, JobSystem* jobs, std::vector<Node>& nodes,
+		uint32_t& mid, uint32_t& axis);
+	void BuildSubtree(const Prims& prims, const BuildRange& root, std::vector<Node>& nodes, uint32_t& maxDepth);
+	// AnyHit - до первого попадания, иначе до ближайшего
+	template <bool AnyHit> bool Traverse(const Ray& ray, Hit& hit) const;
+	template <bool AnyHit> void TraversePacket(const Ray rays[PacketSize], Hit hits[PacketSize], bool occluded[PacketSize]) const;
+
+	std::vector<Node> m_nodes;
+	std::vector<Triangle> m_triangles;
+	std::vector<uint32_t> m_subsets;
+	// Номера треугольников при построении; после - порядок листов
+	std::vector<uint32_t> m_order;
+};
\ No newline at end of file
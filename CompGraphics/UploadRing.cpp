@@ -0,0 +1,131 @@
+#include "UploadRing.h"
+#include "d3dx12.h"
+#include <algorithm>
+#include <cstdio>
+
+UploadRing::Allocation& UploadRing::Allocation::operator=(Allocation&& other) noexcept
+{
+	if (this != &other)
+	{
+		Retire(0);
+		m_ring = other.m_ring;
+		m_resource = std::move(other.m_resource);
+		m_cpu = other.m_cpu;
+		m_offset = other.m_offset;
+		m_id = other.m_id;
+		m_dedicated = other.m_dedicated;
+		other.m_ring = nullptr;
+		other.m_cpu = nullptr;
+	}
+	return *this;
+}
+
+void UploadRing::Allocation::Retire(uint64_t fence)
+{
+	if (m_ring) m_ring->Release(*this, fence);
+	m_ring = nullptr;
+	m_resource.Reset();
+	m_cpu = nullptr;
+	m_offset = 0;
+}
+
+UploadRing::~UploadRing()
+{
+	if (m_buffer) m_buffer->Unmap(0, nullptr);
+}
+
+bool UploadRing::Init(ID3D12Device* device, UINT64 capacity)
+{
+	m_device = device;
+	CD3DX12_HEAP_PROPERTIES upHeap(D3D12_HEAP_TYPE_UPLOAD);
+	CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(capacity);
+	if (FAILED(device->CreateCommittedResource(&upHeap, D3D12_HEAP_FLAG_NONE, &desc,
+		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_buffer))))
+		return false;
+	m_buffer->SetName(L"UploadRing");
+	CD3DX12_RANGE noRead(0, 0);
+	if (FAILED(m_buffer->Map(0, &noRead, reinterpret_cast<void**>(&m_mapped))))
+	{
+		m_buffer.Reset();
+		return false;
+	}
+	m_allocator = UploadRingAllocator(capacity);
+	return true;
+}
+
+bool UploadRing::AllocateDedicated(ID3D12Device* device, UINT64 size, Allocation& out)
+{
+	out = Allocation();
+	CD3DX12_HEAP_PROPERTIES upHeap(D3D12_HEAP_TYPE_UPLOAD);
+	CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(size);
+	if (FAILED(device->CreateCommittedResource(&upHeap, D3D12_HEAP_FLAG_NONE, &desc,
+		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&out.m_resource))))
+		return false;
+	// Отдельный буфер пишется один раз, Unmap не нужен: он освобождается вместе с ресурсом
+	CD3DX12_RANGE noRead(0, 0);
+	if (FAILED(out.m_resource->Map(0, &noRead, reinterpret_cast<void**>(&out.m_cpu))))
+	{
+		out.m_resource.Reset();
+		out.m_cpu = nullptr;
+		return false;
+	}
+	out.m_dedicated = true;
+	return true;
+}
+
+bool UploadRing::Allocate(UINT64 size, UINT64 alignment, Allocation& out)
+{
+	out = Allocation();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint32_t id = 0;
+		const uint64_t offset = m_allocator.Allocate(size, alignment, id);
+		if (offset != UploadRingAllocator::InvalidOffset)
+		{
+			out.m_ring = this;
+			out.m_resource = m_buffer;
+			out.m_cpu = m_mapped + offset;
+			out.m_offset = offset;
+			out.m_id = id;
+			return true;
+		}
+		++m_dedicatedCount;
+		char buf[160];
+		sprintf_s(buf, "[UploadRing] %llu KB does not fit (%llu of %llu KB in flight), using a dedicated buffer\n",
+			size / 1024, m_allocator.GetUsed() / 1024, m_allocator.GetCapacity() / 1024);
+		OutputDebugStringA(buf);
+	}
+	if (!AllocateDedicated(m_device, size, out)) return false;
+	out.m_ring = this;
+	return true;
+}
+
+void UploadRing::Release(Allocation& allocation, uint64_t fence)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (allocation.m_dedicated)
+		m_dedicated.emplace_back(fence, std::move(allocation.m_resource));
+	else
+		m_allocator.Retire(allocation.m_id, fence);
+}
+
+void UploadRing::Reclaim(uint64_t completedFence)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_allocator.Reclaim(completedFence);
+	m_dedicated.erase(std::remove_if(m_dedicated.begin(), m_dedicated.end(),
+		[completedFence](const std::pair<uint64_t, ComPtr<ID3D12Resource>>& d) { return d.first <= completedFence; }),
+		m_dedicated.end());
+}
+
+UINT64 UploadRing::GetUsed() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_allocator.GetUsed();
+}
+
+uint32_t UploadRing::GetDedicatedCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_dedicatedCount;
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "UploadRingAllocator.h"
+using Microsoft::WRL::ComPtr;
+
+// Постоянно отображенный UPLOAD-буфер, через который идут копирования CPU -> GPU: геометрия
+// и текстуры копируются из него в DEFAULT-кучу. Allocate можно звать с любого потока.
+// Если кольцо занято или запрос больше кольца, выделяется отдельный буфер - загрузка не ждет GPU.
+class UploadRing
+{
+public:
+	class Allocation
+	{
+	public:
+		Allocation() = default;
+		Allocation(Allocation&& other) noexcept { *this = std::move(other); }
+		Allocation& operator=(Allocation&& other) noexcept;
+		Allocation(const Allocation&) = delete;
+		Allocation& operator=(const Allocation&) = delete;
+		// Неотправленное выделение освобождается при следующем Reclaim
+		~Allocation() { Retire(0); }
+
+		bool IsValid() const { return m_cpu != nullptr; }
+		uint8_t* GetCPU() const { return m_cpu; }
+		ID3D12Resource* GetResource() const { return m_resource.Get(); }
+		const ComPtr<ID3D12Resource>& GetResourcePtr() const { return m_resource; }
+		UINT64 GetOffset() const { return m_offset; }
+
+		// Копирование записано в список команд, после которого GPU выставит fence: память
+		// (или отдельный буфер) переиспользуется после UploadRing::Reclaim с пройденным fence
+		void Retire(uint64_t fence);
+
+	private:
+		friend class UploadRing;
+		// nullptr - отдельный буфер без кольца, его временем жизни управляет владелец ресурса
+		UploadRing* m_ring = nullptr;
+		ComPtr<ID3D12Resource> m_resource;
+		uint8_t* m_cpu = nullptr;
+		UINT64 m_offset = 0;
+		uint32_t m_id = 0;
+		bool m_dedicated = false;
+	};
+
+	UploadRing() = default;
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+	~UploadRing();
+
+	bool Init(ID3D12Device* device, UINT64 capacity);
+	// alignment - степень двойки (512 для текстур, 256 для константных буферов)
+	bool Allocate(UINT64 size, UINT64 alignment, Allocation& out);
+	// Только с потока, который отправляет списки команд
+	void Reclaim(uint64_t completedFence);
+
+	// Отдельный UPLOAD-буфер под одно выделение, без кольца
+	static bool AllocateDedicated(ID3D12Device* device, UINT64 size, Allocation& out);
+
+	UINT64 GetCapacity() const { return m_allocator.GetCapacity(); }
+	UINT64 GetUsed() const;
+	uint32_t GetDedicatedCount() const;
+
+private:
+	void Release(Allocation& allocation, uint64_t fence);
+
+	ID3D12Device* m_device = nullptr;
+	ComPtr<ID3D12Resource> m_buffer;
+	uint8_t* m_mapped = nullptr;
+	UploadRingAllocator m_allocator{ 0 };
+	// Отдельные буферы, которые ждут свой fence
+	std::vector<std::pair<uint64_t, ComPtr<ID3D12Resource>>> m_dedicated;
+	uint32_t m_dedicatedCount = 0;
+	mutable std::mutex m_mutex;
+};
\ No newline at end of file
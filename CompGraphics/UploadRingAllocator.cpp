@@ -0,0 +1,60 @@
+#include "UploadRingAllocator.h"
+
+void UploadRingAllocator::Push(uint64_t begin, uint64_t end, bool retired)
+{
+	m_blocks.push_back({ begin, end, 0, retired });
+	m_used += end - begin;
+	m_head = end == m_capacity ? 0 : end;
+}
+
+uint64_t UploadRingAllocator::Allocate(uint64_t size, uint64_t alignment, uint32_t& id)
+{
+	if (size == 0 || size > m_capacity) return InvalidOffset;
+	if (m_blocks.empty()) m_head = 0;
+
+	const uint64_t aligned = (m_head + alignment - 1) & ~(alignment - 1);
+	const uint64_t tail = m_blocks.empty() ? m_capacity : m_blocks.front().begin;
+	uint64_t begin = InvalidOffset;
+	if (m_blocks.empty() || m_head > tail)
+	{
+		// Свободно [head, capacity) и [0, tail)
+		if (aligned + size <= m_capacity)
+		{
+			begin = m_head;
+		}
+		else if (size <= tail)
+		{
+			// Хвост до конца кольца пропускаем отдельным блоком, он освободится в свою очередь
+			Push(m_head, m_capacity, true);
+			begin = 0;
+		}
+	}
+	else if (m_head < tail && aligned + size <= tail)
+	{
+		begin = m_head;
+	}
+	// head == tail при непустом кольце - кольцо заполнено
+	if (begin == InvalidOffset) return InvalidOffset;
+
+	const uint64_t offset = begin == 0 ? 0 : (begin + alignment - 1) & ~(alignment - 1);
+	id = m_firstId + (uint32_t)m_blocks.size();
+	Push(begin, offset + size, false);
+	return offset;
+}
+
+void UploadRingAllocator::Retire(uint32_t id, uint64_t fence)
+{
+	Block& block = m_blocks[id - m_firstId];
+	block.fence = fence;
+	block.retired = true;
+}
+
+void UploadRingAllocator::Reclaim(uint64_t completedFence)
+{
+	while (!m_blocks.empty() && m_blocks.front().retired && m_blocks.front().fence <= completedFence)
+	{
+		m_used -= m_blocks.front().end - m_blocks.front().begin;
+		m_blocks.pop_front();
+		++m_firstId;
+	}
+}
\ No newline at end of file
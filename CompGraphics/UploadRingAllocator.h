@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Логика кольцевого буфера загрузки без D3D: только смещения и значения fence, поэтому
+// выделение и освобождение можно проверять на CPU с имитацией fence.
+// Блоки выделяются подряд и освобождаются в том же порядке, когда пройден их fence.
+// Блок, который еще не отправлен (Retire не вызван), держит все следующие за ним.
+// Не потокобезопасен - синхронизирует UploadRing.
+class UploadRingAllocator
+{
+public:
+	static const uint64_t InvalidOffset = ~0ull;
+
+	explicit UploadRingAllocator(uint64_t capacity) : m_capacity(capacity) {}
+
+	// InvalidOffset - сейчас места нет (до Reclaim) или size больше кольца.
+	// alignment - степень двойки
+	uint64_t Allocate(uint64_t size, uint64_t alignment, uint32_t& id);
+	// Копирование из блока записано в список команд, после которого GPU выставит fence.
+	// Неиспользованный блок можно вернуть с fence 0
+	void Retire(uint32_t id, uint64_t fence);
+	// Освобождает блоки с начала кольца, пока их fence пройден
+	void Reclaim(uint64_t completedFence);
+
+	uint64_t GetCapacity() const { return m_capacity; }
+	// Занято вместе с выравниванием и хвостом, пропущенным при переходе через конец
+	uint64_t GetUsed() const { return m_used; }
+	size_t GetLiveBlocks() const { return m_blocks.size(); }
+
+private:
+	struct Block
+	{
+		uint64_t begin;
+		uint64_t end;
+		uint64_t fence;
+		bool retired;
+	};
+
+	void Push(uint64_t begin, uint64_t end, bool retired);
+
+	uint64_t m_capacity;
+	uint64_t m_head = 0;
+	uint64_t m_used = 0;
+	// Блоки по возрастанию id: id первого блока - m_firstId
+	std::deque<Block> m_blocks;
+	uint32_t m_firstId = 0;
+};
\ No newline at end of file
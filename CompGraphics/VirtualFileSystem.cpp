@@ -0,0 +1,248 @@
+#include "VirtualFileSystem.h"
+#include "AssetArchive.h"
+#include "AsyncFileReader.h"
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <fstream>
+#include <cstdio>
+#include <unordered_set>
+
+static const std::string kEmptyPath;
+
+VirtualFileSystem::VirtualFileSystem() = default;
+VirtualFileSystem::~VirtualFileSystem() = default;
+
+VirtualFileSystem::PathId VirtualFileSystem::Intern(const std::string& path)
+{
+	std::string key = Normalize(path);
+	auto it = m_ids.find(key);
+	if (it != m_ids.end()) return it->second;
+	PathId id = (PathId)m_paths.size();
+	m_paths.push_back(key);
+	m_ids.emplace(m_paths.back(), id);
+	return id;
+}
+
+VirtualFileSystem::PathId VirtualFileSystem::Find(const std::string& path) const
+{
+	auto it = m_ids.find(Normalize(path));
+	return it == m_ids.end() ? InvalidPath : it->second;
+}
+
+const std::string& VirtualFileSystem::GetPath(PathId id) const
+{
+	return id < m_paths.size() ? m_paths[id] : kEmptyPath;
+}
+
+void VirtualFileSystem::AddFile(const std::string& virtualPath, const std::string& diskPath, const AssetArchive* archive)
+{
+	PathId id = Intern(virtualPath);
+	auto existing = m_files.find(id);
+	if (existing == m_files.end())
+	{
+		PathId dir = Intern(DirOf(GetPath(id)));
+		m_directories[dir].push_back(id);
+	}
+	FileEntry& entry = m_files[id];
+	if (!archive) entry.diskPath = diskPath;
+	entry.archive = archive;
+}
+
+void VirtualFileSystem::ScanDirectory(const std::string& diskDir, const std::string& virtualDir)
+{
+	WIN32_FIND_DATAA fd;
+	HANDLE h = FindFirstFileA((diskDir + "/*").c_str(), &fd);
+	if (h == INVALID_HANDLE_VALUE) return;
+	do
+	{
+		// "." и "..", а также служебные каталоги вроде .vs и .git
+		if (fd.cFileName[0] == '.') continue;
+		std::string disk = diskDir + "/" + fd.cFileName;
+		std::string virt = virtualDir.empty() ? std::string(fd.cFileName) : virtualDir + "/" + fd.cFileName;
+		if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ScanDirectory(disk, virt);
+		else AddFile(virt, disk, nullptr);
+	} while (FindNextFileA(h, &fd));
+	FindClose(h);
+}
+
+bool VirtualFileSystem::MountDirectory(const std::string& directory, const std::string& mountPoint)
+{
+	DWORD attr = GetFileAttributesA(directory.c_str());
+	if (attr == INVALID_FILE_ATTRIBUTES || !(attr & FILE_ATTRIBUTE_DIRECTORY)) return false;
+
+	size_t before = m_files.size();
+	std::string diskDir = directory;
+	while (diskDir.size() > 1 && (diskDir.back() == '/' || diskDir.back() == '\\')) diskDir.pop_back();
+	ScanDirectory(diskDir, Normalize(mountPoint));
+
+	char msg[512];
+	sprintf_s(msg, "[VFS] Mounted directory %s at '%s': %zu new files\n", directory.c_str(), mountPoint.c_str(), m_files.size() - before);
+	OutputDebugStringA(msg);
+	return true;
+}
+
+bool VirtualFileSystem::MountArchive(const std::string& path)
+{
+	std::unique_ptr<AssetArchive> archive(new AssetArchive());
+	if (!archive->Open(path)) return false;
+
+	// Ассет, исходный файл которого в уже смонтированном каталоге отличается от собранного,
+	// берется с диска целиком: все его записи пропускаются
+	char msg[512];
+	std::unordered_set<std::string> stale;
+	for (uint32_t i = 0; i < archive->GetEntryCount(); ++i)
+	{
+		const std::string name = archive->GetEntryName(i);
+		const AssetSourceStamp cooked = archive->GetEntrySource(i);
+		const FileEntry* loose = FindEntry(AssetArchive::SourceOf(name));
+		if (cooked.time == 0 || !loose || loose->diskPath.empty()) continue;
+		AssetSourceStamp current;
+		if (AssetArchive::StampFile(loose->diskPath, current) && current == cooked) continue;
+		if (!stale.insert(AssetArchive::AssetOf(name)).second) continue;
+		sprintf_s(msg, "[VFS] %s: %s changed since cooking, using loose files\n", path.c_str(), loose->diskPath.c_str());
+		OutputDebugStringA(msg);
+	}
+	for (uint32_t i = 0; i < archive->GetEntryCount(); ++i)
+	{
+		const std::string name = archive->GetEntryName(i);
+		if (archive->GetEntryType(i) == AssetBlobType::Source || stale.count(AssetArchive::AssetOf(name))) continue;
+		AddFile(name, std::string(), archive.get());
+	}
+
+	sprintf_s(msg, "[VFS] Mounted archive %s: %u entries, %zu stale assets\n", path.c_str(), archive->GetEntryCount(), stale.size());
+	OutputDebugStringA(msg);
+	m_archives.push_back(std::move(archive));
+	return true;
+}
+
+const VirtualFileSystem::FileEntry* VirtualFileSystem::FindEntry(const std::string& path) const
+{
+	PathId id = Find(path);
+	if (id == InvalidPath) return nullptr;
+	auto it = m_files.find(id);
+	return it == m_files.end() ? nullptr : &it->second;
+}
+
+bool VirtualFileSystem::Exists(const std::string& path) const
+{
+	return FindEntry(path) != nullptr;
+}
+
+bool VirtualFileSystem::FindFirst(const std::vector<std::string>& candidates, std::string& resolved) const
+{
+	for (const std::string& c : candidates)
+	{
+		if (!Exists(c)) continue;
+		resolved = Normalize(c);
+		return true;
+	}
+	return false;
+}
+
+bool VirtualFileSystem::FindWithExtensions(const std::string& path, const std::vector<std::string>& extensions, std::string& resolved) const
+{
+	if (Exists(path))
+	{
+		resolved = Normalize(path);
+		return true;
+	}
+	std::string base = Normalize(path);
+	size_t slash = base.find_last_of('/');
+	size_t dot = base.find_last_of('.');
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) base.resize(dot);
+	for (const std::string& ext : extensions)
+	{
+		if (!Exists(base + ext)) continue;
+		resolved = Normalize(base + ext);
+		return true;
+	}
+	return false;
+}
+
+std::vector<std::string> VirtualFileSystem::ListDirectory(const std::string& directory) const
+{
+	std::vector<std::string> out;
+	PathId dir = Find(directory);
+	if (dir == InvalidPath) return out;
+	auto it = m_directories.find(dir);
+	if (it == m_directories.end()) return out;
+	for (PathId id : it->second) out.push_back(GetPath(id));
+	return out;
+}
+
+bool VirtualFileSystem::FindInDirectory(const std::string& directory, const std::string& nameContains, std::string& resolved) const
+{
+	std::string needle = Normalize(nameContains);
+	for (const std::string& path : ListDirectory(directory))
+	{
+		if (FileNameOf(path).find(needle) == std::string::npos) continue;
+		resolved = path;
+		return true;
+	}
+	return false;
+}
+
+bool VirtualFileSystem::FromArchive(const FileEntry& e, bool preferLoose)
+{
+	return e.archive && !(preferLoose && !e.diskPath.empty());
+}
+
+const AssetArchive* VirtualFileSystem::FindArchive(const std::string& path, bool preferLoose) const
+{
+	const FileEntry* e = FindEntry(path);
+	return e && FromArchive(*e, preferLoose) ? e->archive : nullptr;
+}
+
+bool VirtualFileSystem::HasLooseFile(const std::string& path) const
+{
+	const FileEntry* e = FindEntry(path);
+	return e && !e->diskPath.empty();
+}
+
+std::string VirtualFileSystem::GetDiskPath(const std::string& path) const
+{
+	const FileEntry* e = FindEntry(path);
+	return e && !e->archive ? e->diskPath : std::string();
+}
+
+bool VirtualFileSystem::ReadFile(const std::string& path, std::vector<uint8_t>& bytes, bool preferLoose) const
+{
+	const FileEntry* e = FindEntry(path);
+	if (!e) return false;
+	if (FromArchive(*e, preferLoose))
+	{
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		if (!e->archive->Find(path, data, size)) return false;
+		bytes.assign(data, data + size);
+		return true;
+	}
+	std::ifstream f(e->diskPath, std::ios::binary | std::ios::ate);
+	if (!f.is_open()) return false;
+	std::streamsize size = f.tellg();
+	if (size < 0) return false;
+	bytes.resize((size_t)size);
+	f.seekg(0);
+	return size == 0 || (bool)f.read(reinterpret_cast<char*>(bytes.data()), size);
+}
+
+void VirtualFileSystem::ReadFiles(const std::vector<std::string>& paths, const ReadCallback& onRead, bool preferLoose) const
+{
+	AsyncFileReader reader;
+	std::vector<size_t> requestPath;
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		const FileEntry* e = FindEntry(paths[i]);
+		if (e && !FromArchive(*e, preferLoose))
+		{
+			reader.Submit(e->diskPath);
+			requestPath.push_back(i);
+			continue;
+		}
+		std::vector<uint8_t> bytes;
+		bool ok = e && ReadFile(paths[i], bytes, preferLoose);
+		onRead(i, ok, bytes);
+	}
+	AsyncFileReader::Result r;
+	while (reader.WaitNext(r)) onRead(requestPath[r.index], r.ok, r.bytes);
+}
\ No newline at end of file
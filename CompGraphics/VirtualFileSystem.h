@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class AssetArchive;
+
+// Виртуальная файловая система: каталоги и архивы индексируются один раз при монтировании,
+// дальше поиск файла - нормализация строки и обращение к хеш-таблице, без системных вызовов.
+// Пути нормализуются (прямые слэши, нижний регистр, без "." и "..") и интернируются.
+// Более позднее монтирование перекрывает файлы с тем же путем из более раннего.
+// Перекрытый архивом файл каталога запоминается: его читают перезагрузки с preferLoose.
+class VirtualFileSystem
+{
+public:
+	using PathId = uint32_t;
+	static const PathId InvalidPath = 0xFFFFFFFFu;
+
+	VirtualFileSystem();
+	~VirtualFileSystem();
+	VirtualFileSystem(const VirtualFileSystem&) = delete;
+	VirtualFileSystem& operator=(const VirtualFileSystem&) = delete;
+
+	// Рекурсивно обходит каталог на диске; файлы видны как mountPoint + относительный путь
+	bool MountDirectory(const std::string& directory, const std::string& mountPoint = "");
+	// Архив AssetCooker монтируется в корень: имена его записей уже нормализованы. Ассеты, чьи
+	// исходные файлы в смонтированных раньше каталогах изменились после сборки, не подключаются
+	bool MountArchive(const std::string& path);
+
+	PathId Intern(const std::string& path);
+	PathId Find(const std::string& path) const;
+	const std::string& GetPath(PathId id) const;
+
+	bool Exists(const std::string& path) const;
+	// Первый существующий путь из списка
+	bool FindFirst(const std::vector<std::string>& candidates, std::string& resolved) const;
+	// Точное совпадение, иначе тот же путь с одним из расширений (заменяя исходное)
+	bool FindWithExtensions(const std::string& path, const std::vector<std::string>& extensions, std::string& resolved) const;
+	// Первый файл каталога, в имени которого есть подстрока (без учета регистра)
+	bool FindInDirectory(const std::string& directory, const std::string& nameContains, std::string& resolved) const;
+	std::vector<std::string> ListDirectory(const std::string& directory) const;
+
+	// preferLoose - файл каталога, даже если архив его перекрывает (правка поверх собранного архива)
+	bool ReadFile(const std::string& path, std::vector<uint8_t>& bytes, bool preferLoose = false) const;
+	// Пачка файлов: с диска все запросы ставятся сразу через AsyncFileReader, из архива - копия.
+	// onRead вызывается на этом же потоке по мере готовности, порядок не гарантирован
+	using ReadCallback = std::function<void(size_t index, bool ok, std::vector<uint8_t>& bytes)>;
+	void ReadFiles(const std::vector<std::string>& paths, const ReadCallback& onRead, bool preferLoose = false) const;
+	// Архив, из которого виден файл, или nullptr, если он лежит на диске
+	// (или при preferLoose есть перекрытый файл каталога)
+	const AssetArchive* FindArchive(const std::string& path, bool preferLoose = false) const;
+	// Файл с этим путем есть в смонтированном каталоге, перекрыт он архивом или нет
+	bool HasLooseFile(const std::string& path) const;
+	// Путь на диске для API, которым нужно имя файла; пустая строка для файлов из архива
+	std::string GetDiskPath(const std::string& path) const;
+
+	size_t GetFileCount() const { return m_files.size(); }
+
+	static std::string Normalize(const std::string& path);
+	static std::string DirOf(const std::string& path);
+	static std::string FileNameOf(const std::string& path);
+	static std::string StemOf(const std::string& path);
+	static std::string Join(const std::string& directory, const std::string& relative);
+
+private:
+	struct FileEntry
+	{
+		// При archive - перекрытый файл каталога, если он был
+		std::string diskPath;
+		const AssetArchive* archive = nullptr;
+	};
+
+	void AddFile(const std::string& virtualPath, const std::string& diskPath, const AssetArchive* archive);
+	void ScanDirectory(const std::string& diskDir, const std::string& virtualDir);
+	const FileEntry* FindEntry(const std::string& path) const;
+	static bool FromArchive(const FileEntry& e, bool preferLoose);
+
+	std::unordered_map<std::string, PathId> m_ids;
+	std::vector<std::string> m_paths;
+	std::unordered_map<PathId, FileEntry> m_files;
+	std::unordered_map<PathId, std::vector<PathId>> m_directories;
+	std::vector<std::unique_ptr<AssetArchive>> m_archives;
+};
\ No newline at end of file
@@ -0,0 +1,56 @@
+// Строковые операции над путями VFS. Отдельно от VirtualFileSystem.cpp и без Win32:
+// ими собирает пути ObjLoader, в том числе в безголовых сборках без файловой системы VFS
+#include "VirtualFileSystem.h"
+#include <cctype>
+
+std::string VirtualFileSystem::Normalize(const std::string& path)
+{
+	std::vector<std::string> parts;
+	std::string part;
+	auto flush = [&]() {
+		if (part.empty() || part == ".") {}
+		else if (part == ".." && !parts.empty() && parts.back() != "..") parts.pop_back();
+		else parts.push_back(part);
+		part.clear();
+		};
+	for (char c : path)
+	{
+		if (c == '/' || c == '\\') flush();
+		else part.push_back((char)tolower((unsigned char)c));
+	}
+	flush();
+
+	std::string out = (!path.empty() && (path[0] == '/' || path[0] == '\\')) ? "/" : "";
+	for (size_t i = 0; i < parts.size(); ++i)
+	{
+		if (i) out.push_back('/');
+		out += parts[i];
+	}
+	return out;
+}
+
+std::string VirtualFileSystem::DirOf(const std::string& path)
+{
+	size_t p = path.find_last_of("/\\");
+	return (p == std::string::npos) ? "" : path.substr(0, p + 1);
+}
+
+std::string VirtualFileSystem::FileNameOf(const std::string& path)
+{
+	size_t p = path.find_last_of("/\\");
+	return (p == std::string::npos) ? path : path.substr(p + 1);
+}
+
+std::string VirtualFileSystem::StemOf(const std::string& path)
+{
+	std::string name = FileNameOf(path);
+	size_t dot = name.find_last_of('.');
+	return (dot == std::string::npos) ? name : name.substr(0, dot);
+}
+
+std::string VirtualFileSystem::Join(const std::string& directory, const std::string& relative)
+{
+	bool absolute = !relative.empty() && (relative[0] == '/' || relative[0] == '\\' || relative.find(':') != std::string::npos);
+	if (absolute || directory.empty()) return Normalize(relative);
+	return Normalize(directory + "/" + relative);
+}
\ No newline at end of file
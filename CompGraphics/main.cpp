@@ -2,6 +2,9 @@
 #include "RenderingSystem.h"
 #include "Timer.h"
 #include "InputDevice.h"
+#include "InputRecording.h"
+#include <cstdio>
+#include <cstring>
 
 class App
 {
@@ -15,25 +18,35 @@ public:
             m_renderingSystem.OnResize(w, h);
             });
 
+        // Архив собирается AssetCooker; ключ -loose грузит исходные файлы для сравнения.
+        // Загрузка фоновая и начинается сразу после создания устройства, параллельно с
+        // компиляцией шейдеров; окно рисует кадры, пока сцена и пень не станут резидентными
+        QueryPerformanceFrequency(&m_freq);
+        QueryPerformanceCounter(&m_loadStart);
+        m_renderingSystem.MountDirectory(".");
+        m_fromArchive = strstr(GetCommandLineA(), "-loose") == nullptr &&
+            m_renderingSystem.MountArchive("sponza.pak");
+        // Правки файлов, не упакованных в архив, подхватываются без перезапуска
+        m_renderingSystem.EnableHotReload();
+
         if (!m_renderingSystem.Init(m_window.GetHWND(),
             m_window.GetWidth(),
-            m_window.GetHeight()))
+            m_window.GetHeight(),
+            [this]() {
+                m_sceneLoad = m_renderingSystem.LoadObjAsync("sponza.obj");
+                m_stumpLoad = m_renderingSystem.LoadStumpAsync("broken_stump.obj");
+            }))
             return false;
 
+        // -record flight.txt: ввод каждого кадра пишется в файл при выходе, его проигрывает FrameBenchmark
+        if (const char* record = strstr(GetCommandLineA(), "-record "))
+        {
+            char path[MAX_PATH] = {};
+            if (sscanf_s(record + 8, "%259s", path, (unsigned)sizeof(path)) == 1) m_recordPath = path;
+        }
+
         m_renderingSystem.SetTexTiling(2.0f, 2.0f);
         m_renderingSystem.SetTexScroll(0.05f, 0.0f);
-        m_renderingSystem.LoadObj("sponza.obj");
-
-        OutputDebugStringA("=========================\n");
-        OutputDebugStringA("Attempting to load Stump...\n");
-        bool stumpLoaded = m_renderingSystem.LoadStump("broken_stump.obj");
-        if (stumpLoaded) {
-            OutputDebugStringA("Stump LoadObj returned SUCCESS\n");
-        }
-        else {
-            OutputDebugStringA("Stump LoadObj returned FAILED\n");
-        }
-        OutputDebugStringA("=========================\n");
         AddTestLights();
 
         m_timer.Reset();
@@ -54,7 +67,10 @@ public:
             while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
             {
                 if (msg.message == WM_QUIT)
+                {
+                    SaveRecording();
                     return (int)msg.wParam;
+                }
 
                 switch (msg.message)
                 {
@@ -72,22 +88,59 @@ public:
             }
 
             m_timer.Tick();
+            if (!m_recordPath.empty()) m_recording.Add(m_timer.DeltaTime(), m_input);
             m_renderingSystem.UpdateCamera(m_timer.DeltaTime(), m_input);
 
             const float clear[] = { 0.1f, 0.1f, 0.15f, 1.0f };
             m_renderingSystem.BeginFrame(clear);
             m_renderingSystem.DrawScene(m_timer.TotalTime(), m_timer.DeltaTime());
             m_renderingSystem.EndFrame();
+            ReportLoading();
 
             m_input.EndFrame();
         }
     }
 
 private:
+    void SaveRecording()
+    {
+        if (m_recordPath.empty()) return;
+        char msg[MAX_PATH + 64];
+        sprintf_s(msg, "[Record] %zu frames %s %s\n", m_recording.GetFrameCount(),
+            m_recording.Save(m_recordPath) ? "saved to" : "FAILED to save to", m_recordPath.c_str());
+        OutputDebugStringA(msg);
+    }
+
+    void ReportLoading()
+    {
+        if (m_loadReported) return;
+        ++m_framesWhileLoading;
+        if (!m_sceneLoad.IsFinished() || !m_stumpLoad.IsFinished()) return;
+        m_loadReported = true;
+
+        OutputDebugStringA(m_stumpLoad.IsResident() ? "Stump load SUCCESS\n" : "Stump load FAILED\n");
+        LARGE_INTEGER loadEnd;
+        QueryPerformanceCounter(&loadEnd);
+        char msg[160];
+        sprintf_s(msg, "[Startup] Assets from %s: %.1f ms, %u frames rendered while loading\n",
+            m_fromArchive ? "sponza.pak" : "loose files",
+            (loadEnd.QuadPart - m_loadStart.QuadPart) * 1000.0 / m_freq.QuadPart, m_framesWhileLoading);
+        OutputDebugStringA(msg);
+    }
+
     Window m_window;
     RenderingSystem m_renderingSystem;
     Timer m_timer;
     InputDevice m_input;
+    InputRecording m_recording;
+    std::string m_recordPath;
+    AsyncLoadHandle m_sceneLoad;
+    AsyncLoadHandle m_stumpLoad;
+    LARGE_INTEGER m_freq{};
+    LARGE_INTEGER m_loadStart{};
+    bool m_fromArchive = false;
+    bool m_loadReported = false;
+    unsigned m_framesWhileLoading = 0;
 };
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
@@ -12,6 +12,7 @@
 #include <map>
 #include "Material.h"
 #include "TextureLoader.h"
+#include "VirtualFileSystem.h"
 
 using namespace DirectX;
 
@@ -50,7 +51,8 @@ struct OBJMesh {
 
 class OBJLoader {
 public:
-    static bool LoadOBJ32(const std::string& filename,
+    static bool LoadOBJ32(const VirtualFileSystem& vfs,
+        const std::string& filename,
         std::vector<OBJVertex>& outVertices,
         std::vector<UINT>& outIndices,
         std::vector<Material*>& outMaterials,
@@ -61,7 +63,7 @@ public:
         std::cout << "\n=== OBJLoader Debug ===" << std::endl;
         std::cout << "Loading file: " << filename << std::endl;
 
-        std::ifstream file(filename);
+        std::ifstream file(vfs.Resolve(filename));
         if (!file.is_open()) {
             std::cerr << "ERROR: Cannot open file: " << filename << std::endl;
             return false;
@@ -107,8 +109,8 @@ public:
             }
             else if (prefix == "mtllib") {
                 iss >> mtlFilename;
-                std::string mtlPath = GetDirectoryPath(filename) + mtlFilename;
-                LoadMaterials(mtlPath, materialMap, device);
+                std::string mtlPath = VirtualFileSystem::Join(VirtualFileSystem::DirOf(filename), mtlFilename);
+                LoadMaterials(vfs, mtlPath, materialMap, device);
             }
             else if (prefix == "usemtl") {
                 if (!currentMesh.vertices.empty()) {
@@ -205,20 +207,13 @@ public:
     }
 
 private:
-    static std::string GetDirectoryPath(const std::string& filename) {
-        size_t pos = filename.find_last_of("/\\");
-        if (pos != std::string::npos) {
-            return filename.substr(0, pos + 1);
-        }
-        return "";
-    }
-
-    static void LoadMaterials(const std::string& filename,
+    static void LoadMaterials(const VirtualFileSystem& vfs,
+        const std::string& filename,
         std::map<std::string, Material*>& materialMap,
         ID3D11Device* device) {
         std::cout << "Loading MTL file: " << filename << std::endl;
 
-        std::ifstream file(filename);
+        std::ifstream file(vfs.Resolve(filename));
         if (!file.is_open()) {
             std::cerr << "Failed to open MTL file: " << filename << std::endl;
             return;
@@ -268,34 +263,21 @@ private:
                     std::string texFile;
                     iss >> texFile;
 
-                    std::string basePath = GetDirectoryPath(filename);
-                    std::string texPath = basePath + texFile;
-
-                    std::vector<std::string> extensions = { ".tga", ".png", ".jpg", ".jpeg", ".bmp" };
-                    bool loaded = false;
-
-                    for (const auto& ext : extensions) {
-                        std::string testPath = texPath;
-                        if (testPath.find(ext) == std::string::npos) {
-                            testPath = texPath + ext;
-                        }
+                    std::string texPath = VirtualFileSystem::Join(VirtualFileSystem::DirOf(filename), texFile);
 
-                        DWORD fileAttr = GetFileAttributesA(testPath.c_str());
-                        if (fileAttr != INVALID_FILE_ATTRIBUTES) {
-                            currentMaterial->diffuseTexture = TextureLoader::CreateTextureFromFile(device, testPath);
-                            if (currentMaterial->diffuseTexture) {
-                                std::cout << "    Loaded diffuse texture: " << texFile << ext << std::endl;
-                                loaded = true;
-                                break;
-                            }
+                    // Расширение в MTL не всегда совпадает с файлом на диске - подбираем по индексу VFS
+                    static const std::vector<std::string> extensions = { ".tga", ".png", ".jpg", ".jpeg", ".bmp" };
+                    std::string resolved;
+                    if (vfs.FindWithExtensions(texPath, extensions, resolved)) {
+                        currentMaterial->diffuseTexture = TextureLoader::CreateTextureFromFile(device, vfs.Resolve(resolved));
+                        if (currentMaterial->diffuseTexture) {
+                            std::cout << "    Loaded diffuse texture: " << resolved << std::endl;
                         }
                     }
-
-                    if (!loaded) {
+                    else {
+                        // Загрузчик сам подставит текстуру по умолчанию
+                        std::cout << "    Diffuse texture not found: " << texPath << std::endl;
                         currentMaterial->diffuseTexture = TextureLoader::CreateTextureFromFile(device, texPath);
-                        if (currentMaterial->diffuseTexture) {
-                            std::cout << "    Loaded diffuse texture: " << texFile << std::endl;
-                        }
                     }
                 }
             }
@@ -8,6 +8,19 @@
 #include <fstream>
 #include <iostream>
 #include <wincodec.h>  
+#include <algorithm>
+#include <cstdint>
+#ifdef TGA_LOADER_BENCHMARK
+#include <chrono>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define TGA_LOADER_SIMD 1
+#include <intrin.h>
+#include <tmmintrin.h>
+#else
+#define TGA_LOADER_SIMD 0
+#endif
 
 #pragma comment(lib, "windowscodecs.lib")
 
@@ -17,55 +30,25 @@ public:
     static ID3D11ShaderResourceView* CreateTGATexture(ID3D11Device* device, const std::string& filename) {
         std::cout << "  Loading TGA texture: " << filename << std::endl;
 
-        FILE* file = nullptr;
-        fopen_s(&file, filename.c_str(), "rb");
-        if (!file) {
+        MappedFile file;
+        if (!file.Open(filename)) {
             std::cerr << "  Failed to open TGA file" << std::endl;
             return CreateDefaultTexture(device, "default");
         }
 
-        unsigned char header[18];
-        fread(header, 1, 18, file);
-
-        int width = header[12] + header[13] * 256;
-        int height = header[14] + header[15] * 256;
-        int bpp = header[16]; 
-
-        std::cout << "  TGA size: " << width << "x" << height << ", " << bpp << "bpp" << std::endl;
-
-        if (width <= 0 || height <= 0 || width > 8192 || height > 8192) {
-            std::cerr << "  Invalid TGA dimensions" << std::endl;
-            fclose(file);
+        int width = 0, height = 0;
+        std::vector<uint32_t> pixels;
+        if (!DecodeTGA(file.data, file.size, pixels, width, height)) {
+            std::cerr << "  Unsupported or corrupted TGA file" << std::endl;
             return CreateDefaultTexture(device, "default");
         }
 
-        int imageSize = width * height * (bpp / 8);
-        std::vector<unsigned char> imageData(imageSize);
-        fread(imageData.data(), 1, imageSize, file);
-        fclose(file);
-
-        std::vector<uint32_t> pixels(width * height);
-
-        for (int i = 0; i < width * height; i++) {
-            unsigned char r, g, b, a = 255;
-
-            if (bpp == 24) {
-                b = imageData[i * 3 + 0];
-                g = imageData[i * 3 + 1];
-                r = imageData[i * 3 + 2];
-            }
-            else if (bpp == 32) {
-                b = imageData[i * 4 + 0];
-                g = imageData[i * 4 + 1];
-                r = imageData[i * 4 + 2];
-                a = imageData[i * 4 + 3];
-            }
-            else {
-                continue;
-            }
+        std::cout << "  TGA size: " << width << "x" << height << ", " << (int)file.data[16] << "bpp"
+            << ((file.data[2] & 8) ? ", RLE" : "") << std::endl;
 
-            pixels[i] = (a << 24) | (r << 16) | (g << 8) | b;
-        }
+#ifdef TGA_LOADER_BENCHMARK
+        BenchmarkTGA(file.data, file.size);
+#endif
 
         D3D11_TEXTURE2D_DESC texDesc = {};
         texDesc.Width = width;
@@ -101,16 +84,90 @@ public:
         return textureView;
     }
 
+    // Типы 2/3 (без сжатия) и 10/11 (RLE), 8/24/32 бит, любой угол начала координат.
+    // Результат - RGBA8 строками сверху вниз, как ждет DXGI_FORMAT_R8G8B8A8_UNORM
+    static bool DecodeTGA(const uint8_t* file, size_t size, std::vector<uint32_t>& pixels, int& width, int& height) {
+        if (!file || size < 18) return false;
+
+        const int idLength = file[0];
+        const int colorMapType = file[1];
+        const int imageType = file[2];
+        const int colorMapLength = file[5] | (file[6] << 8);
+        const int colorMapBits = file[7];
+        width = file[12] | (file[13] << 8);
+        height = file[14] | (file[15] << 8);
+        const int bpp = file[16];
+        const int descriptor = file[17];
+
+        const bool rle = (imageType & 8) != 0;
+        const bool gray = (imageType & ~8) == 3;
+        if ((imageType & ~8) != 2 && !gray) return false;
+        if (gray ? bpp != 8 : (bpp != 24 && bpp != 32)) return false;
+        if (width <= 0 || height <= 0 || width > 8192 || height > 8192) return false;
+
+        size_t offset = 18 + idLength;
+        if (colorMapType == 1) offset += (size_t)colorMapLength * ((colorMapBits + 7) / 8);
+        if (offset > size) return false;
+
+        const uint8_t* src = file + offset;
+        const uint8_t* srcEnd = file + size;
+        const int bytesPerPixel = bpp / 8;
+        const bool topDown = (descriptor & 0x20) != 0;
+        const bool rightToLeft = (descriptor & 0x10) != 0;
+
+        pixels.resize((size_t)width * height);
+        auto dstRow = [&](int y) { return pixels.data() + (size_t)(topDown ? y : height - 1 - y) * width; };
+
+        if (!rle) {
+            if ((size_t)(srcEnd - src) < (size_t)width * height * bytesPerPixel) return false;
+            for (int y = 0; y < height; ++y) {
+                ConvertTGAPixels(src, dstRow(y), width, bytesPerPixel);
+                src += (size_t)width * bytesPerPixel;
+            }
+        }
+        else {
+            // Пакеты могут переходить через границу строки, поэтому режем их по строкам
+            int x = 0, y = 0;
+            while (y < height) {
+                if (src >= srcEnd) return false;
+                const uint8_t packet = *src++;
+                int count = (packet & 0x7F) + 1;
+                const bool run = (packet & 0x80) != 0;
+                if ((size_t)(srcEnd - src) < (size_t)(run ? 1 : count) * bytesPerPixel) return false;
+
+                uint32_t value = 0;
+                if (run) ConvertTGAPixels(src, &value, 1, bytesPerPixel);
+                while (count > 0 && y < height) {
+                    const int n = count < width - x ? count : width - x;
+                    uint32_t* dst = dstRow(y) + x;
+                    if (run) {
+                        std::fill(dst, dst + n, value);
+                    }
+                    else {
+                        ConvertTGAPixels(src, dst, n, bytesPerPixel);
+                        src += (size_t)n * bytesPerPixel;
+                    }
+                    count -= n;
+                    x += n;
+                    if (x == width) { x = 0; ++y; }
+                }
+                if (run) src += bytesPerPixel;
+            }
+        }
+
+        if (rightToLeft) {
+            for (int y = 0; y < height; ++y) std::reverse(dstRow(y), dstRow(y) + width);
+        }
+        return true;
+    }
+
     static ID3D11ShaderResourceView* CreateTextureFromFile(ID3D11Device* device, const std::string& filename) {
         if (!device) return nullptr;
 
         std::cout << "Loading texture: " << filename << std::endl;
 
-        DWORD fileAttr = GetFileAttributesA(filename.c_str());
-        if (fileAttr == INVALID_FILE_ATTRIBUTES) {
-            std::cout << "  Texture file not found" << std::endl;
-            return CreateDefaultTexture(device, "default");
-        }
+        // Существование файла проверяет вызывающий по индексу VirtualFileSystem;
+        // если файла все же нет, загрузчики ниже вернут текстуру по умолчанию
 
         size_t dotPos = filename.find_last_of('.');
         if (dotPos == std::string::npos) {
@@ -132,6 +189,153 @@ public:
     }
 
 private:
+    // Файл, отображенный в память только для чтения
+    struct MappedFile {
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile() {
+            if (data) UnmapViewOfFile(data);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        }
+
+        bool Open(const std::string& path) {
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER fileSize = {};
+            if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return false;
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping) return false;
+            data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            size = (size_t)fileSize.QuadPart;
+            return data != nullptr;
+        }
+    };
+
+    static bool HasSSSE3() {
+#if TGA_LOADER_SIMD
+        static const bool supported = [] {
+            int info[4] = {};
+            __cpuid(info, 1);
+            return (info[2] & (1 << 9)) != 0;
+        }();
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    // BGR/BGRA/серый -> RGBA. 24 бит: pshufb по 4 пикселя (12 байт) за итерацию,
+    // 32 бит: обмен R и B масками SSE2
+    static void ConvertTGAPixels(const uint8_t* src, uint32_t* dst, int count, int bytesPerPixel) {
+        int i = 0;
+        uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+#if TGA_LOADER_SIMD
+        if (bytesPerPixel == 4) {
+            const __m128i maskGA = _mm_set1_epi32((int)0xFF00FF00);
+            const __m128i maskB = _mm_set1_epi32(0x000000FF);
+            for (; i + 4 <= count; i += 4) {
+                __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+                __m128i ga = _mm_and_si128(p, maskGA);
+                __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), maskB);
+                __m128i b = _mm_slli_epi32(_mm_and_si128(p, maskB), 16);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), _mm_or_si128(ga, _mm_or_si128(r, b)));
+            }
+        }
+        else if (bytesPerPixel == 3 && HasSSSE3()) {
+            const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+            const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+            // Загружаем 16 байт, а используем 12 - последние пиксели добираем скалярно
+            for (; i + 6 <= count; i += 4) {
+                __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), _mm_or_si128(_mm_shuffle_epi8(p, shuffle), alpha));
+            }
+        }
+        else if (bytesPerPixel == 1) {
+            const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+            for (; i + 16 <= count; i += 16) {
+                __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m128i gg = _mm_unpacklo_epi8(g, g);
+                __m128i gg2 = _mm_unpackhi_epi8(g, g);
+                __m128i p0 = _mm_or_si128(_mm_unpacklo_epi16(gg, gg), alpha);
+                __m128i p1 = _mm_or_si128(_mm_unpackhi_epi16(gg, gg), alpha);
+                __m128i p2 = _mm_or_si128(_mm_unpacklo_epi16(gg2, gg2), alpha);
+                __m128i p3 = _mm_or_si128(_mm_unpackhi_epi16(gg2, gg2), alpha);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), p0);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4 + 16), p1);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4 + 32), p2);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4 + 48), p3);
+            }
+        }
+#endif
+        for (; i < count; ++i) {
+            const uint8_t* p = src + (size_t)i * bytesPerPixel;
+            uint8_t* o = out + (size_t)i * 4;
+            if (bytesPerPixel == 1) {
+                o[0] = o[1] = o[2] = p[0];
+                o[3] = 255;
+            }
+            else {
+                o[0] = p[2];
+                o[1] = p[1];
+                o[2] = p[0];
+                o[3] = bytesPerPixel == 4 ? p[3] : 255;
+            }
+        }
+    }
+
+#ifdef TGA_LOADER_BENCHMARK
+    // Сравнение с прежним побайтовым циклом (fread в вектор + сборка uint32 по пикселю).
+    // Прежний цикл не понимает RLE, для таких файлов меряется только новый путь
+    static void BenchmarkTGA(const uint8_t* file, size_t size) {
+        const int iterations = 10;
+        int width = 0, height = 0;
+        std::vector<uint32_t> pixels;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int it = 0; it < iterations; ++it) DecodeTGA(file, size, pixels, width, height);
+        double fastMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+        double legacyMs = 0.0;
+        const int bpp = file[16];
+        if (!(file[2] & 8) && (bpp == 24 || bpp == 32) && size >= 18 + (size_t)width * height * (bpp / 8)) {
+            start = std::chrono::high_resolution_clock::now();
+            for (int it = 0; it < iterations; ++it) {
+                int imageSize = width * height * (bpp / 8);
+                std::vector<unsigned char> imageData(file + 18, file + 18 + imageSize);
+                std::vector<uint32_t> legacy(width * height);
+                for (int i = 0; i < width * height; i++) {
+                    unsigned char r, g, b, a = 255;
+                    if (bpp == 24) {
+                        b = imageData[i * 3 + 0];
+                        g = imageData[i * 3 + 1];
+                        r = imageData[i * 3 + 2];
+                    }
+                    else {
+                        b = imageData[i * 4 + 0];
+                        g = imageData[i * 4 + 1];
+                        r = imageData[i * 4 + 2];
+                        a = imageData[i * 4 + 3];
+                    }
+                    legacy[i] = (a << 24) | (r << 16) | (g << 8) | b;
+                }
+            }
+            legacyMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+        }
+
+        std::cout << "  [TGA bench] " << width << "x" << height << " fast: " << fastMs << " ms";
+        if (legacyMs > 0.0) std::cout << ", legacy loop: " << legacyMs << " ms, x" << legacyMs / fastMs;
+        std::cout << std::endl;
+    }
+#endif
+
     static ID3D11ShaderResourceView* CreateDefaultTexture(ID3D11Device* device, const std::string& type) {
         std::cout << "  Creating default texture of type: " << type << std::endl;
 
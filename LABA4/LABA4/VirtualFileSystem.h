@@ -0,0 +1,143 @@
+#pragma once
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include <cctype>
+
+// Индекс смонтированных каталогов: обход диска один раз при MountDirectory,
+// дальше Exists/Resolve - нормализация пути и поиск в хеш-таблице без системных вызовов.
+// Пути нормализуются (прямые слэши, нижний регистр, без "." и "..") и интернируются.
+// Более позднее монтирование перекрывает файлы с тем же путем из более раннего.
+class VirtualFileSystem {
+public:
+    bool MountDirectory(const std::string& directory, const std::string& mountPoint = "") {
+        DWORD attr = GetFileAttributesA(directory.c_str());
+        if (attr == INVALID_FILE_ATTRIBUTES || !(attr & FILE_ATTRIBUTE_DIRECTORY)) {
+            return false;
+        }
+
+        size_t before = diskPaths.size();
+        std::string diskDir = directory;
+        while (diskDir.size() > 1 && (diskDir.back() == '/' || diskDir.back() == '\\')) diskDir.pop_back();
+        ScanDirectory(diskDir, Normalize(mountPoint));
+
+        std::cout << "VFS: mounted " << directory << " at '" << mountPoint << "', "
+            << diskPaths.size() - before << " new files" << std::endl;
+        return true;
+    }
+
+    size_t Intern(const std::string& path) {
+        std::string key = Normalize(path);
+        auto it = ids.find(key);
+        if (it != ids.end()) return it->second;
+        size_t id = paths.size();
+        paths.push_back(key);
+        ids.emplace(key, id);
+        return id;
+    }
+
+    bool Exists(const std::string& path) const {
+        auto it = ids.find(Normalize(path));
+        return it != ids.end() && diskPaths.count(it->second) != 0;
+    }
+
+    // Путь на диске для загрузчиков; пустая строка, если файла нет ни в одном каталоге
+    std::string Resolve(const std::string& path) const {
+        auto it = ids.find(Normalize(path));
+        if (it == ids.end()) return std::string();
+        auto disk = diskPaths.find(it->second);
+        return disk == diskPaths.end() ? std::string() : disk->second;
+    }
+
+    bool FindFirst(const std::vector<std::string>& candidates, std::string& resolved) const {
+        for (const auto& candidate : candidates) {
+            if (Exists(candidate)) {
+                resolved = Normalize(candidate);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Точное совпадение, иначе тот же путь с одним из расширений (заменяя исходное)
+    bool FindWithExtensions(const std::string& path, const std::vector<std::string>& extensions, std::string& resolved) const {
+        if (Exists(path)) {
+            resolved = Normalize(path);
+            return true;
+        }
+        std::string base = Normalize(path);
+        size_t slash = base.find_last_of('/');
+        size_t dot = base.find_last_of('.');
+        if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) base.resize(dot);
+        for (const auto& ext : extensions) {
+            if (Exists(base + ext)) {
+                resolved = Normalize(base + ext);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t GetFileCount() const { return diskPaths.size(); }
+
+    static std::string Normalize(const std::string& path) {
+        std::vector<std::string> parts;
+        std::string part;
+        auto flush = [&]() {
+            if (part.empty() || part == ".") {}
+            else if (part == ".." && !parts.empty() && parts.back() != "..") parts.pop_back();
+            else parts.push_back(part);
+            part.clear();
+        };
+        for (char c : path) {
+            if (c == '/' || c == '\\') flush();
+            else part.push_back((char)tolower((unsigned char)c));
+        }
+        flush();
+
+        std::string out = (!path.empty() && (path[0] == '/' || path[0] == '\\')) ? "/" : "";
+        for (size_t i = 0; i < parts.size(); i++) {
+            if (i) out.push_back('/');
+            out += parts[i];
+        }
+        return out;
+    }
+
+    static std::string DirOf(const std::string& path) {
+        size_t pos = path.find_last_of("/\\");
+        return pos == std::string::npos ? "" : path.substr(0, pos + 1);
+    }
+
+    static std::string Join(const std::string& directory, const std::string& relative) {
+        bool absolute = !relative.empty() && (relative[0] == '/' || relative[0] == '\\' || relative.find(':') != std::string::npos);
+        if (absolute || directory.empty()) return Normalize(relative);
+        return Normalize(directory + "/" + relative);
+    }
+
+private:
+    void ScanDirectory(const std::string& diskDir, const std::string& virtualDir) {
+        WIN32_FIND_DATAA fd;
+        HANDLE h = FindFirstFileA((diskDir + "/*").c_str(), &fd);
+        if (h == INVALID_HANDLE_VALUE) return;
+        do {
+            // "." и "..", а также служебные каталоги вроде .vs и .git
+            if (fd.cFileName[0] == '.') continue;
+            std::string disk = diskDir + "/" + fd.cFileName;
+            std::string virt = virtualDir.empty() ? std::string(fd.cFileName) : virtualDir + "/" + fd.cFileName;
+            if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                ScanDirectory(disk, virt);
+            }
+            else {
+                diskPaths[Intern(virt)] = disk;
+            }
+        } while (FindNextFileA(h, &fd));
+        FindClose(h);
+    }
+
+    std::unordered_map<std::string, size_t> ids;
+    std::vector<std::string> paths;
+    std::unordered_map<size_t, std::string> diskPaths;
+};
\ No newline at end of file
@@ -429,68 +429,57 @@ void Window::CreateSponzaGeometry() {
     GetCurrentDirectoryA(256, currentDir);
     std::cout << "Current directory: " << currentDir << std::endl;
 
-    std::vector<std::string> possiblePaths = {
-        "models/Sponza/sponza.obj",
-        "models/Sponza/Sponza.obj",
-        "../models/Sponza/sponza.obj",
-        "C:/Users/Варя/source/repos/LABA4/LABA4/models/Sponza/sponza.obj"
-    };
+    // Каталоги моделей индексируются один раз, дальше путь к Sponza ищется по индексу.
+    // Смонтированный позже каталог перекрывает предыдущие
+    fileSystem.MountDirectory("C:/Users/Варя/source/repos/LABA4/LABA4/models", "models");
+    fileSystem.MountDirectory("../models", "models");
+    fileSystem.MountDirectory("models", "models");
 
     bool loaded = false;
-    for (const auto& path : possiblePaths) {
-        std::cout << "\nTrying path: " << path << std::endl;
-
-        DWORD fileAttr = GetFileAttributesA(path.c_str());
-        if (fileAttr == INVALID_FILE_ATTRIBUTES) {
-            std::cout << "  File does not exist" << std::endl;
-            continue;
+    const std::string path = "models/Sponza/sponza.obj";
+    if (fileSystem.Exists(path) &&
+        OBJLoader::LoadOBJ32(fileSystem, path, vertices, indices, materials, meshes, d3dDevice, true)) {
+        loaded = true;
+        std::cout << "  SUCCESS! Loaded Sponza from: " << path << std::endl;
+        std::cout << "  Vertices: " << vertices.size() << ", Indices: " << indices.size() << std::endl;
+        std::cout << "  Materials: " << materials.size() << ", Meshes: " << meshes.size() << std::endl;
+
+        int texCount = 0;
+        for (auto* mat : materials) {
+            if (mat && mat->diffuseTexture) {
+                texCount++;
+            }
         }
+        std::cout << "  Materials with textures: " << texCount << " / " << materials.size() << std::endl;
 
-        if (OBJLoader::LoadOBJ32(path, vertices, indices, materials, meshes, d3dDevice, true)) {
-            loaded = true;
-            std::cout << "  SUCCESS! Loaded Sponza from: " << path << std::endl;
-            std::cout << "  Vertices: " << vertices.size() << ", Indices: " << indices.size() << std::endl;
-            std::cout << "  Materials: " << materials.size() << ", Meshes: " << meshes.size() << std::endl;
-
-            int texCount = 0;
-            for (auto* mat : materials) {
-                if (mat && mat->diffuseTexture) {
-                    texCount++;
-                }
-            }
-            std::cout << "  Materials with textures: " << texCount << " / " << materials.size() << std::endl;
+        std::cout << "\n=== MATERIAL MAPPING ===" << std::endl;
 
-            std::cout << "\n=== MATERIAL MAPPING ===" << std::endl;
+        std::map<int, int> materialUsage;
+        for (const auto& mesh : meshes) {
+            materialUsage[mesh.materialIndex]++;
+        }
 
-            std::map<int, int> materialUsage;
-            for (const auto& mesh : meshes) {
-                materialUsage[mesh.materialIndex]++;
-            }
+        for (const auto& pair : materialUsage) {
+            int matIndex = pair.first;
+            int count = pair.second;
 
-            for (const auto& pair : materialUsage) {
-                int matIndex = pair.first;
-                int count = pair.second;
-
-                if (matIndex >= 0 && matIndex < materials.size() && materials[matIndex]) {
-                    std::cout << "Material " << matIndex << ": " << materials[matIndex]->name
-                        << " used in " << count << " meshes" << std::endl;
-                }
-                else {
-                    std::cout << "Material " << matIndex << ": INVALID used in " << count << " meshes" << std::endl;
-                }
+            if (matIndex >= 0 && matIndex < materials.size() && materials[matIndex]) {
+                std::cout << "Material " << matIndex << ": " << materials[matIndex]->name
+                    << " used in " << count << " meshes" << std::endl;
             }
-
-            if (!meshes.empty()) {
-                std::cout << "\nFirst mesh material index: " << meshes[0].materialIndex << std::endl;
-                if (meshes[0].materialIndex >= 0 && meshes[0].materialIndex < materials.size()) {
-                    std::cout << "First mesh material name: " << materials[meshes[0].materialIndex]->name << std::endl;
-                }
+            else {
+                std::cout << "Material " << matIndex << ": INVALID used in " << count << " meshes" << std::endl;
             }
+        }
 
-            std::cout << "=========================\n" << std::endl;
-
-            break;
+        if (!meshes.empty()) {
+            std::cout << "\nFirst mesh material index: " << meshes[0].materialIndex << std::endl;
+            if (meshes[0].materialIndex >= 0 && meshes[0].materialIndex < materials.size()) {
+                std::cout << "First mesh material name: " << materials[meshes[0].materialIndex]->name << std::endl;
+            }
         }
+
+        std::cout << "=========================\n" << std::endl;
     }
 
     if (!loaded) {
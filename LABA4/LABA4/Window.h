@@ -7,6 +7,7 @@
 #include <vector>
 #include "InputDevice.h"
 #include "OBJLoader.h"
+#include "VirtualFileSystem.h"
 
 class Window {
 public:
@@ -69,6 +70,7 @@ private:
 
     std::vector<Material*> materials;
     std::vector<OBJMesh> meshes;
+    VirtualFileSystem fileSystem;
     ID3D11SamplerState* samplerState = nullptr;
 
     float totalTime = 0.0f;